@@ -0,0 +1,264 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// rpc_bench - drive an in-process echo server over loopback and report QPS and
+// latency percentiles.
+//
+// Example:
+//   rpc_bench -connections=4 -depth=16 -payload_size=1024 -duration_s=10
+//   rpc_bench -address=unix:/tmp/rpc_bench.sock
+//   rpc_bench -address=[::1]:8200
+//
+// Every connection is owned by a dedicated client thread (the poller and the
+// socket map are thread local), and keeps `depth` requests in flight, so the
+// total concurrency is `connections * depth`.
+
+#include <echo.pb.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <stdio.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/histogram.h"
+
+DEFINE_int32(port, 8200, "Port of the echo server, listening on 127.0.0.1");
+DEFINE_string(address, "",
+              "Address of the echo server instead of -port, such as "
+              "[::1]:8200 or unix:/tmp/rpc_bench.sock");
+DEFINE_bool(use_shared_memory, false,
+            "Exchange messages by shared memory over a unix domain socket");
+DEFINE_int32(server_threads, 1,
+             "Number of server threads, each listening to the address by "
+             "SO_REUSEPORT if more than one");
+DEFINE_int32(connections, 1, "Number of client connections (and threads)");
+DEFINE_int32(depth, 1, "Number of in-flight requests per connection");
+DEFINE_int32(payload_size, 64, "Bytes of the echo message");
+DEFINE_int32(duration_s, 10, "Seconds to measure");
+DEFINE_int32(warmup_s, 1, "Seconds to run before measuring");
+DEFINE_bool(print_histogram, false,
+            "Print the full percentile distribution of latency");
+
+using namespace google::protobuf;
+using namespace urpc;
+using namespace test;
+
+using Clock = std::chrono::steady_clock;
+using utils::Histogram;
+
+namespace {
+
+enum Phase { PHASE_WARMUP = 0, PHASE_MEASURE = 1, PHASE_STOP = 2 };
+
+std::atomic<int> g_phase{PHASE_WARMUP};
+
+class EchoServiceImpl : public EchoService {
+public:
+    ~EchoServiceImpl() override {}
+
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        response->set_message_count(1);
+        done->Run();
+    }
+};
+
+struct ClientStats {
+    Histogram latency_us;
+    uint64_t errors{0};
+};
+
+/// An in-flight slot of a connection, it issues the next request as soon as
+/// the previous one is done.
+class Slot : public Closure {
+public:
+    Slot(EchoService_Stub* stub, const std::string* payload,
+         ClientStats* stats)
+        : stub_(stub), stats_(stats) {
+        request_.set_message(*payload);
+    }
+
+    void Issue() {
+        if (g_phase.load(std::memory_order_relaxed) == PHASE_STOP) {
+            done_ = true;
+            return;
+        }
+
+        cntl_.reset(NewURPCController());
+        response_.Clear();
+        start_ = Clock::now();
+        stub_->Echo(cntl_.get(), &request_, &response_, this);
+    }
+
+    void Run() override {
+        if (g_phase.load(std::memory_order_relaxed) == PHASE_MEASURE) {
+            if (cntl_->Failed()) {
+                stats_->errors += 1;
+            } else {
+                auto elapsed = std::chrono::duration_cast<
+                    std::chrono::microseconds>(Clock::now() - start_);
+                stats_->latency_us.Record(elapsed.count());
+            }
+        }
+        Issue();
+    }
+
+    bool done() const { return done_; }
+
+private:
+    EchoService_Stub* stub_;
+    ClientStats* stats_;
+    std::unique_ptr<Controller> cntl_;
+    EchoRequest request_;
+    EchoResponse response_;
+    Clock::time_point start_;
+    bool done_{false};
+};
+
+std::string ServerAddress() {
+    if (!FLAGS_address.empty())
+        return FLAGS_address;
+    return "127.0.0.1:" + std::to_string(FLAGS_port);
+}
+
+void RunClient(const std::string* payload, ClientStats* stats) {
+    const std::string url = ServerAddress();
+    ChannelOptions options;
+    options.use_shared_memory = FLAGS_use_shared_memory;
+    Channel channel;
+    if (channel.Init(url.c_str(), options) != 0) {
+        LOG(FATAL) << "Fail to initialize channel to " << url;
+    }
+
+    EchoService_Stub stub(&channel);
+    std::vector<std::unique_ptr<Slot>> slots;
+    for (int i = 0; i < FLAGS_depth; ++i) {
+        slots.emplace_back(new Slot(&stub, payload, stats));
+        slots.back()->Issue();
+    }
+
+    // Drain the in-flight requests, so that no slot is released while its
+    // response is pending.
+    bool all_done = false;
+    while (!all_done) {
+        IOContext context(LOOP_ONCE);
+        all_done = true;
+        for (auto&& slot : slots)
+            all_done = all_done && slot->done();
+    }
+}
+
+void PrintHistogram(const Histogram& hist) {
+    printf("%12s %14s %12s %16s\n", "Value(us)", "Percentile", "TotalCount",
+           "1/(1-Percentile)");
+    uint64_t seen = 0;
+    for (size_t i = 0; i < Histogram::kBucketCount; ++i) {
+        uint64_t count = hist.CountAt(i);
+        if (count == 0)
+            continue;
+        seen += count;
+        double ratio = static_cast<double>(seen) / hist.count();
+        printf("%12lu %14.6f %12lu %16.2f\n", Histogram::BucketLowerBound(i),
+               ratio, seen, ratio < 1.0 ? 1.0 / (1.0 - ratio) : 0.0);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    std::atomic<int> ready{0};
+    std::atomic<bool> exit{false};
+    std::vector<std::thread> servers;
+    for (int i = 0; i < FLAGS_server_threads; ++i) {
+        servers.emplace_back([&]() {
+            Server server;
+            server.AddService(new EchoServiceImpl,
+                              ServiceOwnership::SERVER_OWNS_SERVICE);
+            EndPoint endpoint;
+            ServerOptions options;
+            options.reuse_port = FLAGS_server_threads > 1;
+            if (str2endpoint(ServerAddress().c_str(), &endpoint) != 0 ||
+                server.Start(endpoint, options) != 0) {
+                PLOG(FATAL) << "Start server on " << ServerAddress();
+            }
+
+            ready.fetch_add(1, std::memory_order_release);
+            while (!exit.load(std::memory_order_acquire)) {
+                IOContext context(LOOP_ONCE);
+            }
+        });
+    }
+    while (ready.load(std::memory_order_acquire) < FLAGS_server_threads)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    const std::string payload(FLAGS_payload_size, 'x');
+    std::vector<ClientStats> stats(FLAGS_connections);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < FLAGS_connections; ++i) {
+        clients.emplace_back(RunClient, &payload, &stats[i]);
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(FLAGS_warmup_s));
+    g_phase.store(PHASE_MEASURE, std::memory_order_relaxed);
+    auto start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(FLAGS_duration_s));
+    g_phase.store(PHASE_STOP, std::memory_order_relaxed);
+    auto elapsed = std::chrono::duration<double>(Clock::now() - start);
+
+    for (auto&& client : clients)
+        client.join();
+    exit.store(true, std::memory_order_release);
+    for (auto&& server : servers)
+        server.join();
+
+    Histogram latency;
+    uint64_t errors = 0;
+    for (auto&& s : stats) {
+        latency.Merge(s.latency_us);
+        errors += s.errors;
+    }
+
+    const double seconds = elapsed.count();
+    const double qps = latency.count() / seconds;
+    printf("address=%s server_threads=%d connections=%d depth=%d "
+           "concurrency=%d payload_size=%d\n",
+           ServerAddress().c_str(), FLAGS_server_threads, FLAGS_connections,
+           FLAGS_depth, FLAGS_connections * FLAGS_depth, FLAGS_payload_size);
+    printf("requests=%lu errors=%lu elapsed=%.2fs qps=%.0f throughput=%.2fMB/s\n",
+           latency.count(), errors, seconds, qps,
+           qps * FLAGS_payload_size * 2 / (1024 * 1024));
+    printf("latency(us) avg=%.1f min=%lu p50=%lu p90=%lu p99=%lu p999=%lu "
+           "max=%lu\n",
+           latency.mean(), latency.min(), latency.Percentile(0.5),
+           latency.Percentile(0.9), latency.Percentile(0.99),
+           latency.Percentile(0.999), latency.max());
+    if (FLAGS_print_histogram)
+        PrintHistogram(latency);
+
+    return 0;
+}
@@ -1,7 +1,13 @@
 include(FetchContent)
 
+# Let the options of dependencies be overridden by normal variables.
+set(CMAKE_POLICY_DEFAULT_CMP0077 NEW)
+
 include(cmake/abseil.cmake)
 include(cmake/googletest.cmake)
 include(cmake/gflags.cmake)
 include(cmake/protobuf.cmake)
 include(cmake/glog.cmake)
+include(cmake/snappy.cmake)
+include(cmake/zstd.cmake)
+include(cmake/lz4.cmake)
@@ -0,0 +1,13 @@
+set(LZ4_BUILD_CLI OFF)
+set(LZ4_BUILD_LEGACY_LZ4C OFF)
+set(BUILD_SHARED_LIBS OFF)
+set(BUILD_STATIC_LIBS ON)
+
+FetchContent_Declare(
+    lz4
+    GIT_REPOSITORY https://github.com/lz4/lz4.git
+    GIT_TAG "v1.9.4"
+    SOURCE_SUBDIR  build/cmake
+)
+FetchContent_MakeAvailable(lz4)
+target_include_directories(lz4_static INTERFACE ${lz4_SOURCE_DIR}/lib)
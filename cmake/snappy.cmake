@@ -0,0 +1,10 @@
+set(SNAPPY_BUILD_TESTS OFF)
+set(SNAPPY_BUILD_BENCHMARKS OFF)
+set(SNAPPY_INSTALL OFF)
+
+FetchContent_Declare(
+    snappy
+    GIT_REPOSITORY https://github.com/google/snappy.git
+    GIT_TAG "1.1.10"
+)
+FetchContent_MakeAvailable(snappy)
@@ -13,6 +13,9 @@
 // limitations under the License.
 #pragma once
 
+#include <memory>
+
+#include <urpc/controller.h>
 #include <urpc/endpoint.h>
 
 #include <google/protobuf/service.h>
@@ -24,6 +27,17 @@ enum ProtocolType {
     PROTOCOL_BAIDU_STD = 1,
 };
 
+/// Decide whether a failed RPC is retried, the error is set on `cntl`.
+class RetryPolicy {
+public:
+    virtual ~RetryPolicy() = default;
+
+    /// `sent` is false if the request provably never reached the server,
+    /// e.g. the connection failed, it's always safe to retry then. The
+    /// requests might be sent should be retried only if they are idempotent.
+    virtual bool DoRetry(const Controller* cntl, bool sent) const = 0;
+};
+
 struct ChannelOptions {
     ChannelOptions();
 
@@ -41,18 +55,75 @@ struct ChannelOptions {
     // Maximum: 0x7fffffff (roughly 30 days)
     int32_t timeout_ms;
 
+    // Send the request again to another server, or by another connection to
+    // the same server, if the response has not arrived after so many
+    // milliseconds, the first response wins. -1 means no backup request.
+    //
+    // Default: -1
+    int32_t backup_request_ms;
+
+    // Retry a failed RPC at most so many times, to the server selected again
+    // by the load balancer or by reconnecting to the single server.
+    //
+    // Default: 3
+    int32_t max_retry;
+
+    // Decide whether a failed RPC is retried, not owned by the channel.
+    // nullptr retries only the requests never sent.
+    //
+    // Default: nullptr
+    const RetryPolicy* retry_policy;
+
+    // Each request deposits so many tokens into the retry budget of the
+    // channel, up to `retry_budget_max_tokens`, and each retry withdraws one.
+    // The retries are bounded to the ratio of the requests in an outage.
+    //
+    // Default: 0.1 and 10
+    double retry_budget_ratio;
+    int32_t retry_budget_max_tokens;
+
+    // Isolate the servers of too many errors, by the error rates of the
+    // RPCs over the windows of --circuit_breaker_short_window_size and
+    // --circuit_breaker_long_window_size. The servers failed to connect are
+    // always isolated. The load balancers skip the isolated servers until
+    // they are reconnected in the background.
+    //
+    // Default: false
+    bool enable_circuit_breaker;
+
+    // Exchange the messages with `unix:` servers over shared memory rings
+    // instead of the socket, which is kept only to learn when the peer goes
+    // away. Ignored for the other servers.
+    //
+    // Default: false
+    bool use_shared_memory;
+
     ProtocolType protocol;
 };
 
 class ClientTransport;
+class LoadBalancer;
+class NamingService;
+class RetryBudget;
 
 class Channel : public google::protobuf::RpcChannel {
 public:
-    Channel() {}
-    ~Channel() override = default;
+    Channel();
+    ~Channel() override;
 
+    /// Connect to a single server `ip:port`, `[ipv6]:port` or `unix:/path`,
+    /// or the servers of a naming service url with round robin.
+    /// `hostname:port` is resolved before it returns, and then like
+    /// "list://hostname:port" to follow the changes of the address.
     int Init(const char* url, const ChannelOptions& options);
 
+    /// Balance the RPCs over the servers of `naming_service_url`, such as
+    /// "list://127.0.0.1:8000,127.0.0.1:8001" or "file:///etc/servers", by
+    /// `load_balancer`: "rr", "wr", "la", "c_murmurhash" or "c_ketama",
+    /// see LoadBalancer::New().
+    int Init(const char* naming_service_url, const char* load_balancer,
+             const ChannelOptions& options);
+
 protected:
     void CallMethod(const google::protobuf::MethodDescriptor* method,
                     google::protobuf::RpcController* controller,
@@ -61,9 +132,15 @@ protected:
                     google::protobuf::Closure* done) override;
 
 private:
+    /// Reload the servers of the naming service into the load balancer.
+    int ResetServers();
+
     EndPoint server_address_;
     ChannelOptions options_;
-    ClientTransport* transport_;
+    ClientTransport* transport_{nullptr};
+    std::unique_ptr<NamingService> naming_service_;
+    std::unique_ptr<LoadBalancer> load_balancer_;
+    std::unique_ptr<RetryBudget> retry_budget_;
 };
 
 }  // namespace urpc
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include <string>
 
 #include <google/protobuf/service.h>
@@ -23,6 +25,14 @@ namespace urpc {
 
 using google::protobuf::Closure;
 
+/// The compression algorithms of request and response bodies.
+enum CompressType {
+    COMPRESS_NONE = 0,
+    COMPRESS_SNAPPY = 1,
+    COMPRESS_ZSTD = 2,
+    COMPRESS_LZ4 = 3,
+};
+
 class Controller : public google::protobuf::RpcController {
     friend class ServerTransport;
 
@@ -37,9 +47,43 @@ public:
 
     virtual void SetFailed(int err_code, std::string reason);
 
+    /// The compression of the request body, set by clients. Bodies smaller
+    /// than --compress_min_bytes are always sent uncompressed.
+    CompressType request_compress_type() const {
+        return request_compress_type_;
+    }
+    void set_request_compress_type(CompressType type) {
+        request_compress_type_ = type;
+    }
+
+    /// The compression of the response body. Clients set it to ask for
+    /// compressed responses, servers see the type asked for and could
+    /// change it before the method is done.
+    CompressType response_compress_type() const {
+        return response_compress_type_;
+    }
+    void set_response_compress_type(CompressType type) {
+        response_compress_type_ = type;
+    }
+
+    /// The key of consistent hashing load balancers, such as a hash of the
+    /// user id, the same code is sent to the same server while it's alive.
+    bool has_request_code() const { return has_request_code_; }
+    uint64_t request_code() const { return request_code_; }
+    void set_request_code(uint64_t code) {
+        has_request_code_ = true;
+        request_code_ = code;
+    }
+
 protected:
     virtual void OnComplete();
 
+    /// Clear the error of a failed attempt before the RPC is retried.
+    void ClearFailed() {
+        error_code_ = 0;
+        error_text_.clear();
+    }
+
 private:
     bool IsCanceled() const override { return false; }
     void StartCancel() override;
@@ -49,6 +93,10 @@ private:
     bool completed_;
     int error_code_{0};
     std::string error_text_;
+    CompressType request_compress_type_{COMPRESS_NONE};
+    CompressType response_compress_type_{COMPRESS_NONE};
+    bool has_request_code_{false};
+    uint64_t request_code_{0};
 };
 
 Controller* NewURPCController();
@@ -22,6 +22,8 @@
 #pragma once
 
 #include <netinet/in.h>  // in_addr
+#include <sys/socket.h>  // sockaddr_storage
+#include <sys/un.h>      // sockaddr_un
 
 #include <string>
 #include <iostream>  // std::ostream
@@ -73,20 +75,31 @@ int ip2hostname(ip_t ip, std::string* hostname);
 // NOTE: This function caches result on first call.
 const char* my_hostname();
 
-// ipv4 + port
+// ipv4 + port, ipv6 + port, or the path of a unix domain socket.
 struct EndPoint {
     EndPoint() : ip(IP_ANY), port(0) {}
     EndPoint(ip_t ip2, int port2) : ip(ip2), port(port2) {}
     explicit EndPoint(const sockaddr_in& in)
         : ip(in.sin_addr), port(ntohs(in.sin_port)) {}
+    explicit EndPoint(const sockaddr_in6& in6)
+        : ip(IP_ANY),
+          port(ntohs(in6.sin6_port)),
+          family(AF_INET6),
+          ip6(in6.sin6_addr) {}
 
     ip_t ip;
     int port;
+    // AF_INET, AF_INET6 or AF_UNIX.
+    sa_family_t family{AF_INET};
+    // The address if `family' is AF_INET6.
+    struct in6_addr ip6 {};
+    // The socket path if `family' is AF_UNIX.
+    std::string path;
 };
 
 struct EndPointStr {
     const char* c_str() const { return _buf; }
-    char _buf[INET_ADDRSTRLEN + 16];
+    char _buf[sizeof("unix:") + sizeof(sockaddr_un::sun_path)];
 };
 
 // Convert EndPoint to c-style string. Notice that you can serialize
@@ -96,10 +109,23 @@ struct EndPointStr {
 EndPointStr endpoint2str(const EndPoint&);
 
 // Convert string `ip_and_port_str' to a EndPoint *point.
+// `ip_and_port_str' is in the form of `127.0.0.1:8000', `[::1]:8000' or
+// `unix:/path/to/socket'.
 // Returns 0 on success, -1 otherwise.
 int str2endpoint(const char* ip_and_port_str, EndPoint* point);
 int str2endpoint(const char* ip_str, int port, EndPoint* point);
 
+// Convert `point' to the socket address of its family, the length of the
+// address is written into `len'.
+// Returns 0 on success, -1 otherwise.
+int endpoint2sockaddr(const EndPoint& point, struct sockaddr_storage* ss,
+                      socklen_t* len);
+
+// Convert a socket address of AF_INET, AF_INET6 or AF_UNIX to `point'.
+// Returns 0 on success, -1 otherwise.
+int sockaddr2endpoint(const struct sockaddr_storage* ss, socklen_t len,
+                      EndPoint* point);
+
 // Convert `hostname_and_port_str' to a EndPoint *point.
 // Returns 0 on success, -1 otherwise.
 int hostname2endpoint(const char* ip_and_port_str, EndPoint* point);
@@ -113,14 +139,23 @@ int endpoint2hostname(const EndPoint& point, std::string* host);
 
 // Create a TCP socket and connect it to `server'. Write port of this side
 // into `self_port' if it's not NULL.
+// A unix domain socket is created if `server' is a socket path.
 // Returns the socket descriptor, -1 otherwise and errno is set.
-int tcp_connect(EndPoint server, int* self_port);
+int tcp_connect(const EndPoint& server, int* self_port);
 
 // Create and listen to a TCP socket bound with `ip_and_port'.
+// A unix domain socket is created if `ip_and_port' is a socket path, the
+// stale socket file left by the last process is removed.
 // To enable SO_REUSEADDR for the whole program, enable gflag -reuse_addr
 // To enable SO_REUSEPORT for the whole program, enable gflag -reuse_port
 // Returns the socket descriptor, -1 otherwise and errno is set.
-int tcp_listen(EndPoint ip_and_port);
+int tcp_listen(const EndPoint& ip_and_port);
+
+// Same as above, but SO_REUSEPORT is enabled by `reuse_port' instead of the
+// gflag, so that several sockets could listen to `ip_and_port' and the
+// kernel spreads the connections over them. errno is set to EINVAL if
+// `reuse_port' is true for a socket path.
+int tcp_listen(const EndPoint& ip_and_port, bool reuse_port);
 
 // Get the local end of a socket connection
 int get_local_side(int fd, EndPoint* out);
@@ -151,20 +186,33 @@ inline std::ostream& operator<<(std::ostream& os, urpc::ip_t ip) {
 }
 
 namespace urpc {
+// Compare the endpoints by family, then address and port or path.
+// Returns a negative value, 0 or a positive value like strcmp.
+int compare_endpoint(const EndPoint& p1, const EndPoint& p2);
+
 // Overload operators for EndPoint in the same namespace due to ADL.
-inline bool operator<(EndPoint p1, EndPoint p2) {
-    return (p1.ip != p2.ip) ? (p1.ip < p2.ip) : (p1.port < p2.port);
+
+inline bool operator<(const EndPoint& p1, const EndPoint& p2) {
+    return compare_endpoint(p1, p2) < 0;
+}
+inline bool operator>(const EndPoint& p1, const EndPoint& p2) {
+    return p2 < p1;
+}
+inline bool operator<=(const EndPoint& p1, const EndPoint& p2) {
+    return !(p2 < p1);
+}
+inline bool operator>=(const EndPoint& p1, const EndPoint& p2) {
+    return !(p1 < p2);
+}
+inline bool operator==(const EndPoint& p1, const EndPoint& p2) {
+    return compare_endpoint(p1, p2) == 0;
 }
-inline bool operator>(EndPoint p1, EndPoint p2) { return p2 < p1; }
-inline bool operator<=(EndPoint p1, EndPoint p2) { return !(p2 < p1); }
-inline bool operator>=(EndPoint p1, EndPoint p2) { return !(p1 < p2); }
-inline bool operator==(EndPoint p1, EndPoint p2) {
-    return p1.ip == p2.ip && p1.port == p2.port;
+inline bool operator!=(const EndPoint& p1, const EndPoint& p2) {
+    return !(p1 == p2);
 }
-inline bool operator!=(EndPoint p1, EndPoint p2) { return !(p1 == p2); }
 
 inline std::ostream& operator<<(std::ostream& os, const EndPoint& ep) {
-    return os << ep.ip << ':' << ep.port;
+    return os << endpoint2str(ep).c_str();
 }
 inline std::ostream& operator<<(std::ostream& os, const EndPointStr& ep_str) {
     return os << ep_str.c_str();
@@ -0,0 +1,80 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace urpc {
+
+class IOBuf;
+
+/// The reply of a redis command, encoded into RESP as it is appended. A
+/// command replies exactly one value, an array counts as one value and is
+/// followed by its elements.
+class RedisReply {
+public:
+    explicit RedisReply(IOBuf* buf) : buf_(buf) {}
+
+    /// A simple string, such as "OK". Line breaks are replaced by spaces.
+    void AppendStatus(std::string_view status);
+
+    /// An error, such as "ERR no such key". Line breaks are replaced by
+    /// spaces.
+    void AppendError(std::string_view message);
+
+    void AppendInteger(int64_t value);
+
+    /// A bulk string, binary safe.
+    void AppendString(std::string_view value);
+
+    /// The null bulk string, a missing value.
+    void AppendNull();
+
+    /// The header of an array, followed by `size` elements.
+    void AppendArray(size_t size);
+
+private:
+    void AppendLine(char type, std::string_view line);
+
+    IOBuf* const buf_;
+};
+
+/// The handler of a redis command, `args[0]` is the command name as sent by
+/// the client. It runs in the poller thread and must reply before returning.
+using RedisCommandHandler = std::function<void(
+    const std::vector<std::string>& args, RedisReply* reply)>;
+
+/// The table of redis commands served by a server.
+class RedisService {
+public:
+    /// Register the handler of command `name`, case-insensitive. False is
+    /// returned if the command is already registered.
+    bool AddCommandHandler(std::string_view name, RedisCommandHandler handler);
+
+    /// Find the handler of command `name`, case-insensitive. Return
+    /// [`nullptr`] if no such command is registered.
+    const RedisCommandHandler* FindCommandHandler(std::string_view name) const;
+
+private:
+    std::unordered_map<std::string, RedisCommandHandler> handlers_;
+};
+
+}  // namespace urpc
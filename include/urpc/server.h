@@ -14,7 +14,10 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include <memory>
+#include <string>
 
 #include <urpc/endpoint.h>
 
@@ -26,6 +29,32 @@ namespace urpc {
 enum ServiceOwnership { SERVER_OWNS_SERVICE, SERVER_DOESNT_OWN_SERVICE };
 
 class ServerImpl;
+class RedisService;
+
+struct ServerOptions {
+    ServerOptions();
+
+    // Listen with SO_REUSEPORT, so that each thread could start a server on
+    // the same address with its own listening socket, and the kernel spreads
+    // the connections over them without handing them off between threads.
+    // Not supported by unix domain sockets.
+    //
+    // Default: -reuse_port
+    bool reuse_port;
+
+    // Close the connections accepted once so many connections are open, so
+    // that a reconnect storm doesn't exhaust the descriptors or the memory.
+    // 0 means unlimited.
+    //
+    // Default: 0
+    int32_t max_connections;
+
+    // Close the connections which read or write nothing for so many seconds
+    // while no response is being written. -1 means never.
+    //
+    // Default: -1
+    int32_t idle_timeout_s;
+};
 
 class Server {
 public:
@@ -33,10 +62,43 @@ public:
     ~Server();
 
     int Start(EndPoint ip_port);
+    int Start(EndPoint ip_port, const ServerOptions& options);
+
+    /// Stop accepting connections and ask the clients to go away: the
+    /// responses of urpc carry a draining flag, h2 connections receive
+    /// GOAWAY and HTTP responses `Connection: close`. The requests in
+    /// processing are still served. Called by the thread which starts the
+    /// server, -1 is returned if it isn't started.
+    int Stop();
+
+    /// Loop the thread until the connections of the server are closed, each
+    /// once no request of the thread is in processing and nothing is being
+    /// written to it. The connections left after `timeout_ms` are closed at
+    /// once, -1 means no timeout. Called after Stop() by the same thread.
+    int Join(int timeout_ms = -1);
 
     int AddService(google::protobuf::Service* service,
                    ServiceOwnership ownership);
 
+    /// Limit the requests in processing of the server: "unlimited" (the
+    /// default), a positive number, or "auto" to adapt the limit to the
+    /// capacity measured by the qps and latency. The excess requests fail
+    /// with ERR_LIMITED before they are parsed. -1 is returned for invalid
+    /// values. Like the services, the limit is per thread: it applies to the
+    /// servers of the calling thread, so each thread serving with
+    /// `reuse_port` sets its own.
+    int SetMaxConcurrency(const std::string& max_concurrency);
+
+    /// Limit the requests in processing of the method `full_name` (such as
+    /// "test.EchoService.Echo") which is added already, in addition to the
+    /// limit of the server. It's per thread too.
+    int SetMethodMaxConcurrency(const std::string& full_name,
+                                const std::string& max_concurrency);
+
+    /// Serve the redis commands of `service` on the same port. Only one redis
+    /// service could be added, -1 is returned if there is one already.
+    int AddRedisService(RedisService* service, ServiceOwnership ownership);
+
 private:
     std::unique_ptr<ServerImpl> impl_;
 };
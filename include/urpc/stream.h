@@ -0,0 +1,80 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+
+#include <urpc/controller.h>
+
+namespace urpc {
+
+class IOBuf;
+class StreamWriter;
+
+/// Receives the chunks of a stream, invoked in the poller thread of the
+/// connection.
+class StreamReader {
+public:
+    virtual ~StreamReader() = default;
+
+    /// A chunk written by the peer, in the order of writes. The window of the
+    /// peer is opened once it returns.
+    virtual void OnChunk(StreamWriter* stream, IOBuf chunk) = 0;
+
+    /// The peer closed the stream (`error_code` is 0), or the stream is
+    /// broken. No more chunks follow, but the stream still needs Close().
+    virtual void OnClosed(StreamWriter* stream, int error_code) = 0;
+};
+
+struct StreamOptions {
+    /// The chunks of the peer, nullptr if the stream is write only.
+    StreamReader* reader{nullptr};
+
+    /// The bytes the peer could write before they are consumed by `reader`.
+    int64_t window_size{2 * 1024 * 1024};
+};
+
+/// The local end of a stream bound to a RPC, which carries chunks in both
+/// directions over the connection of the RPC.
+class StreamWriter {
+public:
+    virtual uint64_t id() const = 0;
+
+    /// Write a chunk. ERR_STREAM_FULL is returned if the chunks in flight
+    /// reach the window of the peer, or before a created stream is accepted,
+    /// ERR_STREAM_CLOSED once the stream is closed.
+    virtual int Write(IOBuf chunk) = 0;
+
+    /// Run `done` once the stream is writable, at once if it is already, or
+    /// if it is closed.
+    virtual void NotifyOnWritable(Closure* done) = 0;
+
+    /// Close the stream and release it, it must be called exactly once and
+    /// the stream is invalid since then. Chunks written are still delivered.
+    virtual void Close() = 0;
+
+protected:
+    virtual ~StreamWriter() = default;
+};
+
+/// Create a stream for the RPC of `cntl` (see NewURPCController()) before it
+/// is issued. The stream is writable once the server accepts it, otherwise
+/// it's closed with ERR_STREAM_CLOSED when the response arrives.
+StreamWriter* StreamCreate(Controller* cntl, const StreamOptions& options);
+
+/// Accept the stream created by the client, in the method of the RPC of
+/// `cntl`. nullptr is returned if the client didn't create one.
+StreamWriter* StreamAccept(Controller* cntl, const StreamOptions& options);
+
+}  // namespace urpc
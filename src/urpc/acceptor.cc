@@ -15,45 +15,149 @@
 #include "acceptor.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <string>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "urpc/poller.h"
 #include "urpc/server_transport.h"
+#include "urpc/socket_options.h"
+#include "utils/atomic.h"
+
+DEFINE_int32(accept_batch, 64,
+             "The connections accepted by a wakeup of the poller at most, the "
+             "rest are accepted after the other events of the loop");
 
 namespace urpc {
 
-Acceptor::Acceptor(int listen_fd) : listen_fd_(listen_fd) {
+/// The delay to accept again after the descriptors or the memory run out.
+static constexpr int64_t kAcceptRetryMs = 100;
+
+Acceptor::Acceptor(int listen_fd, int max_connections, int idle_timeout_s)
+    : listen_fd_(listen_fd),
+      max_connections_(max_connections),
+      idle_timeout_s_(idle_timeout_s),
+      poller_id_(Poller::singleton()->id()),
+      created_(std::chrono::steady_clock::now()),
+      reserve_fd_(open("/dev/null", O_RDONLY | O_CLOEXEC)),
+      group_(std::make_shared<ConnectionGroup>()) {
+    StatsRegistry::singleton()->Register(this);
     Poller::singleton()->AddPollIn(this);
 }
 
-Acceptor::~Acceptor() {}
+Acceptor::~Acceptor() { StatsRegistry::singleton()->Unregister(this); }
+
+void Acceptor::GetStats(AcceptorStats* stats) const {
+    stats->listen_fd = listen_fd_;
+    stats->poller_id = poller_id_;
+    stats->accepted = accepted_.load(std::memory_order_relaxed);
+    stats->rejected = rejected_.load(std::memory_order_relaxed);
+    stats->connections = group_->count.load(std::memory_order_relaxed);
+    stats->uptime_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - created_)
+                           .count();
+}
 
 int Acceptor::HandleReadEvent() {
-    while (true) {
+    // Stopped before the timer to accept runs.
+    if (!listen_fd_.valid())
+        return 0;
+    const int batch = std::max(FLAGS_accept_batch, 1);
+    for (int i = 0; i < batch; ++i) {
         // REQUIRED: Linux 2.6.28, glibc 2.10
-        int fd = accept4(listen_fd_, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        struct sockaddr_storage addr;
+        socklen_t addr_len = sizeof(addr);
+        int fd = accept4(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr),
+                         &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (fd < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-                break;
-            else if (errno == EINTR)
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            } else if (errno == EINTR || errno == ECONNABORTED) {
                 continue;
-            else
-                PLOG(FATAL) << "accept4";
+            } else if ((errno == EMFILE || errno == ENFILE) &&
+                       ShedConnection()) {
+                continue;
+            }
+            PLOG(ERROR) << "Fail to accept from fd "
+                        << static_cast<int>(listen_fd_);
+            ScheduleAccept(kAcceptRetryMs);
+            return 0;
+        }
+
+        utils::IncreaseRelaxed(&accepted_, 1);
+        if (max_connections_ > 0 &&
+            group_->transports.size() >=
+                static_cast<size_t>(max_connections_)) {
+            LOG(WARNING) << "Reject new fd " << fd << " over "
+                         << max_connections_ << " connections";
+            utils::IncreaseRelaxed(&rejected_, 1);
+            close(fd);
+            continue;
         }
 
         LOG(INFO) << "Accept new fd " << fd;
+        EndPoint remote_side;
+        sockaddr2endpoint(&addr, addr_len, &remote_side);
+        SetSocketOptions(fd, remote_side.family);
 
-        auto server_cntl = new ServerTransport(fd);
+        auto server_cntl = new ServerTransport(fd, remote_side);
+        server_cntl->set_group(group_);
+        server_cntl->set_idle_timeout_s(idle_timeout_s_);
         server_cntl->StartRead();
+        // Owned by the poller and the calls in processing from now on.
+        server_cntl->RelRef();
     }
+
+    // The batch is used up, the rest are accepted in the next loop.
+    ScheduleAccept(0);
     return 0;
 }
 
+void Acceptor::ScheduleAccept(int64_t delay_ms) {
+    if (timer_id_ != 0)
+        return;
+    AddRef();
+    timer_id_ = Poller::singleton()->AddTimer(delay_ms, [this] {
+        timer_id_ = 0;
+        HandleReadEvent();
+        RelRef();
+    });
+}
+
+void Acceptor::Stop() {
+    if (poll_in())
+        Poller::singleton()->RemoveConsumer(this);
+    if (timer_id_ != 0 && Poller::singleton()->RemoveTimer(timer_id_)) {
+        timer_id_ = 0;
+        RelRef();
+    }
+    listen_fd_.reset();
+    reserve_fd_.reset();
+}
+
+bool Acceptor::ShedConnection() {
+    if (!reserve_fd_.valid())
+        return false;
+    reserve_fd_.reset();
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd >= 0) {
+        LOG(WARNING) << "Reject new fd " << fd << " as descriptors run out";
+        utils::IncreaseRelaxed(&accepted_, 1);
+        utils::IncreaseRelaxed(&rejected_, 1);
+        close(fd);
+    }
+    reserve_fd_ = OwnedFD(open("/dev/null", O_RDONLY | O_CLOEXEC));
+    return fd >= 0;
+}
+
 int Acceptor::HandleWriteEvent() {
     LOG(FATAL) << "Not supported";
     return 0;
@@ -13,16 +13,28 @@
 // limitations under the License.
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
 
 #include "base.h"
 #include "owned_fd.h"
+#include "server_transport.h"
+#include "stats.h"
 
 namespace urpc {
 
+/// Accept the connections of a listening socket in the poller thread which
+/// creates it. At most -accept_batch connections are accepted by a wakeup,
+/// so that a reconnect storm doesn't starve the other I/O of the loop.
 class Acceptor : public IOHandle {
 public:
-    explicit Acceptor(int listen_fd);
+    /// `max_connections` bounds the open connections accepted, the excess
+    /// ones are closed at once. 0 means unlimited. The connections idle for
+    /// `idle_timeout_s` seconds are closed, -1 means never.
+    explicit Acceptor(int listen_fd, int max_connections = 0,
+                      int idle_timeout_s = -1);
     ~Acceptor() override;
 
     int fd() const override { return listen_fd_; }
@@ -32,8 +44,37 @@ public:
 
     void Reset(int code, std::string reason) override;
 
+    /// Take a snapshot of the counters, it could be invoked from any thread.
+    void GetStats(AcceptorStats* stats) const;
+
+    /// The connections accepted and not reset yet.
+    const std::shared_ptr<ConnectionGroup>& group() const { return group_; }
+
+    /// Stop accepting connections and close the listening socket, the
+    /// connections accepted are left open.
+    void Stop();
+
 private:
+    /// Accept the connections left in the backlog after `delay_ms`
+    /// milliseconds, since the edge triggered poller won't report them
+    /// again.
+    void ScheduleAccept(int64_t delay_ms);
+
+    /// Accept a connection by the reserved descriptor and close it at once
+    /// if the descriptors run out, so that the client fails fast instead of
+    /// waiting in the backlog. false is returned if none is shed.
+    bool ShedConnection();
+
     OwnedFD listen_fd_;
+    const int max_connections_;
+    const int idle_timeout_s_;
+    const uint64_t poller_id_;
+    const std::chrono::steady_clock::time_point created_;
+    OwnedFD reserve_fd_;
+    uint64_t timer_id_{0};
+    std::atomic<uint64_t> accepted_{0};
+    std::atomic<uint64_t> rejected_{0};
+    std::shared_ptr<ConnectionGroup> group_;
 };
 
 }  // namespace urpc
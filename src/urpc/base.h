@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include <string>
 
 #include "utils/owner_ptr.h"
@@ -28,13 +30,42 @@ enum ErrCode : int {
     ERR_MISMATCH = 1002,
     /// This protocol doesn't supported.
     ERR_NOT_SUPPORTED = 1003,
+    /// The peer closed the connection.
+    ERR_EOF = 1004,
+    /// Failed to compress or decompress a body.
+    ERR_COMPRESS = 1005,
+    /// The window of the stream is exhausted, write once it's writable.
+    ERR_STREAM_FULL = 1006,
+    /// The stream is closed by the peer, or the connection is broken.
+    ERR_STREAM_CLOSED = 1007,
+    /// The write queue of the connection is above the high watermark.
+    ERR_OVERLOADED = 1008,
+    /// The request exceeds the max concurrency of the server or the method.
+    ERR_LIMITED = 1009,
+    /// No server is available for the channel.
+    ERR_NO_SERVER = 1010,
+    /// Failed to connect to the server, or the connection is broken.
+    ERR_CONNECT = 1011,
+    /// The connection is closed since it's idle for too long.
+    ERR_IDLE = 1012,
 };
 
 class IOHandle : public utils::RefCount {
     friend class IOHandleAccessor;
 
 public:
-    virtual ~IOHandle() {}
+    IOHandle();
+    virtual ~IOHandle();
+
+    /// The process-wide id of the handle, the version of its slot in the
+    /// high 32 bits and the slot in the low ones. The slot is reused once the
+    /// handle is destroyed, with another version.
+    uint64_t id() const noexcept { return id_; }
+
+    /// Take a reference of the handle of `id` from any thread, the pointer is
+    /// null if it's destroyed or being destroyed. The handle is still served
+    /// by the thread of its poller, the others only hold it.
+    static utils::owner_ptr<IOHandle> Address(uint64_t id);
 
     virtual int fd() const = 0;
 
@@ -50,6 +81,7 @@ private:
     enum : unsigned { kPollIn = 1 << 0, kPollOut = 1 << 1 };
 
     unsigned flags_{0};
+    const uint64_t id_;
 };
 
 class IOHandleAccessor {
@@ -0,0 +1,345 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "builtin_service.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "urpc/method_status.h"
+#include "urpc/stats.h"
+
+namespace urpc {
+namespace builtin {
+
+namespace {
+
+double Ratio(uint64_t numerator, uint64_t denominator) {
+    return denominator ? static_cast<double>(numerator) / denominator : 0.0;
+}
+
+void RenderIndex(std::ostream& os) {
+    os << "/health\n"
+       << "/status\n"
+       << "/connections\n"
+       << "/metrics\n";
+}
+
+void RenderStatus(std::ostream& os) {
+    os << std::fixed << std::setprecision(1);
+    os << "[methods]\n";
+    for (auto&& method : MethodStatusRegistry::singleton()->SampleAll()) {
+        const auto& latency = method.latency;
+        os << method.full_name << "\n"
+           << "  count: " << latency.total_count << " errors: "
+           << method.errors << " processing: " << method.processing
+           << " rejected: " << method.rejected << " max_concurrency: "
+           << (method.max_concurrency
+                   ? std::to_string(method.max_concurrency)
+                   : std::string("unlimited"))
+           << "\n"
+           << "  qps: " << latency.qps << " latency(us): avg=" << latency.avg_us
+           << " p50=" << latency.p50_us << " p90=" << latency.p90_us
+           << " p99=" << latency.p99_us << " p999=" << latency.p999_us
+           << " max=" << latency.window_max_us << " (last "
+           << latency.window_s << "s)\n";
+    }
+
+    os << "\n[iobuf]\n"
+       << "block_count: " << IOBuf::block_count() << "\n"
+       << "block_memory: " << IOBuf::block_memory() << "\n"
+       << "new_bigview_count: " << IOBuf::new_bigview_count() << "\n"
+       << "block_count_hit_tls_threshold: "
+       << IOBuf::block_count_hit_tls_threshold() << "\n";
+
+    auto registry = StatsRegistry::singleton();
+    os << "\n[pollers]\n";
+    for (auto&& poller : registry->ListPollers()) {
+        os << "id=" << poller.id << " tid=" << poller.tid
+           << " handles=" << poller.handles << " wakeups=" << poller.wakeups
+           << " events=" << poller.events
+           << " events/wakeup=" << Ratio(poller.events, poller.wakeups)
+           << " max_events/wakeup=" << poller.max_events_per_wakeup
+           << " load=" << 100 * Ratio(poller.busy_us, poller.uptime_us)
+           << "%\n";
+    }
+
+    os << "\n[acceptors]\n";
+    for (auto&& acceptor : registry->ListAcceptors()) {
+        os << "fd=" << acceptor.listen_fd << " poller=" << acceptor.poller_id
+           << " accepted=" << acceptor.accepted
+           << " rejected=" << acceptor.rejected
+           << " connections=" << acceptor.connections << " accept_rate="
+           << 1e6 * Ratio(acceptor.accepted, acceptor.uptime_us) << "/s\n";
+    }
+}
+
+void RenderConnections(std::ostream& os) {
+    os << std::left << std::setw(6) << "fd" << std::setw(8) << "side"
+       << std::setw(22) << "remote" << std::setw(8) << "poller"
+       << std::setw(14) << "bytes_in" << std::setw(14) << "bytes_out"
+       << std::setw(12) << "msgs_in" << std::setw(12) << "msgs_out"
+       << std::setw(10) << "r_eagain" << std::setw(10) << "w_eagain"
+       << std::setw(10) << "pending" << std::setw(15) << "pending_bytes"
+       << std::setw(12) << "overloaded" << "rejected\n";
+    for (auto&& conn : StatsRegistry::singleton()->ListTransports()) {
+        os << std::setw(6) << conn.fd << std::setw(8)
+           << (conn.server_side ? "server" : "client") << std::setw(22)
+           << endpoint2str(conn.remote_side).c_str() << std::setw(8)
+           << conn.poller_id << std::setw(14) << conn.bytes_in
+           << std::setw(14) << conn.bytes_out << std::setw(12)
+           << conn.messages_in << std::setw(12) << conn.messages_out
+           << std::setw(10) << conn.read_eagain << std::setw(10)
+           << conn.write_eagain << std::setw(10) << conn.pending_writes
+           << std::setw(15) << conn.pending_bytes << std::setw(12)
+           << conn.overloaded << conn.rejected_writes << "\n";
+    }
+}
+
+/// Write a metric family in the Prometheus text exposition format.
+class MetricWriter {
+public:
+    explicit MetricWriter(std::ostream& os) : os_(os) {}
+
+    void Family(const char* name, const char* type, const char* help) {
+        os_ << "# HELP " << name << " " << help << "\n"
+            << "# TYPE " << name << " " << type << "\n";
+    }
+
+    template <typename T>
+    void Sample(const char* name, const std::string& labels, T value) {
+        os_ << name;
+        if (!labels.empty())
+            os_ << "{" << labels << "}";
+        os_ << " " << value << "\n";
+    }
+
+private:
+    std::ostream& os_;
+};
+
+std::string Label(const char* key, const std::string& value) {
+    return std::string(key) + "=\"" + value + "\"";
+}
+
+void RenderMetrics(std::ostream& os) {
+    MetricWriter writer(os);
+
+    auto methods = MethodStatusRegistry::singleton()->SampleAll();
+    writer.Family("urpc_method_latency_us", "summary",
+                  "Latency of the succeeded requests in microseconds");
+    for (auto&& method : methods) {
+        const auto& latency = method.latency;
+        const std::string label = Label("method", method.full_name);
+        writer.Sample("urpc_method_latency_us",
+                      label + "," + Label("quantile", "0.5"), latency.p50_us);
+        writer.Sample("urpc_method_latency_us",
+                      label + "," + Label("quantile", "0.9"), latency.p90_us);
+        writer.Sample("urpc_method_latency_us",
+                      label + "," + Label("quantile", "0.99"), latency.p99_us);
+        writer.Sample("urpc_method_latency_us",
+                      label + "," + Label("quantile", "0.999"),
+                      latency.p999_us);
+        writer.Sample("urpc_method_latency_us_sum", label,
+                      latency.total_sum_us);
+        writer.Sample("urpc_method_latency_us_count", label,
+                      latency.total_count);
+    }
+    writer.Family("urpc_method_errors_total", "counter",
+                  "The number of failed requests");
+    for (auto&& method : methods) {
+        writer.Sample("urpc_method_errors_total",
+                      Label("method", method.full_name), method.errors);
+    }
+    writer.Family("urpc_method_processing", "gauge",
+                  "The number of requests in processing");
+    for (auto&& method : methods) {
+        writer.Sample("urpc_method_processing",
+                      Label("method", method.full_name), method.processing);
+    }
+
+    writer.Family("urpc_method_rejected_total", "counter",
+                  "The number of requests rejected by the concurrency limits");
+    for (auto&& method : methods) {
+        writer.Sample("urpc_method_rejected_total",
+                      Label("method", method.full_name), method.rejected);
+    }
+    writer.Family("urpc_method_max_concurrency", "gauge",
+                  "The limit of the requests in processing of the method");
+    for (auto&& method : methods) {
+        if (method.max_concurrency) {
+            writer.Sample("urpc_method_max_concurrency",
+                          Label("method", method.full_name),
+                          method.max_concurrency);
+        }
+    }
+
+    writer.Family("urpc_iobuf_block_count", "gauge",
+                  "The number of IOBuf blocks in use");
+    writer.Sample("urpc_iobuf_block_count", "", IOBuf::block_count());
+    writer.Family("urpc_iobuf_block_memory_bytes", "gauge",
+                  "The memory of IOBuf blocks in use");
+    writer.Sample("urpc_iobuf_block_memory_bytes", "", IOBuf::block_memory());
+
+    auto registry = StatsRegistry::singleton();
+    auto pollers = registry->ListPollers();
+    writer.Family("urpc_poller_wakeups_total", "counter",
+                  "The number of wakeups with events of the poller");
+    for (auto&& poller : pollers) {
+        writer.Sample("urpc_poller_wakeups_total",
+                      Label("poller", std::to_string(poller.id)),
+                      poller.wakeups);
+    }
+    writer.Family("urpc_poller_events_total", "counter",
+                  "The number of events dispatched by the poller");
+    for (auto&& poller : pollers) {
+        writer.Sample("urpc_poller_events_total",
+                      Label("poller", std::to_string(poller.id)),
+                      poller.events);
+    }
+    writer.Family("urpc_poller_busy_us_total", "counter",
+                  "The time spent in dispatching events in microseconds");
+    for (auto&& poller : pollers) {
+        writer.Sample("urpc_poller_busy_us_total",
+                      Label("poller", std::to_string(poller.id)),
+                      poller.busy_us);
+    }
+    writer.Family("urpc_poller_handles", "gauge",
+                  "The number of I/O handles registered in the poller");
+    for (auto&& poller : pollers) {
+        writer.Sample("urpc_poller_handles",
+                      Label("poller", std::to_string(poller.id)),
+                      poller.handles);
+    }
+
+    writer.Family("urpc_acceptor_accepted_total", "counter",
+                  "The number of accepted connections");
+    for (auto&& acceptor : registry->ListAcceptors()) {
+        writer.Sample("urpc_acceptor_accepted_total",
+                      Label("fd", std::to_string(acceptor.listen_fd)),
+                      acceptor.accepted);
+    }
+    writer.Family("urpc_acceptor_rejected_total", "counter",
+                  "The number of accepted connections closed at once, over "
+                  "the limit or as the descriptors run out");
+    for (auto&& acceptor : registry->ListAcceptors()) {
+        writer.Sample("urpc_acceptor_rejected_total",
+                      Label("fd", std::to_string(acceptor.listen_fd)),
+                      acceptor.rejected);
+    }
+    writer.Family("urpc_acceptor_connections", "gauge",
+                  "The number of open connections accepted");
+    for (auto&& acceptor : registry->ListAcceptors()) {
+        writer.Sample("urpc_acceptor_connections",
+                      Label("fd", std::to_string(acceptor.listen_fd)),
+                      acceptor.connections);
+    }
+
+    // Connections are aggregated per poller to bound the cardinality.
+    struct Aggregated {
+        uint64_t connections{0};
+        uint64_t bytes_in{0};
+        uint64_t bytes_out{0};
+        uint64_t pending_bytes{0};
+        uint64_t overloaded{0};
+        uint64_t rejected_writes{0};
+    };
+    std::vector<std::pair<uint64_t, Aggregated>> per_poller;
+    for (auto&& conn : registry->ListTransports()) {
+        auto it = std::find_if(
+            per_poller.begin(), per_poller.end(),
+            [&conn](const auto& item) { return item.first == conn.poller_id; });
+        if (it == per_poller.end()) {
+            per_poller.push_back({conn.poller_id, Aggregated()});
+            it = per_poller.end() - 1;
+        }
+        it->second.connections += 1;
+        it->second.bytes_in += conn.bytes_in;
+        it->second.bytes_out += conn.bytes_out;
+        it->second.pending_bytes += conn.pending_bytes;
+        it->second.overloaded += conn.overloaded;
+        it->second.rejected_writes += conn.rejected_writes;
+    }
+    writer.Family("urpc_connections", "gauge", "The number of connections");
+    for (auto&& [id, value] : per_poller) {
+        writer.Sample("urpc_connections", Label("poller", std::to_string(id)),
+                      value.connections);
+    }
+    writer.Family("urpc_connection_bytes_in", "gauge",
+                  "The bytes read by the live connections");
+    for (auto&& [id, value] : per_poller) {
+        writer.Sample("urpc_connection_bytes_in",
+                      Label("poller", std::to_string(id)), value.bytes_in);
+    }
+    writer.Family("urpc_connection_bytes_out", "gauge",
+                  "The bytes written by the live connections");
+    for (auto&& [id, value] : per_poller) {
+        writer.Sample("urpc_connection_bytes_out",
+                      Label("poller", std::to_string(id)), value.bytes_out);
+    }
+    writer.Family("urpc_connection_pending_bytes", "gauge",
+                  "The bytes waiting in the write queues");
+    for (auto&& [id, value] : per_poller) {
+        writer.Sample("urpc_connection_pending_bytes",
+                      Label("poller", std::to_string(id)),
+                      value.pending_bytes);
+    }
+    writer.Family("urpc_connection_overloaded", "gauge",
+                  "The times the live connections exceeded the high watermark");
+    for (auto&& [id, value] : per_poller) {
+        writer.Sample("urpc_connection_overloaded",
+                      Label("poller", std::to_string(id)), value.overloaded);
+    }
+    writer.Family("urpc_connection_rejected_writes", "gauge",
+                  "The writes rejected by the overloaded live connections");
+    for (auto&& [id, value] : per_poller) {
+        writer.Sample("urpc_connection_rejected_writes",
+                      Label("poller", std::to_string(id)),
+                      value.rejected_writes);
+    }
+}
+
+}  // namespace
+
+bool RenderPage(std::string_view path, Page* page) {
+    path = path.substr(0, path.find('?'));
+
+    std::ostringstream os;
+    if (path == "/") {
+        RenderIndex(os);
+    } else if (path == "/health") {
+        os << "OK\n";
+    } else if (path == "/status") {
+        RenderStatus(os);
+    } else if (path == "/connections") {
+        RenderConnections(os);
+    } else if (path == "/metrics") {
+        // The version of the text exposition format.
+        page->content_type = "text/plain; version=0.0.4";
+        RenderMetrics(os);
+    } else {
+        return false;
+    }
+
+    page->status_code = 200;
+    page->body.append(os.str());
+    return true;
+}
+
+}  // namespace builtin
+}  // namespace urpc
@@ -0,0 +1,43 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "urpc/iobuf.h"
+
+namespace urpc {
+namespace builtin {
+
+/// A rendered builtin page.
+struct Page {
+    int status_code{200};
+    std::string content_type{"text/plain"};
+    IOBuf body;
+};
+
+/// Render the builtin page of `path` (the query string is ignored), false is
+/// returned if no such page exists.
+///
+/// Pages:
+///   /             the index of pages
+///   /health       "OK" if the server is alive
+///   /status       per-method latency, iobuf memory, poller and acceptor load
+///   /connections  the counters of all connections
+///   /metrics      all above in the Prometheus text exposition format
+bool RenderPage(std::string_view path, Page* page);
+
+}  // namespace builtin
+}  // namespace urpc
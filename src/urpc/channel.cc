@@ -12,17 +12,24 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <string.h>
+
 #include <glog/logging.h>
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/message.h>
 #include <urpc/channel.h>
 #include <urpc/endpoint.h>
 
+#include <chrono>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "base.h"
 #include "client_call.h"
 #include "client_transport.h"
+#include "load_balancer.h"
+#include "naming_service.h"
 
 using namespace google::protobuf;
 
@@ -37,44 +44,231 @@ public:
         return &socket_map;
     }
 
-    ClientTransport* GetOrCreateTransport(const char* url,
-                                          const ChannelOptions& options) {
-        auto it = connection_map_.find(std::string(url));
+    /// The connection to `endpoint`. The backup connection carries the
+    /// backup requests to the same server, so they don't queue behind the
+    /// original ones.
+    ClientTransport* GetOrCreateTransport(const EndPoint& endpoint,
+                                          bool backup = false) {
+        std::string key = endpoint2str(endpoint).c_str();
+        if (backup)
+            key += "#backup";
+        auto it = connection_map_.find(key);
         if (it == connection_map_.end()) {
-            EndPoint endpoint;
-            if (str2endpoint(url, &endpoint) == -1) {
-                LOG(WARNING) << "Invalid endpoint " << url;
-                return nullptr;
-            }
             auto client_transport = new ClientTransport(endpoint);
-            it = connection_map_.insert({std::string(url), client_transport})
-                     .first;
+            it = connection_map_.insert({key, client_transport}).first;
         }
         return it->second;
     }
 
+    /// Whether `endpoint` isn't isolated or draining, the ones never
+    /// connected are.
+    bool IsAvailable(const EndPoint& endpoint) const {
+        auto it = connection_map_.find(endpoint2str(endpoint).c_str());
+        return it == connection_map_.end() ||
+               (it->second->available() && !it->second->draining());
+    }
+
 private:
     SocketMap() {}
 
     std::unordered_map<std::string, ClientTransport*> connection_map_;
 };
 
+namespace {
+
+bool IsServerAvailable(const EndPoint& server) {
+    return SocketMap::singleton()->IsAvailable(server);
+}
+
+/// Report the result of a RPC to the load balancer before `done` runs.
+class FeedbackClosure : public Closure {
+public:
+    FeedbackClosure(LoadBalancer* load_balancer, EndPoint server,
+                    Controller* cntl, Closure* done)
+        : load_balancer_(load_balancer),
+          server_(server),
+          cntl_(cntl),
+          done_(done),
+          start_time_(std::chrono::steady_clock::now()) {}
+
+    const EndPoint& server() const { return server_; }
+
+    /// The RPC is retried with `server`, the previous ones failed.
+    void Retry(const EndPoint& server) {
+        auto now = std::chrono::steady_clock::now();
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            now - start_time_);
+        load_balancer_->Feedback(server_, false, latency.count());
+        if (has_backup_server_) {
+            has_backup_server_ = false;
+            auto backup_latency =
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    now - backup_start_time_);
+            load_balancer_->Feedback(backup_server_, false,
+                                     backup_latency.count());
+        }
+        server_ = server;
+        start_time_ = now;
+    }
+
+    /// The server of the backup request sent now.
+    void set_backup_server(const EndPoint& server) {
+        has_backup_server_ = true;
+        backup_server_ = server;
+        backup_start_time_ = std::chrono::steady_clock::now();
+    }
+
+    void Run() override {
+        auto now = std::chrono::steady_clock::now();
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            now - start_time_);
+        load_balancer_->Feedback(server_, !cntl_->Failed(), latency.count());
+        if (has_backup_server_) {
+            // Both requests are done for the load balancer.
+            auto backup_latency =
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    now - backup_start_time_);
+            load_balancer_->Feedback(backup_server_, !cntl_->Failed(),
+                                     backup_latency.count());
+        }
+        Closure* done = done_;
+        delete this;
+        done->Run();
+    }
+
+private:
+    LoadBalancer* load_balancer_;
+    EndPoint server_;
+    Controller* cntl_;
+    Closure* done_;
+    std::chrono::steady_clock::time_point start_time_;
+    bool has_backup_server_{false};
+    EndPoint backup_server_;
+    std::chrono::steady_clock::time_point backup_start_time_;
+};
+
+}  // namespace
+
 ChannelOptions::ChannelOptions()
-    : connect_timeout_ms(200), timeout_ms(500), protocol(PROTOCOL_UNKNOWN) {}
+    : connect_timeout_ms(200),
+      timeout_ms(500),
+      backup_request_ms(-1),
+      max_retry(3),
+      retry_policy(nullptr),
+      retry_budget_ratio(0.1),
+      retry_budget_max_tokens(10),
+      enable_circuit_breaker(false),
+      use_shared_memory(false),
+      protocol(PROTOCOL_UNKNOWN) {}
+
+Channel::Channel() = default;
+
+Channel::~Channel() = default;
 
 int Channel::Init(const char* url, const ChannelOptions& options) {
-    transport_ = SocketMap::singleton()->GetOrCreateTransport(url, options);
+    if (strstr(url, "://"))
+        return Init(url, "rr", options);
+
+    if (str2endpoint(url, &server_address_) == -1) {
+        // A hostname is resolved at first, and then balanced like a list
+        // so the address is refreshed once it changes.
+        ServerNode node;
+        if (ParseServerNode(url, &node, true) != 0) {
+            LOG(WARNING) << "Invalid endpoint " << url;
+            return -1;
+        }
+        return Init(("list://" + std::string(url)).c_str(), "rr", options);
+    }
+    options_ = options;
+    retry_budget_ = std::make_unique<RetryBudget>(
+        options.retry_budget_ratio, options.retry_budget_max_tokens);
+    transport_ = SocketMap::singleton()->GetOrCreateTransport(server_address_);
+    return 0;
+}
+
+int Channel::Init(const char* naming_service_url, const char* load_balancer,
+                  const ChannelOptions& options) {
+    naming_service_ = NamingService::New(naming_service_url);
+    load_balancer_ = LoadBalancer::New(load_balancer);
+    if (!naming_service_ || !load_balancer_)
+        return -1;
+    options_ = options;
+    retry_budget_ = std::make_unique<RetryBudget>(
+        options.retry_budget_ratio, options.retry_budget_max_tokens);
+    return ResetServers();
+}
+
+int Channel::ResetServers() {
+    std::vector<ServerNode> servers;
+    if (naming_service_->GetServers(&servers) != 0)
+        return -1;
+    LOG_IF(WARNING, servers.empty()) << "No server found";
+    load_balancer_->ResetServers(servers);
     return 0;
 }
 
 void Channel::CallMethod(const MethodDescriptor* method, RpcController* cntl,
                          const Message* request, Message* response,
                          Closure* done) {
-    LOG_IF(FATAL, transport_ == nullptr)
+    LOG_IF(FATAL, transport_ == nullptr && load_balancer_ == nullptr)
         << "Please invoke Channel::Init() first";
     LOG(INFO) << "Channel::CallMethod" << method->full_name();
     auto call = reinterpret_cast<ClientCall*>(cntl);
-    call->IssueRPC(transport_, method, request, response, done);
+    ClientTransport* transport = transport_;
+    call->set_connect_timeout_ms(options_.connect_timeout_ms);
+    call->set_use_shared_memory(options_.use_shared_memory);
+    call->set_backup_request_ms(options_.backup_request_ms);
+    call->set_retry(options_.max_retry, options_.retry_policy,
+                    retry_budget_.get());
+    call->set_enable_circuit_breaker(options_.enable_circuit_breaker);
+    retry_budget_->Deposit();
+    if (load_balancer_) {
+        // The old servers are kept if the reload fails.
+        if (naming_service_->Changed())
+            ResetServers();
+
+        LoadBalancer::SelectIn in;
+        in.has_request_code = call->has_request_code();
+        in.request_code = call->request_code();
+        in.available = &IsServerAvailable;
+        EndPoint server;
+        if (load_balancer_->SelectServer(in, &server) != 0) {
+            call->SetFailed(ERR_NO_SERVER, "No server available");
+            done->Run();
+            return;
+        }
+        transport = SocketMap::singleton()->GetOrCreateTransport(server);
+        auto feedback =
+            new FeedbackClosure(load_balancer_.get(), server, call, done);
+        done = feedback;
+        // The requests sent again are done before the feedback runs.
+        call->set_select_transport(
+            [this, in, feedback](bool backup) -> ClientTransport* {
+                EndPoint server;
+                if (load_balancer_->SelectServer(in, &server) != 0)
+                    return nullptr;
+                const bool same = server == feedback->server();
+                if (backup) {
+                    feedback->set_backup_server(server);
+                } else {
+                    feedback->Retry(server);
+                }
+                return SocketMap::singleton()->GetOrCreateTransport(
+                    server, backup && same);
+            });
+    } else {
+        if (!transport->available()) {
+            call->SetFailed(ERR_NO_SERVER, "The server is isolated");
+            done->Run();
+            return;
+        }
+        call->set_select_transport([this](bool backup) -> ClientTransport* {
+            auto transport = SocketMap::singleton()->GetOrCreateTransport(
+                server_address_, backup);
+            return transport->available() ? transport : nullptr;
+        });
+    }
+    call->IssueRPC(transport, method, request, response, done);
 }
 
 }  // namespace urpc
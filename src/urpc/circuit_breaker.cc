@@ -0,0 +1,93 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "circuit_breaker.h"
+
+#include <algorithm>
+
+#include <gflags/gflags.h>
+
+DEFINE_int32(circuit_breaker_short_window_size, 100,
+             "The calls of the short window of circuit breakers");
+DEFINE_int32(circuit_breaker_short_window_error_percent, 50,
+             "The error rate of the short window above which the server is "
+             "isolated");
+DEFINE_int32(circuit_breaker_long_window_size, 1000,
+             "The calls of the long window of circuit breakers");
+DEFINE_int32(circuit_breaker_long_window_error_percent, 10,
+             "The error rate of the long window above which the server is "
+             "isolated");
+DEFINE_int32(circuit_breaker_min_isolation_duration_ms, 100,
+             "The duration a server is isolated for at first");
+DEFINE_int32(circuit_breaker_max_isolation_duration_ms, 30000,
+             "The max duration a server is isolated for, as it doubles once "
+             "isolated again soon");
+
+namespace urpc {
+
+CircuitBreaker::EmaErrorRecorder::EmaErrorRecorder(int32_t window_size,
+                                                   int32_t max_error_percent)
+    : window_size_(std::max(window_size, 1)),
+      max_error_rate_(max_error_percent / 100.0),
+      alpha_(2.0 / (window_size_ + 1)) {}
+
+bool CircuitBreaker::EmaErrorRecorder::OnCallEnd(bool success) {
+    error_rate_ = error_rate_ * (1 - alpha_) + (success ? 0 : alpha_);
+    // Not judged until the window is filled once.
+    if (++samples_ < window_size_)
+        return true;
+    return error_rate_ <= max_error_rate_;
+}
+
+void CircuitBreaker::EmaErrorRecorder::Reset() {
+    samples_ = 0;
+    error_rate_ = 0;
+}
+
+CircuitBreaker::CircuitBreaker()
+    : short_window_(FLAGS_circuit_breaker_short_window_size,
+                    FLAGS_circuit_breaker_short_window_error_percent),
+      long_window_(FLAGS_circuit_breaker_long_window_size,
+                   FLAGS_circuit_breaker_long_window_error_percent) {}
+
+bool CircuitBreaker::OnCallEnd(bool success) {
+    bool short_ok = short_window_.OnCallEnd(success);
+    bool long_ok = long_window_.OnCallEnd(success);
+    return short_ok && long_ok;
+}
+
+int64_t CircuitBreaker::MarkAsIsolated() {
+    const auto now = std::chrono::steady_clock::now();
+    const int64_t max_ms = FLAGS_circuit_breaker_max_isolation_duration_ms;
+    const int64_t min_ms =
+        std::min<int64_t>(FLAGS_circuit_breaker_min_isolation_duration_ms,
+                          max_ms);
+    if (isolated_times_ > 0 &&
+        now - last_isolated_ < std::chrono::milliseconds(max_ms)) {
+        isolation_duration_ms_ =
+            std::min(std::max(isolation_duration_ms_ * 2, min_ms), max_ms);
+    } else {
+        isolation_duration_ms_ = min_ms;
+    }
+    isolated_times_++;
+    last_isolated_ = now;
+    return isolation_duration_ms_;
+}
+
+void CircuitBreaker::Reset() {
+    short_window_.Reset();
+    long_window_.Reset();
+}
+
+}  // namespace urpc
@@ -0,0 +1,68 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+
+namespace urpc {
+
+/// Decide when to isolate a server of too many errors. The error rate is
+/// tracked by the exponential moving averages of two windows, the short one
+/// reacts to a burst of errors and the long one to a sustained error rate.
+/// It's used in the poller thread of its transport like the load balancers.
+class CircuitBreaker {
+public:
+    CircuitBreaker();
+
+    /// Record the result of a call, false is returned if the server should
+    /// be isolated.
+    bool OnCallEnd(bool success);
+
+    /// The server is isolated, the duration to isolate it is returned. It
+    /// doubles up to the max duration if the server is isolated again within
+    /// the max duration since the last time.
+    int64_t MarkAsIsolated();
+
+    /// The server is available again, the windows start over.
+    void Reset();
+
+    int64_t isolation_duration_ms() const { return isolation_duration_ms_; }
+
+private:
+    class EmaErrorRecorder {
+    public:
+        EmaErrorRecorder(int32_t window_size, int32_t max_error_percent);
+
+        /// false is returned if the error rate exceeds the max.
+        bool OnCallEnd(bool success);
+        void Reset();
+
+    private:
+        const int32_t window_size_;
+        const double max_error_rate_;
+        const double alpha_;
+        int64_t samples_{0};
+        double error_rate_{0};
+    };
+
+    EmaErrorRecorder short_window_;
+    EmaErrorRecorder long_window_;
+    int64_t isolation_duration_ms_{0};
+    int64_t isolated_times_{0};
+    std::chrono::steady_clock::time_point last_isolated_;
+};
+
+}  // namespace urpc
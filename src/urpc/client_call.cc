@@ -14,9 +14,14 @@
 
 #include "client_call.h"
 
+#include <utility>
+
 #include <glog/logging.h>
+#include <urpc/channel.h>
 
+#include "base.h"
 #include "client_transport.h"
+#include "poller.h"
 
 using namespace google::protobuf;
 
@@ -31,4 +36,123 @@ void ClientCall::IssueRPC(ClientTransport* transport,
     LOG(FATAL) << "Not implemented";
 }
 
+void ClientCall::StartRequest(ClientTransport* transport, uint64_t request_id,
+                              IOBuf buf) {
+    request_id_ = request_id;
+    request_sent_ = true;
+    request_transport_ = transport;
+    backup_transport_ = nullptr;
+    if (select_transport_ &&
+        (backup_request_ms_ >= 0 || retried_count_ < max_retry_)) {
+        request_buf_ = buf;
+    }
+    if (backup_request_ms_ >= 0 && select_transport_) {
+        timer_ = Poller::singleton()->AddTimer(
+            backup_request_ms_, [this] { IssueBackupRequest(); });
+    }
+
+    transport->InstallClientCall(request_id, this);
+    transport->set_connect_timeout_ms(connect_timeout_ms_);
+    transport->set_use_shared_memory(use_shared_memory_);
+    transport->StartWrite(this, std::move(buf));
+}
+
+bool ClientCall::RetryIfFailed() {
+    if (enable_circuit_breaker_ && request_transport_)
+        request_transport_->OnCallEnd(!Failed());
+
+    if (!Failed() || retried_count_ >= max_retry_ || !select_transport_ ||
+        request_buf_.empty()) {
+        request_buf_.clear();
+        return false;
+    }
+
+    // The requests never sent are always safe to retry.
+    bool retry = retry_policy_ ? retry_policy_->DoRetry(this, request_sent_)
+                               : !request_sent_;
+    if (retry && retry_budget_ && !retry_budget_->Withdraw()) {
+        LOG(WARNING) << "The retry budget is exhausted";
+        retry = false;
+    }
+    if (!retry) {
+        request_buf_.clear();
+        return false;
+    }
+
+    // Not sent in the callbacks of the transport reset or read.
+    retried_count_++;
+    timer_ = Poller::singleton()->AddTimer(0, [this] { IssueRetry(); });
+    return true;
+}
+
+void ClientCall::OnResponseTaken(ClientTransport* transport) {
+    if (timer_ != 0) {
+        Poller::singleton()->RemoveTimer(timer_);
+        timer_ = 0;
+    }
+    if (backup_transport_) {
+        ClientTransport* loser = transport == request_transport_
+                                     ? backup_transport_
+                                     : request_transport_;
+        loser->AbandonClientCall(request_id_);
+        backup_transport_ = nullptr;
+        request_transport_ = transport;
+    }
+}
+
+void ClientCall::OnTransportReset(ClientTransport* transport, int code,
+                                  const std::string& reason, bool sent) {
+    if (backup_transport_) {
+        // The other request might still succeed.
+        if (transport == request_transport_)
+            request_transport_ = backup_transport_;
+        backup_transport_ = nullptr;
+        return;
+    }
+
+    if (timer_ != 0) {
+        Poller::singleton()->RemoveTimer(timer_);
+        timer_ = 0;
+    }
+    request_sent_ = sent;
+    SetFailed(code, reason);
+    ProcessResponse(IOBuf());
+}
+
+void ClientCall::IssueBackupRequest() {
+    timer_ = 0;
+    ClientTransport* transport = select_transport_(true);
+    if (!transport || transport == request_transport_ ||
+        transport->overloaded()) {
+        return;
+    }
+
+    LOG(INFO) << "Issue the backup request " << request_id_;
+    backup_transport_ = transport;
+    transport->InstallClientCall(request_id_, this);
+    transport->StartWrite(this, request_buf_);
+}
+
+void ClientCall::IssueRetry() {
+    timer_ = 0;
+    LOG(INFO) << "Retry the request " << request_id_ << " for the "
+              << retried_count_ << " time";
+    ClientTransport* transport = select_transport_(false);
+    if (!transport) {
+        SetFailed(ERR_NO_SERVER, "No server available");
+        ProcessResponse(IOBuf());
+        return;
+    }
+    if (transport->overloaded()) {
+        transport->OnWriteRejected();
+        SetFailed(ERR_OVERLOADED, "The connection is overloaded");
+        ProcessResponse(IOBuf());
+        return;
+    }
+
+    ClearFailed();
+    IOBuf buf = request_buf_;
+    StartRequest(transport, request_id_, std::move(buf));
+}
+
 }  // namespace urpc
@@ -13,6 +13,13 @@
 // limitations under the License.
 #pragma once
 
+#include <stdint.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <utility>
+
 #include <google/protobuf/service.h>
 #include <urpc/controller.h>
 
@@ -21,6 +28,31 @@
 namespace urpc {
 
 class ClientTransport;
+class RetryPolicy;
+
+/// Bound the retries of a channel to a ratio of its requests. Each request
+/// deposits `ratio` tokens up to `max_tokens`, and each retry withdraws one,
+/// so retries can't amplify an outage into a retry storm.
+class RetryBudget {
+public:
+    RetryBudget(double ratio, double max_tokens)
+        : ratio_(ratio), max_tokens_(max_tokens), tokens_(max_tokens) {}
+
+    void Deposit() { tokens_ = std::min(tokens_ + ratio_, max_tokens_); }
+
+    bool Withdraw() {
+        if (tokens_ < 1)
+            return false;
+        tokens_ -= 1;
+        return true;
+    }
+
+private:
+    const double ratio_;
+    const double max_tokens_;
+    double tokens_;
+};
+
 class ClientCall : public Controller {
 public:
     ~ClientCall() override = default;
@@ -35,6 +67,105 @@ public:
 
     // Invoke if OK. Otherwise Failed is setted.
     virtual int ProcessResponse(const IOBuf& response) = 0;
+
+    /// Select the transport to send the request again by, for a backup
+    /// request if `backup` or a retry, nullptr if none is available.
+    using SelectTransport = std::function<ClientTransport*(bool backup)>;
+
+    /// The options of the channel, set before IssueRPC().
+    void set_select_transport(SelectTransport select) {
+        select_transport_ = std::move(select);
+    }
+
+    /// Fail the connection established for the RPC if it takes longer than
+    /// `connect_timeout_ms`, -1 means waiting indefinitely.
+    void set_connect_timeout_ms(int32_t connect_timeout_ms) {
+        connect_timeout_ms_ = connect_timeout_ms;
+    }
+
+    /// Connect to a `unix:` server over shared memory.
+    void set_use_shared_memory(bool use_shared_memory) {
+        use_shared_memory_ = use_shared_memory;
+    }
+
+    /// Send the request again if no response arrives in `backup_request_ms`
+    /// milliseconds, the first response wins. -1 means no backup request.
+    void set_backup_request_ms(int32_t backup_request_ms) {
+        backup_request_ms_ = backup_request_ms;
+    }
+
+    /// Retry the failed RPC at most `max_retry` times if `policy` allows,
+    /// nullptr retries the requests never sent only, and `budget` has tokens.
+    void set_retry(int32_t max_retry, const RetryPolicy* policy,
+                   RetryBudget* budget) {
+        retried_count_ = 0;
+        max_retry_ = max_retry;
+        retry_policy_ = policy;
+        retry_budget_ = budget;
+    }
+
+    /// Record the results of the RPC for the circuit breaker of its server.
+    void set_enable_circuit_breaker(bool enable) {
+        enable_circuit_breaker_ = enable;
+    }
+
+    /// The times the RPC is retried.
+    int32_t retried_count() const { return retried_count_; }
+
+protected:
+    /// Send `buf`, the request of `request_id`, by `transport` and schedule
+    /// its backup request if any. The request ids are unique among the
+    /// transports of a thread, so the same buffer is sent again by another
+    /// transport without serializing it again.
+    void StartRequest(ClientTransport* transport, uint64_t request_id,
+                      IOBuf buf);
+
+    /// Invoked by the protocol once the response is processed, before the
+    /// done runs. The result is recorded for the circuit breaker, and true is
+    /// returned if the failed RPC is retried and the done shouldn't run.
+    bool RetryIfFailed();
+
+    /// Don't send the request again, e.g. a streaming one bound to its
+    /// transport.
+    void DisableResend() {
+        backup_request_ms_ = -1;
+        max_retry_ = 0;
+    }
+
+private:
+    friend class ClientTransport;
+
+    /// The response from `transport` is taken, the backup request pending is
+    /// cancelled and the request to the other transport abandoned.
+    void OnResponseTaken(ClientTransport* transport);
+
+    /// `transport` is reset before the response arrives, `sent` is false if
+    /// the request never reached the wire.
+    void OnTransportReset(ClientTransport* transport, int code,
+                          const std::string& reason, bool sent);
+
+    void IssueBackupRequest();
+    void IssueRetry();
+
+    SelectTransport select_transport_;
+    int32_t connect_timeout_ms_{-1};
+    bool use_shared_memory_{false};
+    int32_t backup_request_ms_{-1};
+    int32_t max_retry_{0};
+    const RetryPolicy* retry_policy_{nullptr};
+    RetryBudget* retry_budget_{nullptr};
+    int32_t retried_count_{0};
+    bool enable_circuit_breaker_{false};
+
+    uint64_t request_id_{0};
+    /// The request kept to send it again.
+    IOBuf request_buf_;
+    /// The request might have reached the server.
+    bool request_sent_{true};
+    ClientTransport* request_transport_{nullptr};
+    ClientTransport* backup_transport_{nullptr};
+    /// The timer of the backup request or the retry, 0 if none.
+    uint64_t timer_{0};
 };
 
 }  // namespace urpc
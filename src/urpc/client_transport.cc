@@ -14,42 +14,151 @@
 
 #include "client_transport.h"
 
+#include <unordered_set>
+#include <utility>
+
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "poller.h"
 #include "protocol/manager.h"
+#include "stats.h"
+
+DEFINE_int32(client_idle_timeout_s, -1,
+             "Close the client connections idle for so many seconds, the "
+             "next calls reconnect, -1 means never");
 
 using urpc::protocol::ProtocolManager;
 
 namespace urpc {
 
-ClientTransport::~ClientTransport() {}
+namespace {
+
+/// The controller of the requests of abandoned calls still queued.
+class AbandonedWriter final : public Controller {
+public:
+    static AbandonedWriter* singleton() {
+        thread_local AbandonedWriter writer;
+        return &writer;
+    }
+
+protected:
+    void OnComplete() override {}
+};
+
+}  // namespace
+
+ClientTransport::ClientTransport(EndPoint endpoint)
+    : ConnectTransport(endpoint) {
+    StatsRegistry::singleton()->Register(this);
+}
+
+ClientTransport::~ClientTransport() {
+    StatsRegistry::singleton()->Unregister(this);
+}
+
+void ClientTransport::Reset(int code, std::string reason) {
+    std::unordered_set<Controller*> unsent;
+    if (current_cntl_ && !current_written_)
+        unsent.insert(current_cntl_);
+    for (auto&& [cntl, buf] : pending_writes_)
+        unsent.insert(cntl);
+
+    // The calls are failed or retried below instead of their writes.
+    current_cntl_ = nullptr;
+    pending_writes_.clear();
+    auto calls = std::move(pending_calls_);
+    pending_calls_.clear();
+    ConnectTransport::Reset(code, reason);
+
+    // Isolated before the calls are retried.
+    if (code == ERR_CONNECT)
+        Isolate();
+
+    // The transport could be written again by the calls, it reconnects.
+    for (auto&& [request_id, call] : calls) {
+        if (call)
+            call->OnTransportReset(this, code, reason, unsent.count(call) == 0);
+    }
+}
 
 int ClientTransport::OnWriteDone(Controller* cntl) { return 0; }
 
+void ClientTransport::OnCallEnd(bool success) {
+    // The servers of too many errors are isolated like the unreachable ones.
+    if (!circuit_breaker_.OnCallEnd(success) && !isolated_)
+        Isolate();
+}
+
+bool ClientTransport::Idle() const {
+    return pending_calls_.empty() && ConnectTransport::Idle();
+}
+
+void ClientTransport::OnConnected() {
+    set_idle_timeout_s(FLAGS_client_idle_timeout_s);
+    if (!isolated_)
+        return;
+    LOG(WARNING) << "Revive " << endpoint2str(remote_side_);
+    isolated_ = false;
+    circuit_breaker_.Reset();
+}
+
+void ClientTransport::Isolate() {
+    isolated_ = true;
+    if (health_check_timer_ != 0)
+        return;
+    const int64_t duration_ms = circuit_breaker_.MarkAsIsolated();
+    LOG(WARNING) << "Isolate " << endpoint2str(remote_side_) << " for "
+                 << duration_ms << "ms";
+    health_check_timer_ = Poller::singleton()->AddTimer(
+        duration_ms, [this] { HealthCheck(); });
+}
+
+void ClientTransport::HealthCheck() {
+    health_check_timer_ = 0;
+    // Revived once connected, or isolated again by a failure.
+    if (Connect() == 0)
+        OnConnected();
+}
+
 int ClientTransport::OnRead(IOBuf* buf) {
-    int code = ERR_MISMATCH;
-    if (protocol_)
-        code = protocol_->ParseResponse(buf, this);
-    if (code == ERR_MISMATCH) {
-        protocol_ = ProtocolManager::singleton()->ProbeProtocol(*buf);
-        if (!protocol_) {
-            Reset(ERR_NOT_SUPPORTED, "unknown protocol");
-            return -1;
+    // Responses of pipelined requests might arrive in a single read.
+    while (!buf->empty()) {
+        int code = ERR_MISMATCH;
+        if (protocol_)
+            code = protocol_->ParseResponse(buf, this);
+        if (code == ERR_MISMATCH) {
+            code =
+                ProtocolManager::singleton()->ProbeProtocol(*buf, &protocol_);
+            if (code == ERR_TOO_SMALL)
+                return 0;
+            if (code != ERR_OK) {
+                Reset(ERR_NOT_SUPPORTED, "unknown protocol");
+                return -1;
+            }
+            code = protocol_->ParseResponse(buf, this);
         }
-    }
 
-    code = protocol_->ParseResponse(buf, this);
-    if (code != ERR_OK) {
-        if (code == ERR_TOO_SMALL)
-            return 0;
-        Reset(code, "parse request");
-        return -1;
+        if (code != ERR_OK) {
+            if (code == ERR_TOO_SMALL)
+                return 0;
+            Reset(code, "parse response");
+            return -1;
+        }
+        OnMessageRead();
     }
 
+    // Closed once the calls to the draining server are done, the next calls
+    // reconnect. The transport is kept by the socket map, so it isn't
+    // released as a failed read.
+    if (draining() && Idle())
+        Reset(ERR_EOF, "The server is draining");
     return 0;
 }
 
-ClientCall* ClientTransport::TakeClientCall(uint64_t request_id) {
+ClientCall* ClientTransport::TakeClientCall(uint64_t request_id,
+                                            bool* abandoned) {
+    *abandoned = false;
     auto it = pending_calls_.find(request_id);
     if (it == pending_calls_.end()) {
         return nullptr;
@@ -57,6 +166,13 @@ ClientCall* ClientTransport::TakeClientCall(uint64_t request_id) {
 
     ClientCall* client_call = it->second;
     pending_calls_.erase(it);
+    if (!client_call) {
+        LOG(INFO) << "Discard the response of abandoned request "
+                  << request_id;
+        *abandoned = true;
+        return nullptr;
+    }
+    client_call->OnResponseTaken(this);
     return client_call;
 }
 
@@ -64,4 +180,24 @@ void ClientTransport::InstallClientCall(uint64_t request_id, ClientCall* call) {
     pending_calls_.insert({request_id, call});
 }
 
+void ClientTransport::AbandonClientCall(uint64_t request_id) {
+    auto it = pending_calls_.find(request_id);
+    if (it == pending_calls_.end() || !it->second)
+        return;
+
+    Controller* call = it->second;
+    it->second = nullptr;
+    if (current_cntl_ == call)
+        current_cntl_ = AbandonedWriter::singleton();
+    for (auto&& write : pending_writes_) {
+        if (write.first == call)
+            write.first = AbandonedWriter::singleton();
+    }
+}
+
+uint64_t ClientTransport::NextRequestId() {
+    thread_local uint64_t next_request_id = 1;
+    return next_request_id++;
+}
+
 }  // namespace urpc
@@ -14,10 +14,12 @@
 
 #pragma once
 
+#include <string>
 #include <unordered_map>
 
 #include <urpc/endpoint.h>
 
+#include "urpc/circuit_breaker.h"
 #include "urpc/client_call.h"
 #include "urpc/connect_transport.h"
 #include "urpc/iobuf.h"
@@ -27,25 +29,56 @@ namespace urpc {
 
 class ClientTransport : public ConnectTransport {
 public:
-    explicit ClientTransport(EndPoint endpoint) : ConnectTransport(endpoint) {}
+    explicit ClientTransport(EndPoint endpoint);
     ~ClientTransport() override;
 
-    ClientCall* TakeClientCall(uint64_t request_id);
+    /// Take the call of `request_id` out, nullptr if there is none. The
+    /// response of an abandoned call is discarded with `*abandoned` set.
+    ClientCall* TakeClientCall(uint64_t request_id, bool* abandoned);
     void InstallClientCall(uint64_t request_id, ClientCall* call);
-    uint64_t NextRequestId() { return next_request_id_++; }
+
+    /// Abandon the call of `request_id`, its response is taken from another
+    /// transport, the backup request or the original one. The call might be
+    /// gone before its request is written.
+    void AbandonClientCall(uint64_t request_id);
+
+    /// The calls waiting for responses are failed or retried, the requests
+    /// never written are known not to reach the server.
+    void Reset(int code, std::string reason) override;
+
+    /// The request ids are unique among the transports of a thread.
+    static uint64_t NextRequestId();
+
+    /// The server isn't isolated, by the circuit breaker or a failed
+    /// connection. The load balancers skip the isolated servers, which are
+    /// reconnected in the background once the isolation duration elapses.
+    bool available() const { return !isolated_; }
+
+    /// Record the result of a call for the circuit breaker.
+    void OnCallEnd(bool success);
+
+    /// No response is waited for either.
+    bool Idle() const override;
 
 protected:
     int OnWriteDone(Controller* cntl) override;
     int OnRead(IOBuf* buf) override;
+    void OnConnected() override;
 
 private:
-    uint64_t next_request_id_{1};
+    void Isolate();
+    void HealthCheck();
 
     /// The last successfully parsed protocol, used to optimize protocol
     /// lookuping.
     protocol::BaseProtocol* protocol_{nullptr};
 
+    /// The calls waiting for responses, nullptr if abandoned.
     std::unordered_map<uint64_t, ClientCall*> pending_calls_;
+
+    CircuitBreaker circuit_breaker_;
+    bool isolated_{false};
+    uint64_t health_check_timer_{0};
 };
 
 }  // namespace urpc
@@ -68,3 +68,19 @@ inline uint64_t DecodeFixed64(const uint8_t* ptr) {
            (static_cast<uint64_t>(buffer[6]) << 48) |
            (static_cast<uint64_t>(buffer[7]) << 56);
 }
+
+// Network byte order (big endian) versions, used by protocols such as HTTP/2.
+
+inline void EncodeBigEndian32(uint8_t* dst, uint32_t value) {
+    dst[0] = static_cast<uint8_t>(value >> 24);
+    dst[1] = static_cast<uint8_t>(value >> 16);
+    dst[2] = static_cast<uint8_t>(value >> 8);
+    dst[3] = static_cast<uint8_t>(value);
+}
+
+inline uint32_t DecodeBigEndian32(const uint8_t* ptr) {
+    return (static_cast<uint32_t>(ptr[0]) << 24) |
+           (static_cast<uint32_t>(ptr[1]) << 16) |
+           (static_cast<uint32_t>(ptr[2]) << 8) |
+           (static_cast<uint32_t>(ptr[3]));
+}
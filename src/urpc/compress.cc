@@ -0,0 +1,340 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "compress.h"
+
+#include <lz4frame.h>
+#include <snappy-sinksource.h>
+#include <snappy.h>
+#include <stdint.h>
+#include <zstd.h>
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "urpc/base.h"
+
+DEFINE_int32(compress_min_bytes, 512,
+             "Bodies smaller than this are sent uncompressed");
+
+namespace urpc {
+
+namespace {
+
+/// Reads the blocks of an IOBuf without copying.
+class IOBufSource final : public snappy::Source {
+public:
+    explicit IOBufSource(const IOBuf& buf) : buf_(buf), left_(buf.size()) {}
+
+    size_t Available() const override { return left_; }
+
+    const char* Peek(size_t* len) override {
+        std::string_view block = buf_.backing_block(index_);
+        *len = block.size() - offset_;
+        return block.data() + offset_;
+    }
+
+    void Skip(size_t n) override {
+        left_ -= n;
+        while (n > 0) {
+            const size_t size = buf_.backing_block(index_).size() - offset_;
+            if (n < size) {
+                offset_ += n;
+                return;
+            }
+            n -= size;
+            ++index_;
+            offset_ = 0;
+        }
+    }
+
+private:
+    const IOBuf& buf_;
+    size_t left_;
+    size_t index_{0};
+    size_t offset_{0};
+};
+
+class IOBufSink final : public snappy::Sink {
+public:
+    explicit IOBufSink(IOBuf* buf) : buf_(buf) {}
+
+    void Append(const char* bytes, size_t n) override {
+        buf_->append(bytes, n);
+    }
+
+private:
+    IOBuf* const buf_;
+};
+
+int SnappyCompress(const IOBuf& in, IOBuf* out) {
+    IOBufSource source(in);
+    IOBufSink sink(out);
+    snappy::Compress(&source, &sink);
+    return ERR_OK;
+}
+
+int SnappyDecompress(const IOBuf& in, IOBuf* out) {
+    uint32_t size = 0;
+    IOBufSource header(in);
+    if (!snappy::GetUncompressedLength(&header, &size) ||
+        size > kMaxDecompressedSize)
+        return ERR_COMPRESS;
+
+    IOBufSource source(in);
+    IOBufSink sink(out);
+    return snappy::Uncompress(&source, &sink) ? ERR_OK : ERR_COMPRESS;
+}
+
+/// The zstd contexts are reused by the calls of a thread.
+struct ZstdContext {
+    ZstdContext() : cctx(ZSTD_createCCtx()), dctx(ZSTD_createDCtx()) {}
+    ~ZstdContext() {
+        ZSTD_freeCCtx(cctx);
+        ZSTD_freeDCtx(dctx);
+    }
+
+    ZSTD_CCtx* const cctx;
+    ZSTD_DCtx* const dctx;
+};
+
+ZstdContext* zstd_context() {
+    static thread_local ZstdContext context;
+    return &context;
+}
+
+/// Write the output of a stream into the blocks of an IOBuf.
+class ZstdOutput {
+public:
+    explicit ZstdOutput(IOBuf* buf) : stream_(buf) {}
+    ~ZstdOutput() { stream_.BackUp(buffer_.size - buffer_.pos); }
+
+    /// The buffer with free space, false is returned if it's unavailable.
+    bool Reserve() {
+        if (buffer_.pos < buffer_.size)
+            return true;
+        void* data = nullptr;
+        int size = 0;
+        if (!stream_.Next(&data, &size))
+            return false;
+        buffer_ = {data, static_cast<size_t>(size), 0};
+        return true;
+    }
+
+    ZSTD_outBuffer* buffer() { return &buffer_; }
+    bool full() const { return buffer_.pos == buffer_.size; }
+
+private:
+    IOBufAsZeroCopyOutputStream stream_;
+    ZSTD_outBuffer buffer_{nullptr, 0, 0};
+};
+
+int ZstdCompress(const IOBuf& in, IOBuf* out) {
+    ZSTD_CCtx* cctx = zstd_context()->cctx;
+    ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+    ZSTD_CCtx_setPledgedSrcSize(cctx, in.size());
+
+    ZstdOutput output(out);
+    const size_t num = in.backing_block_num();
+    for (size_t i = 0; i <= num; ++i) {
+        // The last round with no input ends the frame.
+        const std::string_view block =
+            i < num ? in.backing_block(i) : std::string_view();
+        const ZSTD_EndDirective mode = i < num ? ZSTD_e_continue : ZSTD_e_end;
+        ZSTD_inBuffer input = {block.data(), block.size(), 0};
+        while (true) {
+            if (!output.Reserve())
+                return ERR_COMPRESS;
+            const size_t remaining =
+                ZSTD_compressStream2(cctx, output.buffer(), &input, mode);
+            if (ZSTD_isError(remaining)) {
+                LOG(ERROR) << "zstd compress " << ZSTD_getErrorName(remaining);
+                return ERR_COMPRESS;
+            }
+            if (mode == ZSTD_e_continue ? input.pos == input.size
+                                        : remaining == 0)
+                break;
+        }
+    }
+    return ERR_OK;
+}
+
+int ZstdDecompress(const IOBuf& in, IOBuf* out) {
+    ZSTD_DCtx* dctx = zstd_context()->dctx;
+    ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+
+    const size_t origin_size = out->size();
+    ZstdOutput output(out);
+    size_t hint = 1;
+    const size_t num = in.backing_block_num();
+    for (size_t i = 0; i <= num; ++i) {
+        // The last round with no input flushes what is left, unless the
+        // frame is complete already.
+        if (i == num && hint == 0)
+            break;
+        const std::string_view block =
+            i < num ? in.backing_block(i) : std::string_view();
+        ZSTD_inBuffer input = {block.data(), block.size(), 0};
+        do {
+            if (!output.Reserve())
+                return ERR_COMPRESS;
+            hint = ZSTD_decompressStream(dctx, output.buffer(), &input);
+            if (ZSTD_isError(hint))
+                return ERR_COMPRESS;
+            if (out->size() - origin_size > kMaxDecompressedSize)
+                return ERR_COMPRESS;
+        } while (input.pos < input.size || output.full());
+    }
+    // A non-zero hint means the frame is truncated.
+    return hint == 0 ? ERR_OK : ERR_COMPRESS;
+}
+
+/// The lz4 contexts are reused by the calls of a thread.
+struct LZ4Context {
+    LZ4Context() {
+        LZ4F_createCompressionContext(&cctx, LZ4F_VERSION);
+        LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+    }
+    ~LZ4Context() {
+        LZ4F_freeCompressionContext(cctx);
+        LZ4F_freeDecompressionContext(dctx);
+    }
+
+    LZ4F_cctx* cctx{nullptr};
+    LZ4F_dctx* dctx{nullptr};
+    /// lz4 requires the whole bound of the output, which the blocks of the
+    /// IOBuf might not have.
+    std::vector<char> scratch;
+};
+
+LZ4Context* lz4_context() {
+    static thread_local LZ4Context context;
+    return &context;
+}
+
+/// The input of each LZ4F_compressUpdate(), which bounds the scratch.
+constexpr size_t kLZ4ChunkSize = 64 * 1024;
+
+int LZ4Compress(const IOBuf& in, IOBuf* out) {
+    LZ4Context* context = lz4_context();
+    LZ4F_preferences_t prefs{};
+    prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+    prefs.frameInfo.contentSize = in.size();
+    context->scratch.resize(
+        std::max<size_t>(LZ4F_compressBound(kLZ4ChunkSize, &prefs),
+                         LZ4F_HEADER_SIZE_MAX));
+    char* scratch = context->scratch.data();
+    const size_t capacity = context->scratch.size();
+
+    size_t n = LZ4F_compressBegin(context->cctx, scratch, capacity, &prefs);
+    if (LZ4F_isError(n))
+        return ERR_COMPRESS;
+    out->append(scratch, n);
+
+    for (size_t i = 0; i < in.backing_block_num(); ++i) {
+        std::string_view block = in.backing_block(i);
+        while (!block.empty()) {
+            const size_t size = std::min(block.size(), kLZ4ChunkSize);
+            n = LZ4F_compressUpdate(context->cctx, scratch, capacity,
+                                    block.data(), size, nullptr);
+            if (LZ4F_isError(n))
+                return ERR_COMPRESS;
+            out->append(scratch, n);
+            block.remove_prefix(size);
+        }
+    }
+
+    n = LZ4F_compressEnd(context->cctx, scratch, capacity, nullptr);
+    if (LZ4F_isError(n))
+        return ERR_COMPRESS;
+    out->append(scratch, n);
+    return ERR_OK;
+}
+
+int LZ4Decompress(const IOBuf& in, IOBuf* out) {
+    LZ4F_dctx* dctx = lz4_context()->dctx;
+    LZ4F_resetDecompressionContext(dctx);
+
+    const size_t origin_size = out->size();
+    IOBufAsZeroCopyOutputStream stream(out);
+    size_t hint = 1;
+    const size_t num = in.backing_block_num();
+    for (size_t i = 0; i <= num; ++i) {
+        // The last round with no input flushes what is left, unless the
+        // frame is complete already.
+        if (i == num && hint == 0)
+            break;
+        std::string_view block =
+            i < num ? in.backing_block(i) : std::string_view();
+        bool full = false;
+        do {
+            void* data = nullptr;
+            int capacity = 0;
+            if (!stream.Next(&data, &capacity))
+                return ERR_COMPRESS;
+            size_t dst_size = capacity;
+            size_t src_size = block.size();
+            hint = LZ4F_decompress(dctx, data, &dst_size, block.data(),
+                                   &src_size, nullptr);
+            stream.BackUp(capacity - dst_size);
+            if (LZ4F_isError(hint))
+                return ERR_COMPRESS;
+            if (out->size() - origin_size > kMaxDecompressedSize)
+                return ERR_COMPRESS;
+            block.remove_prefix(src_size);
+            full = dst_size == static_cast<size_t>(capacity);
+        } while (!block.empty() || full);
+    }
+    // A non-zero hint means the frame is truncated.
+    return hint == 0 ? ERR_OK : ERR_COMPRESS;
+}
+
+}  // namespace
+
+int Compress(CompressType type, const IOBuf& in, IOBuf* out) {
+    switch (type) {
+        case COMPRESS_NONE:
+            out->append(in);
+            return ERR_OK;
+        case COMPRESS_SNAPPY:
+            return SnappyCompress(in, out);
+        case COMPRESS_ZSTD:
+            return ZstdCompress(in, out);
+        case COMPRESS_LZ4:
+            return LZ4Compress(in, out);
+    }
+    LOG(ERROR) << "Unknown compress type " << type;
+    return ERR_COMPRESS;
+}
+
+int Decompress(CompressType type, const IOBuf& in, IOBuf* out) {
+    switch (type) {
+        case COMPRESS_NONE:
+            out->append(in);
+            return ERR_OK;
+        case COMPRESS_SNAPPY:
+            return SnappyDecompress(in, out);
+        case COMPRESS_ZSTD:
+            return ZstdDecompress(in, out);
+        case COMPRESS_LZ4:
+            return LZ4Decompress(in, out);
+    }
+    LOG(ERROR) << "Unknown compress type " << type;
+    return ERR_COMPRESS;
+}
+
+}  // namespace urpc
@@ -0,0 +1,55 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <gflags/gflags.h>
+
+#include <urpc/controller.h>  // CompressType
+
+#include "urpc/iobuf.h"
+
+DECLARE_int32(compress_min_bytes);
+
+namespace urpc {
+
+/// The limit of decompressed bodies, the same as the default total bytes
+/// limit of protobuf messages.
+constexpr size_t kMaxDecompressedSize = 64 << 20;
+
+/// Whether `type` read from the wire is a CompressType, which has no fixed
+/// underlying type, so that it's checked before the cast.
+inline bool IsValidCompressType(int32_t type) {
+    return type >= COMPRESS_NONE && type <= COMPRESS_LZ4;
+}
+
+/// Whether a body of `size` bytes should be compressed with `type`.
+inline bool ShouldCompress(CompressType type, size_t size) {
+    return type != COMPRESS_NONE &&
+           size >= static_cast<size_t>(FLAGS_compress_min_bytes);
+}
+
+/// Compress `in` with `type` and append the result to `out`. The blocks of
+/// `in` are fed to the compressor one by one, and zstd writes directly into
+/// the blocks of `out`. ERR_OK is returned, or ERR_COMPRESS on failure.
+int Compress(CompressType type, const IOBuf& in, IOBuf* out);
+
+/// Decompress `in` of `type` and append the result to `out`. ERR_OK is
+/// returned, or ERR_COMPRESS if `in` is corrupted or larger than
+/// kMaxDecompressedSize once decompressed.
+int Decompress(CompressType type, const IOBuf& in, IOBuf* out);
+
+}  // namespace urpc
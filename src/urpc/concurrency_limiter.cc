@@ -0,0 +1,214 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "concurrency_limiter.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_int32(auto_cl_initial_max_concurrency, 40,
+             "The initial limit of the adaptive concurrency limiter");
+DEFINE_int32(auto_cl_sample_window_ms, 1000,
+             "The duration of the sampling windows of the adaptive limiter");
+DEFINE_int32(auto_cl_min_sample_count, 100,
+             "The sampling windows with fewer samples are dropped");
+DEFINE_int32(auto_cl_max_sample_count, 200,
+             "The sampling windows end early once they have so many samples");
+DEFINE_double(auto_cl_ema_factor, 0.1,
+              "The smoothing factor of the minimum latency and maximum qps");
+DEFINE_double(auto_cl_min_explore_ratio, 0.06,
+              "The lower bound of the headroom above the estimated capacity");
+DEFINE_double(auto_cl_max_explore_ratio, 0.3,
+              "The upper bound of the headroom above the estimated capacity");
+DEFINE_double(auto_cl_explore_step, 0.02,
+              "The change of the headroom per sampling window");
+DEFINE_double(auto_cl_fail_punish_ratio, 1.0,
+              "The weight of the latencies of failed requests");
+DEFINE_int32(auto_cl_remeasure_interval_ms, 50000,
+             "The interval to remeasure the latency without queueing");
+DEFINE_double(auto_cl_remeasure_reduce_ratio, 0.75,
+              "The ratio of the limit while remeasuring the minimum latency");
+
+namespace urpc {
+
+int ConcurrencyLimiter::New(const std::string& spec,
+                            std::unique_ptr<ConcurrencyLimiter>* limiter) {
+    if (spec == "auto") {
+        limiter->reset(new AutoConcurrencyLimiter);
+        return 0;
+    }
+    if (spec == "unlimited") {
+        limiter->reset();
+        return 0;
+    }
+
+    char* end = nullptr;
+    long long value = strtoll(spec.c_str(), &end, 10);
+    if (spec.empty() || *end != '\0' || value < 0) {
+        LOG(ERROR) << "Invalid max concurrency " << spec;
+        return -1;
+    }
+    if (value == 0) {
+        limiter->reset();
+    } else {
+        limiter->reset(new ConstantConcurrencyLimiter(value));
+    }
+    return 0;
+}
+
+bool ConcurrencyLimiter::OnRequested() {
+    if (concurrency_.fetch_add(1, std::memory_order_relaxed) >=
+        max_concurrency()) {
+        concurrency_.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void ConcurrencyLimiter::OnResponded(bool success, int64_t latency_us) {
+    concurrency_.fetch_sub(1, std::memory_order_relaxed);
+    OnSample(success, latency_us);
+}
+
+namespace {
+
+/// Spread the remeasurements of the servers started at the same time.
+int64_t RemeasureIntervalUs() {
+    thread_local std::mt19937 engine(std::random_device{}());
+    const int64_t interval_us = FLAGS_auto_cl_remeasure_interval_ms * 1000LL;
+    std::uniform_int_distribution<int64_t> jitter(0, interval_us / 2);
+    return interval_us + jitter(engine);
+}
+
+}  // namespace
+
+AutoConcurrencyLimiter::AutoConcurrencyLimiter()
+    : max_concurrency_(FLAGS_auto_cl_initial_max_concurrency),
+      explore_ratio_(FLAGS_auto_cl_max_explore_ratio) {}
+
+void AutoConcurrencyLimiter::OnSample(bool success, int64_t latency_us) {
+    auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch());
+    Sample(success, latency_us, now.count());
+}
+
+void AutoConcurrencyLimiter::Sample(bool success, int64_t latency_us,
+                                    int64_t now_us) {
+    std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
+
+    if (window_start_us_ == 0) {
+        ResetWindow(now_us);
+        remeasure_at_us_ = now_us + RemeasureIntervalUs();
+    }
+    if (success) {
+        succeeded_ += 1;
+        succeeded_latency_us_ += latency_us;
+    } else {
+        failed_ += 1;
+        failed_latency_us_ += latency_us;
+    }
+
+    const int64_t elapsed_us = now_us - window_start_us_;
+    const int64_t window_us = FLAGS_auto_cl_sample_window_ms * 1000LL;
+    const int64_t count = succeeded_ + failed_;
+    if (count < FLAGS_auto_cl_min_sample_count) {
+        // The load is too low to measure the capacity.
+        if (elapsed_us >= window_us)
+            ResetWindow(now_us);
+        return;
+    }
+    if (elapsed_us < window_us && count < FLAGS_auto_cl_max_sample_count)
+        return;
+
+    if (succeeded_ == 0) {
+        max_concurrency_.store(std::max<int64_t>(max_concurrency() / 2, 1),
+                               std::memory_order_relaxed);
+    } else {
+        UpdateMaxConcurrency(std::max<int64_t>(elapsed_us, 1), now_us);
+    }
+    ResetWindow(now_us);
+}
+
+void AutoConcurrencyLimiter::ResetWindow(int64_t now_us) {
+    window_start_us_ = now_us;
+    succeeded_ = 0;
+    failed_ = 0;
+    succeeded_latency_us_ = 0;
+    failed_latency_us_ = 0;
+}
+
+void AutoConcurrencyLimiter::UpdateMaxConcurrency(int64_t elapsed_us,
+                                                  int64_t now_us) {
+    // Failures are usually fast, they must not make the server look faster.
+    const double avg_latency_us =
+        (succeeded_latency_us_ +
+         FLAGS_auto_cl_fail_punish_ratio * failed_latency_us_) /
+        succeeded_;
+    const double qps = 1e6 * succeeded_ / elapsed_us;
+    const double ema = FLAGS_auto_cl_ema_factor;
+
+    if (remeasuring_ || min_latency_us_ <= 0) {
+        min_latency_us_ = std::ceil(avg_latency_us);
+        remeasuring_ = false;
+    } else if (avg_latency_us < min_latency_us_) {
+        min_latency_us_ =
+            std::ceil(avg_latency_us * ema + min_latency_us_ * (1 - ema));
+    }
+
+    // The maximum qps decays slowly, so a short dip of the load doesn't
+    // shrink the limit.
+    if (qps >= max_qps_) {
+        max_qps_ = qps;
+    } else {
+        max_qps_ = qps * ema / 10 + max_qps_ * (1 - ema / 10);
+    }
+
+    double next = 0;
+    if (now_us >= remeasure_at_us_) {
+        remeasuring_ = true;
+        remeasure_at_us_ = now_us + RemeasureIntervalUs();
+        next = max_qps_ * min_latency_us_ / 1e6 *
+               FLAGS_auto_cl_remeasure_reduce_ratio;
+    } else {
+        const double min_ratio = FLAGS_auto_cl_min_explore_ratio;
+        const double step = FLAGS_auto_cl_explore_step;
+        if (avg_latency_us <= min_latency_us_ * (1 + min_ratio) ||
+            qps <= max_qps_ / (1 + min_ratio)) {
+            explore_ratio_ = std::min(explore_ratio_ + step,
+                                      FLAGS_auto_cl_max_explore_ratio);
+        } else {
+            explore_ratio_ = std::max(explore_ratio_ - step, min_ratio);
+        }
+        next = max_qps_ * min_latency_us_ / 1e6 * (1 + explore_ratio_);
+    }
+
+    const int64_t max_concurrency =
+        std::max<int64_t>(static_cast<int64_t>(std::ceil(next)), 1);
+    LOG(INFO) << "AutoConcurrencyLimiter avg latency " << avg_latency_us
+              << "us, qps " << qps << ", min latency " << min_latency_us_
+              << "us, max qps " << max_qps_ << ", max concurrency "
+              << max_concurrency;
+    max_concurrency_.store(max_concurrency, std::memory_order_relaxed);
+}
+
+}  // namespace urpc
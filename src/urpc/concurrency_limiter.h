@@ -0,0 +1,128 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace urpc {
+
+/// Limit the requests in processing, it could be invoked from any thread.
+class ConcurrencyLimiter {
+public:
+    virtual ~ConcurrencyLimiter() = default;
+
+    /// Create a limiter of `spec`: "auto" for an adaptive limit, or a
+    /// positive number for a constant one. `limiter` is reset to
+    /// [`nullptr`] for "unlimited" or "0", and -1 is returned for invalid
+    /// values.
+    static int New(const std::string& spec,
+                   std::unique_ptr<ConcurrencyLimiter>* limiter);
+
+    /// Admit a request, false is returned if the limit is reached.
+    bool OnRequested();
+
+    /// Invoked once an admitted request is responded.
+    void OnResponded(bool success, int64_t latency_us);
+
+    /// Release an admitted request which isn't served.
+    void OnCanceled() { concurrency_.fetch_sub(1, std::memory_order_relaxed); }
+
+    /// Take over `concurrency` requests admitted before the limiter replaces
+    /// another one, they're released on this one once responded.
+    void Adopt(int64_t concurrency) {
+        concurrency_.fetch_add(concurrency, std::memory_order_relaxed);
+    }
+
+    /// The requests admitted but not responded.
+    int64_t concurrency() const {
+        return concurrency_.load(std::memory_order_relaxed);
+    }
+
+    virtual int64_t max_concurrency() const = 0;
+
+protected:
+    virtual void OnSample(bool success, int64_t latency_us) {}
+
+private:
+    std::atomic<int64_t> concurrency_{0};
+};
+
+class ConstantConcurrencyLimiter final : public ConcurrencyLimiter {
+public:
+    explicit ConstantConcurrencyLimiter(int64_t max_concurrency)
+        : max_concurrency_(max_concurrency) {}
+
+    int64_t max_concurrency() const override { return max_concurrency_; }
+
+private:
+    const int64_t max_concurrency_;
+};
+
+/// Adapt the limit to the capacity of the server, by the little's law:
+///
+///   max_concurrency = max_qps * min_latency * (1 + explore_ratio)
+///
+/// The qps and average latency are measured per sampling window. The minimum
+/// latency approximates the latency without queueing, it's remeasured
+/// periodically by shrinking the limit to drain the queue. The explore ratio
+/// grows while the latency stays near the minimum, and shrinks once the
+/// requests start queueing.
+class AutoConcurrencyLimiter final : public ConcurrencyLimiter {
+public:
+    AutoConcurrencyLimiter();
+
+    int64_t max_concurrency() const override {
+        return max_concurrency_.load(std::memory_order_relaxed);
+    }
+
+    /// Sample a responded request at `now_us`, the steady clock is used by
+    /// OnResponded().
+    void Sample(bool success, int64_t latency_us, int64_t now_us);
+
+    int64_t min_latency_us() const { return min_latency_us_; }
+    double max_qps() const { return max_qps_; }
+
+protected:
+    void OnSample(bool success, int64_t latency_us) override;
+
+private:
+    void ResetWindow(int64_t now_us);
+    void UpdateMaxConcurrency(int64_t elapsed_us, int64_t now_us);
+
+    std::atomic<int64_t> max_concurrency_;
+
+    /// The states of the sampling window, only one thread updates them at a
+    /// time, the samples are dropped while they're being updated.
+    std::mutex mutex_;
+    int64_t window_start_us_{0};
+    int64_t succeeded_{0};
+    int64_t failed_{0};
+    int64_t succeeded_latency_us_{0};
+    int64_t failed_latency_us_{0};
+
+    int64_t min_latency_us_{-1};
+    double max_qps_{0};
+    double explore_ratio_;
+    /// The time of the next remeasurement of the minimum latency, and whether
+    /// the current window drains the queue for it.
+    int64_t remeasure_at_us_{0};
+    bool remeasuring_{false};
+};
+
+}  // namespace urpc
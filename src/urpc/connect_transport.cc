@@ -15,6 +15,7 @@
 #include "connect_transport.h"
 
 #include <errno.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
@@ -27,22 +28,32 @@
 
 #include "urpc/owned_fd.h"
 #include "urpc/poller.h"
+#include "urpc/socket_options.h"
 
 namespace urpc {
 
 ConnectTransport::~ConnectTransport() {}
 
 int ConnectTransport::DoWrite() {
-    if (ConnectIfNot() == 0) {
+    if (Connect() == 0) {
         HandleWriteEvent();
     }
 
     return 0;
 }
 
+int ConnectTransport::Connect() {
+    int rc = ConnectIfNot();
+    if (rc != 0 && !connecting_) {
+        PLOG(WARNING) << "Fail to connect to " << endpoint2str(endpoint_);
+        Reset(ERR_CONNECT, "Fail to connect");
+    }
+    return rc;
+}
+
 int ConnectTransport::HandleWriteEvent() {
-    if (connecting_) {
-        OnConnect();
+    if (connecting_ && OnConnect() != 0) {
+        return 0;
     }
 
     return Transport::HandleWriteEvent();
@@ -57,49 +68,96 @@ int ConnectTransport::ConnectIfNot() {
         return -1;
     }
 
+    struct sockaddr_storage serv_addr;
+    socklen_t serv_addr_len = 0;
+    if (endpoint2sockaddr(endpoint_, &serv_addr, &serv_addr_len) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
     // REQUIRED: Linux >= 2.6.27
-    urpc::OwnedFD sockfd(
-        socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+    urpc::OwnedFD sockfd(socket(endpoint_.family,
+                                SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
     if (sockfd < 0) {
         return -1;
     }
+    SetSocketOptions(sockfd, endpoint_.family);
+    if (endpoint_.family != AF_UNIX)
+        SetFastOpen(sockfd, false);
 
     LOG(INFO) << "Try connect to " << endpoint2str(endpoint_);
 
-    struct sockaddr_in serv_addr;
-    bzero(reinterpret_cast<char*>(&serv_addr), sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_addr = endpoint_.ip;
-    serv_addr.sin_port = htons(endpoint_.port);
-    int rc = ::connect(sockfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr));
+    int rc = ::connect(sockfd, reinterpret_cast<struct sockaddr*>(&serv_addr),
+                       serv_addr_len);
     if (rc < 0 && errno != EINPROGRESS) {
         return -1;
     }
 
-    fd_ = std::move(sockfd);
+    set_fd(std::move(sockfd));
     if (rc < 0 && errno == EINPROGRESS) {
         LOG(INFO) << "FD " << static_cast<int>(fd_) << " is connecting";
         connecting_ = true;
         Poller::singleton()->AddPollOut(this);
+        if (connect_timeout_ms_ >= 0) {
+            connect_timer_ = Poller::singleton()->AddTimer(
+                connect_timeout_ms_, [this] { OnConnectTimeout(); });
+        }
     } else {
         LOG(INFO) << "FD " << static_cast<int>(fd_) << " is connected";
-        connected_ = true;
+        rc = OnConnect();
     }
 
     return rc;
 }
 
 int ConnectTransport::OnConnect() {
+    CancelConnectTimer();
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+        err = errno;
+    if (err != 0) {
+        LOG(WARNING) << "Fail to connect to " << endpoint2str(endpoint_)
+                     << ": " << strerror(err);
+        Reset(ERR_CONNECT, "Fail to connect");
+        return -1;
+    }
+
     connected_ = true;
     connecting_ = false;
 
+    if (use_shared_memory_ && endpoint_.family == AF_UNIX) {
+        auto link = ShmLink::Connect(fd_);
+        if (!link) {
+            Reset(ERR_CONNECT, "Fail to share memory");
+            return -1;
+        }
+        UseSharedMemory(std::move(link));
+    }
+
     LOG(INFO) << "ConnectTransport::OnConnect";
     StartRead();
+    OnConnected();
 
     return 0;
 }
 
+void ConnectTransport::OnConnectTimeout() {
+    connect_timer_ = 0;
+    LOG(WARNING) << "Fail to connect to " << endpoint2str(endpoint_)
+                 << " in " << connect_timeout_ms_ << "ms";
+    Reset(ERR_CONNECT, "Connect timeout");
+}
+
+void ConnectTransport::CancelConnectTimer() {
+    if (connect_timer_ != 0) {
+        Poller::singleton()->RemoveTimer(connect_timer_);
+        connect_timer_ = 0;
+    }
+}
+
 void ConnectTransport::Reset(int code, std::string reason) {
+    CancelConnectTimer();
     connecting_ = false;
     connected_ = false;
 
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include <string>
 
 #include <urpc/endpoint.h>
@@ -24,21 +26,47 @@ namespace urpc {
 
 class ConnectTransport : public Transport {
 public:
-    explicit ConnectTransport(EndPoint endpoint) : endpoint_(endpoint) {}
+    explicit ConnectTransport(EndPoint endpoint)
+        : Transport(-1, endpoint, false), endpoint_(endpoint) {}
     ~ConnectTransport() override;
 
+    /// The connection in progress is reset with ERR_CONNECT if it's not
+    /// established in `connect_timeout_ms`, -1 means waiting indefinitely.
+    /// It applies to the next connection.
+    void set_connect_timeout_ms(int32_t connect_timeout_ms) {
+        connect_timeout_ms_ = connect_timeout_ms;
+    }
+
+    /// Exchange the bytes with a `unix:` server over shared memory instead
+    /// of the socket. It applies to the next connection.
+    void set_use_shared_memory(bool use_shared_memory) {
+        use_shared_memory_ = use_shared_memory;
+    }
+
 protected:
     void Reset(int code, std::string reason) override;
     int DoWrite() override;
     int HandleWriteEvent() override;
 
+    /// Connect if not yet, 0 is returned if connected. The transport is reset
+    /// with ERR_CONNECT once it fails.
+    int Connect();
+
+    /// Invoked once connected.
+    virtual void OnConnected() {}
+
 private:
     int ConnectIfNot();
     int OnConnect();
+    void OnConnectTimeout();
+    void CancelConnectTimer();
 
-    bool connected_;
-    bool connecting_;
+    bool connected_{false};
+    bool connecting_{false};
     EndPoint endpoint_;
+    int32_t connect_timeout_ms_{-1};
+    bool use_shared_memory_{false};
+    uint64_t connect_timer_{0};
 };
 
 }  // namespace urpc
@@ -23,6 +23,10 @@ void Controller::Reset() {
     error_code_ = 0;
     error_text_.clear();
     completed_ = false;
+    request_compress_type_ = COMPRESS_NONE;
+    response_compress_type_ = COMPRESS_NONE;
+    has_request_code_ = false;
+    request_code_ = 0;
 }
 
 void Controller::StartCancel() { LOG(FATAL) << "Not Supported"; }
@@ -25,13 +25,16 @@
 #include <stdio.h>          // snprintf
 #include <stdlib.h>         // strtol
 #include <string.h>         // strcpy
+#include <stddef.h>         // offsetof
 #include <sys/socket.h>     // SO_REUSEADDR SO_REUSEPORT
+#include <sys/stat.h>       // lstat
 #include <unistd.h>         // gethostname
 #include <urpc/endpoint.h>  // ip_t
 
 #include <string_view>
 
 #include "owned_fd.h"
+#include "socket_options.h"
 
 // supported since Linux 3.9.
 DEFINE_bool(reuse_port, false, "Enable SO_REUSEPORT for all listened sockets");
@@ -89,10 +92,24 @@ int ip2hostname(ip_t ip, std::string* host) {
 
 EndPointStr endpoint2str(const EndPoint& point) {
     EndPointStr str;
-    if (inet_ntop(AF_INET, &point.ip, str._buf, INET_ADDRSTRLEN) == NULL) {
-        return endpoint2str(EndPoint(IP_NONE, 0));
+    if (point.family == AF_UNIX) {
+        snprintf(str._buf, sizeof(str._buf), "unix:%s", point.path.c_str());
+        return str;
+    }
+    char* buf = str._buf;
+    if (point.family == AF_INET6) {
+        *buf++ = '[';
+        if (inet_ntop(AF_INET6, &point.ip6, buf, INET6_ADDRSTRLEN) == NULL) {
+            return endpoint2str(EndPoint(IP_NONE, 0));
+        }
+        buf += strlen(buf);
+        *buf++ = ']';
+    } else {
+        if (inet_ntop(AF_INET, &point.ip, buf, INET_ADDRSTRLEN) == NULL) {
+            return endpoint2str(EndPoint(IP_NONE, 0));
+        }
+        buf += strlen(buf);
     }
-    char* buf = str._buf + strlen(str._buf);
     *buf++ = ':';
     snprintf(buf, 16, "%d", point.port);
     return str;
@@ -135,10 +152,62 @@ int hostname2ip(const char* hostname, ip_t* ip) {
     return 0;
 }
 
+// Parse the port ended with optional spaces.
+static int str2port(const char* str, int* port) {
+    char* end = NULL;
+    long value = strtol(str, &end, 10);
+    if (end == str) {
+        return -1;
+    } else if (*end) {
+        for (; isspace(*end); ++end)
+            ;
+        if (*end) {
+            return -1;
+        }
+    }
+    if (value < 0 || value > 65535) {
+        return -1;
+    }
+    *port = value;
+    return 0;
+}
+
 int str2endpoint(const char* str, EndPoint* point) {
+    if (strncmp(str, "unix:", 5) == 0) {
+        std::string_view path(str + 5);
+        while (!path.empty() && isspace(path.back())) {
+            path.remove_suffix(1);
+        }
+        if (path.empty() || path.size() >= sizeof(sockaddr_un::sun_path)) {
+            return -1;
+        }
+        *point = EndPoint();
+        point->family = AF_UNIX;
+        point->path.assign(path);
+        return 0;
+    }
+
     // Should be enough to hold ip address
     char buf[64];
     size_t i = 0;
+    if (str[0] == '[') {
+        for (++i; i < sizeof(buf) && str[i] != '\0' && str[i] != ']'; ++i) {
+            buf[i - 1] = str[i];
+        }
+        if (i >= sizeof(buf) || str[i] != ']' || str[i + 1] != ':') {
+            return -1;
+        }
+        buf[i - 1] = '\0';
+        EndPoint point6;
+        point6.family = AF_INET6;
+        if (inet_pton(AF_INET6, buf, &point6.ip6) <= 0 ||
+            str2port(str + i + 2, &point6.port) != 0) {
+            return -1;
+        }
+        *point = point6;
+        return 0;
+    }
+
     for (; i < sizeof(buf) && str[i] != '\0' && str[i] != ':'; ++i) {
         buf[i] = str[i];
     }
@@ -146,38 +215,102 @@ int str2endpoint(const char* str, EndPoint* point) {
         return -1;
     }
     buf[i] = '\0';
-    if (str2ip(buf, &point->ip) != 0) {
+    ip_t ip;
+    int port = 0;
+    if (str2ip(buf, &ip) != 0 || str2port(str + i + 1, &port) != 0) {
         return -1;
     }
-    ++i;
-    char* end = NULL;
-    point->port = strtol(str + i, &end, 10);
-    if (end == str + i) {
+    *point = EndPoint(ip, port);
+    return 0;
+}
+
+int str2endpoint(const char* ip_str, int port, EndPoint* point) {
+    if (port < 0 || port > 65535) {
         return -1;
-    } else if (*end) {
-        for (++end; isspace(*end); ++end)
-            ;
-        if (*end) {
-            return -1;
-        }
     }
-    if (point->port < 0 || point->port > 65535) {
+    ip_t ip;
+    if (str2ip(ip_str, &ip) == 0) {
+        *point = EndPoint(ip, port);
+        return 0;
+    }
+    EndPoint point6;
+    point6.family = AF_INET6;
+    point6.port = port;
+    if (ip_str == NULL || inet_pton(AF_INET6, ip_str, &point6.ip6) <= 0) {
         return -1;
     }
+    *point = point6;
     return 0;
 }
 
-int str2endpoint(const char* ip_str, int port, EndPoint* point) {
-    if (str2ip(ip_str, &point->ip) != 0) {
-        return -1;
+int endpoint2sockaddr(const EndPoint& point, struct sockaddr_storage* ss,
+                      socklen_t* len) {
+    bzero((char*)ss, sizeof(*ss));
+    if (point.family == AF_UNIX) {
+        struct sockaddr_un* un = (struct sockaddr_un*)ss;
+        if (point.path.size() >= sizeof(un->sun_path)) {
+            return -1;
+        }
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, point.path.data(), point.path.size());
+        *len = offsetof(struct sockaddr_un, sun_path) + point.path.size() + 1;
+    } else if (point.family == AF_INET6) {
+        struct sockaddr_in6* in6 = (struct sockaddr_in6*)ss;
+        in6->sin6_family = AF_INET6;
+        in6->sin6_addr = point.ip6;
+        in6->sin6_port = htons(point.port);
+        *len = sizeof(*in6);
+    } else {
+        struct sockaddr_in* in = (struct sockaddr_in*)ss;
+        in->sin_family = AF_INET;
+        in->sin_addr = point.ip;
+        in->sin_port = htons(point.port);
+        *len = sizeof(*in);
     }
-    if (port < 0 || port > 65535) {
+    return 0;
+}
+
+int sockaddr2endpoint(const struct sockaddr_storage* ss, socklen_t len,
+                      EndPoint* point) {
+    if (ss->ss_family == AF_INET) {
+        *point = EndPoint(*(const sockaddr_in*)ss);
+    } else if (ss->ss_family == AF_INET6) {
+        *point = EndPoint(*(const sockaddr_in6*)ss);
+    } else if (ss->ss_family == AF_UNIX) {
+        const struct sockaddr_un* un = (const struct sockaddr_un*)ss;
+        const size_t offset = offsetof(struct sockaddr_un, sun_path);
+        *point = EndPoint();
+        point->family = AF_UNIX;
+        // The peers not bound are unnamed.
+        if (len > offset) {
+            point->path.assign(un->sun_path,
+                               strnlen(un->sun_path, len - offset));
+        }
+    } else {
         return -1;
     }
-    point->port = port;
     return 0;
 }
 
+int compare_endpoint(const EndPoint& p1, const EndPoint& p2) {
+    if (p1.family != p2.family) {
+        return p1.family < p2.family ? -1 : 1;
+    }
+    if (p1.family == AF_UNIX) {
+        return p1.path.compare(p2.path);
+    }
+    int rc = 0;
+    if (p1.family == AF_INET6) {
+        rc = memcmp(&p1.ip6, &p2.ip6, sizeof(p1.ip6));
+    } else if (p1.ip != p2.ip) {
+        rc = p1.ip < p2.ip ? -1 : 1;
+    }
+    if (rc != 0) {
+        return rc;
+    }
+    return p1.port < p2.port ? -1 : (p1.port > p2.port ? 1 : 0);
+}
+
 int hostname2endpoint(const char* str, EndPoint* point) {
     // Should be enough to hold ip address
     char buf[64];
@@ -244,17 +377,18 @@ int endpoint2hostname(const EndPoint& point, std::string* host) {
     return -1;
 }
 
-int tcp_connect(EndPoint point, int* self_port) {
-    urpc::OwnedFD sockfd(socket(AF_INET, SOCK_STREAM, 0));
+int tcp_connect(const EndPoint& point, int* self_port) {
+    struct sockaddr_storage serv_addr;
+    socklen_t serv_addr_len = 0;
+    if (endpoint2sockaddr(point, &serv_addr, &serv_addr_len) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    urpc::OwnedFD sockfd(socket(point.family, SOCK_STREAM, 0));
     if (sockfd < 0) {
         return -1;
     }
-    struct sockaddr_in serv_addr;
-    bzero((char*)&serv_addr, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_addr = point.ip;
-    serv_addr.sin_port = htons(point.port);
-    int rc = ::connect(sockfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr));
+    int rc = ::connect(sockfd, (struct sockaddr*)&serv_addr, serv_addr_len);
     if (rc < 0) {
         return -1;
     }
@@ -269,14 +403,35 @@ int tcp_connect(EndPoint point, int* self_port) {
     return sockfd.release();
 }
 
-int tcp_listen(EndPoint point) {
+int tcp_listen(const EndPoint& point) {
+    return tcp_listen(point, FLAGS_reuse_port && point.family != AF_UNIX);
+}
+
+int tcp_listen(const EndPoint& point, bool reuse_port) {
+    if (reuse_port && point.family == AF_UNIX) {
+        // The socket file of the other listener would be removed.
+        errno = EINVAL;
+        return -1;
+    }
+    struct sockaddr_storage serv_addr;
+    socklen_t serv_addr_len = 0;
+    if (endpoint2sockaddr(point, &serv_addr, &serv_addr_len) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
     urpc::OwnedFD sockfd(
-        socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+        socket(point.family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
     if (sockfd < 0) {
         return -1;
     }
 
-    if (FLAGS_reuse_addr) {
+    if (point.family == AF_UNIX) {
+        // Only the socket files are removed, never the regular ones.
+        struct stat st;
+        if (lstat(point.path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(point.path.c_str());
+        }
+    } else if (FLAGS_reuse_addr) {
 #if defined(SO_REUSEADDR)
         const int on = 1;
         if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) !=
@@ -289,7 +444,7 @@ int tcp_listen(EndPoint point) {
 #endif
     }
 
-    if (FLAGS_reuse_port) {
+    if (reuse_port) {
 #if defined(SO_REUSEPORT)
         const int on = 1;
         if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) !=
@@ -298,19 +453,17 @@ int tcp_listen(EndPoint point) {
                          << sockfd;
         }
 #else
-        LOG(ERROR) << "Missing def of SO_REUSEPORT while -reuse_port is on";
+        LOG(ERROR) << "Missing def of SO_REUSEPORT while reuse_port is on";
         return -1;
 #endif
     }
 
-    struct sockaddr_in serv_addr;
-    bzero((char*)&serv_addr, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_addr = point.ip;
-    serv_addr.sin_port = htons(point.port);
-    if (bind(sockfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) != 0) {
+    if (bind(sockfd, (struct sockaddr*)&serv_addr, serv_addr_len) != 0) {
         return -1;
     }
+    if (point.family != AF_UNIX) {
+        SetFastOpen(sockfd, true);
+    }
     if (listen(sockfd, 65535) != 0) {
         //             ^^^ kernel would silently truncate backlog to the value
         //             defined in /proc/sys/net/core/somaxconn if it is less
@@ -321,27 +474,27 @@ int tcp_listen(EndPoint point) {
 }
 
 int get_local_side(int fd, EndPoint* out) {
-    struct sockaddr addr;
+    struct sockaddr_storage addr;
     socklen_t socklen = sizeof(addr);
-    const int rc = getsockname(fd, &addr, &socklen);
+    const int rc = getsockname(fd, (struct sockaddr*)&addr, &socklen);
     if (rc != 0) {
         return rc;
     }
     if (out) {
-        *out = urpc::EndPoint(*(sockaddr_in*)&addr);
+        return sockaddr2endpoint(&addr, socklen, out);
     }
     return 0;
 }
 
 int get_remote_side(int fd, EndPoint* out) {
-    struct sockaddr addr;
+    struct sockaddr_storage addr;
     socklen_t socklen = sizeof(addr);
-    const int rc = getpeername(fd, &addr, &socklen);
+    const int rc = getpeername(fd, (struct sockaddr*)&addr, &socklen);
     if (rc != 0) {
         return rc;
     }
     if (out) {
-        *out = urpc::EndPoint(*(sockaddr_in*)&addr);
+        return sockaddr2endpoint(&addr, socklen, out);
     }
     return 0;
 }
@@ -17,14 +17,20 @@
 #include <glog/logging.h>
 #include <sys/epoll.h>
 
+#include <chrono>
 #include <unordered_set>
+#include <vector>
 
 #include "base.h"
 #include "owned_fd.h"
 #include "poller.h"
+#include "utils/atomic.h"
 
 namespace urpc {
 
+using utils::DecreaseRelaxed;
+using utils::IncreaseRelaxed;
+
 class EPoller : public Poller {
 public:
     EPoller();
@@ -32,7 +38,7 @@ public:
     EPoller(const EPoller&) = delete;
     EPoller& operator=(const EPoller&) = delete;
 
-    int PollOnce() override;
+    int PollOnce(int timeout_ms) override;
     int AddPollIn(IOHandle*) override;
     int AddPollOut(IOHandle*) override;
     int RemoveConsumer(IOHandle*) override;
@@ -51,36 +57,59 @@ EPoller::EPoller() {
         PLOG(FATAL) << "epoll_create1";
     }
     LOG(INFO) << "epoll_create1 " << fd;
-    pollfd_ = fd;
+    pollfd_ = OwnedFD(fd);
 }
 
-int EPoller::PollOnce() {
+int EPoller::PollOnce(int timeout_ms) {
     constexpr int MAX_EVENTS = 32;
     struct epoll_event events[MAX_EVENTS];
-    ssize_t n = epoll_wait(pollfd_, events, MAX_EVENTS, 0);
+    ssize_t n =
+        epoll_wait(pollfd_, events, MAX_EVENTS, PollTimeoutMs(timeout_ms));
     LOG(INFO) << "epoll_wait fd " << static_cast<int>(pollfd_) << " found " << n
               << " active events";
-    if (n < 0) {
+    if (n <= 0) {
+        RunTimers();
+        DestoryDelayedIOHandles();
         return n;
     }
 
+    auto start = std::chrono::steady_clock::now();
+    IncreaseRelaxed(&counters_.wakeups, 1);
+    IncreaseRelaxed(&counters_.events, n);
+    if (counters_.max_events_per_wakeup.load(std::memory_order_relaxed) <
+        static_cast<uint64_t>(n)) {
+        counters_.max_events_per_wakeup.store(n, std::memory_order_relaxed);
+    }
+
     for (ssize_t i = 0; i < n; ++i) {
         struct epoll_event* event = &events[i];
         auto handle = reinterpret_cast<IOHandle*>(event->data.ptr);
+        // A failed handle is removed unless it's reset already, which
+        // removes it too, so that its reference is released only once.
         if (event->events & EPOLLOUT) {
             if (handle->HandleWriteEvent() != ERR_OK) {
-                delayed_destories_.push_back(handle);
+                if (handle->poll_in() || handle->poll_out())
+                    RemoveConsumer(handle);
                 continue;
             }
         }
         if (event->events & EPOLLIN) {
             if (handle->HandleReadEvent() != ERR_OK) {
-                delayed_destories_.push_back(handle);
+                if (handle->poll_in() || handle->poll_out())
+                    RemoveConsumer(handle);
                 continue;
             }
         }
     }
 
+    RunTimers();
+    // Released after the batch, the events of which might refer to them.
+    DestoryDelayedIOHandles();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    IncreaseRelaxed(&counters_.busy_us, elapsed.count());
+
     return n;
 }
 
@@ -98,6 +127,7 @@ int EPoller::AddPollIn(IOHandle* handle) {
     } else {
         handle->AddRef();
         handles_.insert(handle);
+        IncreaseRelaxed(&counters_.handles, 1);
     }
     if (epoll_ctl(pollfd_, op, handle->fd(), &ev) < 0) {
         PLOG(FATAL) << "epoll_ctl " << pollfd_ << " new fd " << handle->fd();
@@ -124,6 +154,7 @@ int EPoller::AddPollOut(IOHandle* handle) {
     } else {
         handle->AddRef();
         handles_.insert(handle);
+        IncreaseRelaxed(&counters_.handles, 1);
     }
     if (epoll_ctl(pollfd_, op, handle->fd(), &ev) < 0) {
         PLOG(FATAL) << "epoll_ctl";
@@ -142,6 +173,7 @@ int EPoller::RemoveConsumer(IOHandle* handle) {
         PLOG(FATAL) << "epoll_ctl";
     } else {
         delayed_destories_.push_back(handle);
+        DecreaseRelaxed(&counters_.handles, 1);
     }
 
     IOHandleAccessor accessor(handle);
@@ -152,11 +184,15 @@ int EPoller::RemoveConsumer(IOHandle* handle) {
 }
 
 void EPoller::DestoryDelayedIOHandles() {
-    for (auto handle : delayed_destories_) {
-        handle->RelRef();
-        handles_.erase(handle);
+    // The destructors might remove more handles.
+    while (!delayed_destories_.empty()) {
+        std::vector<IOHandle*> handles;
+        handles.swap(delayed_destories_);
+        for (auto handle : handles) {
+            handles_.erase(handle);
+            handle->RelRef();
+        }
     }
-    delayed_destories_.clear();
 }
 
 Poller* poller() {
@@ -0,0 +1,104 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "idle_wheel.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "base.h"
+#include "poller.h"
+#include "transport.h"
+
+namespace urpc {
+
+/// The interval of turns, the resolution of idle timeouts.
+static constexpr int64_t kTickMs = 1000;
+/// The deadlines further than the wheel are checked once per round.
+static constexpr size_t kSlots = 64;
+
+IdleWheel* IdleWheel::singleton() {
+    static thread_local IdleWheel wheel;
+    return &wheel;
+}
+
+IdleWheel::IdleWheel() : slots_(kSlots) {}
+
+void IdleWheel::Add(Transport* transport) {
+    if (transport->idle_slot_ >= 0)
+        Remove(transport);
+    transport->last_active_ = now_;
+    Schedule(transport);
+    ++size_;
+    if (timer_id_ == 0) {
+        timer_id_ = Poller::singleton()->AddTimer(kTickMs, [this] { Turn(); });
+    }
+}
+
+void IdleWheel::Remove(Transport* transport) {
+    if (transport->idle_slot_ < 0)
+        return;
+    slots_[transport->idle_slot_].erase(transport);
+    transport->idle_slot_ = -1;
+    --size_;
+}
+
+void IdleWheel::Schedule(Transport* transport) {
+    // At least the timeout elapses, since the tick of the activity is
+    // partially elapsed.
+    const uint64_t deadline = std::max(
+        transport->last_active_ + transport->idle_timeout_s_ * 1000 / kTickMs +
+            1,
+        now_ + 1);
+    const int slot = static_cast<int>(deadline % kSlots);
+    if (transport->idle_slot_ == slot)
+        return;
+    if (transport->idle_slot_ >= 0)
+        slots_[transport->idle_slot_].erase(transport);
+    slots_[slot].insert(transport);
+    transport->idle_slot_ = slot;
+}
+
+void IdleWheel::Turn() {
+    ++now_;
+    // The transports reset are removed from the slot meanwhile.
+    std::vector<Transport*> due(slots_[now_ % kSlots].begin(),
+                                slots_[now_ % kSlots].end());
+    for (auto transport : due) {
+        if (transport->idle_slot_ < 0)
+            continue;
+        const uint64_t deadline = transport->last_active_ +
+                                  transport->idle_timeout_s_ * 1000 / kTickMs +
+                                  1;
+        if (deadline > now_) {
+            Schedule(transport);
+        } else if (transport->Idle()) {
+            LOG(INFO) << "Close transport fd " << transport->fd()
+                      << " idle for " << transport->idle_timeout_s_ << "s";
+            transport->Reset(ERR_IDLE, "Idle timeout");
+        } else {
+            // Waiting for the responses or writes, checked again later.
+            transport->last_active_ = now_;
+            Schedule(transport);
+        }
+    }
+
+    timer_id_ = 0;
+    if (size_ > 0) {
+        timer_id_ = Poller::singleton()->AddTimer(kTickMs, [this] { Turn(); });
+    }
+}
+
+}  // namespace urpc
@@ -0,0 +1,62 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unordered_set>
+#include <vector>
+
+namespace urpc {
+
+class Transport;
+
+/// Close the transports of the thread idle for too long. Instead of a timer
+/// per transport, the transports are hashed into the slots of a wheel by
+/// their deadlines, and the wheel turns a slot per second by a single timer
+/// of the poller. The reads and writes only record the tick of the wheel,
+/// a transport found active in its slot is moved to the slot of its new
+/// deadline.
+class IdleWheel final {
+public:
+    static IdleWheel* singleton();
+
+    /// The ticks elapsed, the coarse clock of the activities of transports.
+    uint64_t now() const noexcept { return now_; }
+
+    /// Track `transport` until it's removed.
+    void Add(Transport* transport);
+    void Remove(Transport* transport);
+
+    /// The number of transports tracked.
+    size_t size() const noexcept { return size_; }
+
+private:
+    IdleWheel();
+
+    /// Move to the next slot and close the idle transports of it.
+    void Turn();
+
+    /// Put `transport` into the slot of its deadline, but later than now.
+    void Schedule(Transport* transport);
+
+    std::vector<std::unordered_set<Transport*>> slots_;
+    size_t size_{0};
+    uint64_t now_{0};
+    uint64_t timer_id_{0};
+};
+
+}  // namespace urpc
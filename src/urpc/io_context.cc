@@ -14,19 +14,19 @@
 
 #include <urpc/io_context.h>
 
-#include <chrono>
-#include <thread>
-
 #include "poller.h"
 
 namespace urpc {
 
+/// The maximum time to block in the poller when there are no events, so that
+/// LOOP_ONCE callers get the chance to check their exit conditions.
+static constexpr int kPollTimeoutMs = 10;
+
 IOContext::IOContext(LoopMode mode) : mode_(mode) {}
 
 IOContext::~IOContext() {
     do {
-        Poller::singleton()->PollOnce();
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        Poller::singleton()->PollOnce(kPollTimeoutMs);
     } while (mode_ == LOOP_FOREVER);
 }
 
@@ -0,0 +1,179 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <thread>
+
+#include <glog/logging.h>
+
+#include "base.h"
+
+namespace urpc {
+
+namespace {
+
+/// The slots of the live handles, addressed by the low 32 bits of ids. The
+/// slots are allocated by blocks never freed, so they are read without any
+/// lock.
+class IOHandleRegistry final {
+public:
+    static IOHandleRegistry* singleton() {
+        static IOHandleRegistry registry;
+        return &registry;
+    }
+
+    uint64_t Register(IOHandle* handle) {
+        uint32_t index;
+        if (!PopFreeSlot(&index)) {
+            index = size_.fetch_add(1, std::memory_order_relaxed);
+            CHECK_LT(index, kMaxBlocks * kBlockSize) << "Too many IO handles";
+        }
+        Slot* slot = FindSlot(index, true);
+        slot->handle.store(handle, std::memory_order_release);
+        return (slot->state.load(std::memory_order_relaxed) & kVersionMask) |
+               index;
+    }
+
+    void Unregister(uint64_t id) {
+        const uint32_t index = static_cast<uint32_t>(id);
+        Slot* slot = FindSlot(index, false);
+        // The addressings of the old version fail once the version changes,
+        // version 0 is skipped so that 0 is never an id.
+        uint64_t state = slot->state.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            next = state + kVersionOne;
+            if ((next & kVersionMask) == 0)
+                next += kVersionOne;
+        } while (!slot->state.compare_exchange_weak(
+            state, next, std::memory_order_acq_rel,
+            std::memory_order_relaxed));
+        // The handle is freed once the addressings in progress are done.
+        while (slot->state.load(std::memory_order_acquire) & kPinMask)
+            std::this_thread::yield();
+        slot->handle.store(nullptr, std::memory_order_relaxed);
+        PushFreeSlot(index);
+    }
+
+    IOHandle* Address(uint64_t id) {
+        const uint32_t index = static_cast<uint32_t>(id);
+        if (index >= size_.load(std::memory_order_acquire))
+            return nullptr;
+        Slot* slot = FindSlot(index, false);
+        if (!slot)
+            return nullptr;
+        // Pin the slot of the version, so that the handle isn't freed until
+        // the reference is added. Its last reference might be released
+        // already, in which case it's being destroyed.
+        uint64_t state = slot->state.load(std::memory_order_acquire);
+        do {
+            if ((state & kVersionMask) != (id & kVersionMask))
+                return nullptr;
+        } while (!slot->state.compare_exchange_weak(
+            state, state + 1, std::memory_order_acq_rel,
+            std::memory_order_acquire));
+        IOHandle* handle = slot->handle.load(std::memory_order_acquire);
+        if (handle && !handle->TryAddRef())
+            handle = nullptr;
+        slot->state.fetch_sub(1, std::memory_order_release);
+        return handle;
+    }
+
+private:
+    static constexpr uint64_t kVersionOne = uint64_t(1) << 32;
+    static constexpr uint64_t kVersionMask = ~uint64_t(0) << 32;
+    static constexpr uint64_t kPinMask = ~kVersionMask;
+    static constexpr uint32_t kBlockSize = 4096;
+    static constexpr uint32_t kMaxBlocks = 16384;
+
+    struct Slot {
+        /// The version in the high 32 bits, and the number of addressings
+        /// in progress in the low ones.
+        std::atomic<uint64_t> state{kVersionOne};
+        std::atomic<IOHandle*> handle{nullptr};
+        /// The next in the free list, plus 1.
+        std::atomic<uint32_t> next_free{0};
+    };
+
+    struct Block {
+        Slot slots[kBlockSize];
+    };
+
+    IOHandleRegistry() = default;
+
+    Slot* FindSlot(uint32_t index, bool create) {
+        std::atomic<Block*>* entry = &blocks_[index / kBlockSize];
+        Block* block = entry->load(std::memory_order_acquire);
+        if (!block && create) {
+            auto created = new Block;
+            if (entry->compare_exchange_strong(block, created,
+                                               std::memory_order_acq_rel)) {
+                block = created;
+            } else {
+                delete created;
+            }
+        }
+        return block ? &block->slots[index % kBlockSize] : nullptr;
+    }
+
+    // The free list is a stack of slots, its head is the top slot plus 1 in
+    // the low 32 bits, and a tag changed by every update against ABA.
+
+    bool PopFreeSlot(uint32_t* index) {
+        uint64_t head = free_head_.load(std::memory_order_acquire);
+        while (static_cast<uint32_t>(head) != 0) {
+            const uint32_t top = static_cast<uint32_t>(head) - 1;
+            const uint64_t next =
+                ((head >> 32) + 1) << 32 |
+                FindSlot(top, false)->next_free.load(
+                    std::memory_order_relaxed);
+            if (free_head_.compare_exchange_weak(head, next,
+                                                 std::memory_order_acq_rel,
+                                                 std::memory_order_acquire)) {
+                *index = top;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void PushFreeSlot(uint32_t index) {
+        Slot* slot = FindSlot(index, false);
+        uint64_t head = free_head_.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            slot->next_free.store(static_cast<uint32_t>(head),
+                                  std::memory_order_relaxed);
+            next = ((head >> 32) + 1) << 32 | (index + 1);
+        } while (!free_head_.compare_exchange_weak(
+            head, next, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    std::atomic<uint32_t> size_{0};
+    std::atomic<uint64_t> free_head_{0};
+    std::atomic<Block*> blocks_[kMaxBlocks] = {};
+};
+
+}  // namespace
+
+IOHandle::IOHandle() : id_(IOHandleRegistry::singleton()->Register(this)) {}
+
+IOHandle::~IOHandle() { IOHandleRegistry::singleton()->Unregister(id_); }
+
+utils::owner_ptr<IOHandle> IOHandle::Address(uint64_t id) {
+    IOHandle* handle = IOHandleRegistry::singleton()->Address(id);
+    return utils::owner_ptr<IOHandle>(handle);
+}
+
+}  // namespace urpc
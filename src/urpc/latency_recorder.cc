@@ -0,0 +1,100 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "latency_recorder.h"
+
+#include <gflags/gflags.h>
+
+#include <algorithm>
+
+DEFINE_int32(
+    latency_window_s, 10,
+    "The minimum window in seconds of the latency percentiles and qps");
+
+namespace urpc {
+
+LatencyRecorder::LatencyRecorder() {
+    previous_.time = current_.time = Clock::now();
+    previous_.buckets.resize(Histogram::kBucketCount, 0);
+    current_.buckets.resize(Histogram::kBucketCount, 0);
+}
+
+void LatencyRecorder::TakeSnapshot(Snapshot* snapshot) const {
+    snapshot->time = Clock::now();
+    snapshot->count = 0;
+    snapshot->sum = 0;
+    snapshot->max = 0;
+    snapshot->buckets.assign(Histogram::kBucketCount, 0);
+    combiner_.ForEach([snapshot](const Agent& agent) {
+        snapshot->count += agent.count.load(std::memory_order_relaxed);
+        snapshot->sum += agent.sum.load(std::memory_order_relaxed);
+        snapshot->max = std::max(snapshot->max,
+                                 agent.max.load(std::memory_order_relaxed));
+        for (size_t i = 0; i < Histogram::kBucketCount; ++i) {
+            snapshot->buckets[i] +=
+                agent.buckets[i].load(std::memory_order_relaxed);
+        }
+    });
+}
+
+LatencyRecorder::Stats LatencyRecorder::Sample() {
+    Snapshot now;
+    TakeSnapshot(&now);
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (now.time - current_.time >=
+        std::chrono::seconds(FLAGS_latency_window_s)) {
+        previous_ = std::move(current_);
+        current_ = now;
+    }
+
+    // Counts are read without synchronization with writers, so the values of
+    // a snapshot might be slightly inconsistent, never underflow.
+    Histogram window;
+    for (size_t i = 0; i < Histogram::kBucketCount; ++i) {
+        if (now.buckets[i] > previous_.buckets[i])
+            window.AddToBucket(i, now.buckets[i] - previous_.buckets[i]);
+    }
+
+    Stats stats;
+    stats.total_count = now.count;
+    stats.total_sum_us = now.sum;
+    stats.max_us = now.max;
+
+    const uint64_t count =
+        now.count > previous_.count ? now.count - previous_.count : 0;
+    const uint64_t sum = now.sum > previous_.sum ? now.sum - previous_.sum : 0;
+    stats.window_s = std::chrono::duration<double>(now.time - previous_.time)
+                         .count();
+    if (stats.window_s > 0)
+        stats.qps = count / stats.window_s;
+    if (count > 0)
+        stats.avg_us = static_cast<double>(sum) / count;
+    stats.p50_us = window.Percentile(0.5);
+    stats.p90_us = window.Percentile(0.9);
+    stats.p99_us = window.Percentile(0.99);
+    stats.p999_us = window.Percentile(0.999);
+    stats.window_max_us = window.max();
+    return stats;
+}
+
+uint64_t LatencyRecorder::count() const {
+    uint64_t count = 0;
+    combiner_.ForEach([&count](const Agent& agent) {
+        count += agent.count.load(std::memory_order_relaxed);
+    });
+    return count;
+}
+
+}  // namespace urpc
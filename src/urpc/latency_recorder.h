@@ -0,0 +1,103 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "utils/agent_combiner.h"
+#include "utils/histogram.h"
+
+namespace urpc {
+
+/// Record latencies (in microseconds) from any thread with a few relaxed
+/// stores on a per-thread agent, percentiles and qps are computed when
+/// reading by merging all agents.
+class LatencyRecorder {
+public:
+    /// Agents record with 4 bits precision (a relative error under 1/16) to
+    /// keep the per-thread footprint small.
+    using Histogram = utils::BasicHistogram<5>;
+
+    struct Stats {
+        /// Cumulative values since the recorder was created.
+        uint64_t total_count{0};
+        uint64_t total_sum_us{0};
+        uint64_t max_us{0};
+
+        /// Values of the recent window, see `Sample()`.
+        double window_s{0};
+        double qps{0};
+        double avg_us{0};
+        uint64_t p50_us{0};
+        uint64_t p90_us{0};
+        uint64_t p99_us{0};
+        uint64_t p999_us{0};
+        uint64_t window_max_us{0};
+    };
+
+    LatencyRecorder();
+    LatencyRecorder(const LatencyRecorder&) = delete;
+    LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+
+    void Record(uint64_t latency_us) {
+        Agent* agent = combiner_.agent();
+        utils::IncreaseRelaxed(&agent->count, 1);
+        utils::IncreaseRelaxed(&agent->sum, latency_us);
+        utils::IncreaseRelaxed(
+            &agent->buckets[Histogram::BucketIndex(latency_us)], 1);
+        if (agent->max.load(std::memory_order_relaxed) < latency_us)
+            agent->max.store(latency_us, std::memory_order_relaxed);
+    }
+
+    /// Merge the agents of all threads. The window values cover the latencies
+    /// recorded in the last `window_s` to `2 * window_s` seconds, the window is
+    /// rolled forward by readers, so no background thread is required.
+    Stats Sample();
+
+    uint64_t count() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Agent {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+        std::atomic<uint64_t> buckets[Histogram::kBucketCount] = {};
+    };
+
+    /// A merged view of all agents at some time.
+    struct Snapshot {
+        Clock::time_point time;
+        uint64_t count{0};
+        uint64_t sum{0};
+        uint64_t max{0};
+        std::vector<uint64_t> buckets;
+    };
+
+    void TakeSnapshot(Snapshot* snapshot) const;
+
+    utils::AgentCombiner<Agent> combiner_;
+
+    std::mutex mutex_;
+    Snapshot previous_;
+    Snapshot current_;
+};
+
+}  // namespace urpc
@@ -0,0 +1,445 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "load_balancer.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_double(chash_load_factor, 1.25,
+              "The bound of the requests in flight of a server relative to "
+              "the average, for the bounded consistent hashing load "
+              "balancers, at least 1");
+
+namespace urpc {
+
+namespace {
+
+/// The weight of a new latency in the moving averages.
+constexpr double kLatencyEmaFactor = 0.1;
+
+uint64_t RandomUint64() {
+    thread_local std::mt19937_64 engine(std::random_device{}());
+    return engine();
+}
+
+}  // namespace
+
+std::unique_ptr<LoadBalancer> LoadBalancer::New(const std::string& name) {
+    if (name == "rr")
+        return std::make_unique<RoundRobinLoadBalancer>();
+    if (name == "wr")
+        return std::make_unique<WeightedRandomLoadBalancer>();
+    if (name == "la")
+        return std::make_unique<LocalityAwareLoadBalancer>();
+
+    constexpr std::string_view kBounded = "_bounded";
+    std::string_view hash = name;
+    bool bounded = false;
+    if (hash.size() > kBounded.size() &&
+        hash.substr(hash.size() - kBounded.size()) == kBounded) {
+        hash.remove_suffix(kBounded.size());
+        bounded = true;
+    }
+    if (hash == "c_murmurhash") {
+        return std::make_unique<ConsistentHashLoadBalancer>(
+            ConsistentHashLoadBalancer::HASH_MURMUR, bounded);
+    }
+    if (hash == "c_ketama") {
+        return std::make_unique<ConsistentHashLoadBalancer>(
+            ConsistentHashLoadBalancer::HASH_KETAMA, bounded);
+    }
+    LOG(ERROR) << "Unknown load balancer " << name;
+    return nullptr;
+}
+
+void RoundRobinLoadBalancer::ResetServers(
+    const std::vector<ServerNode>& servers) {
+    auto addrs = std::make_shared<std::vector<EndPoint>>();
+    for (auto&& node : servers)
+        addrs->push_back(node.addr);
+    servers_ = std::move(addrs);
+}
+
+int RoundRobinLoadBalancer::SelectServer(const SelectIn& in,
+                                         EndPoint* server) {
+    if (!servers_ || servers_->empty())
+        return -1;
+    const auto& servers = *servers_;
+    for (size_t i = 0; i < servers.size(); ++i) {
+        const EndPoint& addr = servers[next_++ % servers.size()];
+        if (IsAvailable(in, addr)) {
+            *server = addr;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void WeightedRandomLoadBalancer::ResetServers(
+    const std::vector<ServerNode>& servers) {
+    auto list = std::make_shared<Servers>();
+    uint64_t sum = 0;
+    for (auto&& node : servers) {
+        sum += node.weight;
+        list->addrs.push_back(node.addr);
+        list->weight_sums.push_back(sum);
+    }
+    servers_ = std::move(list);
+}
+
+int WeightedRandomLoadBalancer::SelectServer(const SelectIn& in,
+                                             EndPoint* server) {
+    if (!servers_ || servers_->addrs.empty())
+        return -1;
+    const auto& addrs = servers_->addrs;
+    const auto& sums = servers_->weight_sums;
+    uint64_t point = RandomUint64() % sums.back();
+    size_t index = std::upper_bound(sums.begin(), sums.end(), point) -
+                   sums.begin();
+    // The unavailable servers pass their share to the next ones.
+    for (size_t i = 0; i < addrs.size(); ++i) {
+        const EndPoint& addr = addrs[(index + i) % addrs.size()];
+        if (IsAvailable(in, addr)) {
+            *server = addr;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void LocalityAwareLoadBalancer::ResetServers(
+    const std::vector<ServerNode>& servers) {
+    std::map<EndPoint, std::shared_ptr<Stats>> stats;
+    auto list = std::make_shared<std::vector<Server>>();
+    for (auto&& node : servers) {
+        auto& server_stats = stats[node.addr];
+        if (!server_stats) {
+            auto it = stats_.find(node.addr);
+            server_stats = it != stats_.end() ? it->second
+                                              : std::make_shared<Stats>();
+        }
+        list->push_back(Server{node.addr, server_stats});
+    }
+    stats_ = std::move(stats);
+    servers_ = std::move(list);
+}
+
+int LocalityAwareLoadBalancer::SelectServer(const SelectIn& in,
+                                            EndPoint* server) {
+    if (!servers_ || servers_->empty())
+        return -1;
+
+    // The servers without feedback are assumed as fast as the average, so
+    // they are probed soon.
+    const auto& servers = *servers_;
+    double sum = 0;
+    size_t measured = 0;
+    for (auto&& item : servers) {
+        if (item.stats->avg_latency_us > 0) {
+            sum += item.stats->avg_latency_us;
+            measured++;
+        }
+    }
+    const double default_latency_us = measured ? sum / measured : 1;
+
+    weights_.resize(servers.size());
+    double total = 0;
+    for (size_t i = 0; i < servers.size(); ++i) {
+        const Stats& stats = *servers[i].stats;
+        double latency_us = stats.avg_latency_us > 0 ? stats.avg_latency_us
+                                                     : default_latency_us;
+        if (IsAvailable(in, servers[i].addr))
+            total += 1.0 / (std::max(latency_us, 1.0) * (stats.inflight + 1));
+        weights_[i] = total;
+    }
+    if (total <= 0)
+        return -1;
+
+    double point = total * (RandomUint64() >> 11) * 0x1.0p-53;
+    size_t index = std::upper_bound(weights_.begin(), weights_.end(), point) -
+                   weights_.begin();
+    index = std::min(index, servers.size() - 1);
+    servers[index].stats->inflight++;
+    *server = servers[index].addr;
+    return 0;
+}
+
+void LocalityAwareLoadBalancer::Feedback(const EndPoint& server, bool success,
+                                         int64_t latency_us) {
+    auto it = stats_.find(server);
+    if (it == stats_.end())
+        return;
+
+    Stats* stats = it->second.get();
+    stats->inflight = std::max<int64_t>(stats->inflight - 1, 0);
+    double latency = latency_us;
+    if (!success)
+        latency = std::max(latency, 2 * stats->avg_latency_us);
+    if (stats->avg_latency_us <= 0) {
+        stats->avg_latency_us = latency;
+    } else {
+        stats->avg_latency_us = latency * kLatencyEmaFactor +
+                                stats->avg_latency_us * (1 - kLatencyEmaFactor);
+    }
+}
+
+ConsistentHashLoadBalancer::ConsistentHashLoadBalancer(HashType type,
+                                                       bool bounded)
+    : type_(type), bounded_(bounded) {}
+
+void ConsistentHashLoadBalancer::ResetServers(
+    const std::vector<ServerNode>& servers) {
+    auto ring = std::make_shared<Ring>();
+    std::map<EndPoint, std::shared_ptr<int64_t>> inflight;
+    total_inflight_ = 0;
+    for (auto&& node : servers) {
+        auto& counter = inflight[node.addr];
+        if (!counter) {
+            auto it = inflight_.find(node.addr);
+            if (it != inflight_.end()) {
+                counter = it->second;
+                total_inflight_ += *counter;
+            } else {
+                counter = std::make_shared<int64_t>(0);
+            }
+        }
+
+        const size_t index = ring->servers.size();
+        ring->servers.push_back(Server{node.addr, counter});
+        const std::string name = endpoint2str(node.addr).c_str();
+        if (type_ == HASH_MURMUR) {
+            for (int i = 0; i < 100 * node.weight; ++i) {
+                std::string key = name + "-" + std::to_string(i);
+                ring->nodes.emplace_back(
+                    MurmurHash64(key.data(), key.size(), 0), index);
+            }
+        } else {
+            for (int i = 0; i < 40 * node.weight; ++i) {
+                std::string key = name + "-" + std::to_string(i);
+                uint8_t digest[16];
+                MD5(key.data(), key.size(), digest);
+                for (int j = 0; j < 4; ++j) {
+                    const uint8_t* p = digest + j * 4;
+                    uint64_t hash = (uint64_t(p[3]) << 24) |
+                                    (uint64_t(p[2]) << 16) |
+                                    (uint64_t(p[1]) << 8) | p[0];
+                    ring->nodes.emplace_back(hash, index);
+                }
+            }
+        }
+    }
+    std::sort(ring->nodes.begin(), ring->nodes.end());
+    ring_ = std::move(ring);
+    inflight_ = std::move(inflight);
+}
+
+int ConsistentHashLoadBalancer::SelectServer(const SelectIn& in,
+                                             EndPoint* server) {
+    if (!ring_ || ring_->nodes.empty())
+        return -1;
+    if (!in.has_request_code) {
+        LOG(ERROR) << "Controller::set_request_code() is required by "
+                      "consistent hashing";
+        return -1;
+    }
+
+    const Ring& ring = *ring_;
+    uint64_t code = in.request_code;
+    if (type_ == HASH_KETAMA)
+        code &= 0xffffffff;
+    auto it = std::lower_bound(
+        ring.nodes.begin(), ring.nodes.end(), code,
+        [](const auto& node, uint64_t code) { return node.first < code; });
+    size_t pos = it - ring.nodes.begin();
+    if (pos == ring.nodes.size())
+        pos = 0;
+
+    // Counting this request, some server is always below the average and
+    // so the capacity.
+    int64_t capacity = INT64_MAX;
+    if (bounded_) {
+        const double average =
+            (total_inflight_ + 1.0) / static_cast<double>(ring.servers.size());
+        capacity = static_cast<int64_t>(
+            std::ceil(std::max(FLAGS_chash_load_factor, 1.0) * average));
+    }
+
+    // The codes of the unavailable or overloaded servers go to the next
+    // servers on the ring.
+    size_t index = ring.nodes[pos].second;
+    size_t i = 0;
+    for (; i < ring.nodes.size(); ++i) {
+        const Server& item = ring.servers[index];
+        if (*item.inflight < capacity && IsAvailable(in, item.addr))
+            break;
+        pos = pos + 1 == ring.nodes.size() ? 0 : pos + 1;
+        index = ring.nodes[pos].second;
+    }
+    if (i == ring.nodes.size())
+        return -1;
+
+    ++*ring.servers[index].inflight;
+    ++total_inflight_;
+    *server = ring.servers[index].addr;
+    return 0;
+}
+
+void ConsistentHashLoadBalancer::Feedback(const EndPoint& server,
+                                          bool success, int64_t latency_us) {
+    auto it = inflight_.find(server);
+    if (it == inflight_.end() || *it->second <= 0)
+        return;
+    --*it->second;
+    --total_inflight_;
+}
+
+uint64_t MurmurHash64(const void* data, size_t len, uint64_t seed) {
+    constexpr uint64_t m = 0xc6a4a7935bd1e995ULL;
+    constexpr int r = 47;
+
+    uint64_t h = seed ^ (len * m);
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    const uint8_t* end = bytes + (len / 8) * 8;
+    for (; bytes != end; bytes += 8) {
+        uint64_t k;
+        memcpy(&k, bytes, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    switch (len & 7) {
+        case 7:
+            h ^= uint64_t(bytes[6]) << 48;
+            [[fallthrough]];
+        case 6:
+            h ^= uint64_t(bytes[5]) << 40;
+            [[fallthrough]];
+        case 5:
+            h ^= uint64_t(bytes[4]) << 32;
+            [[fallthrough]];
+        case 4:
+            h ^= uint64_t(bytes[3]) << 24;
+            [[fallthrough]];
+        case 3:
+            h ^= uint64_t(bytes[2]) << 16;
+            [[fallthrough]];
+        case 2:
+            h ^= uint64_t(bytes[1]) << 8;
+            [[fallthrough]];
+        case 1:
+            h ^= uint64_t(bytes[0]);
+            h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+namespace {
+
+constexpr uint32_t kMD5Shifts[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+void MD5Transform(uint32_t state[4], const uint8_t block[64]) {
+    // floor(abs(sin(i + 1)) * 2^32).
+    static const auto kSines = [] {
+        std::array<uint32_t, 64> sines{};
+        for (int i = 0; i < 64; ++i)
+            sines[i] = static_cast<uint32_t>(
+                std::floor(std::fabs(std::sin(i + 1.0)) * 4294967296.0));
+        return sines;
+    }();
+
+    uint32_t m[16];
+    for (int i = 0; i < 16; ++i) {
+        const uint8_t* p = block + i * 4;
+        m[i] = uint32_t(p[0]) | (uint32_t(p[1]) << 8) |
+               (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t f;
+        int g;
+        if (i < 16) {
+            f = (b & c) | (~b & d);
+            g = i;
+        } else if (i < 32) {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) % 16;
+        } else if (i < 48) {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) % 16;
+        } else {
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+        }
+        f += a + kSines[i] + m[g];
+        a = d;
+        d = c;
+        c = b;
+        b += (f << kMD5Shifts[i]) | (f >> (32 - kMD5Shifts[i]));
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+}  // namespace
+
+void MD5(const void* data, size_t len, uint8_t digest[16]) {
+    uint32_t state[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    size_t left = len;
+    for (; left >= 64; left -= 64, bytes += 64)
+        MD5Transform(state, bytes);
+
+    // Pad with 0x80, zeros and the length in bits.
+    uint8_t tail[128] = {0};
+    memcpy(tail, bytes, left);
+    tail[left] = 0x80;
+    const size_t tail_len = left < 56 ? 64 : 128;
+    const uint64_t bits = static_cast<uint64_t>(len) * 8;
+    for (int i = 0; i < 8; ++i)
+        tail[tail_len - 8 + i] = static_cast<uint8_t>(bits >> (i * 8));
+    for (size_t i = 0; i < tail_len; i += 64)
+        MD5Transform(state, tail + i);
+
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j)
+            digest[i * 4 + j] = static_cast<uint8_t>(state[i] >> (j * 8));
+    }
+}
+
+}  // namespace urpc
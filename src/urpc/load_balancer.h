@@ -0,0 +1,182 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <urpc/endpoint.h>
+
+#include "urpc/naming_service.h"
+
+namespace urpc {
+
+/// Select a server per RPC. Load balancers are used in the poller thread of
+/// their channel like the transports, so the selection takes no lock. The
+/// servers are kept in an immutable list replaced as a whole by
+/// ResetServers(), a selection sees either the old list or the new one.
+class LoadBalancer {
+public:
+    struct SelectIn {
+        bool has_request_code{false};
+        uint64_t request_code{0};
+        /// The servers it returns false for are skipped, e.g. the ones
+        /// isolated by the circuit breakers. nullptr if all are available.
+        bool (*available)(const EndPoint& server){nullptr};
+    };
+
+    virtual ~LoadBalancer() = default;
+
+    /// Create the load balancer of `name`, [`nullptr`] if it's unknown:
+    ///
+    ///   rr            round robin
+    ///   wr            random, weighted by the weights of the servers
+    ///   la            locality-aware, more requests to the servers of lower
+    ///                 latency
+    ///   c_murmurhash  consistent hashing by the request code of the
+    ///                 controller, with the virtual nodes hashed by murmurhash
+    ///   c_ketama      consistent hashing compatible with the ketama clients
+    ///
+    /// The consistent hashing ones suffixed by `_bounded`, e.g.
+    /// `c_ketama_bounded`, bound the requests in flight of each server.
+    static std::unique_ptr<LoadBalancer> New(const std::string& name);
+
+    virtual void ResetServers(const std::vector<ServerNode>& servers) = 0;
+
+    /// Select a server for a RPC, -1 is returned if none is available.
+    virtual int SelectServer(const SelectIn& in, EndPoint* server) = 0;
+
+    /// The result of a RPC sent to a selected server.
+    virtual void Feedback(const EndPoint& server, bool success,
+                          int64_t latency_us) {}
+
+protected:
+    static bool IsAvailable(const SelectIn& in, const EndPoint& server) {
+        return !in.available || in.available(server);
+    }
+};
+
+class RoundRobinLoadBalancer final : public LoadBalancer {
+public:
+    void ResetServers(const std::vector<ServerNode>& servers) override;
+    int SelectServer(const SelectIn& in, EndPoint* server) override;
+
+private:
+    std::shared_ptr<const std::vector<EndPoint>> servers_;
+    uint64_t next_{0};
+};
+
+class WeightedRandomLoadBalancer final : public LoadBalancer {
+public:
+    void ResetServers(const std::vector<ServerNode>& servers) override;
+    int SelectServer(const SelectIn& in, EndPoint* server) override;
+
+private:
+    struct Servers {
+        std::vector<EndPoint> addrs;
+        /// The prefix sums of the weights.
+        std::vector<uint64_t> weight_sums;
+    };
+
+    std::shared_ptr<const Servers> servers_;
+};
+
+/// Weight the servers by the inverse of their average latency multiplied by
+/// the requests in flight, so slower or more loaded servers get fewer
+/// requests, and a failure counts as twice the average latency.
+class LocalityAwareLoadBalancer final : public LoadBalancer {
+public:
+    void ResetServers(const std::vector<ServerNode>& servers) override;
+    int SelectServer(const SelectIn& in, EndPoint* server) override;
+    void Feedback(const EndPoint& server, bool success,
+                  int64_t latency_us) override;
+
+private:
+    struct Stats {
+        /// The moving average of the latency, 0 until the first feedback.
+        double avg_latency_us{0};
+        int64_t inflight{0};
+    };
+
+    struct Server {
+        EndPoint addr;
+        std::shared_ptr<Stats> stats;
+    };
+
+    std::shared_ptr<const std::vector<Server>> servers_;
+    /// The stats of the servers, kept across the resets.
+    std::map<EndPoint, std::shared_ptr<Stats>> stats_;
+    std::vector<double> weights_;
+};
+
+/// Map the request code onto a ring of the hashes of the servers, each
+/// server has many virtual nodes per weight to spread the load evenly. Only
+/// the codes mapped to a removed server move to other servers.
+///
+/// With bounded loads, a server of more requests in flight than
+/// `-chash_load_factor` times the average is skipped, the codes mapped to it
+/// spill over to the next servers on the ring until its load drops. Hot codes
+/// are then spread instead of overloading a single server.
+class ConsistentHashLoadBalancer final : public LoadBalancer {
+public:
+    enum HashType {
+        /// 100 virtual nodes per weight of the 64-bit MurmurHash2 of
+        /// "ip:port-i".
+        HASH_MURMUR,
+        /// 160 virtual nodes per weight, 4 from each MD5 digest of
+        /// "ip:port-i", matched with the lower 32 bits of the request code.
+        HASH_KETAMA,
+    };
+
+    ConsistentHashLoadBalancer(HashType type, bool bounded);
+
+    void ResetServers(const std::vector<ServerNode>& servers) override;
+    int SelectServer(const SelectIn& in, EndPoint* server) override;
+    void Feedback(const EndPoint& server, bool success,
+                  int64_t latency_us) override;
+
+private:
+    struct Server {
+        EndPoint addr;
+        std::shared_ptr<int64_t> inflight;
+    };
+
+    struct Ring {
+        std::vector<Server> servers;
+        /// The virtual nodes ordered by hash, pairs of the hash and the
+        /// index of the server.
+        std::vector<std::pair<uint64_t, size_t>> nodes;
+    };
+
+    const HashType type_;
+    const bool bounded_;
+    std::shared_ptr<const Ring> ring_;
+    /// The requests in flight of the servers, kept across the resets.
+    std::map<EndPoint, std::shared_ptr<int64_t>> inflight_;
+    /// The sum of the requests in flight of the current servers.
+    int64_t total_inflight_{0};
+};
+
+/// The 64-bit MurmurHash2 of `data`.
+uint64_t MurmurHash64(const void* data, size_t len, uint64_t seed);
+
+/// The MD5 digest of `data`.
+void MD5(const void* data, size_t len, uint8_t digest[16]);
+
+}  // namespace urpc
@@ -0,0 +1,85 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "method_status.h"
+
+#include <algorithm>
+
+#include <string>
+#include <vector>
+
+namespace urpc {
+
+MethodStatus::Stats MethodStatus::Sample() {
+    Stats stats;
+    stats.full_name = full_name_;
+    stats.latency = latency_.Sample();
+    counters_.ForEach([&stats](const Counters& counters) {
+        stats.processing += counters.processing.load(std::memory_order_relaxed);
+        stats.errors += counters.errors.load(std::memory_order_relaxed);
+        stats.rejected += counters.rejected.load(std::memory_order_relaxed);
+    });
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (auto limiter : limiters_)
+        stats.max_concurrency += limiter->max_concurrency();
+    return stats;
+}
+
+void MethodStatus::AddLimiter(const ConcurrencyLimiter* limiter) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    limiters_.push_back(limiter);
+}
+
+void MethodStatus::RemoveLimiter(const ConcurrencyLimiter* limiter) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    limiters_.erase(std::remove(limiters_.begin(), limiters_.end(), limiter),
+                    limiters_.end());
+}
+
+int64_t MethodStatus::processing() const {
+    int64_t processing = 0;
+    counters_.ForEach([&processing](const Counters& counters) {
+        processing += counters.processing.load(std::memory_order_relaxed);
+    });
+    return processing;
+}
+
+MethodStatusRegistry* MethodStatusRegistry::singleton() {
+    static MethodStatusRegistry registry;
+    return &registry;
+}
+
+MethodStatus* MethodStatusRegistry::GetOrCreate(const std::string& full_name) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto& status = methods_[full_name];
+    if (!status)
+        status.reset(new MethodStatus(full_name));
+    return status.get();
+}
+
+std::vector<MethodStatus::Stats> MethodStatusRegistry::SampleAll() {
+    std::vector<MethodStatus*> methods;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        for (auto&& [name, status] : methods_)
+            methods.push_back(status.get());
+    }
+
+    std::vector<MethodStatus::Stats> stats;
+    for (auto status : methods)
+        stats.push_back(status->Sample());
+    return stats;
+}
+
+}  // namespace urpc
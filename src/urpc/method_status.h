@@ -0,0 +1,122 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "urpc/concurrency_limiter.h"
+#include "urpc/latency_recorder.h"
+#include "utils/agent_combiner.h"
+
+namespace urpc {
+
+/// The runtime statistics of a method: latency, qps, errors and the number of
+/// requests in processing.
+class MethodStatus {
+public:
+    struct Stats {
+        std::string full_name;
+        LatencyRecorder::Stats latency;
+        uint64_t errors{0};
+        int64_t processing{0};
+        /// The requests rejected by the concurrency limits.
+        uint64_t rejected{0};
+        /// The limit of the requests in processing summed over the threads
+        /// limiting the method, 0 if unlimited.
+        int64_t max_concurrency{0};
+    };
+
+    explicit MethodStatus(std::string full_name)
+        : full_name_(std::move(full_name)) {}
+    MethodStatus(const MethodStatus&) = delete;
+    MethodStatus& operator=(const MethodStatus&) = delete;
+
+    const std::string& full_name() const { return full_name_; }
+
+    /// Report the limit of `limiter` in the stats. The limiters are owned by
+    /// the threads serving the method, each removes its own before it's
+    /// destroyed.
+    void AddLimiter(const ConcurrencyLimiter* limiter);
+    void RemoveLimiter(const ConcurrencyLimiter* limiter);
+
+    /// Invoked before an admitted request is dispatched to the service.
+    void OnRequested() {
+        utils::IncreaseRelaxed(&counters_.agent()->processing, 1);
+    }
+
+    /// Invoked once the response of a request is sent, `OnRequested()`
+    /// should succeed before.
+    void OnResponded(bool success, uint64_t latency_us) {
+        Counters* counters = counters_.agent();
+        utils::IncreaseRelaxed(&counters->processing, -1);
+        if (success) {
+            latency_.Record(latency_us);
+        } else {
+            utils::IncreaseRelaxed(&counters->errors, 1);
+        }
+    }
+
+    /// Invoked once a request is rejected.
+    void OnRejected() {
+        utils::IncreaseRelaxed(&counters_.agent()->rejected, 1);
+    }
+
+    /// Merge the statistics of all threads.
+    Stats Sample();
+
+    /// The number of requests in processing.
+    int64_t processing() const;
+
+private:
+    struct Counters {
+        std::atomic<int64_t> processing{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> rejected{0};
+    };
+
+    const std::string full_name_;
+    std::mutex mutex_;
+    std::vector<const ConcurrencyLimiter*> limiters_;
+    LatencyRecorder latency_;
+    utils::AgentCombiner<Counters> counters_;
+};
+
+/// The process-wide registry of method status, shared by the servers of all
+/// threads.
+class MethodStatusRegistry final {
+public:
+    static MethodStatusRegistry* singleton();
+
+    /// Return the status of the method, create it if not exists. The returned
+    /// pointer is valid until the process exits.
+    MethodStatus* GetOrCreate(const std::string& full_name);
+
+    /// Sample all registered methods, ordered by the full name.
+    std::vector<MethodStatus::Stats> SampleAll();
+
+private:
+    MethodStatusRegistry() = default;
+
+    std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<MethodStatus>> methods_;
+};
+
+}  // namespace urpc
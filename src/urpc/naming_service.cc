@@ -0,0 +1,183 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "naming_service.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "resolver.h"
+
+DEFINE_int32(naming_file_check_interval_ms, 1000,
+             "The interval to check the modification of file:// servers");
+
+namespace urpc {
+
+namespace {
+
+/// Resolve `hostname:port` by the resolver.
+int ResolveEndPoint(const std::string& addr, EndPoint* point, bool wait) {
+    auto pos = addr.rfind(':');
+    if (pos == std::string::npos || pos == 0 || pos + 1 == addr.size() ||
+        addr[0] == '[') {
+        return -1;
+    }
+    char* end = nullptr;
+    long port = strtol(addr.c_str() + pos + 1, &end, 10);
+    if (*end != '\0' || port < 0 || port > 65535)
+        return -1;
+    point->port = port;
+
+    const std::string hostname = addr.substr(0, pos);
+    auto resolver = Resolver::singleton();
+    if (wait)
+        return resolver->Resolve(hostname, &point->ip);
+    return resolver->Lookup(hostname, &point->ip) == 0 ? 0 : 1;
+}
+
+bool IsHostname(const std::string& text) {
+    std::istringstream in(text);
+    std::string addr;
+    EndPoint point;
+    return in >> addr && str2endpoint(addr.c_str(), &point) != 0;
+}
+
+}  // namespace
+
+int ParseServerNode(const std::string& text, ServerNode* node, bool wait) {
+    std::istringstream in(text);
+    std::string addr;
+    if (!(in >> addr))
+        return -1;
+    int rc = 0;
+    if (str2endpoint(addr.c_str(), &node->addr) != 0) {
+        rc = ResolveEndPoint(addr, &node->addr, wait);
+        if (rc < 0)
+            return -1;
+    }
+
+    node->weight = 1;
+    std::string weight;
+    if (in >> weight) {
+        char* end = nullptr;
+        errno = 0;
+        long value = strtol(weight.c_str(), &end, 10);
+        if (*end != '\0' || errno == ERANGE || value <= 0 ||
+            value > kMaxServerWeight)
+            return -1;
+        node->weight = value;
+    }
+
+    std::string extra;
+    if (in >> extra)
+        return -1;
+    return rc;
+}
+
+int NamingService::ParseServers(std::istream& in, char delimiter,
+                                std::vector<ServerNode>* servers) {
+    // Taken before the lookups, so an address resolved meanwhile isn't missed.
+    resolver_version_ = Resolver::singleton()->version();
+    has_hostnames_ = false;
+    servers->clear();
+    std::string line;
+    while (std::getline(in, line, delimiter)) {
+        auto begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#')
+            continue;
+
+        ServerNode node;
+        const std::string text = line.substr(begin);
+        const int rc = ParseServerNode(text, &node);
+        if (rc < 0) {
+            LOG(ERROR) << "Invalid server " << line;
+            return -1;
+        }
+        if (IsHostname(text))
+            has_hostnames_ = true;
+        if (rc == 0)
+            servers->push_back(node);
+    }
+    return 0;
+}
+
+bool NamingService::HostsChanged() const {
+    return has_hostnames_ &&
+           Resolver::singleton()->version() != resolver_version_;
+}
+
+std::unique_ptr<NamingService> NamingService::New(const std::string& url) {
+    auto pos = url.find("://");
+    if (pos == std::string::npos)
+        return nullptr;
+
+    const std::string scheme = url.substr(0, pos);
+    std::string rest = url.substr(pos + 3);
+    if (scheme == "list")
+        return std::make_unique<ListNamingService>(std::move(rest));
+    if (scheme == "file")
+        return std::make_unique<FileNamingService>(std::move(rest));
+    LOG(ERROR) << "Unsupported naming service " << scheme;
+    return nullptr;
+}
+
+int ListNamingService::GetServers(std::vector<ServerNode>* servers) {
+    std::istringstream in(list_);
+    return ParseServers(in, ',', servers);
+}
+
+int FileNamingService::GetServers(std::vector<ServerNode>* servers) {
+    struct stat st;
+    if (stat(path_.c_str(), &st) != 0) {
+        PLOG(ERROR) << "stat " << path_;
+        return -1;
+    }
+    mtime_ = st.st_mtim;
+
+    std::ifstream in(path_);
+    if (!in) {
+        LOG(ERROR) << "Failed to open " << path_;
+        return -1;
+    }
+    return ParseServers(in, '\n', servers);
+}
+
+bool FileNamingService::Changed() {
+    if (HostsChanged())
+        return true;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_check_)
+        return false;
+    next_check_ =
+        now + std::chrono::milliseconds(FLAGS_naming_file_check_interval_ms);
+
+    struct stat st;
+    if (stat(path_.c_str(), &st) != 0)
+        return false;
+    return st.st_mtim.tv_sec != mtime_.tv_sec ||
+           st.st_mtim.tv_nsec != mtime_.tv_nsec;
+}
+
+}  // namespace urpc
@@ -0,0 +1,111 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include <chrono>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <urpc/endpoint.h>
+
+namespace urpc {
+
+/// The max weight of a server, consistent hashing builds up to 160 virtual
+/// nodes per weight.
+constexpr int kMaxServerWeight = 10000;
+
+struct ServerNode {
+    EndPoint addr;
+    /// The relative capacity used by weighted load balancers, in
+    /// [1, kMaxServerWeight].
+    int weight{1};
+};
+
+/// Parse `ip:port`, `[ipv6]:port`, `unix:/path` or `hostname:port` with an
+/// optional weight separated by spaces, such as "127.0.0.1:8000 10". -1 is
+/// returned if it's invalid. The hostnames are looked up in the cache of the
+/// resolver, 1 is returned if it's being resolved in the background unless
+/// `wait` for it.
+int ParseServerNode(const std::string& text, ServerNode* node,
+                    bool wait = false);
+
+/// Resolve the servers of a channel by the url:
+///
+///   list://127.0.0.1:8000,127.0.0.1:8001   the servers separated by ','
+///   file:///etc/servers                    a server per line, reloaded once
+///                                          the file is modified
+///
+/// Lines starting with '#' and blank lines are ignored.
+class NamingService {
+public:
+    virtual ~NamingService() = default;
+
+    /// Create the naming service of `url`, [`nullptr`] if the scheme is
+    /// unsupported.
+    static std::unique_ptr<NamingService> New(const std::string& url);
+
+    /// Fetch the servers, -1 is returned on failure. The servers of
+    /// hostnames not resolved yet are skipped until Changed().
+    virtual int GetServers(std::vector<ServerNode>* servers) = 0;
+
+    /// Whether the servers might have changed since the last GetServers(),
+    /// it's cheap enough to be invoked per RPC.
+    virtual bool Changed() { return HostsChanged(); }
+
+protected:
+    /// Parse the servers separated by `delimiter`.
+    int ParseServers(std::istream& in, char delimiter,
+                     std::vector<ServerNode>* servers);
+
+    /// Whether the hostnames of the servers are resolved again since the
+    /// last ParseServers().
+    bool HostsChanged() const;
+
+private:
+    bool has_hostnames_{false};
+    uint64_t resolver_version_{0};
+};
+
+class ListNamingService final : public NamingService {
+public:
+    explicit ListNamingService(std::string list) : list_(std::move(list)) {}
+
+    int GetServers(std::vector<ServerNode>* servers) override;
+
+private:
+    const std::string list_;
+};
+
+class FileNamingService final : public NamingService {
+public:
+    explicit FileNamingService(std::string path) : path_(std::move(path)) {}
+
+    int GetServers(std::vector<ServerNode>* servers) override;
+
+    /// The modification time is checked at most once per
+    /// --naming_file_check_interval_ms, or the hostnames are resolved again.
+    bool Changed() override;
+
+private:
+    const std::string path_;
+    struct timespec mtime_ {};
+    std::chrono::steady_clock::time_point next_check_;
+};
+
+}  // namespace urpc
@@ -14,10 +14,87 @@
 
 #include "poller.h"
 
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
 namespace urpc {
 
 extern Poller* poller();
 
+static uint64_t NextPollerId() {
+    static std::atomic<uint64_t> next_id{1};
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
 Poller* Poller::singleton() { return poller(); }
 
+Poller::Poller()
+    : id_(NextPollerId()),
+      tid_(static_cast<int>(syscall(SYS_gettid))),
+      created_(std::chrono::steady_clock::now()) {
+    StatsRegistry::singleton()->Register(this);
+}
+
+Poller::~Poller() { StatsRegistry::singleton()->Unregister(this); }
+
+void Poller::GetStats(PollerStats* stats) const {
+    stats->id = id_;
+    stats->tid = tid_;
+    stats->handles = counters_.handles.load(std::memory_order_relaxed);
+    stats->wakeups = counters_.wakeups.load(std::memory_order_relaxed);
+    stats->events = counters_.events.load(std::memory_order_relaxed);
+    stats->max_events_per_wakeup =
+        counters_.max_events_per_wakeup.load(std::memory_order_relaxed);
+    stats->busy_us = counters_.busy_us.load(std::memory_order_relaxed);
+    stats->uptime_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - created_)
+                           .count();
+}
+
+uint64_t Poller::AddTimer(int64_t delay_ms, std::function<void()> callback) {
+    const uint64_t id = next_timer_id_++;
+    const TimePoint deadline = std::chrono::steady_clock::now() +
+                               std::chrono::milliseconds(delay_ms);
+    timers_.emplace(std::pair{deadline, id}, std::move(callback));
+    timer_deadlines_.emplace(id, deadline);
+    return id;
+}
+
+bool Poller::RemoveTimer(uint64_t id) {
+    auto it = timer_deadlines_.find(id);
+    if (it == timer_deadlines_.end())
+        return false;
+    timers_.erase(std::pair{it->second, id});
+    timer_deadlines_.erase(it);
+    return true;
+}
+
+int Poller::PollTimeoutMs(int timeout_ms) const {
+    if (timers_.empty())
+        return timeout_ms;
+
+    // Rounded up, so the first timer is expired once the poller wakes up.
+    auto delay = timers_.begin()->first.first - std::chrono::steady_clock::now();
+    int64_t delay_ms = std::max<int64_t>(
+        std::chrono::ceil<std::chrono::milliseconds>(delay).count(), 0);
+    if (timeout_ms >= 0)
+        delay_ms = std::min<int64_t>(delay_ms, timeout_ms);
+    return static_cast<int>(delay_ms);
+}
+
+void Poller::RunTimers() {
+    const TimePoint now = std::chrono::steady_clock::now();
+    while (!timers_.empty() && timers_.begin()->first.first <= now) {
+        auto it = timers_.begin();
+        std::function<void()> callback = std::move(it->second);
+        timer_deadlines_.erase(it->first.second);
+        timers_.erase(it);
+        // The callback might add or remove timers.
+        callback();
+    }
+}
+
 }  // namespace urpc
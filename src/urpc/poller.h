@@ -14,7 +14,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
 #include "base.h"
+#include "stats.h"
 
 namespace urpc {
 
@@ -22,12 +30,58 @@ class Poller {
 public:
     static Poller* singleton();
 
-    virtual ~Poller() = default;
+    Poller();
+    virtual ~Poller();
+
+    /// The process-wide unique id of the poller.
+    uint64_t id() const noexcept { return id_; }
+
+    /// Take a snapshot of the counters, it could be invoked from any thread.
+    void GetStats(PollerStats* stats) const;
 
-    virtual int PollOnce() = 0;
+    /// Wait at most `timeout_ms` milliseconds for events and dispatch them,
+    /// -1 means wait indefinitely. Returns the number of dispatched events.
+    virtual int PollOnce(int timeout_ms) = 0;
     virtual int AddPollIn(IOHandle*) = 0;
     virtual int AddPollOut(IOHandle*) = 0;
     virtual int RemoveConsumer(IOHandle*) = 0;
+
+    /// Run `callback` in the poller thread once `delay_ms` milliseconds
+    /// elapse. The id returned could remove the timer before it runs.
+    uint64_t AddTimer(int64_t delay_ms, std::function<void()> callback);
+
+    /// Remove a timer not run yet, false is returned if there is no such one.
+    bool RemoveTimer(uint64_t id);
+
+protected:
+    /// The time to wait for events in PollOnce(), bounded by the first timer.
+    int PollTimeoutMs(int timeout_ms) const;
+
+    /// Run the timers expired, invoked by PollOnce() after the events.
+    void RunTimers();
+
+    /// Updated by the implementations, only the owner thread writes them.
+    struct Counters {
+        std::atomic<uint64_t> handles{0};
+        std::atomic<uint64_t> wakeups{0};
+        std::atomic<uint64_t> events{0};
+        std::atomic<uint64_t> max_events_per_wakeup{0};
+        std::atomic<uint64_t> busy_us{0};
+    };
+
+    Counters counters_;
+
+private:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    /// The timers ordered by deadline and id.
+    std::map<std::pair<TimePoint, uint64_t>, std::function<void()>> timers_;
+    std::unordered_map<uint64_t, TimePoint> timer_deadlines_;
+    uint64_t next_timer_id_{1};
+
+    const uint64_t id_;
+    const int tid_;
+    const std::chrono::steady_clock::time_point created_;
 };
 
 }  // namespace urpc
@@ -14,26 +14,54 @@
 
 #pragma once
 
+#include <memory>
+
+#include "urpc/base.h"
 #include "urpc/iobuf.h"
 #include "urpc/server_call.h"
 
 namespace urpc {
 
 class ClientTransport;
+class ServerTransport;
 
 namespace protocol {
 
+/// The per-connection parsing state of a protocol, such as a partially parsed
+/// header. It is owned by the server transport and dropped once another
+/// protocol is probed on the connection.
+class ParseContext {
+public:
+    virtual ~ParseContext() = default;
+
+    /// The server is stopping, ask the peer to send no more requests over the
+    /// connection if the protocol could.
+    virtual void OnDraining() {}
+
+    /// The connection is reset, complete the calls waiting for it if any.
+    virtual void OnReset() {}
+};
+
 class BaseProtocol {
 public:
     virtual ~BaseProtocol() = default;
 
     /// A constant bytes which always appears in the header of network message
-    /// packets.
+    /// packets. It could be any length no more than
+    /// `ProtocolManager::kMaxMagicSize`.
     virtual const char* Header() const = 0;
 
+    /// Confirm that `buf`, whose leading bytes match a registered magic of
+    /// this protocol, belongs to this protocol. ERR_TOO_SMALL is returned if
+    /// more bytes are required to decide, ERR_MISMATCH if it doesn't belong.
+    /// It is invoked on the first read of connections, so it shouldn't
+    /// allocate.
+    virtual int Probe(const IOBuf& buf) const { return ERR_OK; }
+
     /// Parse the protocol request. If the payload isn't enough, ERR_TOO_SMALL
     /// is returned. If the header is mismatched, ERR_MISMATCH is returned.
-    virtual int ParseRequest(IOBuf* buf, ServerCall** server_call) = 0;
+    virtual int ParseRequest(IOBuf* buf, ServerTransport* transport,
+                             ServerCall** server_call) = 0;
 
     /// Parse the protocol response. If the payload isn't enough, ERR_TOO_SMALL
     /// is returned. If the header is mismatched, ERR_MISMATCH is returned.
@@ -0,0 +1,692 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "call.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "urpc/base.h"
+#include "urpc/builtin/builtin_service.h"
+#include "urpc/coding.h"
+#include "urpc/transport.h"
+
+using namespace google::protobuf;
+
+namespace urpc {
+namespace protocol {
+namespace h2 {
+
+namespace {
+
+/// The status codes of gRPC.
+enum GRPCStatus {
+    GRPC_OK = 0,
+    GRPC_UNKNOWN = 2,
+    GRPC_RESOURCE_EXHAUSTED = 8,
+    GRPC_UNIMPLEMENTED = 12,
+    GRPC_INTERNAL = 13,
+};
+
+/// The length prefix of gRPC messages: compressed flag and length.
+constexpr size_t kGRPCPrefixSize = 5;
+
+void AppendSetting(uint16_t id, uint32_t value, IOBuf* out) {
+    uint8_t data[6];
+    data[0] = static_cast<uint8_t>(id >> 8);
+    data[1] = static_cast<uint8_t>(id);
+    EncodeBigEndian32(data + 2, value);
+    out->append(data, sizeof(data));
+}
+
+void AppendHeadersFrame(const std::vector<Header>& headers, uint8_t flags,
+                        uint32_t stream_id, IOBuf* out) {
+    IOBuf block;
+    HPackEncoder::Encode(headers, &block);
+    AppendFrameHeader(block.size(), FRAME_HEADERS, flags | FLAG_END_HEADERS,
+                      stream_id, out);
+    out->append(block);
+}
+
+uint32_t ReadBigEndian32(const IOBuf& payload, size_t pos = 0) {
+    uint8_t data[4];
+    payload.copy_to(data, sizeof(data), pos);
+    return DecodeBigEndian32(data);
+}
+
+/// Percent-encode the grpc-message as the gRPC spec requires.
+std::string PercentEncode(const std::string& message) {
+    static const char kHex[] = "0123456789ABCDEF";
+    std::string encoded;
+    for (unsigned char c : message) {
+        if (c < 0x20 || c > 0x7e || c == '%') {
+            encoded.push_back('%');
+            encoded.push_back(kHex[c >> 4]);
+            encoded.push_back(kHex[c & 0xf]);
+        } else {
+            encoded.push_back(c);
+        }
+    }
+    return encoded;
+}
+
+}  // namespace
+
+int H2Context::Parse(IOBuf* buf, ServerCall** server_call) {
+    int code = ParseFrames(buf, server_call);
+    FlushControl();
+    return code;
+}
+
+int H2Context::ParseFrames(IOBuf* buf, ServerCall** server_call) {
+    if (!preface_received_) {
+        char preface[kConnectionPrefaceSize];
+        const size_t size = buf->copy_to(preface, sizeof(preface));
+        if (memcmp(preface, kConnectionPreface, size) != 0)
+            return ERR_MISMATCH;
+        if (size < kConnectionPrefaceSize)
+            return ERR_TOO_SMALL;
+        buf->pop_front(kConnectionPrefaceSize);
+        preface_received_ = true;
+
+        // The server connection preface, followed by the enlarged window of
+        // the connection.
+        IOBuf settings;
+        AppendSetting(SETTINGS_MAX_CONCURRENT_STREAMS, kMaxConcurrentStreams,
+                      &settings);
+        AppendSetting(SETTINGS_INITIAL_WINDOW_SIZE, kLocalWindowSize,
+                      &settings);
+        AppendFrameHeader(settings.size(), FRAME_SETTINGS, 0, 0,
+                          &control_buf_);
+        control_buf_.append(settings);
+        AppendWindowUpdate(0, kLocalWindowSize - kDefaultWindowSize);
+        recv_window_ = kLocalWindowSize;
+    }
+
+    while (true) {
+        FrameHeader header;
+        if (!PeekFrameHeader(*buf, &header))
+            return ERR_TOO_SMALL;
+        if (header.length > kDefaultMaxFrameSize)
+            return ConnectionError(H2_FRAME_SIZE_ERROR, "frame too large");
+        if (buf->size() < kFrameHeaderSize + header.length)
+            return ERR_TOO_SMALL;
+
+        buf->pop_front(kFrameHeaderSize);
+        IOBuf payload;
+        buf->cutn(&payload, header.length);
+        int code = OnFrame(header, &payload, server_call);
+        if (code != ERR_OK || *server_call)
+            return code;
+    }
+}
+
+int H2Context::OnFrame(const FrameHeader& header, IOBuf* payload,
+                       ServerCall** server_call) {
+    if (continuation_stream_ && header.type != FRAME_CONTINUATION)
+        return ConnectionError(H2_PROTOCOL_ERROR, "expect CONTINUATION");
+
+    switch (header.type) {
+        case FRAME_DATA:
+            return OnData(header, payload, server_call);
+        case FRAME_HEADERS:
+            return OnHeaders(header, payload, server_call);
+        case FRAME_CONTINUATION:
+            return OnContinuation(header, payload, server_call);
+        case FRAME_SETTINGS:
+            return OnSettings(header, payload);
+        case FRAME_PING:
+            return OnPing(header, payload);
+        case FRAME_WINDOW_UPDATE:
+            return OnWindowUpdate(header, payload);
+        case FRAME_RST_STREAM:
+            return OnRstStream(header, payload);
+        case FRAME_PRIORITY:
+            if (header.length != 5)
+                return ConnectionError(H2_FRAME_SIZE_ERROR, "PRIORITY size");
+            return ERR_OK;
+        case FRAME_GOAWAY:
+            LOG(INFO) << "H2 peer sent GOAWAY";
+            return ERR_OK;
+        case FRAME_PUSH_PROMISE:
+            return ConnectionError(H2_PROTOCOL_ERROR, "PUSH_PROMISE");
+        default:
+            // Unknown frames are ignored, RFC 7540 4.1.
+            return ERR_OK;
+    }
+}
+
+int H2Context::RemovePadding(const FrameHeader& header, IOBuf* payload) {
+    if (!(header.flags & FLAG_PADDED))
+        return ERR_OK;
+    uint8_t pad_length = 0;
+    if (payload->cutn(&pad_length, 1) < 1 || pad_length > payload->size())
+        return ConnectionError(H2_PROTOCOL_ERROR, "invalid padding");
+    payload->pop_back(pad_length);
+    return ERR_OK;
+}
+
+int H2Context::OnData(const FrameHeader& header, IOBuf* payload,
+                      ServerCall** server_call) {
+    if (header.stream_id == 0)
+        return ConnectionError(H2_PROTOCOL_ERROR, "DATA on stream 0");
+
+    // The whole frame, including the padding, is flow controlled.
+    recv_window_ -= header.length;
+    unacked_bytes_ += header.length;
+    if (recv_window_ < 0)
+        return ConnectionError(H2_FLOW_CONTROL_ERROR, "connection window");
+    if (unacked_bytes_ >= kLocalWindowSize / 2) {
+        AppendWindowUpdate(0, unacked_bytes_);
+        recv_window_ += unacked_bytes_;
+        unacked_bytes_ = 0;
+    }
+
+    int code = RemovePadding(header, payload);
+    if (code != ERR_OK)
+        return code;
+
+    auto it = streams_.find(header.stream_id);
+    if (it == streams_.end() || it->second.remote_closed) {
+        if (header.stream_id > last_stream_id_)
+            return ConnectionError(H2_PROTOCOL_ERROR, "DATA on idle stream");
+        ResetStream(header.stream_id, H2_STREAM_CLOSED);
+        return ERR_OK;
+    }
+
+    Stream* stream = &it->second;
+    stream->recv_window -= header.length;
+    if (stream->recv_window < 0) {
+        ResetStream(header.stream_id, H2_FLOW_CONTROL_ERROR);
+        return ERR_OK;
+    }
+    stream->data.append(std::move(*payload));
+    if (header.flags & FLAG_END_STREAM) {
+        OnStreamComplete(header.stream_id, stream, server_call);
+        return ERR_OK;
+    }
+
+    stream->unacked_bytes += header.length;
+    if (stream->unacked_bytes >= kLocalWindowSize / 2) {
+        AppendWindowUpdate(header.stream_id, stream->unacked_bytes);
+        stream->recv_window += stream->unacked_bytes;
+        stream->unacked_bytes = 0;
+    }
+    return ERR_OK;
+}
+
+int H2Context::OnHeaders(const FrameHeader& header, IOBuf* payload,
+                         ServerCall** server_call) {
+    const uint32_t stream_id = header.stream_id;
+    if (stream_id == 0)
+        return ConnectionError(H2_PROTOCOL_ERROR, "HEADERS on stream 0");
+
+    int code = RemovePadding(header, payload);
+    if (code != ERR_OK)
+        return code;
+    if (header.flags & FLAG_PRIORITY) {
+        if (payload->pop_front(5) < 5)
+            return ConnectionError(H2_PROTOCOL_ERROR, "HEADERS priority");
+    }
+
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) {
+        if (stream_id <= last_stream_id_ || stream_id % 2 == 0)
+            return ConnectionError(H2_PROTOCOL_ERROR, "invalid stream id");
+        last_stream_id_ = stream_id;
+        streams_[stream_id].send_window = peer_initial_window_;
+    } else if (it->second.remote_closed) {
+        return ConnectionError(H2_STREAM_CLOSED, "HEADERS on closed stream");
+    } else if (!(header.flags & FLAG_END_STREAM)) {
+        // Trailers must end the stream.
+        return ConnectionError(H2_PROTOCOL_ERROR, "trailers without end");
+    }
+
+    continuation_stream_ = stream_id;
+    continuation_end_stream_ = header.flags & FLAG_END_STREAM;
+    header_block_ = std::move(*payload);
+    if (!(header.flags & FLAG_END_HEADERS))
+        return ERR_OK;
+    return OnEndHeaders(server_call);
+}
+
+int H2Context::OnContinuation(const FrameHeader& header, IOBuf* payload,
+                              ServerCall** server_call) {
+    if (!continuation_stream_ || header.stream_id != continuation_stream_)
+        return ConnectionError(H2_PROTOCOL_ERROR, "unexpected CONTINUATION");
+
+    header_block_.append(std::move(*payload));
+    if (header_block_.size() > kMaxHeaderBlockSize)
+        return ConnectionError(H2_PROTOCOL_ERROR, "header block too large");
+    if (!(header.flags & FLAG_END_HEADERS))
+        return ERR_OK;
+    return OnEndHeaders(server_call);
+}
+
+int H2Context::OnEndHeaders(ServerCall** server_call) {
+    const uint32_t stream_id = continuation_stream_;
+    continuation_stream_ = 0;
+
+    // The block is always decoded to keep the dynamic table in sync, even
+    // if the stream is refused.
+    std::vector<Header> headers;
+    if (decoder_.Decode(header_block_, &headers) != ERR_OK)
+        return ConnectionError(H2_COMPRESSION_ERROR, "HPACK decode");
+    header_block_.clear();
+
+    Stream* stream = &streams_[stream_id];
+    if (stream->headers.empty()) {
+        stream->headers = std::move(headers);
+        if (streams_.size() > kMaxConcurrentStreams) {
+            ResetStream(stream_id, H2_REFUSED_STREAM);
+            return ERR_OK;
+        }
+    }
+    if (continuation_end_stream_)
+        OnStreamComplete(stream_id, stream, server_call);
+    return ERR_OK;
+}
+
+void H2Context::OnStreamComplete(uint32_t stream_id, Stream* stream,
+                                 ServerCall** server_call) {
+    stream->remote_closed = true;
+    *server_call =
+        new H2ServerCall(shared_from_this(), stream_id,
+                         std::move(stream->headers), std::move(stream->data));
+}
+
+int H2Context::OnSettings(const FrameHeader& header, IOBuf* payload) {
+    if (header.stream_id != 0)
+        return ConnectionError(H2_PROTOCOL_ERROR, "SETTINGS on stream");
+    if (header.flags & FLAG_ACK) {
+        if (header.length != 0)
+            return ConnectionError(H2_FRAME_SIZE_ERROR, "SETTINGS ack size");
+        return ERR_OK;
+    }
+    if (header.length % 6 != 0)
+        return ConnectionError(H2_FRAME_SIZE_ERROR, "SETTINGS size");
+
+    while (!payload->empty()) {
+        uint8_t data[6];
+        payload->cutn(data, sizeof(data));
+        const uint16_t id = (static_cast<uint16_t>(data[0]) << 8) | data[1];
+        const uint32_t value = DecodeBigEndian32(data + 2);
+        switch (id) {
+            case SETTINGS_ENABLE_PUSH:
+                if (value > 1)
+                    return ConnectionError(H2_PROTOCOL_ERROR, "ENABLE_PUSH");
+                break;
+            case SETTINGS_INITIAL_WINDOW_SIZE: {
+                if (value > kMaxWindowSize)
+                    return ConnectionError(H2_FLOW_CONTROL_ERROR,
+                                           "INITIAL_WINDOW_SIZE");
+                const int64_t delta = value - peer_initial_window_;
+                for (auto&& [id, stream] : streams_)
+                    stream.send_window += delta;
+                peer_initial_window_ = value;
+                break;
+            }
+            case SETTINGS_MAX_FRAME_SIZE:
+                if (value < kDefaultMaxFrameSize || value > 0xffffff)
+                    return ConnectionError(H2_PROTOCOL_ERROR,
+                                           "MAX_FRAME_SIZE");
+                peer_max_frame_size_ = value;
+                break;
+            default:
+                // The encoder never indexes, so HEADER_TABLE_SIZE doesn't
+                // matter, and the others are advisory.
+                break;
+        }
+    }
+
+    AppendFrameHeader(0, FRAME_SETTINGS, FLAG_ACK, 0, &control_buf_);
+    FlushBlockedStreams();
+    return ERR_OK;
+}
+
+int H2Context::OnPing(const FrameHeader& header, IOBuf* payload) {
+    if (header.stream_id != 0)
+        return ConnectionError(H2_PROTOCOL_ERROR, "PING on stream");
+    if (header.length != 8)
+        return ConnectionError(H2_FRAME_SIZE_ERROR, "PING size");
+    if (!(header.flags & FLAG_ACK)) {
+        AppendFrameHeader(8, FRAME_PING, FLAG_ACK, 0, &control_buf_);
+        control_buf_.append(std::move(*payload));
+    }
+    return ERR_OK;
+}
+
+int H2Context::OnWindowUpdate(const FrameHeader& header, IOBuf* payload) {
+    if (header.length != 4)
+        return ConnectionError(H2_FRAME_SIZE_ERROR, "WINDOW_UPDATE size");
+    const uint32_t increment = ReadBigEndian32(*payload) & 0x7fffffff;
+
+    if (header.stream_id == 0) {
+        if (increment == 0)
+            return ConnectionError(H2_PROTOCOL_ERROR, "zero increment");
+        send_window_ += increment;
+        if (send_window_ > kMaxWindowSize)
+            return ConnectionError(H2_FLOW_CONTROL_ERROR, "window overflow");
+    } else {
+        auto it = streams_.find(header.stream_id);
+        if (it == streams_.end())
+            return ERR_OK;
+        it->second.send_window += increment;
+        if (increment == 0 || it->second.send_window > kMaxWindowSize) {
+            ResetStream(header.stream_id, increment ? H2_FLOW_CONTROL_ERROR
+                                                    : H2_PROTOCOL_ERROR);
+            return ERR_OK;
+        }
+    }
+    FlushBlockedStreams();
+    return ERR_OK;
+}
+
+int H2Context::OnRstStream(const FrameHeader& header, IOBuf* payload) {
+    if (header.stream_id == 0)
+        return ConnectionError(H2_PROTOCOL_ERROR, "RST_STREAM on stream 0");
+    if (header.length != 4)
+        return ConnectionError(H2_FRAME_SIZE_ERROR, "RST_STREAM size");
+
+    auto it = streams_.find(header.stream_id);
+    if (it == streams_.end())
+        return ERR_OK;
+    // A blocked response is dropped, a response in processing finds the
+    // stream missing once it is ready.
+    H2ServerCall* call = it->second.call;
+    streams_.erase(it);
+    if (call) {
+        call->SetFailed(H2_CANCEL, "stream reset by peer");
+        call->OnComplete();
+    }
+    return ERR_OK;
+}
+
+void H2Context::OnDraining() {
+    AppendGoAway(H2_NO_ERROR);
+    FlushControl();
+}
+
+void H2Context::OnReset() {
+    std::vector<H2ServerCall*> calls;
+    for (auto&& [id, stream] : streams_) {
+        if (stream.call)
+            calls.push_back(stream.call);
+    }
+    streams_.clear();
+    for (auto call : calls) {
+        call->SetFailed(H2_CANCEL, "connection closed");
+        call->OnComplete();
+    }
+}
+
+int H2Context::ConnectionError(H2Error error, const char* reason) {
+    LOG(INFO) << "H2 connection error " << error << ": " << reason;
+    AppendGoAway(error);
+    return ERR_NOT_SUPPORTED;
+}
+
+void H2Context::AppendGoAway(H2Error error) {
+    AppendFrameHeader(8, FRAME_GOAWAY, 0, 0, &control_buf_);
+    uint8_t data[8];
+    EncodeBigEndian32(data, last_stream_id_);
+    EncodeBigEndian32(data + 4, error);
+    control_buf_.append(data, sizeof(data));
+}
+
+void H2Context::ResetStream(uint32_t stream_id, H2Error error) {
+    AppendFrameHeader(4, FRAME_RST_STREAM, 0, stream_id, &control_buf_);
+    uint8_t data[4];
+    EncodeBigEndian32(data, error);
+    control_buf_.append(data, sizeof(data));
+
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end())
+        return;
+    H2ServerCall* call = it->second.call;
+    streams_.erase(it);
+    if (call) {
+        call->SetFailed(error, "stream reset");
+        call->OnComplete();
+    }
+}
+
+void H2Context::AppendWindowUpdate(uint32_t stream_id, uint32_t increment) {
+    AppendFrameHeader(4, FRAME_WINDOW_UPDATE, 0, stream_id, &control_buf_);
+    uint8_t data[4];
+    EncodeBigEndian32(data, increment);
+    control_buf_.append(data, sizeof(data));
+}
+
+void H2Context::Respond(H2ServerCall* call, uint32_t stream_id,
+                        const std::vector<Header>& headers, IOBuf data,
+                        const std::vector<Header>& trailers) {
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end() || transport_->fd() < 0) {
+        // The stream is reset by the peer, or the connection is closed.
+        call->SetFailed(H2_CANCEL, "stream closed");
+        call->OnComplete();
+        return;
+    }
+
+    Stream* stream = &it->second;
+    const bool end_with_headers = data.empty() && trailers.empty();
+    AppendHeadersFrame(headers, end_with_headers ? FLAG_END_STREAM : 0,
+                       stream_id, &stream->pending_head);
+    if (!trailers.empty()) {
+        AppendHeadersFrame(trailers, FLAG_END_STREAM, stream_id,
+                           &stream->pending_tail);
+    } else if (!end_with_headers) {
+        AppendFrameHeader(0, FRAME_DATA, FLAG_END_STREAM, stream_id,
+                          &stream->pending_tail);
+    }
+    stream->pending_data = std::move(data);
+    stream->call = call;
+    FlushStream(stream_id, stream);
+}
+
+void H2Context::FlushStream(uint32_t stream_id, Stream* stream) {
+    IOBuf out = std::move(stream->pending_head);
+    stream->pending_head.clear();
+    while (!stream->pending_data.empty()) {
+        const int64_t window = std::min(send_window_, stream->send_window);
+        if (window <= 0)
+            break;
+        const size_t size =
+            std::min<size_t>({stream->pending_data.size(),
+                              peer_max_frame_size_,
+                              static_cast<size_t>(window)});
+        AppendFrameHeader(size, FRAME_DATA, 0, stream_id, &out);
+        stream->pending_data.cutn(&out, size);
+        send_window_ -= size;
+        stream->send_window -= size;
+    }
+
+    // The frames are queued behind the pending control frames.
+    if (!stream->pending_data.empty()) {
+        control_buf_.append(std::move(out));
+        FlushControl();
+        return;
+    }
+
+    out.append(std::move(stream->pending_tail));
+    H2ServerCall* call = stream->call;
+    streams_.erase(stream_id);
+    FlushControl();
+    transport_->StartWrite(call, std::move(out));
+}
+
+void H2Context::FlushBlockedStreams() {
+    if (send_window_ <= 0)
+        return;
+    std::vector<uint32_t> blocked;
+    for (auto&& [id, stream] : streams_) {
+        if (stream.call && stream.send_window > 0)
+            blocked.push_back(id);
+    }
+    std::sort(blocked.begin(), blocked.end());
+    for (uint32_t id : blocked) {
+        auto it = streams_.find(id);
+        if (it != streams_.end())
+            FlushStream(id, &it->second);
+    }
+}
+
+void H2Context::FlushControl() {
+    if (control_buf_.empty() || transport_->fd() < 0)
+        return;
+    transport_->StartWrite(&frame_writer_, std::move(control_buf_));
+    control_buf_.clear();
+}
+
+int H2ServerCall::Serve(Transport* trans) {
+    const std::string* path = FindHeader(":path");
+    const std::string* method = FindHeader(":method");
+    const std::string* content_type = FindHeader("content-type");
+    if (!path || !method) {
+        Respond({{":status", "400"}}, IOBuf(), {});
+        return 0;
+    }
+
+    if (content_type && content_type->compare(0, 16, "application/grpc") == 0) {
+        // The path of methods is "/<service full name>/<method name>".
+        const size_t slash = path->rfind('/');
+        MethodProperty* property = nullptr;
+        if (slash != 0 && slash != std::string::npos) {
+            property = ServiceHolder::singleton()->FindMethodProperty(
+                path->substr(1, slash - 1), path->substr(slash + 1));
+        }
+        if (!property) {
+            RespondGRPC(GRPC_UNIMPLEMENTED, "Method not found: " + *path,
+                        IOBuf());
+            return 0;
+        }
+        return ServeMethod(property);
+    }
+
+    builtin::Page page;
+    if (*method == "GET" && builtin::RenderPage(*path, &page)) {
+        Respond({{":status", std::to_string(page.status_code)},
+                 {"content-type", page.content_type}},
+                std::move(page.body), {});
+    } else {
+        Respond({{":status", "404"}}, IOBuf(), {});
+    }
+    return 0;
+}
+
+int H2ServerCall::ServeMethod(MethodProperty* property) {
+    const MethodDescriptor* method = property->method;
+    Service* service =
+        ServiceHolder::singleton()->FindService(method->service()->full_name());
+
+    uint8_t prefix[kGRPCPrefixSize];
+    if (body_.copy_to(prefix, sizeof(prefix)) < sizeof(prefix) ||
+        body_.size() != kGRPCPrefixSize + DecodeBigEndian32(prefix + 1)) {
+        RespondGRPC(GRPC_INTERNAL, "Invalid message framing", IOBuf());
+        return 0;
+    }
+    if (prefix[0] != 0) {
+        RespondGRPC(GRPC_UNIMPLEMENTED, "Compression isn't supported",
+                    IOBuf());
+        return 0;
+    }
+    body_.pop_front(kGRPCPrefixSize);
+
+    if (!ServiceHolder::singleton()->OnRequested(property)) {
+        RespondGRPC(GRPC_RESOURCE_EXHAUSTED, "Reached the max concurrency",
+                    IOBuf());
+        return 0;
+    }
+    property_ = property;
+    start_time_ = std::chrono::steady_clock::now();
+
+    request_.reset(service->GetRequestPrototype(method).New());
+    response_.reset(service->GetResponsePrototype(method).New());
+    IOBufAsZeroCopyInputStream in(body_);
+    if (!request_->ParseFromZeroCopyStream(&in)) {
+        ServiceHolder::singleton()->OnResponded(property_, false, 0);
+        RespondGRPC(GRPC_INTERNAL, "Failed to parse the request", IOBuf());
+        return 0;
+    }
+
+    LOG(INFO) << "H2ServerCall::ServeMethod " << method->full_name();
+    service->CallMethod(method, this, request_.get(), response_.get(), this);
+    return 0;
+}
+
+void H2ServerCall::Run() {
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_time_);
+    ServiceHolder::singleton()->OnResponded(property_, !Failed(),
+                                            latency.count());
+
+    if (Failed()) {
+        RespondGRPC(GRPC_UNKNOWN, ErrorText(), IOBuf());
+        return;
+    }
+
+    IOBuf data;
+    uint8_t prefix[kGRPCPrefixSize] = {0};
+    EncodeBigEndian32(prefix + 1, response_->ByteSizeLong());
+    data.append(prefix, sizeof(prefix));
+    {
+        IOBufAsZeroCopyOutputStream out(&data);
+        response_->SerializeToZeroCopyStream(&out);
+    }
+    RespondGRPC(GRPC_OK, "", std::move(data));
+}
+
+const std::string* H2ServerCall::FindHeader(std::string_view name) const {
+    for (auto&& header : headers_) {
+        if (header.name == name)
+            return &header.value;
+    }
+    return nullptr;
+}
+
+void H2ServerCall::RespondGRPC(int grpc_status, const std::string& message,
+                               IOBuf data) {
+    std::vector<Header> headers = {{":status", "200"},
+                                   {"content-type", "application/grpc"}};
+    std::vector<Header> trailers = {
+        {"grpc-status", std::to_string(grpc_status)}};
+    if (!message.empty())
+        trailers.push_back({"grpc-message", PercentEncode(message)});
+
+    if (data.empty()) {
+        // Trailers-Only response.
+        headers.insert(headers.end(), trailers.begin(), trailers.end());
+        Respond(headers, IOBuf(), {});
+    } else {
+        Respond(headers, std::move(data), trailers);
+    }
+}
+
+void H2ServerCall::Respond(const std::vector<Header>& headers, IOBuf data,
+                           const std::vector<Header>& trailers) {
+    // The call might be deleted once its response is written, keep the
+    // context alive until the flushing is done.
+    std::shared_ptr<H2Context> context = context_;
+    context->Respond(this, stream_id_, headers, std::move(data), trailers);
+}
+
+}  // namespace h2
+}  // namespace protocol
+}  // namespace urpc
@@ -0,0 +1,194 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <google/protobuf/message.h>
+
+#include <urpc/controller.h>
+
+#include "urpc/iobuf.h"
+#include "urpc/method_status.h"
+#include "urpc/protocol/base.h"
+#include "urpc/protocol/h2/frame.h"
+#include "urpc/protocol/h2/hpack.h"
+#include "urpc/server_call.h"
+#include "urpc/service_holder.h"
+
+namespace urpc {
+namespace protocol {
+namespace h2 {
+
+class H2ServerCall;
+
+/// The HTTP/2 state of a connection: HPACK, streams and flow control. Frames
+/// are cut from the read buffer by reference, the payload of DATA frames is
+/// appended to the request body without copying.
+class H2Context final : public ParseContext,
+                        public std::enable_shared_from_this<H2Context> {
+public:
+    /// The window advertised for each stream and the connection.
+    static constexpr int64_t kLocalWindowSize = 1 << 20;
+    static constexpr uint32_t kMaxConcurrentStreams = 128;
+    /// The limit of a header block, including CONTINUATION frames.
+    static constexpr size_t kMaxHeaderBlockSize = 64 * 1024;
+
+    explicit H2Context(Transport* transport) : transport_(transport) {}
+    ~H2Context() override = default;
+
+    /// Consume frames from `buf` until a request is complete. ERR_OK is
+    /// returned with the call, ERR_TOO_SMALL if more frames are required,
+    /// ERR_MISMATCH if the connection preface is mismatched, or
+    /// ERR_NOT_SUPPORTED on connection errors, after GOAWAY is sent.
+    int Parse(IOBuf* buf, ServerCall** server_call);
+
+    /// Send the response of a stream. DATA frames are sent as the flow
+    /// control windows allow, and the call completes once the last frame
+    /// is written. The stream ends with `trailers`, or with the last DATA
+    /// frame if there are no trailers.
+    void Respond(H2ServerCall* call, uint32_t stream_id,
+                 const std::vector<Header>& headers, IOBuf data,
+                 const std::vector<Header>& trailers);
+
+    /// Send GOAWAY without error, the streams already opened are served.
+    void OnDraining() override;
+
+    /// Complete the responses blocked by the flow control windows.
+    void OnReset() override;
+
+private:
+    struct Stream {
+        std::vector<Header> headers;
+        IOBuf data;
+        /// END_STREAM is received, the request is complete.
+        bool remote_closed{false};
+        int64_t recv_window{kLocalWindowSize};
+        int64_t send_window{kDefaultWindowSize};
+        /// The bytes received but not acknowledged by WINDOW_UPDATE.
+        int64_t unacked_bytes{0};
+
+        /// The response waiting for the flow control windows.
+        H2ServerCall* call{nullptr};
+        IOBuf pending_head;
+        IOBuf pending_data;
+        IOBuf pending_tail;
+    };
+
+    /// The controller of the writes of control frames, nothing to do once
+    /// they are written.
+    class FrameWriter final : public Controller {
+    protected:
+        void OnComplete() override {}
+    };
+
+    int ParseFrames(IOBuf* buf, ServerCall** server_call);
+    int OnFrame(const FrameHeader& header, IOBuf* payload,
+                ServerCall** server_call);
+    int OnData(const FrameHeader& header, IOBuf* payload,
+               ServerCall** server_call);
+    int OnHeaders(const FrameHeader& header, IOBuf* payload,
+                  ServerCall** server_call);
+    int OnContinuation(const FrameHeader& header, IOBuf* payload,
+                       ServerCall** server_call);
+    int OnEndHeaders(ServerCall** server_call);
+    int OnSettings(const FrameHeader& header, IOBuf* payload);
+    int OnPing(const FrameHeader& header, IOBuf* payload);
+    int OnWindowUpdate(const FrameHeader& header, IOBuf* payload);
+    int OnRstStream(const FrameHeader& header, IOBuf* payload);
+
+    /// Remove the padding of DATA and HEADERS frames.
+    int RemovePadding(const FrameHeader& header, IOBuf* payload);
+    void OnStreamComplete(uint32_t stream_id, Stream* stream,
+                          ServerCall** server_call);
+
+    int ConnectionError(H2Error error, const char* reason);
+    void AppendGoAway(H2Error error);
+    void ResetStream(uint32_t stream_id, H2Error error);
+    void AppendWindowUpdate(uint32_t stream_id, uint32_t increment);
+
+    void FlushStream(uint32_t stream_id, Stream* stream);
+    void FlushBlockedStreams();
+    void FlushControl();
+
+    Transport* const transport_;
+    bool preface_received_{false};
+    HPackDecoder decoder_;
+    std::unordered_map<uint32_t, Stream> streams_;
+    uint32_t last_stream_id_{0};
+
+    /// The stream whose header block is continued by CONTINUATION frames,
+    /// 0 if none.
+    uint32_t continuation_stream_{0};
+    bool continuation_end_stream_{false};
+    IOBuf header_block_;
+
+    uint32_t peer_max_frame_size_{kDefaultMaxFrameSize};
+    int64_t peer_initial_window_{kDefaultWindowSize};
+    int64_t send_window_{kDefaultWindowSize};
+    int64_t recv_window_{kDefaultWindowSize};
+    int64_t unacked_bytes_{0};
+
+    FrameWriter frame_writer_;
+    /// The control frames to write once the frames in the read buffer are
+    /// consumed.
+    IOBuf control_buf_;
+};
+
+/// Serves a HTTP/2 stream. gRPC requests (`application/grpc`) to
+/// `/<service full name>/<method>` are mapped to the registered methods,
+/// the other GET requests are served by the builtin pages.
+class H2ServerCall : public ServerCall, public google::protobuf::Closure {
+public:
+    H2ServerCall(std::shared_ptr<H2Context> context, uint32_t stream_id,
+                 std::vector<Header> headers, IOBuf body)
+        : context_(std::move(context)),
+          stream_id_(stream_id),
+          headers_(std::move(headers)),
+          body_(std::move(body)) {}
+    ~H2ServerCall() override = default;
+
+    int Serve(Transport* trans) override;
+
+    /// Invoked once the service method is done.
+    void Run() override;
+
+private:
+    const std::string* FindHeader(std::string_view name) const;
+    int ServeMethod(MethodProperty* property);
+    void RespondGRPC(int grpc_status, const std::string& message,
+                     IOBuf data);
+    void Respond(const std::vector<Header>& headers, IOBuf data,
+                 const std::vector<Header>& trailers);
+
+    std::shared_ptr<H2Context> context_;
+    const uint32_t stream_id_;
+    const std::vector<Header> headers_;
+    IOBuf body_;
+    std::unique_ptr<google::protobuf::Message> request_;
+    std::unique_ptr<google::protobuf::Message> response_;
+    MethodProperty* property_{nullptr};
+    std::chrono::steady_clock::time_point start_time_;
+};
+
+}  // namespace h2
+}  // namespace protocol
+}  // namespace urpc
@@ -0,0 +1,115 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "urpc/coding.h"
+#include "urpc/iobuf.h"
+
+namespace urpc {
+namespace protocol {
+namespace h2 {
+
+/// The connection preface sent by clients, RFC 7540 3.5.
+constexpr char kConnectionPreface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+constexpr size_t kConnectionPrefaceSize = sizeof(kConnectionPreface) - 1;
+
+constexpr size_t kFrameHeaderSize = 9;
+/// The default SETTINGS_MAX_FRAME_SIZE and SETTINGS_INITIAL_WINDOW_SIZE.
+constexpr uint32_t kDefaultMaxFrameSize = 16384;
+constexpr int64_t kDefaultWindowSize = 65535;
+constexpr int64_t kMaxWindowSize = 0x7fffffff;
+
+enum FrameType : uint8_t {
+    FRAME_DATA = 0x0,
+    FRAME_HEADERS = 0x1,
+    FRAME_PRIORITY = 0x2,
+    FRAME_RST_STREAM = 0x3,
+    FRAME_SETTINGS = 0x4,
+    FRAME_PUSH_PROMISE = 0x5,
+    FRAME_PING = 0x6,
+    FRAME_GOAWAY = 0x7,
+    FRAME_WINDOW_UPDATE = 0x8,
+    FRAME_CONTINUATION = 0x9,
+};
+
+enum FrameFlag : uint8_t {
+    FLAG_END_STREAM = 0x1,
+    FLAG_ACK = 0x1,
+    FLAG_END_HEADERS = 0x4,
+    FLAG_PADDED = 0x8,
+    FLAG_PRIORITY = 0x20,
+};
+
+enum SettingsId : uint16_t {
+    SETTINGS_HEADER_TABLE_SIZE = 0x1,
+    SETTINGS_ENABLE_PUSH = 0x2,
+    SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+    SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+    SETTINGS_MAX_FRAME_SIZE = 0x5,
+    SETTINGS_MAX_HEADER_LIST_SIZE = 0x6,
+};
+
+/// The error codes of RST_STREAM and GOAWAY, RFC 7540 7.
+enum H2Error : uint32_t {
+    H2_NO_ERROR = 0x0,
+    H2_PROTOCOL_ERROR = 0x1,
+    H2_INTERNAL_ERROR = 0x2,
+    H2_FLOW_CONTROL_ERROR = 0x3,
+    H2_SETTINGS_TIMEOUT = 0x4,
+    H2_STREAM_CLOSED = 0x5,
+    H2_FRAME_SIZE_ERROR = 0x6,
+    H2_REFUSED_STREAM = 0x7,
+    H2_CANCEL = 0x8,
+    H2_COMPRESSION_ERROR = 0x9,
+};
+
+struct FrameHeader {
+    uint32_t length{0};
+    uint8_t type{0};
+    uint8_t flags{0};
+    uint32_t stream_id{0};
+};
+
+/// Peek the frame header at the front of `buf`, false is returned if `buf`
+/// is shorter than a frame header.
+inline bool PeekFrameHeader(const IOBuf& buf, FrameHeader* header) {
+    uint8_t data[kFrameHeaderSize];
+    if (buf.copy_to(data, kFrameHeaderSize) < kFrameHeaderSize)
+        return false;
+    header->length = (static_cast<uint32_t>(data[0]) << 16) |
+                     (static_cast<uint32_t>(data[1]) << 8) | data[2];
+    header->type = data[3];
+    header->flags = data[4];
+    header->stream_id = DecodeBigEndian32(data + 5) & 0x7fffffff;
+    return true;
+}
+
+inline void AppendFrameHeader(uint32_t length, uint8_t type, uint8_t flags,
+                              uint32_t stream_id, IOBuf* out) {
+    uint8_t data[kFrameHeaderSize];
+    data[0] = static_cast<uint8_t>(length >> 16);
+    data[1] = static_cast<uint8_t>(length >> 8);
+    data[2] = static_cast<uint8_t>(length);
+    data[3] = type;
+    data[4] = flags;
+    EncodeBigEndian32(data + 5, stream_id);
+    out->append(data, kFrameHeaderSize);
+}
+
+}  // namespace h2
+}  // namespace protocol
+}  // namespace urpc
@@ -0,0 +1,472 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hpack.h"
+
+#include <string>
+#include <utility>
+
+#include "urpc/base.h"
+
+namespace urpc {
+namespace protocol {
+namespace h2 {
+
+namespace {
+
+constexpr size_t kEOS = 256;
+constexpr size_t kMaxCodeLength = 30;
+
+/// The code lengths of the Huffman code (RFC 7541 Appendix B), indexed by
+/// symbol. The code is canonical, so the codes are derived from lengths.
+constexpr uint8_t kCodeLengths[kEOS + 1] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+/// Codes no longer than this are decoded by a single table lookup, the
+/// others walk the canonical code by length.
+constexpr size_t kFastBits = 9;
+
+class HuffmanTable {
+public:
+    HuffmanTable() {
+        // Assign the canonical codes: ordered by length, then symbol.
+        uint32_t code = 0;
+        size_t next = 0;
+        for (size_t length = 1; length <= kMaxCodeLength; ++length) {
+            first_code_[length] = code;
+            first_index_[length] = next;
+            for (size_t symbol = 0; symbol <= kEOS; ++symbol) {
+                if (kCodeLengths[symbol] != length)
+                    continue;
+                codes_[symbol] = code++;
+                sorted_symbols_[next++] = symbol;
+            }
+            count_[length] = next - first_index_[length];
+            code <<= 1;
+        }
+
+        for (size_t symbol = 0; symbol <= kEOS; ++symbol) {
+            const size_t length = kCodeLengths[symbol];
+            if (length > kFastBits)
+                continue;
+            // All entries prefixed by the code decode to the symbol.
+            const size_t shift = kFastBits - length;
+            const uint32_t begin = codes_[symbol] << shift;
+            for (uint32_t i = 0; i < (1u << shift); ++i) {
+                fast_[begin + i].symbol = symbol;
+                fast_[begin + i].length = length;
+            }
+        }
+    }
+
+    uint32_t code(size_t symbol) const { return codes_[symbol]; }
+
+    /// Decode a symbol from the top `bits` bits of `acc`. Returns false if
+    /// `bits` isn't enough for any code.
+    bool Decode(uint64_t acc, size_t bits, uint16_t* symbol,
+                size_t* length) const {
+        const uint32_t peek =
+            bits >= kFastBits
+                ? static_cast<uint32_t>(acc >> (bits - kFastBits))
+                : static_cast<uint32_t>(acc << (kFastBits - bits));
+        const FastEntry& entry = fast_[peek & ((1u << kFastBits) - 1)];
+        if (entry.length) {
+            if (entry.length > bits)
+                return false;
+            *symbol = entry.symbol;
+            *length = entry.length;
+            return true;
+        }
+
+        for (size_t len = kFastBits + 1; len <= kMaxCodeLength && len <= bits;
+             ++len) {
+            const uint32_t code =
+                static_cast<uint32_t>(acc >> (bits - len)) & ((1u << len) - 1);
+            if (code - first_code_[len] < count_[len]) {
+                *symbol = sorted_symbols_[first_index_[len] + code -
+                                          first_code_[len]];
+                *length = len;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct FastEntry {
+        uint16_t symbol{0};
+        uint8_t length{0};
+    };
+
+    uint32_t codes_[kEOS + 1];
+    uint16_t sorted_symbols_[kEOS + 1];
+    uint32_t first_code_[kMaxCodeLength + 1];
+    uint32_t first_index_[kMaxCodeLength + 1];
+    uint32_t count_[kMaxCodeLength + 1];
+    FastEntry fast_[1 << kFastBits];
+};
+
+const HuffmanTable& huffman_table() {
+    static const HuffmanTable table;
+    return table;
+}
+
+struct StaticEntry {
+    const char* name;
+    const char* value;
+};
+
+/// RFC 7541 Appendix A, the index starts from 1.
+constexpr StaticEntry kStaticTable[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+constexpr size_t kStaticTableSize =
+    sizeof(kStaticTable) / sizeof(kStaticTable[0]);
+
+/// The overhead of an entry in the dynamic table, RFC 7541 4.1.
+constexpr size_t kEntryOverhead = 32;
+
+/// The limit of decoded strings, to bound the memory of a header block.
+constexpr size_t kMaxStringSize = 64 * 1024;
+
+/// Decode an integer with `prefix_bits` prefix (RFC 7541 5.1), `first` is
+/// the first byte which is already consumed.
+int DecodeInteger(uint8_t first, size_t prefix_bits, IOBufBytesIterator* it,
+                  uint64_t* value) {
+    const uint64_t max_prefix = (1u << prefix_bits) - 1;
+    *value = first & max_prefix;
+    if (*value < max_prefix)
+        return ERR_OK;
+
+    for (size_t shift = 0; *it; shift += 7) {
+        if (shift > 28)
+            return ERR_NOT_SUPPORTED;
+        const uint8_t byte = **it;
+        ++*it;
+        *value += static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return ERR_OK;
+    }
+    return ERR_NOT_SUPPORTED;
+}
+
+void EncodeInteger(uint8_t flags, size_t prefix_bits, uint64_t value,
+                   std::string* out) {
+    const uint64_t max_prefix = (1u << prefix_bits) - 1;
+    if (value < max_prefix) {
+        out->push_back(static_cast<char>(flags | value));
+        return;
+    }
+    out->push_back(static_cast<char>(flags | max_prefix));
+    value -= max_prefix;
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+void EncodeString(std::string_view value, std::string* out) {
+    const size_t huffman_size = HuffmanEncodedSize(value);
+    if (huffman_size < value.size()) {
+        EncodeInteger(0x80, 7, huffman_size, out);
+        HuffmanEncode(value, out);
+    } else {
+        EncodeInteger(0, 7, value.size(), out);
+        out->append(value);
+    }
+}
+
+}  // namespace
+
+int HuffmanDecode(IOBufBytesIterator* it, size_t size, std::string* out) {
+    const HuffmanTable& table = huffman_table();
+    uint64_t acc = 0;
+    size_t bits = 0;
+    while (true) {
+        while (bits <= 56 && size && *it) {
+            acc = (acc << 8) | **it;
+            ++*it;
+            --size;
+            bits += 8;
+        }
+        if (!bits)
+            break;
+
+        uint16_t symbol;
+        size_t length;
+        if (!table.Decode(acc, bits, &symbol, &length)) {
+            // The code is complete, every 30 bits decode to a symbol, so
+            // only the padding is left.
+            if (size)
+                return ERR_NOT_SUPPORTED;
+            break;
+        }
+        if (symbol == kEOS)
+            return ERR_NOT_SUPPORTED;
+        out->push_back(static_cast<char>(symbol));
+        bits -= length;
+        acc &= (uint64_t{1} << bits) - 1;
+    }
+
+    // The padding is the most significant bits of EOS, which are all ones.
+    const uint64_t mask = (uint64_t{1} << bits) - 1;
+    if (bits > 7 || (acc & mask) != mask)
+        return ERR_NOT_SUPPORTED;
+    return ERR_OK;
+}
+
+size_t HuffmanEncodedSize(std::string_view value) {
+    size_t bits = 0;
+    for (unsigned char c : value)
+        bits += kCodeLengths[c];
+    return (bits + 7) / 8;
+}
+
+void HuffmanEncode(std::string_view value, std::string* out) {
+    const HuffmanTable& table = huffman_table();
+    uint64_t acc = 0;
+    size_t bits = 0;
+    for (unsigned char c : value) {
+        acc = (acc << kCodeLengths[c]) | table.code(c);
+        bits += kCodeLengths[c];
+        while (bits >= 8) {
+            bits -= 8;
+            out->push_back(static_cast<char>(acc >> bits));
+        }
+        acc &= (uint64_t{1} << bits) - 1;
+    }
+    if (bits) {
+        // Pad with the most significant bits of EOS.
+        out->push_back(
+            static_cast<char>((acc << (8 - bits)) | (0xff >> bits)));
+    }
+}
+
+int HPackDecoder::Decode(const IOBuf& block, std::vector<Header>* headers) {
+    IOBufBytesIterator it(block);
+    while (it) {
+        const uint8_t first = *it;
+        ++it;
+
+        uint64_t index = 0;
+        if (first & 0x80) {
+            // Indexed header field.
+            if (DecodeInteger(first, 7, &it, &index) != ERR_OK)
+                return ERR_NOT_SUPPORTED;
+            const Header* header = Lookup(index);
+            if (!header)
+                return ERR_NOT_SUPPORTED;
+            headers->push_back(*header);
+            continue;
+        }
+
+        if ((first & 0xe0) == 0x20) {
+            // Dynamic table size update.
+            uint64_t size = 0;
+            if (DecodeInteger(first, 5, &it, &size) != ERR_OK ||
+                size > settings_max_table_size_)
+                return ERR_NOT_SUPPORTED;
+            max_table_size_ = size;
+            Evict(max_table_size_);
+            continue;
+        }
+
+        // Literal header field, with incremental indexing (01), without
+        // indexing (0000) or never indexed (0001).
+        const bool indexing = first & 0x40;
+        if (DecodeInteger(first, indexing ? 6 : 4, &it, &index) != ERR_OK)
+            return ERR_NOT_SUPPORTED;
+        Header header;
+        if (index) {
+            const Header* name = Lookup(index);
+            if (!name)
+                return ERR_NOT_SUPPORTED;
+            header.name = name->name;
+        } else if (DecodeString(&it, &header.name) != ERR_OK) {
+            return ERR_NOT_SUPPORTED;
+        }
+        if (DecodeString(&it, &header.value) != ERR_OK)
+            return ERR_NOT_SUPPORTED;
+
+        if (indexing)
+            Insert(header);
+        headers->push_back(std::move(header));
+    }
+    return ERR_OK;
+}
+
+int HPackDecoder::DecodeString(IOBufBytesIterator* it, std::string* out) {
+    if (!*it)
+        return ERR_NOT_SUPPORTED;
+    const uint8_t first = **it;
+    ++*it;
+    uint64_t size = 0;
+    if (DecodeInteger(first, 7, it, &size) != ERR_OK ||
+        size > kMaxStringSize || size > it->bytes_left())
+        return ERR_NOT_SUPPORTED;
+
+    if (first & 0x80)
+        return HuffmanDecode(it, size, out);
+    it->copy_and_forward(out, size);
+    return ERR_OK;
+}
+
+const Header* HPackDecoder::Lookup(uint64_t index) const {
+    static const std::vector<Header> static_table = [] {
+        std::vector<Header> table;
+        for (auto&& entry : kStaticTable)
+            table.push_back(Header{entry.name, entry.value});
+        return table;
+    }();
+
+    if (index == 0)
+        return nullptr;
+    if (index <= kStaticTableSize)
+        return &static_table[index - 1];
+    index -= kStaticTableSize + 1;
+    return index < dynamic_table_.size() ? &dynamic_table_[index] : nullptr;
+}
+
+void HPackDecoder::Insert(Header header) {
+    const size_t size =
+        header.name.size() + header.value.size() + kEntryOverhead;
+    if (size > max_table_size_) {
+        // An entry larger than the table empties the table.
+        Evict(0);
+        return;
+    }
+    Evict(max_table_size_ - size);
+    table_size_ += size;
+    dynamic_table_.push_front(std::move(header));
+}
+
+void HPackDecoder::Evict(size_t limit) {
+    while (table_size_ > limit) {
+        const Header& oldest = dynamic_table_.back();
+        table_size_ -=
+            oldest.name.size() + oldest.value.size() + kEntryOverhead;
+        dynamic_table_.pop_back();
+    }
+}
+
+void HPackEncoder::Encode(const std::vector<Header>& headers, IOBuf* out) {
+    std::string buf;
+    for (auto&& header : headers) {
+        size_t name_index = 0;
+        size_t index = 0;
+        for (size_t i = 0; i < kStaticTableSize; ++i) {
+            if (header.name != kStaticTable[i].name)
+                continue;
+            if (!name_index)
+                name_index = i + 1;
+            if (header.value == kStaticTable[i].value) {
+                index = i + 1;
+                break;
+            }
+        }
+
+        if (index) {
+            EncodeInteger(0x80, 7, index, &buf);
+            continue;
+        }
+        // Literal header field without indexing.
+        EncodeInteger(0, 4, name_index, &buf);
+        if (!name_index)
+            EncodeString(header.name, &buf);
+        EncodeString(header.value, &buf);
+    }
+    out->append(buf);
+}
+
+}  // namespace h2
+}  // namespace protocol
+}  // namespace urpc
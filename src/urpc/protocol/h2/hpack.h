@@ -0,0 +1,88 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "urpc/iobuf.h"
+
+namespace urpc {
+namespace protocol {
+namespace h2 {
+
+struct Header {
+    std::string name;
+    std::string value;
+};
+
+/// Decode `size` bytes of Huffman coded string (RFC 7541 5.2) from `it` and
+/// append to `out`. ERR_OK is returned, or ERR_NOT_SUPPORTED if the string
+/// is invalid, such as containing EOS or a padding longer than 7 bits.
+int HuffmanDecode(IOBufBytesIterator* it, size_t size, std::string* out);
+
+/// The size of `value` after Huffman coding.
+size_t HuffmanEncodedSize(std::string_view value);
+
+/// Append the Huffman coded `value` to `out`.
+void HuffmanEncode(std::string_view value, std::string* out);
+
+/// HPACK (RFC 7541) decoder of a connection, the dynamic table is kept
+/// across header blocks.
+class HPackDecoder {
+public:
+    /// `max_table_size` is the SETTINGS_HEADER_TABLE_SIZE advertised to the
+    /// peer, the peer could only shrink the dynamic table below it.
+    explicit HPackDecoder(size_t max_table_size = 4096)
+        : settings_max_table_size_(max_table_size),
+          max_table_size_(max_table_size) {}
+
+    /// Decode a complete header block and append the headers. ERR_OK is
+    /// returned, or ERR_NOT_SUPPORTED on a compression error, which is a
+    /// connection error since the dynamic table is out of sync.
+    int Decode(const IOBuf& block, std::vector<Header>* headers);
+
+    /// The size of the dynamic table as defined in RFC 7541 4.1.
+    size_t table_size() const { return table_size_; }
+    size_t table_entries() const { return dynamic_table_.size(); }
+
+private:
+    int DecodeString(IOBufBytesIterator* it, std::string* out);
+    const Header* Lookup(uint64_t index) const;
+    void Insert(Header header);
+    void Evict(size_t limit);
+
+    const size_t settings_max_table_size_;
+    size_t max_table_size_;
+    size_t table_size_{0};
+    /// The newest entry is at the front.
+    std::deque<Header> dynamic_table_;
+};
+
+/// HPACK encoder. It never inserts into the dynamic table of the peer, so
+/// it is stateless: headers in the static table are indexed, the others are
+/// literals without indexing, Huffman coded when it is shorter.
+class HPackEncoder {
+public:
+    static void Encode(const std::vector<Header>& headers, IOBuf* out);
+};
+
+}  // namespace h2
+}  // namespace protocol
+}  // namespace urpc
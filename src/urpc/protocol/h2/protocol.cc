@@ -0,0 +1,45 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "protocol.h"
+
+#include <memory>
+
+#include "urpc/protocol/h2/call.h"
+#include "urpc/server_transport.h"
+
+namespace urpc {
+namespace protocol {
+namespace h2 {
+
+int H2Protocol::ParseRequest(IOBuf* buf, ServerTransport* transport,
+                             ServerCall** server_call) {
+    // The transport drops the context once another protocol is probed, so
+    // a non-null context always belongs to HTTP/2.
+    auto context =
+        std::static_pointer_cast<H2Context>(transport->parse_context());
+    if (!context) {
+        context = std::make_shared<H2Context>(transport);
+        transport->set_parse_context(context);
+    }
+    return context->Parse(buf, server_call);
+}
+
+int H2Protocol::ParseResponse(IOBuf* buf, ClientTransport* transport) {
+    return ERR_NOT_SUPPORTED;
+}
+
+}  // namespace h2
+}  // namespace protocol
+}  // namespace urpc
@@ -0,0 +1,43 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include "urpc/protocol/base.h"
+#include "urpc/protocol/h2/frame.h"
+
+namespace urpc {
+namespace protocol {
+namespace h2 {
+
+/// HTTP/2 server protocol with prior knowledge (h2c), serving gRPC on the
+/// same port as the RPC services.
+class H2Protocol final : public BaseProtocol {
+public:
+    ~H2Protocol() override = default;
+
+    /// The connection preface of clients.
+    const char* Header() const override { return kConnectionPreface; }
+
+    /// Parse the protocol request. If the payload isn't enough, ERR_TOO_SMALL
+    /// is returned. If the header is mismatched, ERR_MISMATCH is returned.
+    int ParseRequest(IOBuf* buf, ServerTransport* transport,
+                     ServerCall** server_call) override;
+
+    /// HTTP/2 client isn't supported, ERR_NOT_SUPPORTED is always returned.
+    int ParseResponse(IOBuf* buf, ClientTransport* transport) override;
+};
+
+}  // namespace h2
+}  // namespace protocol
+}  // namespace urpc
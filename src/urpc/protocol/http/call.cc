@@ -0,0 +1,240 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "call.h"
+
+#include <sys/socket.h>
+
+#include <string>
+#include <string_view>
+
+#include <glog/logging.h>
+#include <google/protobuf/util/json_util.h>
+
+#include "urpc/builtin/builtin_service.h"
+#include "urpc/transport.h"
+
+using namespace google::protobuf;
+
+namespace urpc {
+namespace protocol {
+namespace http {
+
+namespace {
+
+constexpr char kJsonContentType[] = "application/json";
+constexpr char kProtobufContentType[] = "application/x-protobuf";
+constexpr char kTextContentType[] = "text/plain";
+
+const char* ReasonPhrase(int status_code) {
+    switch (status_code) {
+        case 200:
+            return "OK";
+        case 400:
+            return "Bad Request";
+        case 404:
+            return "Not Found";
+        case 405:
+            return "Method Not Allowed";
+        case 413:
+            return "Payload Too Large";
+        case 503:
+            return "Service Unavailable";
+        default:
+            return "Internal Server Error";
+    }
+}
+
+bool IsProtobufContentType(std::string_view content_type) {
+    content_type = content_type.substr(0, content_type.find(';'));
+    return content_type == kProtobufContentType ||
+           content_type == "application/protobuf" ||
+           content_type == "application/proto";
+}
+
+IOBuf TextBody(std::string_view text) {
+    IOBuf body;
+    body.append(text.data(), text.size());
+    return body;
+}
+
+}  // namespace
+
+void AppendResponse(int status_code, const std::string& content_type,
+                    bool keep_alive, const IOBuf& body, IOBuf* out) {
+    std::string header;
+    header.reserve(128);
+    header.append("HTTP/1.1 ")
+        .append(std::to_string(status_code))
+        .append(" ")
+        .append(ReasonPhrase(status_code))
+        .append("\r\nContent-Type: ")
+        .append(content_type)
+        .append("\r\nContent-Length: ")
+        .append(std::to_string(body.size()))
+        .append(keep_alive ? "\r\nConnection: keep-alive\r\n\r\n"
+                           : "\r\nConnection: close\r\n\r\n");
+    out->append(header);
+    out->append(body);
+}
+
+void HTTPContext::Respond(uint64_t sequence, HTTPServerCall* call, IOBuf buf) {
+    if (sequence != next_write_) {
+        ready_.emplace(sequence, std::pair{call, std::move(buf)});
+        return;
+    }
+
+    Write(call, std::move(buf));
+    ++next_write_;
+    for (auto it = ready_.begin();
+         it != ready_.end() && it->first == next_write_;
+         it = ready_.erase(it)) {
+        Write(it->second.first, std::move(it->second.second));
+        ++next_write_;
+    }
+}
+
+void HTTPContext::Write(HTTPServerCall* call, IOBuf buf) {
+    if (transport_->fd() < 0) {
+        // The peer closed the connection before the response is ready.
+        call->SetFailed(ERR_EOF, "connection closed");
+        call->OnComplete();
+        return;
+    }
+    transport_->StartWrite(call, std::move(buf));
+}
+
+int HTTPServerCall::Serve(Transport* trans) {
+    transport_ = trans;
+    if (request_.reject_status != 0) {
+        Respond(request_.reject_status, kTextContentType,
+                TextBody("Invalid Content-Length\n"));
+        return 0;
+    }
+
+    // The path of methods is "/<service full name>/<method name>".
+    std::string_view path = request_.path();
+    size_t slash = path.rfind('/');
+    if (slash != 0 && slash != std::string_view::npos) {
+        MethodProperty* property =
+            ServiceHolder::singleton()->FindMethodProperty(
+                std::string(path.substr(1, slash - 1)),
+                std::string(path.substr(slash + 1)));
+        if (property)
+            return ServeMethod(property);
+    }
+
+    builtin::Page page;
+    if (request_.method == "GET" && builtin::RenderPage(path, &page)) {
+        Respond(page.status_code, page.content_type, std::move(page.body));
+    } else {
+        Respond(404, kTextContentType,
+                TextBody("No such method or page, see / for the builtin "
+                         "pages\n"));
+    }
+    return 0;
+}
+
+int HTTPServerCall::ServeMethod(MethodProperty* property) {
+    const MethodDescriptor* method = property->method;
+    Service* service =
+        ServiceHolder::singleton()->FindService(method->service()->full_name());
+    if (!ServiceHolder::singleton()->OnRequested(property)) {
+        Respond(503, kTextContentType,
+                TextBody("Reached the max concurrency of " +
+                         method->full_name() + "\n"));
+        return 0;
+    }
+    property_ = property;
+    start_time_ = std::chrono::steady_clock::now();
+
+    request_message_.reset(service->GetRequestPrototype(method).New());
+    response_message_.reset(service->GetResponsePrototype(method).New());
+
+    json_ = !IsProtobufContentType(request_.content_type);
+    bool parsed = true;
+    if (json_ && !request_.body.empty()) {
+        std::string json;
+        request_.body.copy_to(&json);
+        parsed = util::JsonStringToMessage(json, request_message_.get()).ok();
+    } else if (!json_) {
+        IOBufAsZeroCopyInputStream in(request_.body);
+        parsed = request_message_->ParseFromZeroCopyStream(&in);
+    }
+    if (!parsed) {
+        ServiceHolder::singleton()->OnResponded(property_, false, 0);
+        Respond(400, kTextContentType,
+                TextBody("Failed to parse the request of " +
+                         method->full_name() + "\n"));
+        return 0;
+    }
+
+    LOG(INFO) << "HTTPServerCall::ServeMethod " << method->full_name();
+    service->CallMethod(method, this, request_message_.get(),
+                        response_message_.get(), this);
+    return 0;
+}
+
+void HTTPServerCall::Run() {
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_time_);
+    ServiceHolder::singleton()->OnResponded(property_, !Failed(),
+                                            latency.count());
+
+    if (Failed()) {
+        Respond(500, kTextContentType, TextBody(ErrorText() + "\n"));
+        return;
+    }
+
+    IOBuf body;
+    if (json_) {
+        std::string json;
+        util::MessageToJsonString(*response_message_, &json);
+        body.append(json);
+    } else {
+        IOBufAsZeroCopyOutputStream out(&body);
+        response_message_->SerializeToZeroCopyStream(&out);
+    }
+    Respond(200, json_ ? kJsonContentType : kProtobufContentType,
+            std::move(body));
+}
+
+void HTTPServerCall::OnComplete() {
+    if (!request_.keep_alive && transport_->fd() >= 0) {
+        // The last response on this connection is written, let the peer
+        // close the connection.
+        shutdown(transport_->fd(), SHUT_WR);
+    }
+    ServerCall::OnComplete();
+}
+
+void HTTPServerCall::Respond(int status_code, const std::string& content_type,
+                             IOBuf body) {
+    // The clients reconnect to the other servers.
+    if (transport_->draining()) {
+        request_.keep_alive = false;
+        context_->set_closing();
+    }
+    IOBuf buf;
+    AppendResponse(status_code, content_type, request_.keep_alive, body, &buf);
+
+    // The call might be deleted once its response is written, keep the
+    // context alive until all ready responses are written.
+    std::shared_ptr<HTTPContext> context = context_;
+    context->Respond(sequence_, this, std::move(buf));
+}
+
+}  // namespace http
+}  // namespace protocol
+}  // namespace urpc
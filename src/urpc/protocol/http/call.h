@@ -0,0 +1,114 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <google/protobuf/message.h>
+
+#include "urpc/iobuf.h"
+#include "urpc/method_status.h"
+#include "urpc/protocol/base.h"
+#include "urpc/protocol/http/parser.h"
+#include "urpc/server_call.h"
+#include "urpc/service_holder.h"
+
+namespace urpc {
+namespace protocol {
+namespace http {
+
+/// Append a HTTP/1.1 response with `body` to `out`.
+void AppendResponse(int status_code, const std::string& content_type,
+                    bool keep_alive, const IOBuf& body, IOBuf* out);
+
+class HTTPServerCall;
+
+/// The HTTP state of a connection: the parser of the next request, and the
+/// responses waiting for the responses of earlier pipelined requests.
+class HTTPContext final : public ParseContext {
+public:
+    explicit HTTPContext(Transport* transport) : transport_(transport) {}
+    ~HTTPContext() override = default;
+
+    HTTPRequestParser* parser() { return &parser_; }
+
+    /// The sequence of the next parsed request.
+    uint64_t NextSequence() { return next_sequence_++; }
+
+    /// Once a request asks to close the connection, the following requests
+    /// are discarded.
+    bool closing() const { return closing_; }
+    void set_closing() { closing_ = true; }
+
+    /// Write the response of the `sequence`-th request. HTTP/1.1 has no
+    /// request id, so responses are written in the order of requests, a
+    /// response is held until all responses before it are written.
+    void Respond(uint64_t sequence, HTTPServerCall* call, IOBuf buf);
+
+private:
+    void Write(HTTPServerCall* call, IOBuf buf);
+
+    Transport* const transport_;
+    HTTPRequestParser parser_;
+    bool closing_{false};
+    uint64_t next_sequence_{0};
+    uint64_t next_write_{0};
+    std::map<uint64_t, std::pair<HTTPServerCall*, IOBuf>> ready_;
+};
+
+/// Serves a HTTP request. `/<service full name>/<method>` is mapped to the
+/// registered method, the body is JSON unless the content type is protobuf,
+/// and the other GET requests are served by the builtin pages.
+class HTTPServerCall : public ServerCall, public google::protobuf::Closure {
+public:
+    HTTPServerCall(std::shared_ptr<HTTPContext> context, uint64_t sequence,
+                   HTTPRequest request)
+        : context_(std::move(context)),
+          sequence_(sequence),
+          request_(std::move(request)) {}
+    ~HTTPServerCall() override = default;
+
+    int Serve(Transport* trans) override;
+
+    /// Invoked once the service method is done.
+    void Run() override;
+
+    void OnComplete() override;
+
+private:
+    int ServeMethod(MethodProperty* property);
+    void Respond(int status_code, const std::string& content_type,
+                 IOBuf body);
+
+    std::shared_ptr<HTTPContext> context_;
+    const uint64_t sequence_;
+    HTTPRequest request_;
+    Transport* transport_{nullptr};
+    /// Whether the body of request and response is JSON or protobuf.
+    bool json_{true};
+    std::unique_ptr<google::protobuf::Message> request_message_;
+    std::unique_ptr<google::protobuf::Message> response_message_;
+    MethodProperty* property_{nullptr};
+    std::chrono::steady_clock::time_point start_time_;
+};
+
+}  // namespace http
+}  // namespace protocol
+}  // namespace urpc
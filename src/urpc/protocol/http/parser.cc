@@ -0,0 +1,246 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parser.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <gflags/gflags.h>
+
+#include "urpc/base.h"
+
+DEFINE_int64(http_max_body_size, 64 * 1024 * 1024,
+             "The max Content-Length of HTTP requests, the larger ones are "
+             "answered with 413 and the connection is closed");
+
+namespace urpc {
+namespace protocol {
+namespace http {
+
+namespace {
+
+/// Check the method at the front of `buf`, returns ERR_OK if it is supported.
+int CheckMethod(const IOBuf& buf) {
+    char prefix[8];
+    const size_t size = buf.copy_to(prefix, sizeof(prefix));
+    int code = ERR_MISMATCH;
+    for (std::string_view method : kMethods) {
+        if (size >= method.size()) {
+            if (method.compare(0, method.size(), prefix, method.size()) == 0)
+                return ERR_OK;
+        } else if (method.compare(0, size, prefix, size) == 0) {
+            code = ERR_TOO_SMALL;
+        }
+    }
+    return code;
+}
+
+std::string_view Trim(std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+        value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+        value.remove_suffix(1);
+    return value;
+}
+
+bool EqualsIgnoreCase(std::string_view lhs, std::string_view rhs) {
+    return lhs.size() == rhs.size() &&
+           strncasecmp(lhs.data(), rhs.data(), lhs.size()) == 0;
+}
+
+}  // namespace
+
+std::string_view HTTPRequest::path() const {
+    std::string_view path(uri);
+    return path.substr(0, path.find('?'));
+}
+
+int HTTPRequestParser::Parse(IOBuf* buf, HTTPRequest* request) {
+    if (state_ != State::kBody) {
+        if (state_ == State::kMethod && scanned_ == 0) {
+            int code = CheckMethod(*buf);
+            if (code != ERR_OK)
+                return code;
+        }
+
+        int code = ScanHeader(*buf);
+        if (code != ERR_OK)
+            return code;
+        buf->pop_front(scanned_);
+        scanned_ = 0;
+        // The body of a rejected request isn't read.
+        if (request_.reject_status != 0) {
+            content_length_ = 0;
+            request_.keep_alive = false;
+        }
+    }
+
+    if (buf->size() < content_length_)
+        return ERR_TOO_SMALL;
+    buf->cutn(&request_.body, content_length_);
+    *request = std::move(request_);
+    Clear();
+    return ERR_OK;
+}
+
+int HTTPRequestParser::ScanHeader(const IOBuf& buf) {
+    IOBufBytesIterator it(buf);
+    it.forward(scanned_);
+    for (; it; ++it) {
+        if (++scanned_ > kMaxHeaderSize)
+            return ERR_NOT_SUPPORTED;
+
+        const char c = *it;
+        switch (state_) {
+            case State::kMethod:
+                if (c == ' ') {
+                    state_ = State::kUri;
+                } else {
+                    request_.method.push_back(c);
+                }
+                break;
+            case State::kUri:
+                if (c == ' ') {
+                    if (request_.uri.empty())
+                        return ERR_NOT_SUPPORTED;
+                    state_ = State::kVersion;
+                } else if (c == '\r' || c == '\n') {
+                    return ERR_NOT_SUPPORTED;
+                } else {
+                    request_.uri.push_back(c);
+                }
+                break;
+            case State::kVersion:
+                if (c == '\n') {
+                    if (token_ == "HTTP/1.1") {
+                        request_.minor_version = 1;
+                    } else if (token_ == "HTTP/1.0") {
+                        request_.minor_version = 0;
+                    } else {
+                        return ERR_NOT_SUPPORTED;
+                    }
+                    token_.clear();
+                    state_ = State::kHeaderName;
+                } else if (c != '\r') {
+                    token_.push_back(c);
+                }
+                break;
+            case State::kHeaderName:
+                if (c == '\n') {
+                    if (!token_.empty())
+                        return ERR_NOT_SUPPORTED;
+                    // An empty line, the end of headers.
+                    if (!has_connection_)
+                        request_.keep_alive = request_.minor_version == 1;
+                    state_ = State::kBody;
+                    return ERR_OK;
+                } else if (c == ':') {
+                    if (EqualsIgnoreCase(token_, "Connection")) {
+                        header_ = Header::kConnection;
+                    } else if (EqualsIgnoreCase(token_, "Content-Length")) {
+                        header_ = Header::kContentLength;
+                    } else if (EqualsIgnoreCase(token_, "Content-Type")) {
+                        header_ = Header::kContentType;
+                    } else if (EqualsIgnoreCase(token_, "Transfer-Encoding")) {
+                        header_ = Header::kTransferEncoding;
+                    } else {
+                        header_ = Header::kOther;
+                    }
+                    token_.clear();
+                    state_ = State::kHeaderValue;
+                } else if (c != '\r') {
+                    token_.push_back(c);
+                }
+                break;
+            case State::kHeaderValue:
+                if (c == '\n') {
+                    int code = OnHeaderValue();
+                    if (code != ERR_OK)
+                        return code;
+                    token_.clear();
+                    state_ = State::kHeaderName;
+                } else if (c != '\r' && header_ != Header::kOther) {
+                    token_.push_back(c);
+                }
+                break;
+            case State::kBody:
+                break;
+        }
+    }
+    return ERR_TOO_SMALL;
+}
+
+int HTTPRequestParser::OnHeaderValue() {
+    std::string_view value = Trim(token_);
+    switch (header_) {
+        case Header::kConnection:
+            has_connection_ = true;
+            if (EqualsIgnoreCase(value, "close")) {
+                request_.keep_alive = false;
+            } else if (EqualsIgnoreCase(value, "keep-alive")) {
+                request_.keep_alive = true;
+            }
+            break;
+        case Header::kContentLength: {
+            if (request_.reject_status != 0)
+                break;
+            // strtoull() would accept the signs and wrap "-1" around.
+            std::string digits(value);
+            if (digits.empty() ||
+                digits.find_first_not_of("0123456789") != std::string::npos) {
+                request_.reject_status = 400;
+                break;
+            }
+            errno = 0;
+            unsigned long long length = strtoull(digits.c_str(), nullptr, 10);
+            if (errno == ERANGE ||
+                length > static_cast<uint64_t>(FLAGS_http_max_body_size)) {
+                request_.reject_status = 413;
+                break;
+            }
+            content_length_ = length;
+            break;
+        }
+        case Header::kContentType:
+            request_.content_type = value;
+            break;
+        case Header::kTransferEncoding:
+            if (!EqualsIgnoreCase(value, "identity"))
+                return ERR_NOT_SUPPORTED;
+            break;
+        case Header::kOther:
+            break;
+    }
+    return ERR_OK;
+}
+
+void HTTPRequestParser::Clear() {
+    state_ = State::kMethod;
+    scanned_ = 0;
+    header_ = Header::kOther;
+    token_.clear();
+    content_length_ = 0;
+    has_connection_ = false;
+    request_ = HTTPRequest();
+}
+
+}  // namespace http
+}  // namespace protocol
+}  // namespace urpc
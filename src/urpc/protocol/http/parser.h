@@ -0,0 +1,100 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+#include <string_view>
+
+#include "urpc/iobuf.h"
+
+namespace urpc {
+namespace protocol {
+namespace http {
+
+/// The supported request methods, including the following space.
+inline constexpr const char* kMethods[] = {"GET ", "POST "};
+
+/// A parsed HTTP/1.x request. Only the headers the server acts on are kept.
+struct HTTPRequest {
+    std::string method;
+    /// The request target, including the query string.
+    std::string uri;
+    /// 0 for HTTP/1.0 and 1 for HTTP/1.1.
+    int minor_version{1};
+    bool keep_alive{true};
+    std::string content_type;
+    IOBuf body;
+    /// The status answered without serving the request, such as 413 for a
+    /// body over `-http_max_body_size`, 0 if it's valid. The connection is
+    /// closed after the response since the body isn't read.
+    int reject_status{0};
+
+    /// The path of `uri`, without the query string.
+    std::string_view path() const;
+};
+
+/// An incremental HTTP/1.x request parser. The header is scanned in place
+/// over the IOBuf, bytes already scanned are not visited again when more
+/// payload arrives, and only the values of the interesting headers are copied
+/// out. Chunked request bodies aren't supported.
+class HTTPRequestParser {
+public:
+    /// The limit of the request line and headers.
+    static constexpr size_t kMaxHeaderSize = 64 * 1024;
+
+    /// Parse a request from the front of `buf`. Returns ERR_OK and cuts the
+    /// request out of `buf` once it is complete, ERR_TOO_SMALL if more
+    /// payload is required, ERR_MISMATCH if `buf` doesn't start with a
+    /// supported method, or ERR_NOT_SUPPORTED if the request is malformed.
+    int Parse(IOBuf* buf, HTTPRequest* request);
+
+private:
+    enum class State {
+        kMethod,
+        kUri,
+        kVersion,
+        kHeaderName,
+        kHeaderValue,
+        kBody,
+    };
+
+    /// The headers whose value is kept.
+    enum class Header {
+        kOther,
+        kConnection,
+        kContentLength,
+        kContentType,
+        kTransferEncoding,
+    };
+
+    int ScanHeader(const IOBuf& buf);
+    int OnHeaderValue();
+    void Clear();
+
+    State state_{State::kMethod};
+    /// The bytes of `buf` scanned by previous calls.
+    size_t scanned_{0};
+    Header header_{Header::kOther};
+    /// The header name or value being scanned.
+    std::string token_;
+    size_t content_length_{0};
+    bool has_connection_{false};
+    HTTPRequest request_;
+};
+
+}  // namespace http
+}  // namespace protocol
+}  // namespace urpc
@@ -0,0 +1,68 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "protocol.h"
+
+#include <memory>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "urpc/protocol/http/call.h"
+#include "urpc/server_transport.h"
+
+namespace urpc {
+namespace protocol {
+namespace http {
+
+int HTTPProtocol::ParseRequest(IOBuf* buf, ServerTransport* transport,
+                               ServerCall** server_call) {
+    // The transport drops the context once another protocol is probed, so
+    // a non-null context always belongs to HTTP.
+    auto context =
+        std::static_pointer_cast<HTTPContext>(transport->parse_context());
+    if (!context) {
+        context = std::make_shared<HTTPContext>(transport);
+        transport->set_parse_context(context);
+    }
+
+    if (context->closing()) {
+        // The connection will be closed once the pending responses are
+        // written, the following requests are ignored.
+        buf->clear();
+        return ERR_TOO_SMALL;
+    }
+
+    HTTPRequest request;
+    int code = context->parser()->Parse(buf, &request);
+    if (code != ERR_OK) {
+        if (code == ERR_NOT_SUPPORTED)
+            LOG(INFO) << "Invalid HTTP request";
+        return code;
+    }
+
+    if (!request.keep_alive)
+        context->set_closing();
+    *server_call = new HTTPServerCall(context, context->NextSequence(),
+                                      std::move(request));
+    return ERR_OK;
+}
+
+int HTTPProtocol::ParseResponse(IOBuf* buf, ClientTransport* transport) {
+    return ERR_NOT_SUPPORTED;
+}
+
+}  // namespace http
+}  // namespace protocol
+}  // namespace urpc
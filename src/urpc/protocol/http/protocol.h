@@ -0,0 +1,46 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include "urpc/protocol/base.h"
+#include "urpc/protocol/http/parser.h"
+
+namespace urpc {
+namespace protocol {
+namespace http {
+
+/// HTTP/1.1 server protocol, which serves the registered methods with JSON or
+/// protobuf bodies and the builtin pages on the same port as the RPC services.
+/// Requests on a connection could be pipelined and the connection is kept
+/// alive unless the client asks to close it.
+class HTTPProtocol final : public BaseProtocol {
+public:
+    ~HTTPProtocol() override = default;
+
+    /// A constant bytes which always appears in the header of network message
+    /// packets. The other methods are registered as extra magics.
+    const char* Header() const override { return kMethods[0]; }
+
+    /// Parse the protocol request. If the payload isn't enough, ERR_TOO_SMALL
+    /// is returned. If the header is mismatched, ERR_MISMATCH is returned.
+    int ParseRequest(IOBuf* buf, ServerTransport* transport,
+                     ServerCall** server_call) override;
+
+    /// HTTP client isn't supported, ERR_NOT_SUPPORTED is always returned.
+    int ParseResponse(IOBuf* buf, ClientTransport* transport) override;
+};
+
+}  // namespace http
+}  // namespace protocol
+}  // namespace urpc
@@ -14,21 +14,34 @@
 
 #include "manager.h"
 
+#include <assert.h>
+#include <string.h>
+
 #include <mutex>
 
 #include <glog/logging.h>
 
 #include "urpc/protocol.h"
+#include "urpc/protocol/h2/protocol.h"
+#include "urpc/protocol/http/protocol.h"
+#include "urpc/protocol/redis/protocol.h"
 
 namespace urpc {
 namespace protocol {
 namespace internal {
 
 static urpc::URPCProtocol urpc_protocol;
+static http::HTTPProtocol http_protocol;
+static h2::H2Protocol h2_protocol;
+static redis::RedisProtocol redis_protocol;
 static std::once_flag flag;
 
 static void RegisterAllProtocols(ProtocolManager* manager) {
     manager->Register(&urpc_protocol);
+    for (const char* method : http::kMethods)
+        manager->Register(&http_protocol, method);
+    manager->Register(&h2_protocol);
+    manager->Register(&redis_protocol);
 }
 
 }  // namespace internal
@@ -42,26 +55,65 @@ ProtocolManager* ProtocolManager::singleton() {
 ProtocolManager::ProtocolManager() {}
 
 bool ProtocolManager::Register(BaseProtocol* protocol) {
-    assert(strlen(protocol->Header()) == 4);
-    LOG(INFO) << "Register new protocol " << protocol->Header();
-    return protocols_.insert_or_assign(protocol->Header(), protocol).second;
+    return Register(protocol, protocol->Header());
 }
 
-BaseProtocol* ProtocolManager::ProbeProtocol(const IOBuf& buf) {
-    if (buf.size() < 4) {
-        return nullptr;
+bool ProtocolManager::Register(BaseProtocol* protocol, const char* magic) {
+    const size_t size = strlen(magic);
+    assert(size > 0 && size <= kMaxMagicSize);
+    LOG(INFO) << "Register new protocol " << protocol->Header() << " magic "
+              << magic;
+
+    auto& entries = entries_[static_cast<uint8_t>(magic[0])];
+    for (auto&& entry : entries) {
+        if (entry.magic == magic) {
+            entry.protocol = protocol;
+            return false;
+        }
     }
+    auto it = entries.begin();
+    while (it != entries.end() && it->magic.size() >= size)
+        ++it;
+    entries.insert(it, Entry{magic, protocol});
+    return true;
+}
 
-    std::string header;
-    buf.append_to(&header, 4);
-    LOG(INFO) << "ProbeProtocol header is " << header;
-
-    auto it = protocols_.find(header);
-    if (it == protocols_.end()) {
-        return nullptr;
+BaseProtocol* ProtocolManager::FindProtocol(const char* header) {
+    for (auto&& entry : entries_[static_cast<uint8_t>(header[0])]) {
+        if (entry.magic == header)
+            return entry.protocol;
     }
+    return nullptr;
+}
 
-    return it->second;
+int ProtocolManager::ProbeProtocol(const IOBuf& buf, BaseProtocol** protocol) {
+    char prefix[kMaxMagicSize];
+    const size_t size = buf.copy_to(prefix, sizeof(prefix));
+    if (size == 0)
+        return ERR_TOO_SMALL;
+
+    int code = ERR_MISMATCH;
+    for (auto&& entry : entries_[static_cast<uint8_t>(prefix[0])]) {
+        const size_t magic_size = entry.magic.size();
+        if (size < magic_size) {
+            // The longer magics come first, a shorter one matched meanwhile
+            // might be a part of it.
+            if (memcmp(prefix, entry.magic.data(), size) == 0)
+                return ERR_TOO_SMALL;
+            continue;
+        }
+        if (memcmp(prefix, entry.magic.data(), magic_size) != 0)
+            continue;
+
+        int res = entry.protocol->Probe(buf);
+        if (res == ERR_OK) {
+            *protocol = entry.protocol;
+            return ERR_OK;
+        } else if (res == ERR_TOO_SMALL) {
+            code = ERR_TOO_SMALL;
+        }
+    }
+    return code;
 }
 
 }  // namespace protocol
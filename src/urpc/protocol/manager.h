@@ -11,11 +11,13 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
-
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <string>
-#include <unordered_map>
+#include <vector>
 
 #include "base.h"
 
@@ -24,23 +26,42 @@ namespace protocol {
 
 class ProtocolManager {
 public:
+    /// The limit of the length of magics.
+    static constexpr size_t kMaxMagicSize = 32;
+
     static ProtocolManager* singleton();
 
     /// Register or update a protocol by the corresponding protocol header.
     bool Register(BaseProtocol* protocol);
 
+    /// Register or update a protocol by a magic, which are the leading bytes
+    /// of the messages of the protocol. A protocol could be registered with
+    /// several magics, such as the methods of HTTP.
+    bool Register(BaseProtocol* protocol, const char* magic);
+
     /// Find the corresponding protocol by the specified header. `nullptr` is
     /// returned if no such protocol exists.
     BaseProtocol* FindProtocol(const char* header);
 
-    /// Probe the corresponding protocol of the buf, `nullptr` is returned if no
-    /// such protocol exists.
-    BaseProtocol* ProbeProtocol(const IOBuf& buf);
+    /// Probe the corresponding protocol of the buf. ERR_TOO_SMALL is returned
+    /// if `buf` is a prefix of some magics or the protocol asks for more
+    /// bytes, ERR_MISMATCH is returned if no such protocol exists.
+    ///
+    /// Magics are matched longest first, then the `Probe()` of the protocol
+    /// confirms it. Probing doesn't allocate.
+    int ProbeProtocol(const IOBuf& buf, BaseProtocol** protocol);
 
 private:
+    struct Entry {
+        std::string magic;
+        BaseProtocol* protocol;
+    };
+
     ProtocolManager();
 
-    std::unordered_map<std::string, BaseProtocol*> protocols_;
+    /// The entries indexed by the first byte of magics, each list is ordered
+    /// by the length of magics in descending order.
+    std::vector<Entry> entries_[256];
 };
 
 }  // namespace protocol
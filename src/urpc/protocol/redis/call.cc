@@ -0,0 +1,59 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "call.h"
+
+#include <urpc/redis.h>
+
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "urpc/iobuf.h"
+#include "urpc/service_holder.h"
+#include "urpc/transport.h"
+
+namespace urpc {
+namespace protocol {
+namespace redis {
+
+int RedisServerCall::Serve(Transport* trans) {
+    RedisService* service = ServiceHolder::singleton()->redis_service();
+    IOBuf buf;
+    RedisReply reply(&buf);
+    for (auto&& args : commands_) {
+        const RedisCommandHandler* handler =
+            service ? service->FindCommandHandler(args[0]) : nullptr;
+        if (!handler) {
+            reply.AppendError("ERR unknown command '" + args[0] + "'");
+            continue;
+        }
+
+        const size_t size = buf.size();
+        (*handler)(args, &reply);
+        if (buf.size() == size) {
+            LOG(ERROR) << "Redis command " << args[0] << " doesn't reply";
+            reply.AppendError("ERR no reply");
+        }
+    }
+    commands_.clear();
+
+    LOG(INFO) << "RedisServerCall::Serve write " << buf.size() << " bytes";
+    trans->StartWrite(this, std::move(buf));
+    return 0;
+}
+
+}  // namespace redis
+}  // namespace protocol
+}  // namespace urpc
@@ -0,0 +1,60 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "urpc/protocol/base.h"
+#include "urpc/protocol/redis/parser.h"
+#include "urpc/server_call.h"
+
+namespace urpc {
+namespace protocol {
+namespace redis {
+
+/// The redis state of a connection, the parser of the next command.
+class RedisContext final : public ParseContext {
+public:
+    ~RedisContext() override = default;
+
+    RedisCommandParser* parser() { return &parser_; }
+
+private:
+    RedisCommandParser parser_;
+};
+
+/// Serves the pipelined commands parsed from the read buffer at once, the
+/// replies are written in a single IOBuf in the order of commands.
+class RedisServerCall : public ServerCall {
+public:
+    /// The limit of the commands served by a call, which bounds the replies
+    /// held in memory.
+    static constexpr size_t kMaxBatchSize = 1024;
+
+    explicit RedisServerCall(std::vector<std::vector<std::string>> commands)
+        : commands_(std::move(commands)) {}
+    ~RedisServerCall() override = default;
+
+    int Serve(Transport* trans) override;
+
+private:
+    std::vector<std::vector<std::string>> commands_;
+};
+
+}  // namespace redis
+}  // namespace protocol
+}  // namespace urpc
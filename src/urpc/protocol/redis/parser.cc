@@ -0,0 +1,113 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parser.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "urpc/base.h"
+
+namespace urpc {
+namespace protocol {
+namespace redis {
+
+namespace {
+
+/// The longest length line, the type, 19 digits and CRLF.
+constexpr size_t kMaxLengthLineSize = 22;
+
+}  // namespace
+
+int RedisCommandParser::ParseLength(const IOBuf& buf, char type,
+                                    int64_t* length, size_t* line_size) {
+    char line[kMaxLengthLineSize];
+    const size_t size = buf.copy_to(line, sizeof(line));
+    if (size == 0)
+        return ERR_TOO_SMALL;
+    if (line[0] != type)
+        return ERR_NOT_SUPPORTED;
+
+    int64_t value = 0;
+    size_t i = 1;
+    for (; i < size && line[i] >= '0' && line[i] <= '9'; ++i) {
+        value = value * 10 + (line[i] - '0');
+        // Both limits are far from overflowing.
+        if (value > std::max(kMaxArgs, kMaxBulkSize))
+            return ERR_NOT_SUPPORTED;
+    }
+    if (i + 2 > size)
+        return size < sizeof(line) ? ERR_TOO_SMALL : ERR_NOT_SUPPORTED;
+    if (i == 1 || line[i] != '\r' || line[i + 1] != '\n')
+        return ERR_NOT_SUPPORTED;
+
+    *length = value;
+    *line_size = i + 2;
+    return ERR_OK;
+}
+
+int RedisCommandParser::Parse(IOBuf* buf, std::vector<std::string>* args) {
+    int64_t length = 0;
+    size_t line_size = 0;
+    while (remaining_ < 0) {
+        char type;
+        if (buf->copy_to(&type, 1) < 1)
+            return ERR_TOO_SMALL;
+        if (type != '*')
+            return ERR_MISMATCH;
+        int code = ParseLength(*buf, '*', &length, &line_size);
+        if (code != ERR_OK)
+            return code;
+        if (length > kMaxArgs)
+            return ERR_NOT_SUPPORTED;
+        buf->pop_front(line_size);
+        // Empty arrays are skipped as redis does.
+        if (length == 0)
+            continue;
+        remaining_ = length;
+        args_.clear();
+        args_.reserve(std::min<int64_t>(length, 16));
+    }
+
+    while (remaining_ > 0) {
+        int code = ParseLength(*buf, '$', &length, &line_size);
+        if (code != ERR_OK)
+            return code;
+        if (length > kMaxBulkSize)
+            return ERR_NOT_SUPPORTED;
+        if (buf->size() < line_size + length + 2)
+            return ERR_TOO_SMALL;
+
+        buf->pop_front(line_size);
+        std::string arg;
+        buf->cutn(&arg, length);
+        char crlf[2];
+        buf->cutn(crlf, sizeof(crlf));
+        if (memcmp(crlf, "\r\n", 2) != 0)
+            return ERR_NOT_SUPPORTED;
+        args_.push_back(std::move(arg));
+        --remaining_;
+    }
+
+    remaining_ = -1;
+    args->swap(args_);
+    args_.clear();
+    return ERR_OK;
+}
+
+}  // namespace redis
+}  // namespace protocol
+}  // namespace urpc
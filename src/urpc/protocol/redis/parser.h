@@ -0,0 +1,58 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "urpc/iobuf.h"
+
+namespace urpc {
+namespace protocol {
+namespace redis {
+
+/// An incremental parser of RESP commands, arrays of bulk strings as sent by
+/// redis clients. Each element is cut from the buffer once it is complete,
+/// so a command split across many reads is still scanned only once.
+/// Inline commands aren't supported.
+class RedisCommandParser {
+public:
+    /// The limits of the elements of a command and of a bulk string, the
+    /// same as the defaults of redis.
+    static constexpr int64_t kMaxArgs = 1024 * 1024;
+    static constexpr int64_t kMaxBulkSize = 512 * 1024 * 1024;
+
+    /// Parse a command from the front of `buf`. Returns ERR_OK with the
+    /// arguments once the command is complete, ERR_TOO_SMALL if more payload
+    /// is required, ERR_MISMATCH if `buf` doesn't start with an array, or
+    /// ERR_NOT_SUPPORTED if the command is malformed.
+    int Parse(IOBuf* buf, std::vector<std::string>* args);
+
+private:
+    /// Parse the length line "<type><integer>\r\n" at the front of `buf`.
+    int ParseLength(const IOBuf& buf, char type, int64_t* length,
+                    size_t* line_size);
+
+    /// The elements left in the current command, -1 if the array header
+    /// isn't parsed yet.
+    int64_t remaining_{-1};
+    std::vector<std::string> args_;
+};
+
+}  // namespace redis
+}  // namespace protocol
+}  // namespace urpc
@@ -0,0 +1,76 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "protocol.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "urpc/protocol/redis/call.h"
+#include "urpc/server_transport.h"
+
+namespace urpc {
+namespace protocol {
+namespace redis {
+
+int RedisProtocol::Probe(const IOBuf& buf) const {
+    char data[2];
+    if (buf.copy_to(data, sizeof(data)) < sizeof(data))
+        return ERR_TOO_SMALL;
+    return data[1] >= '0' && data[1] <= '9' ? ERR_OK : ERR_MISMATCH;
+}
+
+int RedisProtocol::ParseRequest(IOBuf* buf, ServerTransport* transport,
+                                ServerCall** server_call) {
+    // The transport drops the context once another protocol is probed, so
+    // a non-null context always belongs to redis.
+    auto context =
+        std::static_pointer_cast<RedisContext>(transport->parse_context());
+    if (!context) {
+        context = std::make_shared<RedisContext>();
+        transport->set_parse_context(context);
+    }
+
+    // Take all complete commands, an error after them is reported by the
+    // next parsing once their replies are queued.
+    std::vector<std::vector<std::string>> commands;
+    int code = ERR_OK;
+    while (commands.size() < RedisServerCall::kMaxBatchSize) {
+        std::vector<std::string> args;
+        code = context->parser()->Parse(buf, &args);
+        if (code != ERR_OK)
+            break;
+        commands.push_back(std::move(args));
+    }
+    if (commands.empty()) {
+        if (code == ERR_NOT_SUPPORTED)
+            LOG(INFO) << "Invalid redis command";
+        return code;
+    }
+
+    *server_call = new RedisServerCall(std::move(commands));
+    return ERR_OK;
+}
+
+int RedisProtocol::ParseResponse(IOBuf* buf, ClientTransport* transport) {
+    return ERR_NOT_SUPPORTED;
+}
+
+}  // namespace redis
+}  // namespace protocol
+}  // namespace urpc
@@ -0,0 +1,47 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include "urpc/protocol/base.h"
+
+namespace urpc {
+namespace protocol {
+namespace redis {
+
+/// Redis server protocol (RESP), which serves the commands of the redis
+/// service on the same port as the RPC services. Pipelined commands are
+/// served in batches, one write for all commands parsed from a read.
+class RedisProtocol final : public BaseProtocol {
+public:
+    ~RedisProtocol() override = default;
+
+    /// Commands are arrays of bulk strings.
+    const char* Header() const override { return "*"; }
+
+    /// The array length must follow the type, which tells commands from
+    /// other payloads starting with '*'.
+    int Probe(const IOBuf& buf) const override;
+
+    /// Parse the protocol request. If the payload isn't enough, ERR_TOO_SMALL
+    /// is returned. If the header is mismatched, ERR_MISMATCH is returned.
+    int ParseRequest(IOBuf* buf, ServerTransport* transport,
+                     ServerCall** server_call) override;
+
+    /// Redis client isn't supported, ERR_NOT_SUPPORTED is always returned.
+    int ParseResponse(IOBuf* buf, ClientTransport* transport) override;
+};
+
+}  // namespace redis
+}  // namespace protocol
+}  // namespace urpc
@@ -14,6 +14,8 @@
 
 #include "call.h"
 
+#include <chrono>
+
 #include <glog/logging.h>
 #include <google/protobuf/message.h>
 #include <google/protobuf/service.h>
@@ -23,7 +25,9 @@
 
 #include "urpc/client_transport.h"
 #include "urpc/coding.h"
+#include "urpc/compress.h"
 #include "urpc/iobuf.h"
+#include "urpc/protocol/urpc/stream.h"
 #include "urpc/service_holder.h"
 #include "urpc_meta.pb.h"
 
@@ -33,6 +37,22 @@ namespace urpc {
 namespace protocol {
 namespace urpc {
 
+void AppendMessage(const RPCMeta& meta, IOBuf body, IOBuf* out) {
+    out->append("URPC");
+
+    uint8_t dst[4];
+    EncodeFixed32(dst, meta.ByteSizeLong());
+    out->append(dst, 4);
+    EncodeFixed32(dst, body.size());
+    out->append(dst, 4);
+
+    {
+        IOBufAsZeroCopyOutputStream stream(out);
+        meta.SerializeToZeroCopyStream(&stream);
+    }
+    out->append(std::move(body));
+}
+
 void URPCClientCall::OnComplete() { LOG(FATAL) << "Not implemented"; }
 
 void URPCClientCall::IssueRPC(ClientTransport* transport,
@@ -44,41 +64,69 @@ void URPCClientCall::IssueRPC(ClientTransport* transport,
     response_ = response;
     done_ = done;
 
-    uint64_t request_id = transport_->NextRequestId();
+    // Fail fast instead of queueing more behind a slow server.
+    if (transport->overloaded()) {
+        transport->OnWriteRejected();
+        SetFailed(ERR_OVERLOADED, "The connection is overloaded");
+        if (stream_) {
+            stream_->OnResponse(nullptr);
+            stream_ = nullptr;
+        }
+        done_->Run();
+        return;
+    }
+
+    uint64_t request_id = ClientTransport::NextRequestId();
 
     RPCMeta rpc_meta;
     auto* req = rpc_meta.mutable_request();
     req->set_service_name(method->service()->full_name());
     req->set_method_name(method->name());
     req->set_log_id(0);
+    req->set_response_compress_type(response_compress_type());
     rpc_meta.set_attachment_size(0);
     rpc_meta.set_correlation_id(request_id);
 
-    IOBuf buf;
-    buf.append("URPC");
-
-    uint8_t dst[4];
-    const size_t meta_size = rpc_meta.ByteSizeLong();
-    EncodeFixed32(dst, meta_size);
-    buf.append(dst, 4);
+    IOBuf body;
+    {
+        IOBufAsZeroCopyOutputStream out(&body);
+        request->SerializeToZeroCopyStream(&out);
+    }
+    if (ShouldCompress(request_compress_type(), body.size())) {
+        IOBuf compressed;
+        if (Compress(request_compress_type(), body, &compressed) == ERR_OK) {
+            req->set_compress_type(request_compress_type());
+            body.swap(compressed);
+        }
+    }
 
-    const size_t body_size = request->ByteSizeLong();
-    EncodeFixed32(dst, body_size);
-    buf.append(dst, 4);
+    if (stream_) {
+        // The stream is bound to the transport of the request.
+        DisableResend();
+        // Chunks of the server might arrive before the response.
+        stream_->Bind(transport, request_id);
+        transport->AddStream(request_id, stream_);
+        stream_->FillSettings(rpc_meta.mutable_stream_settings());
+    }
 
-    IOBufAsZeroCopyOutputStream out(&buf);
-    rpc_meta.SerializeToZeroCopyStream(&out);
-    LOG(INFO) << "RPC Meta len " << out.ByteCount();
-    request->SerializeToZeroCopyStream(&out);
-    LOG(INFO) << "RPC Meta + Request len " << out.ByteCount();
+    IOBuf buf;
+    AppendMessage(rpc_meta, std::move(body), &buf);
 
     LOG(INFO) << "URPCClientCall::IssueRPC buf len is " << buf.size();
 
-    transport_->InstallClientCall(request_id, this);
-    transport->StartWrite(this, std::move(buf));
+    StartRequest(transport, request_id, std::move(buf));
 }
 
 int URPCClientCall::ProcessResponse(const IOBuf& response) {
+    // The protocol fails the call on errors of the server, decompression or
+    // the connection.
+    if (RetryIfFailed())
+        return 0;
+    if (Failed()) {
+        done_->Run();
+        return 0;
+    }
+
     IOBufAsZeroCopyInputStream in(response);
     if (!response_->ParseFromZeroCopyStream(&in)) {
         // TODO(walter) report error.
@@ -89,40 +137,102 @@ int URPCClientCall::ProcessResponse(const IOBuf& response) {
     return 0;
 }
 
+URPCStream* URPCServerCall::AcceptStream(const StreamOptions& options) {
+    if (stream_settings_.stream_id() == 0 || stream_)
+        return nullptr;
+
+    const uint64_t id = stream_settings_.stream_id();
+    stream_ = new URPCStream(options, true);
+    stream_->Bind(transport_, id);
+    stream_->Accept(stream_settings_);
+    transport_->AddStream(id, stream_);
+    return stream_;
+}
+
 int URPCServerCall::Serve(Transport* trans) {
     transport_ = trans;
+    start_time_ = std::chrono::steady_clock::now();
     Service* service = ServiceHolder::singleton()->FindService(service_name_);
-    const MethodDescriptor* method =
-        service->GetDescriptor()->FindMethodByName(method_name_);
-    Message* request = service->GetRequestPrototype(method).New();
-    response_ = service->GetResponsePrototype(method).New();
+    MethodProperty* property =
+        ServiceHolder::singleton()->FindMethodProperty(service_name_,
+                                                       method_name_);
+    const MethodDescriptor* method = property->method;
+    if (!ServiceHolder::singleton()->OnRequested(property)) {
+        // Rejected before the request is decompressed or parsed.
+        SetFailed(ERR_LIMITED, "Reached the max concurrency");
+        Run();
+        return 0;
+    }
+    property_ = property;
+    request_.reset(service->GetRequestPrototype(method).New());
+    response_.reset(service->GetResponsePrototype(method).New());
+    if (compress_type_ != COMPRESS_NONE) {
+        IOBuf decompressed;
+        if (Decompress(compress_type_, buf_, &decompressed) != ERR_OK) {
+            SetFailed(ERR_COMPRESS, "Failed to decompress the request");
+            Run();
+            return 0;
+        }
+        buf_.swap(decompressed);
+    }
     IOBufAsZeroCopyInputStream in(buf_);
-    request->ParseFromZeroCopyStream(&in);
-    service->CallMethod(method, this, request, response_, this);
+    request_->ParseFromZeroCopyStream(&in);
+    service->CallMethod(method, this, request_.get(), response_.get(), this);
     return 0;
 }
 
 void URPCServerCall::Run() {
     RPCMeta rpc_meta;
     auto* resp = rpc_meta.mutable_response();
-    resp->set_error_code(0);
+    resp->set_error_code(ErrorCode());
+    if (Failed())
+        resp->set_error_text(ErrorText());
+    if (transport_->draining())
+        resp->set_draining(true);
     rpc_meta.set_attachment_size(0);
     rpc_meta.set_correlation_id(request_id_);
 
-    const size_t payload_size =
-        rpc_meta.ByteSizeLong() + response_->ByteSizeLong();
-    IOBuf buf;
-    buf.append("URPC");
+    IOBuf body;
+    if (!Failed()) {
+        {
+            IOBufAsZeroCopyOutputStream out(&body);
+            response_->SerializeToZeroCopyStream(&out);
+        }
+        if (ShouldCompress(response_compress_type(), body.size())) {
+            IOBuf compressed;
+            if (Compress(response_compress_type(), body, &compressed) ==
+                ERR_OK) {
+                resp->set_compress_type(response_compress_type());
+                body.swap(compressed);
+            }
+        }
+    }
 
-    uint8_t dst[4];
-    EncodeFixed32(dst, payload_size);
-    buf.append(dst, 4);
-    IOBufAsZeroCopyOutputStream out(&buf);
-    rpc_meta.SerializeToZeroCopyStream(&out);
-    response_->SerializeToZeroCopyStream(&out);
+    if (stream_) {
+        // The stream is closed if the method fails.
+        if (!Failed())
+            stream_->FillSettings(rpc_meta.mutable_stream_settings());
+        stream_->OnResponse(Failed() ? nullptr : &stream_settings_);
+        stream_ = nullptr;
+    }
+
+    IOBuf buf;
+    AppendMessage(rpc_meta, std::move(body), &buf);
 
     LOG(INFO) << "URPCServerCall::Run buf len is " << buf.size();
 
+    if (property_) {
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_time_);
+        ServiceHolder::singleton()->OnResponded(property_, !Failed(),
+                                                latency.count());
+    }
+
+    if (transport_->fd() < 0) {
+        // The peer closed the connection before the response is ready.
+        OnComplete();
+        return;
+    }
     transport_->StartWrite(this, std::move(buf));
 }
 
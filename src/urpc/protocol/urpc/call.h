@@ -13,6 +13,8 @@
 // limitations under the License.
 #pragma once
 
+#include <chrono>
+#include <memory>
 #include <string>
 #include <utility>
 
@@ -22,9 +24,18 @@
 #include "urpc/server_call.h"
 
 namespace urpc {
+
+struct MethodProperty;
+struct StreamOptions;
+
 namespace protocol {
 namespace urpc {
 
+class URPCStream;
+
+/// Append a message of the protocol: the header, `meta` and `body`.
+void AppendMessage(const RPCMeta& meta, IOBuf body, IOBuf* out);
+
 class URPCClientCall : public ClientCall {
 public:
     ~URPCClientCall() override = default;
@@ -35,12 +46,17 @@ public:
                   google::protobuf::Message* response,
                   google::protobuf::Closure* done) override;
 
+    /// The stream created for the RPC, nullptr if none.
+    URPCStream* stream() const { return stream_; }
+    void set_stream(URPCStream* stream) { stream_ = stream; }
+
 protected:
     void OnComplete() override;
     int ProcessResponse(const IOBuf& response) override;
 
 private:
     ClientTransport* transport_ = nullptr;
+    URPCStream* stream_{nullptr};
     google::protobuf::Message* response_ = nullptr;
     google::protobuf::Closure* done_ = nullptr;
 };
@@ -48,23 +64,41 @@ private:
 class URPCServerCall : public ServerCall, public google::protobuf::Closure {
 public:
     URPCServerCall(uint64_t request_id, std::string service_name,
-                   std::string method_name, IOBuf buf)
+                   std::string method_name, CompressType compress_type,
+                   IOBuf buf)
         : request_id_(request_id),
           buf_(std::move(buf)),
           service_name_(std::move(service_name)),
-          method_name_(std::move(method_name)) {}
+          method_name_(std::move(method_name)),
+          compress_type_(compress_type) {}
     ~URPCServerCall() override = default;
 
     int Serve(Transport* trans) override;
     void Run() override;
 
+    /// The stream settings of the client, if it created a stream.
+    void set_stream_settings(const StreamSettings& settings) {
+        stream_settings_ = settings;
+    }
+
+    /// Accept the stream created by the client, nullptr if there is none or
+    /// it's accepted already.
+    URPCStream* AcceptStream(const StreamOptions& options);
+
 private:
     const uint64_t request_id_;
     const std::string service_name_;
     const std::string method_name_;
+    /// The compression of `buf_`.
+    const CompressType compress_type_;
     Transport* transport_;
-    google::protobuf::Message* response_;
+    std::unique_ptr<google::protobuf::Message> request_;
+    std::unique_ptr<google::protobuf::Message> response_;
     IOBuf buf_;
+    MethodProperty* property_{nullptr};
+    std::chrono::steady_clock::time_point start_time_;
+    StreamSettings stream_settings_;
+    URPCStream* stream_{nullptr};
 };
 
 }  // namespace urpc
@@ -25,23 +25,30 @@
 
 #include "urpc/client_transport.h"
 #include "urpc/coding.h"
+#include "urpc/compress.h"
 #include "urpc/protocol/base.h"
 #include "urpc/protocol/manager.h"
 #include "urpc/protocol/urpc/call.h"
+#include "urpc/protocol/urpc/stream.h"
+#include "urpc/server_transport.h"
 #include "urpc_meta.pb.h"
 
 namespace urpc {
 namespace protocol {
 namespace urpc {
 
-int URPCProtocol::ParseRequest(IOBuf* buf, ServerCall** server_call) {
+namespace {
+
+/// Cut a message from `buf`, ERR_TOO_SMALL is returned if it's incomplete.
+int ParseMessage(const std::string& magic, IOBuf* buf, RPCMeta* rpc_meta,
+                 IOBuf* payload) {
     std::string header;
     if (buf->append_to(&header, 4) < 4) {
         return ERR_TOO_SMALL;
     }
 
-    LOG(INFO) << "ParseRequest header is " << header;
-    if (header != Header()) {
+    LOG(INFO) << "ParseMessage header is " << header;
+    if (header != magic) {
         return ERR_MISMATCH;
     }
 
@@ -64,60 +71,117 @@ int URPCProtocol::ParseRequest(IOBuf* buf, ServerCall** server_call) {
         return ERR_TOO_SMALL;
     }
 
-    IOBuf meta_data, payload;
+    IOBuf meta_data;
     buf->pop_front(12);
     buf->cutn(&meta_data, meta_size);
-    buf->cutn(&payload, body_size);
+    buf->cutn(payload, body_size);
 
     IOBufAsZeroCopyInputStream in(meta_data);
-    RPCMeta rpc_meta;
-    rpc_meta.ParsePartialFromZeroCopyStream(&in);
-    auto request_id = rpc_meta.correlation_id();
-    LOG(INFO) << "Receive RPC with request id " << request_id;
-    *server_call = new URPCServerCall(
-        request_id, rpc_meta.request().service_name(),
-        rpc_meta.request().method_name(), std::move(payload));
+    rpc_meta->ParsePartialFromZeroCopyStream(&in);
     return ERR_OK;
 }
 
-int URPCProtocol::ParseResponse(IOBuf* buf, ClientTransport* transport) {
-    std::string header;
-    if (buf->append_to(&header, 4) < 4) {
-        return ERR_TOO_SMALL;
+/// Dispatch a frame to its stream, the frames of closed streams are dropped.
+void DispatchFrame(Transport* transport, const StreamFrame& frame,
+                   IOBuf payload) {
+    auto stream = transport->FindStream(frame.stream_id());
+    if (!stream) {
+        LOG(INFO) << "stream " << frame.stream_id() << " not found";
+        return;
     }
+    static_cast<URPCStream*>(stream)->OnFrame(frame, std::move(payload));
+}
 
-    LOG(INFO) << "ParseRequest header is " << header;
-    if (header != Header()) {
-        return ERR_MISMATCH;
+}  // namespace
+
+int URPCProtocol::ParseRequest(IOBuf* buf, ServerTransport* transport,
+                               ServerCall** server_call) {
+    RPCMeta rpc_meta;
+    IOBuf payload;
+    while (true) {
+        int code = ParseMessage(Header(), buf, &rpc_meta, &payload);
+        if (code != ERR_OK)
+            return code;
+        if (!rpc_meta.has_stream_frame())
+            break;
+
+        // Frames aren't served as calls.
+        DispatchFrame(transport, rpc_meta.stream_frame(), std::move(payload));
+        if (buf->empty())
+            return ERR_TOO_SMALL;
+        rpc_meta.Clear();
+        payload.clear();
     }
 
-    std::vector<uint8_t> len_buf(4, 0);
-    if (buf->copy_to(len_buf.data(), 4, 4) < 4) {
-        return ERR_TOO_SMALL;
+    auto request_id = rpc_meta.correlation_id();
+    LOG(INFO) << "Receive RPC with request id " << request_id;
+    const auto& request_meta = rpc_meta.request();
+    if (!IsValidCompressType(request_meta.compress_type()) ||
+        !IsValidCompressType(request_meta.response_compress_type())) {
+        LOG(INFO) << "Unknown compress type of request " << request_id;
+        return ERR_NOT_SUPPORTED;
     }
+    auto call = new URPCServerCall(
+        request_id, request_meta.service_name(), request_meta.method_name(),
+        static_cast<CompressType>(request_meta.compress_type()),
+        std::move(payload));
+    call->set_response_compress_type(
+        static_cast<CompressType>(request_meta.response_compress_type()));
+    if (rpc_meta.has_stream_settings())
+        call->set_stream_settings(rpc_meta.stream_settings());
+    *server_call = call;
+    return ERR_OK;
+}
 
-    uint32_t length = DecodeFixed32(len_buf.data());
-    if (buf->size() < 8 + length) {
-        return ERR_TOO_SMALL;
+int URPCProtocol::ParseResponse(IOBuf* buf, ClientTransport* transport) {
+    RPCMeta rpc_meta;
+    IOBuf payload;
+    int code = ParseMessage(Header(), buf, &rpc_meta, &payload);
+    if (code != ERR_OK)
+        return code;
+
+    if (rpc_meta.has_stream_frame()) {
+        DispatchFrame(transport, rpc_meta.stream_frame(), std::move(payload));
+        return ERR_OK;
     }
 
-    IOBuf data;
-    buf->pop_front(8);
-    buf->cutn(&data, length);
+    if (rpc_meta.response().draining())
+        transport->OnDraining();
 
-    IOBufAsZeroCopyInputStream in(data);
-    RPCMeta rpc_meta;
-    rpc_meta.ParseFromZeroCopyStream(&in);
     auto request_id = rpc_meta.correlation_id();
-    auto cntl = transport->TakeClientCall(request_id);
+    bool abandoned = false;
+    auto cntl = transport->TakeClientCall(request_id, &abandoned);
+    if (abandoned)
+        return ERR_OK;
     if (!cntl) {
         LOG(INFO) << "request id " << request_id << " not found";
         // TODO(walter) return error and close transport.
         return -1;
     }
 
-    data.pop_front(in.ByteCount());
-    return cntl->ProcessResponse(data);
+    const auto& response_meta = rpc_meta.response();
+    if (response_meta.error_code() != 0) {
+        cntl->SetFailed(response_meta.error_code(),
+                        response_meta.error_text());
+    } else if (!IsValidCompressType(response_meta.compress_type())) {
+        cntl->SetFailed(ERR_COMPRESS, "Unknown compress type of the response");
+    } else if (response_meta.compress_type() != COMPRESS_NONE) {
+        IOBuf decompressed;
+        if (Decompress(static_cast<CompressType>(response_meta.compress_type()),
+                       payload, &decompressed) != ERR_OK) {
+            cntl->SetFailed(ERR_COMPRESS, "Failed to decompress the response");
+        }
+        payload.swap(decompressed);
+    }
+
+    // The stream is accepted before the done of the call runs.
+    auto call = static_cast<URPCClientCall*>(cntl);
+    if (auto stream = call->stream()) {
+        call->set_stream(nullptr);
+        bool accepted = !cntl->Failed() && rpc_meta.has_stream_settings();
+        stream->OnResponse(accepted ? &rpc_meta.stream_settings() : nullptr);
+    }
+    return cntl->ProcessResponse(payload);
 }
 
 }  // namespace urpc
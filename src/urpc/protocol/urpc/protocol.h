@@ -29,7 +29,8 @@ public:
 
     /// Parse the protocol request. If the payload isn't enough, ERR_TOO_SMALL
     /// is returned. If the header is mismatched, ERR_MISMATCH is returned.
-    int ParseRequest(IOBuf* buf, ServerCall** server_call) override;
+    int ParseRequest(IOBuf* buf, ServerTransport* transport,
+                     ServerCall** server_call) override;
 
     /// Parse the protocol response. If the payload isn't enough, ERR_TOO_SMALL
     /// is returned. If the header is mismatched, ERR_MISMATCH is returned.
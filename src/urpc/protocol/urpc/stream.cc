@@ -0,0 +1,220 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stream.h"
+
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "urpc/base.h"
+#include "urpc/protocol/urpc/call.h"
+
+namespace urpc {
+namespace protocol {
+namespace urpc {
+
+namespace {
+
+/// The frames aren't owned by any call, and might outlive their streams in
+/// the write queue.
+class FrameWriter final : public Controller {
+public:
+    static FrameWriter* singleton() {
+        thread_local FrameWriter writer;
+        return &writer;
+    }
+
+protected:
+    void OnComplete() override {}
+};
+
+}  // namespace
+
+URPCStream::URPCStream(const StreamOptions& options, bool server_side)
+    : reader_(options.reader),
+      window_size_(options.window_size),
+      server_side_(server_side) {}
+
+int URPCStream::Write(IOBuf chunk) {
+    if (local_closed_ || remote_closed_)
+        return ERR_STREAM_CLOSED;
+    if (!accepted_ || !writable())
+        return ERR_STREAM_FULL;
+
+    produced_ += chunk.size();
+    SendFrame(StreamFrame::FRAME_DATA, std::move(chunk));
+    return ERR_OK;
+}
+
+void URPCStream::NotifyOnWritable(Closure* done) {
+    writable_callbacks_.push_back(done);
+    if (local_closed_ || remote_closed_ || (accepted_ && writable()))
+        RunWritableCallbacks();
+}
+
+void URPCStream::Close() {
+    CHECK(!local_closed_) << "Stream " << id_ << " is closed twice";
+    local_closed_ = true;
+    if (!remote_closed_) {
+        if (accepted_)
+            SendFrame(StreamFrame::FRAME_CLOSE, IOBuf());
+        if (transport_)
+            transport_->RemoveStream(id_);
+    }
+    RunWritableCallbacks();
+    MaybeDestroy();
+}
+
+void URPCStream::OnReset(int code) {
+    // Calls of clients are never done once the transport is reset, but the
+    // calls of servers always respond.
+    if (!server_side_)
+        waiting_response_ = false;
+    OnRemoteClosed(ERR_STREAM_CLOSED);
+    MaybeDestroy();
+}
+
+void URPCStream::Bind(Transport* transport, uint64_t id) {
+    transport_ = transport;
+    id_ = id;
+}
+
+void URPCStream::FillSettings(StreamSettings* settings) const {
+    settings->set_stream_id(id_);
+    settings->set_window_size(window_size_);
+}
+
+void URPCStream::Accept(const StreamSettings& peer) {
+    accepted_ = true;
+    peer_window_ = peer.window_size();
+    if (writable())
+        RunWritableCallbacks();
+}
+
+void URPCStream::OnResponse(const StreamSettings* peer) {
+    waiting_response_ = false;
+    if (!peer) {
+        OnRemoteClosed(ERR_STREAM_CLOSED);
+    } else if (!accepted_) {
+        Accept(*peer);
+        // The stream closed before it's accepted.
+        if (local_closed_ && !remote_closed_)
+            SendFrame(StreamFrame::FRAME_CLOSE, IOBuf());
+    }
+    MaybeDestroy();
+}
+
+void URPCStream::OnFrame(const StreamFrame& frame, IOBuf payload) {
+    switch (frame.frame_type()) {
+        case StreamFrame::FRAME_DATA: {
+            if (local_closed_ || remote_closed_ || !reader_)
+                break;
+            consumed_ += payload.size();
+            callbacks_++;
+            reader_->OnChunk(this, std::move(payload));
+            callbacks_--;
+            if (!local_closed_ && !remote_closed_ &&
+                consumed_ - acked_ >= window_size_ / 2) {
+                acked_ = consumed_;
+                SendFrame(StreamFrame::FRAME_FEEDBACK, IOBuf());
+            }
+            break;
+        }
+        case StreamFrame::FRAME_FEEDBACK:
+            if (frame.consumed_size() > peer_consumed_) {
+                peer_consumed_ = frame.consumed_size();
+                if (writable())
+                    RunWritableCallbacks();
+            }
+            break;
+        case StreamFrame::FRAME_CLOSE:
+            OnRemoteClosed(ERR_OK);
+            break;
+        default:
+            LOG(WARNING) << "Unknown frame type " << frame.frame_type()
+                         << " of stream " << id_;
+            break;
+    }
+    MaybeDestroy();
+}
+
+void URPCStream::SendFrame(StreamFrame::FrameType type, IOBuf payload) {
+    if (transport_->fd() < 0)
+        return;
+
+    RPCMeta meta;
+    meta.set_correlation_id(id_);
+    auto* frame = meta.mutable_stream_frame();
+    frame->set_stream_id(id_);
+    frame->set_frame_type(type);
+    frame->set_consumed_size(consumed_);
+
+    IOBuf buf;
+    AppendMessage(meta, std::move(payload), &buf);
+    transport_->StartWrite(FrameWriter::singleton(), std::move(buf));
+}
+
+void URPCStream::OnRemoteClosed(int code) {
+    if (remote_closed_)
+        return;
+    remote_closed_ = true;
+    if (transport_)
+        transport_->RemoveStream(id_);
+    if (reader_ && !local_closed_) {
+        callbacks_++;
+        reader_->OnClosed(this, code);
+        callbacks_--;
+    }
+    RunWritableCallbacks();
+}
+
+void URPCStream::RunWritableCallbacks() {
+    auto callbacks = std::move(writable_callbacks_);
+    writable_callbacks_.clear();
+    callbacks_++;
+    for (auto* done : callbacks) {
+        done->Run();
+    }
+    callbacks_--;
+}
+
+void URPCStream::MaybeDestroy() {
+    if (local_closed_ && !waiting_response_ && callbacks_ == 0)
+        delete this;
+}
+
+}  // namespace urpc
+}  // namespace protocol
+
+StreamWriter* StreamCreate(Controller* cntl, const StreamOptions& options) {
+    auto call = dynamic_cast<protocol::urpc::URPCClientCall*>(cntl);
+    if (!call || call->stream()) {
+        LOG(WARNING) << "Streams are created by the controllers of "
+                        "NewURPCController(), once per RPC";
+        return nullptr;
+    }
+    auto stream = new protocol::urpc::URPCStream(options, false);
+    call->set_stream(stream);
+    return stream;
+}
+
+StreamWriter* StreamAccept(Controller* cntl, const StreamOptions& options) {
+    auto call = dynamic_cast<protocol::urpc::URPCServerCall*>(cntl);
+    if (!call)
+        return nullptr;
+    return call->AcceptStream(options);
+}
+
+}  // namespace urpc
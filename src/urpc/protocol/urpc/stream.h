@@ -0,0 +1,101 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <urpc/stream.h>
+
+#include "urpc/iobuf.h"
+#include "urpc/transport.h"
+#include "urpc_meta.pb.h"
+
+namespace urpc {
+namespace protocol {
+namespace urpc {
+
+/// A stream bound to a RPC of the urpc protocol. Chunks are carried by
+/// messages with `stream_frame` in both directions, and the writer stops
+/// once the bytes not consumed by the reader of the peer reach its window.
+///
+/// The stream is released once it's closed locally and the RPC is done with
+/// it, all methods must be invoked in the poller thread of the transport.
+class URPCStream final : public StreamWriter, public TransportStream {
+public:
+    URPCStream(const StreamOptions& options, bool server_side);
+
+    uint64_t id() const override { return id_; }
+    int Write(IOBuf chunk) override;
+    void NotifyOnWritable(Closure* done) override;
+    void Close() override;
+
+    void OnReset(int code) override;
+
+    /// Bind the stream to the RPC `id` over `transport`.
+    void Bind(Transport* transport, uint64_t id);
+
+    /// The settings sent to the peer, the window of the local reader.
+    void FillSettings(StreamSettings* settings) const;
+
+    /// Accept the stream with the settings of the peer.
+    void Accept(const StreamSettings& peer);
+
+    /// The RPC is done, the stream is accepted with the settings of the
+    /// peer, or closed if `peer` is nullptr.
+    void OnResponse(const StreamSettings* peer);
+
+    void OnFrame(const StreamFrame& frame, IOBuf payload);
+
+private:
+    ~URPCStream() override = default;
+
+    bool writable() const {
+        return produced_ - peer_consumed_ < peer_window_;
+    }
+
+    void SendFrame(StreamFrame::FrameType type, IOBuf payload);
+    void OnRemoteClosed(int code);
+    void RunWritableCallbacks();
+    void MaybeDestroy();
+
+    StreamReader* const reader_;
+    const int64_t window_size_;
+    const bool server_side_;
+    Transport* transport_{nullptr};
+    uint64_t id_{0};
+
+    bool accepted_{false};
+    /// The RPC still refers to the stream.
+    bool waiting_response_{true};
+    bool local_closed_{false};
+    bool remote_closed_{false};
+    /// The depth of the user callbacks in progress.
+    int callbacks_{0};
+
+    /// The window of the peer, and the bytes written and consumed by it.
+    int64_t peer_window_{0};
+    int64_t produced_{0};
+    int64_t peer_consumed_{0};
+    /// The bytes consumed by the local reader, and the part told to the peer.
+    int64_t consumed_{0};
+    int64_t acked_{0};
+
+    std::vector<Closure*> writable_callbacks_;
+};
+
+}  // namespace urpc
+}  // namespace protocol
+}  // namespace urpc
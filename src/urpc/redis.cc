@@ -0,0 +1,97 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <urpc/redis.h>
+
+#include <ctype.h>
+
+#include <charconv>
+#include <string>
+#include <utility>
+
+#include "urpc/iobuf.h"
+
+namespace urpc {
+
+namespace {
+
+std::string ToLower(std::string_view name) {
+    std::string lower(name);
+    for (char& c : lower)
+        c = tolower(static_cast<unsigned char>(c));
+    return lower;
+}
+
+}  // namespace
+
+void RedisReply::AppendLine(char type, std::string_view line) {
+    buf_->push_back(type);
+    size_t begin = 0;
+    while (begin < line.size()) {
+        size_t end = line.find_first_of("\r\n", begin);
+        if (end == std::string_view::npos)
+            end = line.size();
+        buf_->append(line.data() + begin, end - begin);
+        if (end < line.size())
+            buf_->push_back(' ');
+        begin = end + 1;
+    }
+    buf_->append("\r\n", 2);
+}
+
+void RedisReply::AppendStatus(std::string_view status) {
+    AppendLine('+', status);
+}
+
+void RedisReply::AppendError(std::string_view message) {
+    AppendLine('-', message);
+}
+
+void RedisReply::AppendInteger(int64_t value) {
+    char data[24];
+    auto result = std::to_chars(data, data + sizeof(data), value);
+    AppendLine(':', std::string_view(data, result.ptr - data));
+}
+
+void RedisReply::AppendString(std::string_view value) {
+    char data[24];
+    auto result = std::to_chars(data, data + sizeof(data), value.size());
+    AppendLine('$', std::string_view(data, result.ptr - data));
+    buf_->append(value.data(), value.size());
+    buf_->append("\r\n", 2);
+}
+
+void RedisReply::AppendNull() { buf_->append("$-1\r\n", 5); }
+
+void RedisReply::AppendArray(size_t size) {
+    char data[24];
+    auto result = std::to_chars(data, data + sizeof(data), size);
+    AppendLine('*', std::string_view(data, result.ptr - data));
+}
+
+bool RedisService::AddCommandHandler(std::string_view name,
+                                     RedisCommandHandler handler) {
+    return handlers_.emplace(ToLower(name), std::move(handler)).second;
+}
+
+const RedisCommandHandler* RedisService::FindCommandHandler(
+    std::string_view name) const {
+    auto it = handlers_.find(ToLower(name));
+    if (it == handlers_.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+}  // namespace urpc
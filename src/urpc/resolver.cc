@@ -0,0 +1,154 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "resolver.h"
+
+#include <netdb.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_int32(dns_cache_ttl_s, 60,
+             "The seconds a resolved hostname is cached before it's resolved "
+             "again");
+DEFINE_int32(dns_retry_interval_ms, 1000,
+             "The interval to resolve a hostname failed to resolve again");
+
+namespace urpc {
+
+namespace {
+
+int ResolveHostname(const std::string& hostname, ip_t* ip) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    int rc = getaddrinfo(hostname.c_str(), nullptr, &hints, &result);
+    if (rc != 0 || result == nullptr) {
+        LOG(WARNING) << "Fail to resolve " << hostname << ": "
+                     << gai_strerror(rc);
+        return -1;
+    }
+    // Only the first address is used like hostname2ip().
+    *ip = reinterpret_cast<struct sockaddr_in*>(result->ai_addr)->sin_addr;
+    freeaddrinfo(result);
+    return 0;
+}
+
+}  // namespace
+
+Resolver* Resolver::singleton() {
+    // Never destroyed, the background thread outlives the other statics.
+    static Resolver* resolver = new Resolver;
+    return resolver;
+}
+
+Resolver::Resolver() { std::thread([this] { Run(); }).detach(); }
+
+int Resolver::Lookup(const std::string& hostname, ip_t* ip) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry* entry = &cache_[hostname];
+    MaybeResolveLocked(hostname, entry);
+    if (!entry->resolved)
+        return -1;
+    *ip = entry->ip;
+    return 0;
+}
+
+int Resolver::Resolve(const std::string& hostname, ip_t* ip) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Entry* entry = &cache_[hostname];
+    MaybeResolveLocked(hostname, entry);
+    // The entries are never erased, so the pointer stays valid.
+    cond_.wait(lock, [entry] { return entry->resolved || !entry->resolving; });
+    if (!entry->resolved)
+        return -1;
+    *ip = entry->ip;
+    return 0;
+}
+
+void Resolver::MaybeResolveLocked(const std::string& hostname, Entry* entry) {
+    if (entry->resolving || Clock::now() < entry->expiration)
+        return;
+    entry->resolving = true;
+    queue_.push_back(hostname);
+    cond_.notify_all();
+}
+
+void Resolver::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (queue_.empty()) {
+            // The expired entries are refreshed, the addresses resolved
+            // before are still used meanwhile.
+            const auto now = Clock::now();
+            auto next_expiration = Clock::time_point::max();
+            for (auto&& [hostname, entry] : cache_) {
+                if (entry.resolving)
+                    continue;
+                if (entry.expiration <= now) {
+                    entry.resolving = true;
+                    queue_.push_back(hostname);
+                } else {
+                    next_expiration =
+                        std::min(next_expiration, entry.expiration);
+                }
+            }
+            if (queue_.empty()) {
+                if (next_expiration == Clock::time_point::max()) {
+                    cond_.wait(lock);
+                } else {
+                    cond_.wait_until(lock, next_expiration);
+                }
+                continue;
+            }
+        }
+
+        std::string hostname = std::move(queue_.front());
+        queue_.pop_front();
+
+        lock.unlock();
+        ip_t ip;
+        const int rc = ResolveHostname(hostname, &ip);
+        lock.lock();
+
+        Entry* entry = &cache_[hostname];
+        entry->resolving = false;
+        if (rc == 0) {
+            const bool changed =
+                !entry->resolved || entry->ip.s_addr != ip.s_addr;
+            entry->resolved = true;
+            entry->ip = ip;
+            entry->expiration =
+                Clock::now() + std::chrono::seconds(FLAGS_dns_cache_ttl_s);
+            if (changed)
+                version_.fetch_add(1, std::memory_order_release);
+        } else {
+            // The address resolved before is kept until it resolves again.
+            entry->expiration =
+                Clock::now() +
+                std::chrono::milliseconds(FLAGS_dns_retry_interval_ms);
+        }
+        cond_.notify_all();
+    }
+}
+
+}  // namespace urpc
@@ -0,0 +1,78 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <urpc/endpoint.h>
+
+namespace urpc {
+
+/// Resolve hostnames by a background thread, so the poller threads never
+/// block on DNS. The addresses are cached for -dns_cache_ttl_s and the
+/// background thread refreshes them once expired, the expired ones are still
+/// used until then. The failures are retried after -dns_retry_interval_ms.
+class Resolver {
+public:
+    static Resolver* singleton();
+
+    /// Look `hostname` up in the cache without blocking, 0 is returned with
+    /// `*ip` set if it's resolved. Otherwise -1 is returned and it's resolved
+    /// in the background, look it up again once version() changes.
+    int Lookup(const std::string& hostname, ip_t* ip);
+
+    /// Like Lookup(), but wait for the background resolution if it's not
+    /// cached. Don't invoke it in the poller threads.
+    int Resolve(const std::string& hostname, ip_t* ip);
+
+    /// Increased once an address is resolved or changes.
+    uint64_t version() const {
+        return version_.load(std::memory_order_acquire);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        bool resolved{false};
+        bool resolving{false};
+        ip_t ip{IP_NONE};
+        /// Resolved again once passed.
+        Clock::time_point expiration;
+    };
+
+    Resolver();
+
+    /// Queue `hostname` for the background thread unless it's being resolved
+    /// or fresh, with `mutex_` held.
+    void MaybeResolveLocked(const std::string& hostname, Entry* entry);
+    void Run();
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::unordered_map<std::string, Entry> cache_;
+    std::deque<std::string> queue_;
+    std::atomic<uint64_t> version_{0};
+};
+
+}  // namespace urpc
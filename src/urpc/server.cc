@@ -12,18 +12,27 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/service.h>
 #include <urpc/endpoint.h>
+#include <urpc/io_context.h>
 #include <urpc/server.h>
 
+#include <chrono>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "acceptor.h"
+#include "concurrency_limiter.h"
 #include "service_holder.h"
 #include "utils/owner_ptr.h"
 
+DECLARE_bool(reuse_port);
+
 using namespace google::protobuf;
 
 namespace urpc {
@@ -32,23 +41,82 @@ class ServerImpl {
 public:
     ~ServerImpl();
 
-    int Start(EndPoint endpoint);
+    int Start(EndPoint endpoint, const ServerOptions& options);
+    int Stop();
+    int Join(int timeout_ms);
 
 private:
+    /// Reset the connections of the group, only the idle ones unless `all`.
+    void CloseConnections(bool all);
+
     utils::owner_ptr<Acceptor> acceptor_;
+    /// The connections accepted, kept after the acceptor is stopped.
+    std::shared_ptr<ConnectionGroup> group_;
 };
 
-int ServerImpl::Start(EndPoint endpoint) {
-    int fd = tcp_listen(endpoint);
+int ServerImpl::Start(EndPoint endpoint, const ServerOptions& options) {
+    int fd = tcp_listen(endpoint, options.reuse_port);
     if (fd < 0)
         return fd;
 
     LOG(INFO) << "Server make Acceptor " << fd;
-    acceptor_.reset(new Acceptor(fd));
+    acceptor_.reset(
+        new Acceptor(fd, options.max_connections, options.idle_timeout_s));
+    group_ = acceptor_->group();
+    return 0;
+}
+
+int ServerImpl::Stop() {
+    if (!acceptor_.get())
+        return -1;
+    acceptor_->Stop();
+    acceptor_.reset();
+
+    // Copied since the connections leave the group once reset.
+    std::vector<ServerTransport*> transports(group_->transports.begin(),
+                                             group_->transports.end());
+    for (auto transport : transports)
+        transport->OnDraining();
+    return 0;
+}
+
+int ServerImpl::Join(int timeout_ms) {
+    if (!group_)
+        return -1;
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeout_ms);
+    while (!group_->transports.empty()) {
+        if (timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline) {
+            LOG(WARNING) << "Close " << group_->transports.size()
+                         << " connections still busy";
+            CloseConnections(true);
+            break;
+        }
+        // The responses of the requests in processing are written first.
+        if (ServiceHolder::singleton()->in_flight() == 0)
+            CloseConnections(false);
+        IOContext context(LOOP_ONCE);
+    }
+    group_.reset();
     return 0;
 }
 
-ServerImpl::~ServerImpl() {}
+void ServerImpl::CloseConnections(bool all) {
+    std::vector<ServerTransport*> transports(group_->transports.begin(),
+                                             group_->transports.end());
+    for (auto transport : transports) {
+        if (all || transport->Idle())
+            transport->Reset(ERR_EOF, "Server stopped");
+    }
+}
+
+ServerImpl::~ServerImpl() {
+    if (acceptor_.get())
+        acceptor_->Stop();
+}
+
+ServerOptions::ServerOptions()
+    : reuse_port(FLAGS_reuse_port), max_connections(0), idle_timeout_s(-1) {}
 
 Server::Server() : impl_(new ServerImpl) {}
 
@@ -58,6 +126,41 @@ int Server::AddService(Service* service, ServiceOwnership ownership) {
     return ServiceHolder::singleton()->AddService(service, ownership);
 }
 
-int Server::Start(EndPoint endpoint) { return impl_->Start(endpoint); }
+int Server::SetMaxConcurrency(const std::string& max_concurrency) {
+    std::unique_ptr<ConcurrencyLimiter> limiter;
+    if (ConcurrencyLimiter::New(max_concurrency, &limiter) != 0)
+        return -1;
+    ServiceHolder::singleton()->set_limiter(std::move(limiter));
+    return 0;
+}
+
+int Server::SetMethodMaxConcurrency(const std::string& full_name,
+                                    const std::string& max_concurrency) {
+    std::unique_ptr<ConcurrencyLimiter> limiter;
+    if (ConcurrencyLimiter::New(max_concurrency, &limiter) != 0)
+        return -1;
+    return ServiceHolder::singleton()->SetMethodLimiter(full_name,
+                                                        std::move(limiter));
+}
+
+int Server::AddRedisService(RedisService* service,
+                            ServiceOwnership ownership) {
+    return ServiceHolder::singleton()->AddRedisService(service, ownership);
+}
+
+int Server::Start(EndPoint endpoint) {
+    ServerOptions options;
+    // The flag is ignored by unix domain sockets.
+    options.reuse_port &= endpoint.family != AF_UNIX;
+    return impl_->Start(endpoint, options);
+}
+
+int Server::Start(EndPoint endpoint, const ServerOptions& options) {
+    return impl_->Start(endpoint, options);
+}
+
+int Server::Stop() { return impl_->Stop(); }
+
+int Server::Join(int timeout_ms) { return impl_->Join(timeout_ms); }
 
 }  // namespace urpc
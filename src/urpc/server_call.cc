@@ -16,8 +16,21 @@
 
 #include <glog/logging.h>
 
+#include "server_transport.h"
+
 namespace urpc {
 
+ServerCall::~ServerCall() {
+    if (transport_ref_)
+        static_cast<ServerTransport*>(transport_ref_.get())->OnCallDone();
+}
+
 void ServerCall::OnComplete() { delete this; }
 
+void ServerCall::Hold(ServerTransport* trans) {
+    trans->AddRef();
+    trans->OnCallStarted();
+    transport_ref_.reset(trans);
+}
+
 }  // namespace urpc
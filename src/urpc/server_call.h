@@ -17,16 +17,28 @@
 #include <urpc/controller.h>
 
 #include "transport.h"
+#include "utils/owner_ptr.h"
 
 namespace urpc {
 
+class ServerTransport;
+
 class ServerCall : public Controller {
 public:
-    ~ServerCall() override = default;
+    ~ServerCall() override;
 
+    /// Delete the call, which releases its reference of the transport.
     void OnComplete() override;
 
     virtual int Serve(Transport* trans) = 0;
+
+    /// Keep `trans` alive until the call completes, the response might be
+    /// ready after the connection is reset. The transport isn't idle
+    /// meanwhile.
+    void Hold(ServerTransport* trans);
+
+private:
+    utils::owner_ptr<Transport> transport_ref_;
 };
 
 }  // namespace urpc
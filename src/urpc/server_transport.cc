@@ -14,49 +14,145 @@
 
 #include "server_transport.h"
 
+#include <errno.h>
+
 #include <glog/logging.h>
 
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "base.h"
 #include "protocol/manager.h"
+#include "stats.h"
 
 using urpc::protocol::ProtocolManager;
 
 namespace urpc {
 
-ServerTransport::~ServerTransport() {}
+ServerTransport::ServerTransport(int fd, EndPoint remote_side)
+    : Transport(fd, remote_side, true) {
+    StatsRegistry::singleton()->Register(this);
+}
+
+ServerTransport::~ServerTransport() {
+    StatsRegistry::singleton()->Unregister(this);
+    set_group(nullptr);
+}
+
+void ServerTransport::set_group(std::shared_ptr<ConnectionGroup> group) {
+    if (group_) {
+        group_->transports.erase(this);
+        group_->count.fetch_sub(1, std::memory_order_relaxed);
+    }
+    group_ = std::move(group);
+    if (group_) {
+        group_->transports.insert(this);
+        group_->count.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void ServerTransport::Reset(int code, std::string reason) {
+    set_group(nullptr);
+
+    // The calls are completed below instead of dropped with their writes,
+    // they hold the references of the transport.
+    std::vector<Controller*> unsent;
+    if (current_cntl_)
+        unsent.push_back(current_cntl_);
+    for (auto&& [cntl, buf] : pending_writes_)
+        unsent.push_back(cntl);
+    current_cntl_ = nullptr;
+    pending_writes_.clear();
+    Transport::Reset(code, reason);
+
+    for (auto cntl : unsent) {
+        cntl->SetFailed(code, reason);
+        cntl->OnComplete();
+    }
+    if (parse_context_)
+        parse_context_->OnReset();
+}
+
+void ServerTransport::OnDraining() {
+    Transport::OnDraining();
+    if (parse_context_)
+        parse_context_->OnDraining();
+}
+
+bool ServerTransport::Idle() const {
+    return calls_ == 0 && Transport::Idle();
+}
 
 int ServerTransport::OnWriteDone(Controller* cntl) {
     cntl->OnComplete();
     return 0;
 }
 
-int ServerTransport::OnRead(IOBuf* buf) {
-    ServerCall* raw_call = nullptr;
-
-    int code = ERR_MISMATCH;
-    if (protocol_)
-        code = protocol_->ParseRequest(buf, &raw_call);
-    if (code == ERR_MISMATCH) {
-        protocol_ = ProtocolManager::singleton()->ProbeProtocol(*buf);
-        if (!protocol_) {
-            LOG(INFO) << "NOT supported protocol";
-            Reset(ERR_NOT_SUPPORTED, "unknown protocol");
+int ServerTransport::HandleReadEvent() {
+    if (!fd_.valid())
+        return 0;
+    if (remote_side_.family == AF_UNIX && !handshaked_) {
+        std::unique_ptr<ShmLink> link;
+        ssize_t n = ShmLink::Accept(fd_, &read_buf_, &link);
+        if (n < 0 && errno == EAGAIN)
+            return 0;
+        handshaked_ = true;
+        if (n < 0) {
+            Reset(ERR_NOT_SUPPORTED, "Invalid shared memory handshake");
             return -1;
         }
+        if (link) {
+            UseSharedMemory(std::move(link));
+        } else if (n > 0) {
+            // The first bytes of a client not using shared memory.
+            int code = OnRead(&read_buf_);
+            if (code != ERR_OK)
+                return code;
+        }
     }
+    return Transport::HandleReadEvent();
+}
 
-    code = protocol_->ParseRequest(buf, &raw_call);
-    if (code != ERR_OK) {
-        if (code == ERR_TOO_SMALL)
-            return 0;
-        LOG(INFO) << "parse request code " << code;
-        Reset(code, "parse request");
-        return -1;
+int ServerTransport::OnRead(IOBuf* buf) {
+    // A single read might carry several pipelined requests, and the poller
+    // is edge triggered, so parse until the remaining payload isn't enough.
+    while (!buf->empty()) {
+        ServerCall* raw_call = nullptr;
+
+        int code = ERR_MISMATCH;
+        if (protocol_)
+            code = protocol_->ParseRequest(buf, this, &raw_call);
+        if (code == ERR_MISMATCH) {
+            code =
+                ProtocolManager::singleton()->ProbeProtocol(*buf, &protocol_);
+            if (code == ERR_TOO_SMALL)
+                return 0;
+            if (code != ERR_OK) {
+                LOG(INFO) << "NOT supported protocol";
+                Reset(ERR_NOT_SUPPORTED, "unknown protocol");
+                return -1;
+            }
+            parse_context_.reset();
+            code = protocol_->ParseRequest(buf, this, &raw_call);
+        }
+
+        if (code != ERR_OK) {
+            if (code == ERR_TOO_SMALL)
+                return 0;
+            LOG(INFO) << "parse request code " << code;
+            Reset(code, "parse request");
+            return -1;
+        }
+
+        OnMessageRead();
+        raw_call->Hold(this);
+        int res = raw_call->Serve(this);
+        if (res != 0)
+            return res;
     }
 
-    return raw_call->Serve(this);
+    return 0;
 }
 
 }  // namespace urpc
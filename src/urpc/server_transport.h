@@ -14,24 +14,74 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
 #include "protocol/base.h"
 #include "transport.h"
 
 namespace urpc {
 
+class ServerTransport;
+
+/// The connections accepted by a listening socket, shared by the acceptor and
+/// the connections since the acceptor might be stopped first.
+struct ConnectionGroup {
+    /// The size of `transports`, read by the stats of any thread.
+    std::atomic<uint64_t> count{0};
+    std::unordered_set<ServerTransport*> transports;
+};
+
 class ServerTransport : public Transport {
 public:
-    explicit ServerTransport(int fd) : Transport(fd) {}
+    ServerTransport(int fd, EndPoint remote_side);
     ~ServerTransport() override;
 
+    /// The parsing state of the current protocol, nullptr if not set.
+    const std::shared_ptr<protocol::ParseContext>& parse_context() const {
+        return parse_context_;
+    }
+    void set_parse_context(std::shared_ptr<protocol::ParseContext> context) {
+        parse_context_ = std::move(context);
+    }
+
+    /// Join `group` until the transport is reset.
+    void set_group(std::shared_ptr<ConnectionGroup> group);
+
+    void Reset(int code, std::string reason) override;
+
+    /// Ask the client to go away by the protocol too, such as GOAWAY of h2.
+    void OnDraining() override;
+
+    /// No call is in processing either, the responses are written later.
+    bool Idle() const override;
+
+    /// Counted by the calls held on the transport until they complete.
+    void OnCallStarted() { ++calls_; }
+    void OnCallDone() { --calls_; }
+
 protected:
     int OnWriteDone(Controller* cntl) override;
     int OnRead(IOBuf* buf) override;
 
+    /// The first read of a unix domain socket takes the shared memory sent
+    /// by a client on the same host, if any.
+    int HandleReadEvent() override;
+
 private:
     /// The last successfully parsed protocol, used to optimize protocol
     /// lookuping.
     protocol::BaseProtocol* protocol_{nullptr};
+    /// Shared with the in-flight calls which need the state to respond, such
+    /// as the ordering of pipelined HTTP responses.
+    std::shared_ptr<protocol::ParseContext> parse_context_;
+    bool handshaked_{false};
+    /// The calls of the requests read and not completed yet.
+    int64_t calls_{0};
+    std::shared_ptr<ConnectionGroup> group_;
 };
 
 }  // namespace urpc
@@ -32,6 +32,10 @@ ServiceHolder* ServiceHolder::singleton() {
 ServiceHolder::ServiceHolder() = default;
 
 ServiceHolder::~ServiceHolder() {
+    for (auto&& [name, property] : methods_) {
+        if (property.limiter)
+            property.status->RemoveLimiter(property.limiter.get());
+    }
     for (auto&& service : owned_services_) {
         delete service;
     }
@@ -46,7 +50,12 @@ int ServiceHolder::AddService(Service* service, ServiceOwnership ownership) {
         const MethodDescriptor* method = descriptor->method(i);
         LOG(INFO) << "Add method " << method->name();
         LOG(INFO) << "Add method (full name) " << method->full_name();
-        descriptor_.insert({method->full_name(), method});
+        MethodStatus* status =
+            MethodStatusRegistry::singleton()->GetOrCreate(method->full_name());
+        MethodProperty property;
+        property.method = method;
+        property.status = status;
+        methods_.emplace(method->full_name(), std::move(property));
     }
 
     services_.insert({descriptor->full_name(), service});
@@ -58,13 +67,20 @@ int ServiceHolder::AddService(Service* service, ServiceOwnership ownership) {
 }
 
 const MethodDescriptor* ServiceHolder::FindMethod(
+    const std::string& service_name, const std::string& method_name) {
+    const MethodProperty* property =
+        FindMethodProperty(service_name, method_name);
+    return property ? property->method : nullptr;
+}
+
+MethodProperty* ServiceHolder::FindMethodProperty(
     const std::string& service_name, const std::string& method_name) {
     std::string full_name = service_name + "." + method_name;
-    auto it = descriptor_.find(full_name);
-    if (it == descriptor_.end()) {
+    auto it = methods_.find(full_name);
+    if (it == methods_.end()) {
         return nullptr;
     }
-    return it->second;
+    return &it->second;
 }
 
 Service* ServiceHolder::FindService(const std::string& service_name) {
@@ -75,4 +91,71 @@ Service* ServiceHolder::FindService(const std::string& service_name) {
     return it->second;
 }
 
+int ServiceHolder::SetMethodLimiter(
+    const std::string& full_name, std::unique_ptr<ConcurrencyLimiter> limiter) {
+    auto it = methods_.find(full_name);
+    if (it == methods_.end()) {
+        LOG(ERROR) << "Method " << full_name << " not found";
+        return -1;
+    }
+    MethodProperty* property = &it->second;
+    if (property->limiter)
+        property->status->RemoveLimiter(property->limiter.get());
+    property->limiter = std::move(limiter);
+    if (property->limiter) {
+        property->limiter->Adopt(property->processing);
+        property->status->AddLimiter(property->limiter.get());
+    }
+    return 0;
+}
+
+void ServiceHolder::set_limiter(std::unique_ptr<ConcurrencyLimiter> limiter) {
+    limiter_ = std::move(limiter);
+    if (limiter_)
+        limiter_->Adopt(in_flight_);
+}
+
+bool ServiceHolder::OnRequested(MethodProperty* property) {
+    MethodStatus* status = property->status;
+    if (limiter_ && !limiter_->OnRequested()) {
+        status->OnRejected();
+        return false;
+    }
+    if (property->limiter && !property->limiter->OnRequested()) {
+        status->OnRejected();
+        if (limiter_)
+            limiter_->OnCanceled();
+        return false;
+    }
+    status->OnRequested();
+    ++property->processing;
+    ++in_flight_;
+    return true;
+}
+
+void ServiceHolder::OnResponded(MethodProperty* property, bool success,
+                                uint64_t latency_us) {
+    --in_flight_;
+    --property->processing;
+    property->status->OnResponded(success, latency_us);
+    if (property->limiter)
+        property->limiter->OnResponded(success, latency_us);
+    if (limiter_)
+        limiter_->OnResponded(success, latency_us);
+}
+
+int ServiceHolder::AddRedisService(RedisService* service,
+                                   ServiceOwnership ownership) {
+    if (redis_service_) {
+        LOG(ERROR) << "Redis service is already added";
+        return -1;
+    }
+
+    redis_service_ = service;
+    if (ownership == ServiceOwnership::SERVER_OWNS_SERVICE) {
+        owned_redis_service_.reset(service);
+    }
+    return 0;
+}
+
 }  // namespace urpc
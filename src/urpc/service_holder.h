@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <memory>
 #include <unordered_map>
 #include <vector>
 #include <string>
@@ -21,10 +22,24 @@
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/service.h>
 
+#include <urpc/redis.h>
 #include <urpc/server.h>  // ServiceOwnership
 
+#include "urpc/concurrency_limiter.h"
+#include "urpc/method_status.h"
+
 namespace urpc {
 
+struct MethodProperty {
+    const google::protobuf::MethodDescriptor* method{nullptr};
+    /// Shared by the servers of all threads.
+    MethodStatus* status{nullptr};
+    /// The limiter of the thread, [`nullptr`] if unlimited.
+    std::unique_ptr<ConcurrencyLimiter> limiter;
+    /// The requests admitted by the thread and not responded yet.
+    int64_t processing{0};
+};
+
 class ServiceHolder final {
     using Service = google::protobuf::Service;
     using MethodDescriptor = google::protobuf::MethodDescriptor;
@@ -41,16 +56,51 @@ public:
     const MethodDescriptor* FindMethod(const std::string& service_name,
                                        const std::string& method_name);
 
+    /// Find the corresponding method property, return [`nullptr`] if no such
+    /// method are found.
+    MethodProperty* FindMethodProperty(const std::string& service_name,
+                                       const std::string& method_name);
+
     /// Find the corresponding service, return [`nullptr`] if no such service
     /// are found.
     Service* FindService(const std::string& service_name);
 
+    /// Limit the requests in processing of all methods of the thread,
+    /// [`nullptr`] if unlimited. The limiter takes over the requests admitted
+    /// already, they're released on it once responded.
+    void set_limiter(std::unique_ptr<ConcurrencyLimiter> limiter);
+
+    /// Limit the requests in processing of a method on the thread, like
+    /// set_limiter(). -1 is returned if no such method is found.
+    int SetMethodLimiter(const std::string& full_name,
+                         std::unique_ptr<ConcurrencyLimiter> limiter);
+
+    /// Admit a request of the method of `property` by the concurrency limits
+    /// of the thread and the method, false is returned if it's rejected.
+    bool OnRequested(MethodProperty* property);
+
+    /// Invoked once the response of an admitted request is sent.
+    void OnResponded(MethodProperty* property, bool success,
+                     uint64_t latency_us);
+
+    /// The admitted requests not responded yet, of all servers of the thread.
+    int64_t in_flight() const { return in_flight_; }
+
+    int AddRedisService(RedisService* service, ServiceOwnership ownership);
+
+    /// The redis service, [`nullptr`] if none is added.
+    RedisService* redis_service() const { return redis_service_; }
+
 private:
     ServiceHolder();
 
     std::vector<Service*> owned_services_;
     std::unordered_map<std::string, Service*> services_;
-    std::unordered_map<std::string, const MethodDescriptor*> descriptor_;
+    std::unordered_map<std::string, MethodProperty> methods_;
+    std::unique_ptr<ConcurrencyLimiter> limiter_;
+    RedisService* redis_service_{nullptr};
+    int64_t in_flight_{0};
+    std::unique_ptr<RedisService> owned_redis_service_;
 };
 
 }  // namespace urpc
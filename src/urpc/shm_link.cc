@@ -0,0 +1,343 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shm_link.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "base.h"
+#include "poller.h"
+
+DEFINE_int32(shm_ring_size, 4 * 1024 * 1024,
+             "The bytes of a shared memory ring per direction of a "
+             "connection, rounded up to a power of 2");
+
+namespace urpc {
+
+namespace {
+
+constexpr uint32_t kHandshakeMagic = 0x4d485355;  // "USHM"
+constexpr uint32_t kHandshakeVersion = 1;
+constexpr int kHandshakeFds = 3;
+
+/// Sent with the memfd, the bell of the accepting side and the bell of the
+/// connecting side.
+struct Handshake {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t ring_size;
+};
+
+size_t RoundUpRingSize(int32_t size) {
+    size_t ring_size = 4096;
+    while (ring_size < static_cast<size_t>(std::max(size, 0)))
+        ring_size <<= 1;
+    return ring_size;
+}
+
+}  // namespace
+
+/// The header of a ring followed by its data. The producer and the consumer
+/// write different cache lines, and each side sets its waiting flag before
+/// it sleeps, so the other side rings the bell only when needed.
+struct ShmLink::Ring {
+    alignas(64) std::atomic<uint64_t> head;
+    std::atomic<uint32_t> consumer_waiting;
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> producer_waiting;
+
+    char* data() { return reinterpret_cast<char*>(this + 1); }
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+              "The atomics shared by processes must be lock free");
+
+/// Poll the socket of the link for the close of the peer.
+class ShmLink::Watcher : public IOHandle {
+public:
+    Watcher(OwnedFD fd, std::function<void()> on_close)
+        : fd_(std::move(fd)), on_close_(std::move(on_close)) {}
+
+    int fd() const override { return fd_; }
+
+    int HandleReadEvent() override {
+        char buf[64];
+        while (true) {
+            ssize_t n = read(fd_, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && errno == EAGAIN)
+                return 0;
+            // The peer never writes the socket after the handshake.
+            break;
+        }
+        auto on_close = std::move(on_close_);
+        on_close_ = nullptr;
+        if (on_close)
+            on_close();
+        return 0;
+    }
+
+    int HandleWriteEvent() override { return 0; }
+
+    void Reset(int code, std::string reason) override {}
+
+private:
+    OwnedFD fd_;
+    std::function<void()> on_close_;
+};
+
+ShmLink::~ShmLink() {
+    if (watcher_) {
+        if (watcher_->poll_in())
+            Poller::singleton()->RemoveConsumer(watcher_);
+        watcher_->RelRef();
+    }
+    if (addr_)
+        munmap(addr_, length_);
+}
+
+std::unique_ptr<ShmLink> ShmLink::Connect(int fd) {
+    const size_t ring_size = RoundUpRingSize(FLAGS_shm_ring_size);
+    const size_t length = 2 * (sizeof(Ring) + ring_size);
+    // REQUIRED: Linux >= 3.17
+    OwnedFD memfd(memfd_create("urpc_shm", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    OwnedFD bell(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+    OwnedFD peer_bell(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+    if (!memfd.valid() || !bell.valid() || !peer_bell.valid() ||
+        ftruncate(memfd, length) != 0 ||
+        // The peer can't shrink it to crash this process with SIGBUS.
+        fcntl(memfd, F_ADD_SEALS,
+              F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+        PLOG(WARNING) << "Fail to create shared memory";
+        return nullptr;
+    }
+
+    std::unique_ptr<ShmLink> link(new ShmLink);
+    const int fds[kHandshakeFds] = {memfd, peer_bell, bell};
+    if (link->Init(memfd, ring_size, true, std::move(bell),
+                   std::move(peer_bell)) != 0) {
+        return nullptr;
+    }
+    // Neither side has read yet, so the first writes of both ring the bell.
+    link->out_->consumer_waiting.store(1, std::memory_order_relaxed);
+    link->in_->consumer_waiting.store(1, std::memory_order_relaxed);
+
+    Handshake handshake = {kHandshakeMagic, kHandshakeVersion, ring_size};
+    struct iovec iov = {&handshake, sizeof(handshake)};
+    char control[CMSG_SPACE(kHandshakeFds * sizeof(int))] = {};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(kHandshakeFds * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    // The socket just connected has room for it.
+    ssize_t n;
+    do {
+        n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    if (n != sizeof(handshake)) {
+        PLOG(WARNING) << "Fail to send shared memory to fd " << fd;
+        return nullptr;
+    }
+    return link;
+}
+
+ssize_t ShmLink::Accept(int fd, IOPortal* buf,
+                        std::unique_ptr<ShmLink>* link) {
+    Handshake handshake;
+    struct iovec iov = {&handshake, sizeof(handshake)};
+    char control[CMSG_SPACE(kHandshakeFds * sizeof(int))];
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n;
+    do {
+        n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0)
+        return n;
+
+    OwnedFD fds[kHandshakeFds];
+    size_t nfds = 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+        const size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; ++i) {
+            int received;
+            memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            OwnedFD owned(received);
+            if (nfds < kHandshakeFds)
+                fds[nfds++] = std::move(owned);
+        }
+    }
+
+    if (nfds == 0) {
+        buf->append(&handshake, n);
+        return n;
+    }
+
+    struct stat st;
+    int seals = fcntl(fds[0], F_GET_SEALS);
+    if (n != sizeof(handshake) || nfds != kHandshakeFds ||
+        handshake.magic != kHandshakeMagic ||
+        handshake.version != kHandshakeVersion ||
+        handshake.ring_size < 4096 ||
+        (handshake.ring_size & (handshake.ring_size - 1)) != 0 ||
+        fstat(fds[0], &st) != 0 ||
+        static_cast<uint64_t>(st.st_size) !=
+            2 * (sizeof(Ring) + handshake.ring_size) ||
+        seals < 0 || !(seals & F_SEAL_SHRINK)) {
+        LOG(WARNING) << "Invalid shared memory handshake from fd " << fd;
+        errno = EPROTO;
+        return -1;
+    }
+
+    std::unique_ptr<ShmLink> accepted(new ShmLink);
+    if (accepted->Init(fds[0], handshake.ring_size, false, std::move(fds[1]),
+                       std::move(fds[2])) != 0) {
+        errno = EPROTO;
+        return -1;
+    }
+    *link = std::move(accepted);
+    return n;
+}
+
+int ShmLink::Init(int memfd, size_t ring_size, bool connected, OwnedFD bell,
+                  OwnedFD peer_bell) {
+    length_ = 2 * (sizeof(Ring) + ring_size);
+    void* addr =
+        mmap(nullptr, length_, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (addr == MAP_FAILED) {
+        PLOG(WARNING) << "Fail to map shared memory";
+        return -1;
+    }
+    addr_ = addr;
+    ring_size_ = ring_size;
+    auto first = static_cast<Ring*>(addr_);
+    auto second = reinterpret_cast<Ring*>(first->data() + ring_size);
+    out_ = connected ? first : second;
+    in_ = connected ? second : first;
+    bell_ = std::move(bell);
+    peer_bell_ = std::move(peer_bell);
+    return 0;
+}
+
+void ShmLink::ClearBell(int fd) {
+    eventfd_t value;
+    eventfd_read(fd, &value);
+}
+
+void ShmLink::Watch(OwnedFD fd, std::function<void()> on_close) {
+    watcher_ = new Watcher(std::move(fd), std::move(on_close));
+    Poller::singleton()->AddPollIn(watcher_);
+}
+
+ssize_t ShmLink::Read(IOPortal* buf, size_t max_count) {
+    const uint64_t tail = in_->tail.load(std::memory_order_relaxed);
+    uint64_t head = in_->head.load(std::memory_order_acquire);
+    if (head == tail) {
+        in_->consumer_waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        head = in_->head.load(std::memory_order_acquire);
+        if (head == tail) {
+            errno = EAGAIN;
+            return -1;
+        }
+        in_->consumer_waiting.store(0, std::memory_order_relaxed);
+    }
+    if (head - tail > ring_size_) {
+        // Taken as the end of the connection.
+        LOG(ERROR) << "The shared memory ring is corrupted by the peer";
+        return 0;
+    }
+
+    const size_t n = std::min<uint64_t>(head - tail, max_count);
+    const size_t offset = tail & (ring_size_ - 1);
+    const size_t first = std::min(n, ring_size_ - offset);
+    buf->append(in_->data() + offset, first);
+    if (first < n)
+        buf->append(in_->data(), n - first);
+    in_->tail.store(tail + n, std::memory_order_release);
+    Notify(&in_->producer_waiting);
+    return n;
+}
+
+ssize_t ShmLink::Write(IOBuf* buf) {
+    const uint64_t head = out_->head.load(std::memory_order_relaxed);
+    uint64_t tail = out_->tail.load(std::memory_order_acquire);
+    if (head - tail > ring_size_) {
+        LOG(ERROR) << "The shared memory ring is corrupted by the peer";
+        errno = EPIPE;
+        return -1;
+    }
+    if (head - tail == ring_size_) {
+        out_->producer_waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        tail = out_->tail.load(std::memory_order_acquire);
+        if (head - tail == ring_size_) {
+            errno = EAGAIN;
+            return -1;
+        }
+        out_->producer_waiting.store(0, std::memory_order_relaxed);
+    }
+
+    const size_t n = std::min<uint64_t>(ring_size_ - (head - tail),
+                                        buf->size());
+    const size_t offset = head & (ring_size_ - 1);
+    const size_t first = std::min(n, ring_size_ - offset);
+    buf->cutn(out_->data() + offset, first);
+    if (first < n)
+        buf->cutn(out_->data(), n - first);
+    out_->head.store(head + n, std::memory_order_release);
+    Notify(&out_->consumer_waiting);
+    return n;
+}
+
+void ShmLink::Notify(std::atomic<uint32_t>* waiting) {
+    // Pairs with the fence of the waiting side, either it sees the update
+    // or the bell rings.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting->load(std::memory_order_relaxed) != 0 &&
+        waiting->exchange(0, std::memory_order_relaxed) != 0) {
+        eventfd_write(peer_bell_, 1);
+    }
+}
+
+}  // namespace urpc
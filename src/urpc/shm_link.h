@@ -0,0 +1,94 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "urpc/iobuf.h"
+#include "urpc/owned_fd.h"
+
+namespace urpc {
+
+/// The connection of two processes on the same host over shared memory,
+/// negotiated over a connected unix domain socket. A memfd maps a ring per
+/// direction, each side writes to one ring and reads from the other without
+/// any syscall, and rings the eventfd of its peer only if the peer is waiting
+/// for data or room. The socket is kept to learn when the peer goes away.
+///
+/// The transport polls its bell instead of the socket, so the protocols
+/// parse the bytes read from the ring like the ones read from a socket.
+class ShmLink {
+public:
+    ~ShmLink();
+
+    /// Create the rings of -shm_ring_size bytes each and send them over
+    /// `fd`, a connected unix domain socket. nullptr is returned on failure.
+    static std::unique_ptr<ShmLink> Connect(int fd);
+
+    /// Receive the rings sent by Connect() over `fd` as the first read of an
+    /// accepted unix domain socket. If the peer sent something else, the
+    /// bytes are appended to `buf` and `*link` is left empty. Returns the
+    /// bytes received like read(2).
+    static ssize_t Accept(int fd, IOPortal* buf, std::unique_ptr<ShmLink>* link);
+
+    /// The eventfd rung by the peer once it writes to an empty ring or frees
+    /// some room of a full one, polled by the transport instead of the socket.
+    OwnedFD TakeBell() { return std::move(bell_); }
+
+    /// Consume the notifications of the bell `fd`.
+    static void ClearBell(int fd);
+
+    /// Poll the socket `fd`, `on_close` is invoked once the peer closes it.
+    void Watch(OwnedFD fd, std::function<void()> on_close);
+
+    /// Read at most `max_count` bytes from the ring of the peer into `buf`.
+    /// -1 is returned with errno set to EAGAIN if the ring is empty.
+    ssize_t Read(IOPortal* buf, size_t max_count);
+
+    /// Cut the bytes of `buf` into the ring to the peer as many as it holds.
+    /// -1 is returned with errno set to EAGAIN if the ring is full.
+    ssize_t Write(IOBuf* buf);
+
+private:
+    struct Ring;
+    class Watcher;
+
+    ShmLink() = default;
+
+    /// Map the rings of `memfd` and take the bells, the ring written by the
+    /// side which connects comes first.
+    int Init(int memfd, size_t ring_size, bool connected, OwnedFD bell,
+             OwnedFD peer_bell);
+
+    /// Ring the bell of the peer if it waits on `waiting`.
+    void Notify(std::atomic<uint32_t>* waiting);
+
+    void* addr_{nullptr};
+    size_t length_{0};
+    Ring* in_{nullptr};
+    Ring* out_{nullptr};
+    size_t ring_size_{0};
+    OwnedFD bell_;
+    OwnedFD peer_bell_;
+    Watcher* watcher_{nullptr};
+};
+
+}  // namespace urpc
@@ -0,0 +1,114 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "socket_options.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_bool(socket_nodelay, true,
+            "Disable Nagle's algorithm on connections, so small messages "
+            "aren't delayed");
+DEFINE_int32(socket_send_buffer_size, 0,
+             "SO_SNDBUF of connections in bytes, 0 keeps the system default");
+DEFINE_int32(socket_recv_buffer_size, 0,
+             "SO_RCVBUF of connections in bytes, 0 keeps the system default");
+DEFINE_bool(socket_quickack, false,
+            "Acknowledge the data read at once instead of delaying the ack");
+DEFINE_bool(tcp_fast_open, false,
+            "Enable TCP fast open for the connections and listened sockets");
+DEFINE_int32(tcp_fast_open_queue_size, 1024,
+             "The max pending fast open requests of a listened socket");
+DEFINE_bool(socket_keepalive, false,
+            "Probe the peers of idle connections by TCP keepalive, so the "
+            "connections of crashed hosts are closed");
+DEFINE_int32(socket_keepalive_idle_s, 0,
+             "Seconds idle before the first keepalive probe, 0 keeps the "
+             "system default");
+DEFINE_int32(socket_keepalive_interval_s, 0,
+             "Seconds between keepalive probes, 0 keeps the system default");
+DEFINE_int32(socket_keepalive_count, 0,
+             "Unacknowledged keepalive probes before the connection is "
+             "closed, 0 keeps the system default");
+
+namespace urpc {
+
+namespace {
+
+void SetOption(int fd, int level, int name, int value, const char* desc) {
+    if (setsockopt(fd, level, name, &value, sizeof(value)) != 0)
+        PLOG(WARNING) << "Fail to set " << desc << " of fd " << fd;
+}
+
+}  // namespace
+
+void SetSocketOptions(int fd, int family) {
+    if (FLAGS_socket_nodelay && family != AF_UNIX)
+        SetOption(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+    if (FLAGS_socket_send_buffer_size > 0) {
+        SetOption(fd, SOL_SOCKET, SO_SNDBUF, FLAGS_socket_send_buffer_size,
+                  "SO_SNDBUF");
+    }
+    if (FLAGS_socket_recv_buffer_size > 0) {
+        SetOption(fd, SOL_SOCKET, SO_RCVBUF, FLAGS_socket_recv_buffer_size,
+                  "SO_RCVBUF");
+    }
+    if (FLAGS_socket_keepalive && family != AF_UNIX) {
+        SetOption(fd, SOL_SOCKET, SO_KEEPALIVE, 1, "SO_KEEPALIVE");
+        if (FLAGS_socket_keepalive_idle_s > 0) {
+            SetOption(fd, IPPROTO_TCP, TCP_KEEPIDLE,
+                      FLAGS_socket_keepalive_idle_s, "TCP_KEEPIDLE");
+        }
+        if (FLAGS_socket_keepalive_interval_s > 0) {
+            SetOption(fd, IPPROTO_TCP, TCP_KEEPINTVL,
+                      FLAGS_socket_keepalive_interval_s, "TCP_KEEPINTVL");
+        }
+        if (FLAGS_socket_keepalive_count > 0) {
+            SetOption(fd, IPPROTO_TCP, TCP_KEEPCNT,
+                      FLAGS_socket_keepalive_count, "TCP_KEEPCNT");
+        }
+    }
+    if (family != AF_UNIX)
+        RearmQuickAck(fd);
+}
+
+void SetFastOpen(int fd, bool listen) {
+    if (!FLAGS_tcp_fast_open)
+        return;
+    if (listen) {
+#if defined(TCP_FASTOPEN)
+        SetOption(fd, IPPROTO_TCP, TCP_FASTOPEN,
+                  FLAGS_tcp_fast_open_queue_size, "TCP_FASTOPEN");
+#endif
+    } else {
+        // REQUIRED: Linux >= 4.11
+#if defined(TCP_FASTOPEN_CONNECT)
+        SetOption(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1,
+                  "TCP_FASTOPEN_CONNECT");
+#endif
+    }
+}
+
+void RearmQuickAck(int fd) {
+#if defined(TCP_QUICKACK)
+    if (FLAGS_socket_quickack)
+        SetOption(fd, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+#endif
+}
+
+}  // namespace urpc
@@ -0,0 +1,33 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+namespace urpc {
+
+/// Apply the presets of the -socket_* flags, such as the buffer sizes and
+/// TCP keepalive, to a connection of `family` before it connects or once it's
+/// accepted. The TCP options are skipped for unix domain sockets.
+void SetSocketOptions(int fd, int family);
+
+/// Enable TCP fast open on a socket about to connect or listen if
+/// -tcp_fast_open, where the kernel supports it. Connecting sockets carry the
+/// first request in the SYN once the server is known to support it.
+void SetFastOpen(int fd, bool listen);
+
+/// Re-arm TCP_QUICKACK after a read if -socket_quickack, the kernel clears it
+/// once it falls back to delayed acks.
+void RearmQuickAck(int fd);
+
+}  // namespace urpc
@@ -0,0 +1,90 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stats.h"
+
+#include <vector>
+
+#include "acceptor.h"
+#include "poller.h"
+#include "transport.h"
+
+namespace urpc {
+
+StatsRegistry* StatsRegistry::singleton() {
+    static StatsRegistry registry;
+    return &registry;
+}
+
+void StatsRegistry::Register(Transport* transport) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    transports_.insert(transport);
+}
+
+void StatsRegistry::Unregister(Transport* transport) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    transports_.erase(transport);
+}
+
+void StatsRegistry::Register(Poller* poller) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    pollers_.insert(poller);
+}
+
+void StatsRegistry::Unregister(Poller* poller) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    pollers_.erase(poller);
+}
+
+void StatsRegistry::Register(Acceptor* acceptor) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    acceptors_.insert(acceptor);
+}
+
+void StatsRegistry::Unregister(Acceptor* acceptor) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    acceptors_.erase(acceptor);
+}
+
+// The snapshots are taken with the lock held, so the objects couldn't be
+// destroyed by their owner threads meanwhile.
+
+std::vector<TransportStats> StatsRegistry::ListTransports() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    std::vector<TransportStats> stats(transports_.size());
+    size_t i = 0;
+    for (auto transport : transports_)
+        transport->GetStats(&stats[i++]);
+    return stats;
+}
+
+std::vector<PollerStats> StatsRegistry::ListPollers() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    std::vector<PollerStats> stats(pollers_.size());
+    size_t i = 0;
+    for (auto poller : pollers_)
+        poller->GetStats(&stats[i++]);
+    return stats;
+}
+
+std::vector<AcceptorStats> StatsRegistry::ListAcceptors() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    std::vector<AcceptorStats> stats(acceptors_.size());
+    size_t i = 0;
+    for (auto acceptor : acceptors_)
+        acceptor->GetStats(&stats[i++]);
+    return stats;
+}
+
+}  // namespace urpc
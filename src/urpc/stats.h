@@ -0,0 +1,117 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include <urpc/endpoint.h>
+
+namespace urpc {
+
+class Acceptor;
+class Poller;
+class Transport;
+
+/// A snapshot of the counters of a connection.
+struct TransportStats {
+    /// The id addressing the connection by IOHandle::Address().
+    uint64_t id{0};
+    int fd{-1};
+    /// The id of the poller which the connection belongs to.
+    uint64_t poller_id{0};
+    bool server_side{false};
+    EndPoint remote_side;
+
+    uint64_t bytes_in{0};
+    uint64_t bytes_out{0};
+    uint64_t messages_in{0};
+    uint64_t messages_out{0};
+    /// The number of reads/writes returned EAGAIN.
+    uint64_t read_eagain{0};
+    uint64_t write_eagain{0};
+
+    /// The writes waiting in queue, including the one being written.
+    uint64_t pending_writes{0};
+    uint64_t pending_bytes{0};
+    /// The number of times the pending bytes exceeded --write_high_watermark,
+    /// and the writes rejected since then.
+    uint64_t overloaded{0};
+    uint64_t rejected_writes{0};
+};
+
+/// A snapshot of the counters of a poller (an I/O loop).
+struct PollerStats {
+    uint64_t id{0};
+    /// The linux thread id of the loop.
+    int tid{0};
+    /// The number of I/O handles registered.
+    uint64_t handles{0};
+    /// The number of times the poller returned from waiting.
+    uint64_t wakeups{0};
+    /// The number of events dispatched, `events / wakeups` is the average
+    /// events per wakeup.
+    uint64_t events{0};
+    uint64_t max_events_per_wakeup{0};
+    /// The time spent in dispatching events, the ratio to the uptime is the
+    /// load of the loop.
+    uint64_t busy_us{0};
+    uint64_t uptime_us{0};
+};
+
+/// A snapshot of the counters of a listening socket.
+struct AcceptorStats {
+    int listen_fd{-1};
+    uint64_t poller_id{0};
+    uint64_t accepted{0};
+    /// The accepted connections closed at once, over the limit of the server
+    /// or as the descriptors run out.
+    uint64_t rejected{0};
+    /// The open connections accepted.
+    uint64_t connections{0};
+    uint64_t uptime_us{0};
+};
+
+/// The registry of live transports, pollers and acceptors of all threads.
+/// Objects register themselves when created and unregister when destroyed,
+/// their counters are atomics so snapshots could be taken from any thread.
+class StatsRegistry final {
+public:
+    static StatsRegistry* singleton();
+
+    void Register(Transport* transport);
+    void Unregister(Transport* transport);
+    void Register(Poller* poller);
+    void Unregister(Poller* poller);
+    void Register(Acceptor* acceptor);
+    void Unregister(Acceptor* acceptor);
+
+    std::vector<TransportStats> ListTransports();
+    std::vector<PollerStats> ListPollers();
+    std::vector<AcceptorStats> ListAcceptors();
+
+private:
+    StatsRegistry() = default;
+
+    std::mutex mutex_;
+    std::unordered_set<Transport*> transports_;
+    std::unordered_set<Poller*> pollers_;
+    std::unordered_set<Acceptor*> acceptors_;
+};
+
+}  // namespace urpc
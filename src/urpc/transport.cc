@@ -20,18 +20,76 @@
 #include <string>
 #include <utility>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "base.h"
+#include "idle_wheel.h"
 #include "poller.h"
+#include "socket_options.h"
+#include "utils/atomic.h"
+
+DEFINE_int64(write_high_watermark, 64 * 1024 * 1024,
+             "The pending bytes of a connection above which it's overloaded, "
+             "0 means unlimited");
+DEFINE_int64(write_low_watermark, 16 * 1024 * 1024,
+             "The pending bytes of an overloaded connection below which it "
+             "recovers");
 
 namespace urpc {
 
+using utils::DecreaseRelaxed;
+using utils::IncreaseRelaxed;
+
+Transport::Transport(int fd, const EndPoint& remote_side, bool server_side)
+    : fd_(fd),
+      remote_side_(remote_side),
+      server_side_(server_side),
+      poller_id_(Poller::singleton()->id()) {
+    counters_.fd.store(fd, std::memory_order_relaxed);
+}
+
 Transport::~Transport() {
     CHECK(!fd_.valid()) << "Please reset transport before destruction";
+    if (idle_slot_ >= 0)
+        IdleWheel::singleton()->Remove(this);
+}
+
+void Transport::set_fd(OwnedFD fd) {
+    fd_ = std::move(fd);
+    counters_.fd.store(fd_, std::memory_order_relaxed);
+}
+
+void Transport::GetStats(TransportStats* stats) const {
+    stats->id = id();
+    stats->fd = counters_.fd.load(std::memory_order_relaxed);
+    stats->poller_id = poller_id_;
+    stats->server_side = server_side_;
+    stats->remote_side = remote_side_;
+    stats->bytes_in = counters_.bytes_in.load(std::memory_order_relaxed);
+    stats->bytes_out = counters_.bytes_out.load(std::memory_order_relaxed);
+    stats->messages_in = counters_.messages_in.load(std::memory_order_relaxed);
+    stats->messages_out = counters_.messages_out.load(std::memory_order_relaxed);
+    stats->read_eagain = counters_.read_eagain.load(std::memory_order_relaxed);
+    stats->write_eagain = counters_.write_eagain.load(std::memory_order_relaxed);
+    stats->pending_writes =
+        counters_.pending_writes.load(std::memory_order_relaxed);
+    stats->pending_bytes =
+        counters_.pending_bytes.load(std::memory_order_relaxed);
+    stats->overloaded = counters_.overloaded.load(std::memory_order_relaxed);
+    stats->rejected_writes =
+        counters_.rejected_writes.load(std::memory_order_relaxed);
+}
+
+void Transport::OnMessageRead() { IncreaseRelaxed(&counters_.messages_in, 1); }
+
+void Transport::OnWriteRejected() {
+    IncreaseRelaxed(&counters_.rejected_writes, 1);
 }
 
 void Transport::Reset(int code, std::string reason) {
+    if (idle_slot_ >= 0)
+        IdleWheel::singleton()->Remove(this);
     write_buf_.clear();
     read_buf_.clear();
 
@@ -40,16 +98,68 @@ void Transport::Reset(int code, std::string reason) {
         current_cntl_->SetFailed(code, reason);
         current_cntl_ = nullptr;
     }
+    current_written_ = false;
 
     for (auto&& [cntl, buf] : pending_writes_) {
         cntl->SetFailed(code, reason);
     }
     pending_writes_.clear();
+    counters_.pending_writes.store(0, std::memory_order_relaxed);
+    counters_.pending_bytes.store(0, std::memory_order_relaxed);
+    overloaded_ = false;
+    read_paused_ = false;
+    draining_ = false;
 
     if (poll_in() || poll_out())
         Poller::singleton()->RemoveConsumer(this);
 
-    fd_.reset();
+    set_fd(OwnedFD());
+    shm_.reset();
+
+    // Streams might write or be removed in their callbacks.
+    auto streams = std::move(streams_);
+    streams_.clear();
+    for (auto&& [id, stream] : streams) {
+        stream->OnReset(code);
+    }
+}
+
+void Transport::set_idle_timeout_s(int32_t timeout_s) {
+    idle_timeout_s_ = timeout_s;
+    if (timeout_s > 0 && fd_.valid()) {
+        IdleWheel::singleton()->Add(this);
+    } else {
+        IdleWheel::singleton()->Remove(this);
+    }
+}
+
+bool Transport::Idle() const {
+    return !current_cntl_ && pending_writes_.empty() && streams_.empty();
+}
+
+TransportStream* Transport::FindStream(uint64_t id) const {
+    auto it = streams_.find(id);
+    if (it == streams_.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void Transport::AddStream(uint64_t id, TransportStream* stream) {
+    streams_.insert({id, stream});
+}
+
+void Transport::RemoveStream(uint64_t id) { streams_.erase(id); }
+
+void Transport::UseSharedMemory(std::unique_ptr<ShmLink> link) {
+    const bool polled = poll_in();
+    if (poll_in() || poll_out())
+        Poller::singleton()->RemoveConsumer(this);
+    link->Watch(std::move(fd_), [this] { Reset(ERR_EOF, "end of file"); });
+    set_fd(link->TakeBell());
+    shm_ = std::move(link);
+    if (polled)
+        Poller::singleton()->AddPollIn(this);
 }
 
 int Transport::StartRead() {
@@ -65,6 +175,8 @@ int Transport::StartRead() {
 int Transport::StartWrite(Controller* cntl, IOBuf buf) {
     assert(!buf.empty());
 
+    IncreaseRelaxed(&counters_.pending_writes, 1);
+    IncreaseRelaxed(&counters_.pending_bytes, buf.size());
     if (current_cntl_) {
         LOG(INFO) << "Transport::StartWrite insert into pending writes";
         pending_writes_.emplace_back(std::pair{cntl, std::move(buf)});
@@ -75,6 +187,18 @@ int Transport::StartWrite(Controller* cntl, IOBuf buf) {
         DoWrite();
     }
 
+    // Checked after the write, a large message written at once doesn't
+    // overload the transport.
+    const int64_t pending_bytes =
+        counters_.pending_bytes.load(std::memory_order_relaxed);
+    if (!overloaded_ && FLAGS_write_high_watermark > 0 &&
+        pending_bytes > FLAGS_write_high_watermark) {
+        LOG(WARNING) << "Transport fd " << static_cast<int>(fd_)
+                     << " is overloaded with " << pending_bytes
+                     << " pending bytes";
+        overloaded_ = true;
+        IncreaseRelaxed(&counters_.overloaded, 1);
+    }
     return 0;
 }
 
@@ -86,56 +210,120 @@ int Transport::DoWrite() {
 }
 
 int Transport::HandleReadEvent() {
-    assert(fd_.valid());
+    // Reset by the write of the same event.
+    if (!fd_.valid())
+        return 0;
+    int code = ERR_OK;
+    reading_ = true;
+    if (shm_) {
+        // The bell rings for the room freed in the ring of writes too.
+        ShmLink::ClearBell(fd_);
+        if (!write_buf_.empty())
+            HandleWriteEvent();
+    }
     while (true) {
-        int n = read_buf_.append_from_file_descriptor(fd_, 1024 * 1024);
+        // Reset by a failed write of a response.
+        if (!fd_.valid())
+            break;
+
+        // The poller is edge triggered, so the input left in the socket is
+        // read once the transport recovers.
+        if (overloaded_ && server_side_) {
+            read_paused_ = true;
+            break;
+        }
+
+        int n = shm_ ? shm_->Read(&read_buf_, 1024 * 1024)
+                     : read_buf_.append_from_file_descriptor(fd_, 1024 * 1024);
         if (n < 0) {
             if (errno == EINTR) {
                 continue;
             } else if (errno != EAGAIN) {
-                PLOG(ERROR)
-                    << "append from file descriptor " << static_cast<int>(fd_);
-                assert(false && "unknown error");
+                // Such as ECONNRESET.
+                PLOG(WARNING)
+                    << "Fail to read from fd " << static_cast<int>(fd_);
+                Reset(ERR_CONNECT, "Fail to read");
+                break;
             } else {
                 assert(poll_in());
+                IncreaseRelaxed(&counters_.read_eagain, 1);
+                // Return the block cached for the next read to the thread,
+                // so the idle connections hold no memory.
+                if (read_buf_.empty())
+                    read_buf_.return_cached_blocks();
                 break;
             }
         } else if (n == 0) {
-            // EOF
-            assert(false && "TODO handle end of file");
+            // The requests already parsed are still served, the writes of
+            // their responses fail once the transport is reset.
+            LOG(INFO) << "Transport fd " << static_cast<int>(fd_)
+                      << " closed by peer";
+            Reset(ERR_EOF, "end of file");
+            break;
         } else {
             LOG(INFO) << "Read " << n << " bytes from fd "
                       << static_cast<int>(fd_);
+            IncreaseRelaxed(&counters_.bytes_in, n);
+            if (idle_slot_ >= 0)
+                last_active_ = IdleWheel::singleton()->now();
+            if (remote_side_.family != AF_UNIX)
+                RearmQuickAck(fd_);
             // TODO(w41ter) handle result.
             int res = OnRead(&read_buf_);
             if (res != ERR_OK) {
-                return res;
+                code = res;
+                break;
             }
         }
     }
-    return 0;
+    reading_ = false;
+    return code;
 }
 
 int Transport::HandleWriteEvent() {
     while (!write_buf_.empty()) {
-        int n = write_buf_.cut_into_file_descriptor(fd_);
+        int n = shm_ ? shm_->Write(&write_buf_)
+                     : write_buf_.cut_into_file_descriptor(fd_);
         if (n < 0) {
             if (errno == EINTR) {
                 continue;
-            } else if (errno != EAGAIN) {
-                assert(false && "unknown error");
+            } else if (errno != EAGAIN && errno != EINPROGRESS) {
+                PLOG(WARNING) << "Fail to write to fd "
+                              << static_cast<int>(fd_);
+                Reset(ERR_CONNECT, "Fail to write");
+                return 0;
             } else {
-                if (!poll_out())
+                // A connection with TCP fast open fails with EINPROGRESS
+                // where its first write isn't carried by the SYN, it's
+                // writable once connected.
+                IncreaseRelaxed(&counters_.write_eagain, 1);
+                // The bell of shared memory rings once the peer reads.
+                if (!shm_ && !poll_out())
                     Poller::singleton()->AddPollOut(this);
                 break;
             }
         }
         LOG(INFO) << "Write " << n << " bytes to fd " << static_cast<int>(fd_);
+        IncreaseRelaxed(&counters_.bytes_out, n);
+        if (idle_slot_ >= 0)
+            last_active_ = IdleWheel::singleton()->now();
+        DecreaseRelaxed(&counters_.pending_bytes, n);
+        current_written_ = true;
+        if (overloaded_ &&
+            static_cast<int64_t>(counters_.pending_bytes.load(
+                std::memory_order_relaxed)) <= FLAGS_write_low_watermark) {
+            LOG(WARNING) << "Transport fd " << static_cast<int>(fd_)
+                         << " recovers from overloaded";
+            overloaded_ = false;
+        }
 
         if (write_buf_.empty()) {
             write_buf_.clear();
+            IncreaseRelaxed(&counters_.messages_out, 1);
+            DecreaseRelaxed(&counters_.pending_writes, 1);
             OnWriteDone(current_cntl_);
             current_cntl_ = nullptr;
+            current_written_ = false;
 
             if (!pending_writes_.empty()) {
                 current_cntl_ = pending_writes_.front().first;
@@ -144,6 +332,12 @@ int Transport::HandleWriteEvent() {
             }
         }
     }
+
+    // The reads paused are resumed by the outer read loop if any.
+    if (read_paused_ && !overloaded_ && !reading_) {
+        read_paused_ = false;
+        return HandleReadEvent();
+    }
     return 0;
 }
 
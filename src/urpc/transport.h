@@ -17,19 +17,37 @@
 #include <urpc/controller.h>
 
 #include <deque>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
 
+#include <atomic>
+
+#include <urpc/endpoint.h>
+
 #include "urpc/base.h"
 #include "urpc/iobuf.h"
 #include "urpc/owned_fd.h"
+#include "urpc/shm_link.h"
+#include "urpc/stats.h"
 
 namespace urpc {
 
+/// A stream multiplexed over a transport by its protocol.
+class TransportStream {
+public:
+    virtual ~TransportStream() = default;
+
+    /// The transport is reset, the stream is already removed from it.
+    virtual void OnReset(int code) = 0;
+};
+
 class Transport : public IOHandle {
 public:
-    Transport() {}
-    explicit Transport(int fd) : fd_(fd) {}
+    /// Registered to the stats by the concrete transports once they are
+    /// built, and unregistered before they are destroyed.
+    Transport(int fd, const EndPoint& remote_side, bool server_side);
     Transport(const Transport&) = delete;
     Transport& operator=(const Transport&) = delete;
 
@@ -41,6 +59,35 @@ public:
     int fd() const override { return fd_; }
     void Reset(int code, std::string reason) override;
 
+    /// The pending bytes exceeded --write_high_watermark and haven't fallen
+    /// to --write_low_watermark since. Servers stop reading requests from the
+    /// connection meanwhile, and clients should fail new writes fast.
+    bool overloaded() const { return overloaded_; }
+
+    /// Invoked once a write is rejected since the transport is overloaded.
+    void OnWriteRejected();
+
+    /// Take a snapshot of the counters, it could be invoked from any thread.
+    void GetStats(TransportStats* stats) const;
+
+    /// Close the transport with ERR_IDLE once nothing is read or written for
+    /// `timeout_s` seconds while it's idle, non-positive values mean never.
+    void set_idle_timeout_s(int32_t timeout_s);
+
+    /// Nothing is being written or waited for, so the transport could be
+    /// closed once it's idle for too long.
+    virtual bool Idle() const;
+
+    /// The server of the transport is stopping, the clients are asked to move
+    /// their calls to the other servers.
+    bool draining() const { return draining_; }
+    virtual void OnDraining() { draining_ = true; }
+
+    /// The streams over the transport by id, [`nullptr`] if not found.
+    TransportStream* FindStream(uint64_t id) const;
+    void AddStream(uint64_t id, TransportStream* stream);
+    void RemoveStream(uint64_t id);
+
 protected:
     virtual int DoWrite();
     virtual int OnWriteDone(Controller* cntl) = 0;
@@ -49,11 +96,61 @@ protected:
     int HandleReadEvent() override;
     int HandleWriteEvent() override;
 
+    /// Invoked by subclasses once a message is parsed from `read_buf_`.
+    void OnMessageRead();
+
+    /// Exchange the bytes over `link` instead of the unix domain socket, the
+    /// bell of the link is polled instead and the socket is watched for the
+    /// close of the peer.
+    void UseSharedMemory(std::unique_ptr<ShmLink> link);
+
+    /// Replace `fd_`, the snapshots of the stats read the copy.
+    void set_fd(OwnedFD fd);
+
     OwnedFD fd_;
+    /// Never changed, read by the stats of any thread.
+    const EndPoint remote_side_;
+    const bool server_side_;
     IOPortal read_buf_;
     IOBuf write_buf_;
     Controller* current_cntl_{nullptr};
+    /// Some bytes of the message of `current_cntl_` are written, it might
+    /// have reached the peer.
+    bool current_written_{false};
     std::deque<std::pair<Controller*, IOBuf>> pending_writes_;
+    std::unique_ptr<ShmLink> shm_;
+
+private:
+    struct Counters {
+        /// The copy of `fd_`.
+        std::atomic<int> fd{-1};
+        std::atomic<uint64_t> bytes_in{0};
+        std::atomic<uint64_t> bytes_out{0};
+        std::atomic<uint64_t> messages_in{0};
+        std::atomic<uint64_t> messages_out{0};
+        std::atomic<uint64_t> read_eagain{0};
+        std::atomic<uint64_t> write_eagain{0};
+        std::atomic<uint64_t> pending_writes{0};
+        std::atomic<uint64_t> pending_bytes{0};
+        std::atomic<uint64_t> overloaded{0};
+        std::atomic<uint64_t> rejected_writes{0};
+    };
+
+    friend class IdleWheel;
+
+    const uint64_t poller_id_;
+    Counters counters_;
+    /// Maintained by the idle wheel of the thread.
+    int32_t idle_timeout_s_{-1};
+    uint64_t last_active_{0};
+    int idle_slot_{-1};
+    bool overloaded_{false};
+    bool draining_{false};
+    /// A read event is being handled, or is postponed until the transport
+    /// isn't overloaded.
+    bool reading_{false};
+    bool read_paused_{false};
+    std::unordered_map<uint64_t, TransportStream*> streams_;
 };
 
 }  // namespace urpc
@@ -0,0 +1,98 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "utils/atomic.h"
+
+namespace urpc {
+namespace utils {
+namespace internal {
+
+inline size_t NextCombinerId() {
+    static std::atomic<size_t> next_id{0};
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline std::vector<void*>& ThreadLocalAgents() {
+    static thread_local std::vector<void*> agents;
+    return agents;
+}
+
+}  // namespace internal
+
+/// AgentCombiner gives each thread its own `Agent`, so writers never contend
+/// with each other, and readers combine all agents on demand.
+///
+/// The agent is only written by its owner thread, the fields of `Agent` should
+/// be atomics updated with relaxed orders so they could be read concurrently.
+/// Agents are kept after the owner thread exits, until the combiner is
+/// destroyed, so no counts are lost.
+template <typename Agent>
+class AgentCombiner {
+public:
+    AgentCombiner() : id_(internal::NextCombinerId()) {}
+    ~AgentCombiner() {
+        for (auto agent : agents_)
+            delete agent;
+    }
+    AgentCombiner(const AgentCombiner&) = delete;
+    AgentCombiner& operator=(const AgentCombiner&) = delete;
+
+    /// Return the agent of the calling thread, create it if not exists.
+    Agent* agent() {
+        auto& agents = internal::ThreadLocalAgents();
+        if (id_ < agents.size() && agents[id_])
+            return static_cast<Agent*>(agents[id_]);
+        return CreateAgent();
+    }
+
+    /// Invoke `fn(const Agent&)` for the agents of all threads.
+    template <typename Fn>
+    void ForEach(Fn&& fn) const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        for (auto agent : agents_)
+            fn(*agent);
+    }
+
+private:
+    Agent* CreateAgent() {
+        Agent* agent = new Agent;
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            agents_.push_back(agent);
+        }
+
+        auto& agents = internal::ThreadLocalAgents();
+        if (agents.size() <= id_)
+            agents.resize(id_ + 1, nullptr);
+        agents[id_] = agent;
+        return agent;
+    }
+
+    /// Combiner ids are never reused, so the thread local slots of a
+    /// destroyed combiner are never visited again.
+    const size_t id_;
+    mutable std::mutex mutex_;
+    std::vector<Agent*> agents_;
+};
+
+}  // namespace utils
+}  // namespace urpc
@@ -0,0 +1,42 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+namespace urpc {
+namespace utils {
+
+// Update a counter which has a single writer without a locked instruction,
+// readers of other threads always observe a value written by the writer.
+
+inline void IncreaseRelaxed(std::atomic<uint64_t>* value, uint64_t n) {
+    value->store(value->load(std::memory_order_relaxed) + n,
+                 std::memory_order_relaxed);
+}
+
+inline void IncreaseRelaxed(std::atomic<int64_t>* value, int64_t n) {
+    value->store(value->load(std::memory_order_relaxed) + n,
+                 std::memory_order_relaxed);
+}
+
+inline void DecreaseRelaxed(std::atomic<uint64_t>* value, uint64_t n) {
+    value->store(value->load(std::memory_order_relaxed) - n,
+                 std::memory_order_relaxed);
+}
+
+}  // namespace utils
+}  // namespace urpc
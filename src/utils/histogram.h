@@ -0,0 +1,143 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace urpc {
+namespace utils {
+
+/// A log-linear histogram in the spirit of HdrHistogram. Values below
+/// `kSubBucketCount` are recorded exactly, larger values are recorded with
+/// `kSubBucketBits - 1` bits of precision, so the relative error is bounded by
+/// 1 / kSubBucketHalf.
+///
+/// It isn't thread safe, the users should record into a per-thread instance
+/// and `Merge` them when reading.
+template <size_t kSubBucketBits_>
+class BasicHistogram {
+public:
+    static constexpr size_t kSubBucketBits = kSubBucketBits_;
+    static constexpr size_t kSubBucketCount = 1 << kSubBucketBits;
+    static constexpr size_t kSubBucketHalf = kSubBucketCount / 2;
+    /// Values above 2^kMaxValueBits are clamped to the last bucket.
+    static constexpr size_t kMaxValueBits = 40;
+    static constexpr size_t kBucketCount =
+        (kMaxValueBits - kSubBucketBits + 3) * kSubBucketHalf;
+
+    BasicHistogram() { Reset(); }
+
+    void Record(uint64_t value) {
+        counts_[BucketIndex(value)] += 1;
+        total_count_ += 1;
+        sum_ += value;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    void Merge(const BasicHistogram& other) {
+        for (size_t i = 0; i < kBucketCount; ++i)
+            counts_[i] += other.counts_[i];
+        total_count_ += other.total_count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    /// Add `count` values to the bucket `index` directly, the extremes and the
+    /// sum are approximated by the lower bound of the bucket.
+    void AddToBucket(size_t index, uint64_t count) {
+        if (count == 0)
+            return;
+        uint64_t value = BucketLowerBound(index);
+        counts_[index] += count;
+        total_count_ += count;
+        sum_ += value * count;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    void Reset() {
+        counts_.fill(0);
+        total_count_ = 0;
+        sum_ = 0;
+        min_ = std::numeric_limits<uint64_t>::max();
+        max_ = 0;
+    }
+
+    /// Return the value at the `ratio` (in [0, 1]) percentile, eg. 0.999 for
+    /// p999. The lowest equivalent value of the bucket is returned.
+    uint64_t Percentile(double ratio) const {
+        if (total_count_ == 0)
+            return 0;
+        if (ratio >= 1.0)
+            return max_;
+
+        uint64_t target = static_cast<uint64_t>(ratio * total_count_) + 1;
+        target = std::min(target, total_count_);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            seen += counts_[i];
+            if (seen >= target)
+                return std::clamp(BucketLowerBound(i), min_, max_);
+        }
+        return max_;
+    }
+
+    /// The number of values recorded into the bucket `index`.
+    uint64_t CountAt(size_t index) const { return counts_[index]; }
+
+    uint64_t count() const { return total_count_; }
+    uint64_t sum() const { return sum_; }
+    uint64_t min() const { return total_count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const {
+        return total_count_ ? static_cast<double>(sum_) / total_count_ : 0.0;
+    }
+
+    static size_t BucketIndex(uint64_t value) {
+        if (value < kSubBucketCount)
+            return value;
+        size_t msb = 63 - __builtin_clzll(value);
+        if (msb > kMaxValueBits)
+            return kBucketCount - 1;
+        size_t shift = msb - (kSubBucketBits - 1);
+        return shift * kSubBucketHalf + (value >> shift);
+    }
+
+    static uint64_t BucketLowerBound(size_t index) {
+        if (index < kSubBucketCount)
+            return index;
+        size_t shift = index / kSubBucketHalf - 1;
+        uint64_t sub_bucket = index - shift * kSubBucketHalf;
+        return sub_bucket << shift;
+    }
+
+private:
+    std::array<uint64_t, kBucketCount> counts_;
+    uint64_t total_count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
+
+using Histogram = BasicHistogram<7>;
+
+}  // namespace utils
+}  // namespace urpc
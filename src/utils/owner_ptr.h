@@ -17,25 +17,47 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <atomic>
 #include <utility>
 
 namespace urpc {
 namespace utils {
 
+/// An intrusive reference count starting at 1, the references could be
+/// added and released by any thread.
 class RefCount {
 public:
     RefCount() : ref_count_(1) {}
-    ~RefCount() { assert(ref_count_ <= 1); }
+    virtual ~RefCount() {
+        assert(ref_count_.load(std::memory_order_relaxed) <= 1);
+    }
 
-    void AddRef() { ref_count_ += 1; }
+    void AddRef() { ref_count_.fetch_add(1, std::memory_order_relaxed); }
     void RelRef() {
-        if (--ref_count_ == 0) {
+        // The writes of the other owners happen before the deletion.
+        if (ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
             delete this;
         }
     }
 
+    /// Add a reference unless the last one is released already, in which
+    /// case the object is being destroyed.
+    bool TryAddRef() {
+        size_t count = ref_count_.load(std::memory_order_relaxed);
+        while (count != 0) {
+            if (ref_count_.compare_exchange_weak(count, count + 1,
+                                                 std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+
+    size_t ref_count() const {
+        return ref_count_.load(std::memory_order_relaxed);
+    }
+
 private:
-    size_t ref_count_;
+    std::atomic<size_t> ref_count_;
 };
 
 template <typename T>
@@ -59,15 +81,20 @@ public:
     T* get() { return ptr_; }
     const T* get() const { return ptr_; }
 
-    T& operator*() { return ptr_; }
-    const T& operator*() const { return ptr_; }
+    T& operator*() { return *ptr_; }
+    const T& operator*() const { return *ptr_; }
 
     T* operator->() { return ptr_; }
     const T* operator->() const { return ptr_; }
 
-    explicit operator bool() const { return get() == nullptr; }
+    explicit operator bool() const { return get() != nullptr; }
 
-    T* release() { return ptr_; }
+    /// Give up the reference without releasing it.
+    T* release() {
+        T* ptr = ptr_;
+        ptr_ = nullptr;
+        return ptr;
+    }
 
     void reset(T* ptr = nullptr) {
         if (ptr_ && ptr != ptr_)
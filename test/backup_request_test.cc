@@ -0,0 +1,159 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <echo.pb.h>
+#include <gtest/gtest.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "urpc/poller.h"
+#include "urpc/stats.h"
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+/// Reply the next request after 300ms once set slow, and the others at
+/// once. The response carries the index of the request served.
+class SlowEchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        response->set_message_count(++calls_);
+        if (slow_) {
+            slow_ = false;
+            Poller::singleton()->AddTimer(300, [done] { done->Run(); });
+        } else {
+            done->Run();
+        }
+    }
+
+    void set_slow() { slow_ = true; }
+    int calls() const { return calls_; }
+
+private:
+    bool slow_{false};
+    int calls_{0};
+};
+
+void SetTrue(bool* flag) { *flag = true; }
+
+/// Call Echo and return the milliseconds elapsed.
+int64_t Echo(Channel* channel, Controller* cntl, EchoResponse* response) {
+    EchoService_Stub stub(channel);
+    EchoRequest request;
+    request.set_message("hello");
+    bool done = false;
+    auto start = std::chrono::steady_clock::now();
+    stub.Echo(cntl, &request, response, NewCallback(&SetTrue, &done));
+    while (!done) {
+        IOContext context(LOOP_ONCE);
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+void RunFor(int64_t ms) {
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    while (std::chrono::steady_clock::now() < deadline) {
+        IOContext context(LOOP_ONCE);
+    }
+}
+
+}  // namespace
+
+TEST(BackupRequestTest, Timer) {
+    std::vector<int> fired;
+    Poller* poller = Poller::singleton();
+    poller->AddTimer(20, [&] { fired.push_back(2); });
+    uint64_t removed = poller->AddTimer(10, [&] { fired.push_back(0); });
+    poller->AddTimer(10, [&] { fired.push_back(1); });
+    EXPECT_TRUE(poller->RemoveTimer(removed));
+    EXPECT_FALSE(poller->RemoveTimer(removed));
+
+    RunFor(50);
+    EXPECT_EQ(fired, (std::vector<int>{1, 2}));
+}
+
+TEST(BackupRequestTest, Channel) {
+    // The services are shared by the servers of a thread.
+    auto service = new SlowEchoServiceImpl;
+    Server server1, server2, server3;
+    server1.AddService(service, ServiceOwnership::SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server1.Start(EndPoint(IP_ANY, 8100)), 0);
+    ASSERT_EQ(server2.Start(EndPoint(IP_ANY, 8101)), 0);
+    ASSERT_EQ(server3.Start(EndPoint(IP_ANY, 8102)), 0);
+
+    ChannelOptions options;
+    options.backup_request_ms = 20;
+    Channel channel;
+    ASSERT_EQ(channel.Init("127.0.0.1:8100", options), 0);
+
+    // The backup request wins, the late response of the first one is
+    // discarded without breaking its connection.
+    service->set_slow();
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    EchoResponse response;
+    EXPECT_LT(Echo(&channel, cntl.get(), &response), 200);
+    EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+    EXPECT_EQ(response.message_count(), 2);
+    cntl.reset();
+    RunFor(400);
+
+    // Fast responses send no backup request.
+    for (int i = 0; i < 3; ++i) {
+        std::unique_ptr<Controller> cntl(NewURPCController());
+        EchoResponse response;
+        Echo(&channel, cntl.get(), &response);
+        EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+        EXPECT_EQ(response.message_count(), 3 + i);
+    }
+    RunFor(50);
+    EXPECT_EQ(service->calls(), 5);
+
+    // The backup request is sent to the next server of the load balancer.
+    Channel lb_channel;
+    ASSERT_EQ(lb_channel.Init("list://127.0.0.1:8101,127.0.0.1:8102", "rr",
+                              options),
+              0);
+    service->set_slow();
+    cntl.reset(NewURPCController());
+    EXPECT_LT(Echo(&lb_channel, cntl.get(), &response), 200);
+    EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+    EXPECT_EQ(response.message_count(), 7);
+    RunFor(400);
+
+    std::map<int, uint64_t> messages;
+    for (auto&& stats : StatsRegistry::singleton()->ListTransports()) {
+        if (!stats.server_side)
+            messages[stats.remote_side.port] += stats.messages_out;
+    }
+    EXPECT_EQ(messages[8100], 5);
+    EXPECT_EQ(messages[8101], 1);
+    EXPECT_EQ(messages[8102], 1);
+}
@@ -0,0 +1,113 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <string>
+
+#include "urpc/builtin/builtin_service.h"
+
+using namespace urpc;
+
+namespace {
+
+int ConnectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/// Drive the server loop until `expected_responses` responses are received.
+std::string Receive(int fd, int expected_responses) {
+    std::string received;
+    char buf[4096];
+    for (int i = 0; i < 1000; ++i) {
+        IOContext context(LOOP_ONCE);
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0)
+            received.append(buf, n);
+        int responses = 0;
+        for (size_t pos = 0;
+             (pos = received.find("HTTP/1.1 ", pos)) != std::string::npos;
+             ++pos) {
+            ++responses;
+        }
+        if (responses >= expected_responses &&
+            received.rfind("\r\n\r\n") != std::string::npos)
+            break;
+    }
+    return received;
+}
+
+}  // namespace
+
+TEST(BuiltinServiceTest, RenderPage) {
+    builtin::Page page;
+    ASSERT_TRUE(builtin::RenderPage("/health?verbose=1", &page));
+    EXPECT_EQ(page.status_code, 200);
+    EXPECT_TRUE(page.body.equals("OK\n"));
+
+    builtin::Page metrics;
+    ASSERT_TRUE(builtin::RenderPage("/metrics", &metrics));
+    std::string body;
+    metrics.body.copy_to(&body);
+    EXPECT_NE(body.find("# TYPE urpc_iobuf_block_count gauge"),
+              std::string::npos);
+
+    builtin::Page missing;
+    EXPECT_FALSE(builtin::RenderPage("/no_such_page", &missing));
+}
+
+TEST(BuiltinServiceTest, ServeOnRPCPort) {
+    Server server;
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8088)), 0);
+
+    int fd = ConnectTo(8088);
+    ASSERT_GE(fd, 0);
+    // Two pipelined requests, the second one is split across writes.
+    std::string requests =
+        "GET /health HTTP/1.1\r\nHost: localhost\r\n\r\n"
+        "GET /status HTTP/1.1\r\n";
+    ASSERT_EQ(write(fd, requests.data(), requests.size()),
+              static_cast<ssize_t>(requests.size()));
+    std::string received = Receive(fd, 1);
+    EXPECT_EQ(received.find("HTTP/1.1 200 OK\r\n"), 0);
+    EXPECT_NE(received.find("\r\n\r\nOK\n"), std::string::npos);
+
+    ASSERT_EQ(write(fd, "\r\n", 2), 2);
+    received = Receive(fd, 1);
+    EXPECT_EQ(received.find("HTTP/1.1 200 OK\r\n"), 0);
+    EXPECT_NE(received.find("[pollers]"), std::string::npos);
+
+    std::string missing = "GET /missing HTTP/1.1\r\n\r\n";
+    ASSERT_EQ(write(fd, missing.data(), missing.size()),
+              static_cast<ssize_t>(missing.size()));
+    received = Receive(fd, 1);
+    EXPECT_EQ(received.find("HTTP/1.1 404 Not Found\r\n"), 0);
+    close(fd);
+}
@@ -0,0 +1,178 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <echo.pb.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+
+#include "urpc/base.h"
+#include "urpc/circuit_breaker.h"
+#include "urpc/stats.h"
+
+DECLARE_int32(circuit_breaker_short_window_size);
+DECLARE_int32(circuit_breaker_short_window_error_percent);
+DECLARE_int32(circuit_breaker_min_isolation_duration_ms);
+DECLARE_int32(circuit_breaker_max_isolation_duration_ms);
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+class EchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        if (fail_)
+            static_cast<Controller*>(controller)->SetFailed(1, "failed");
+        response->set_message(request->message());
+        done->Run();
+    }
+
+    void set_fail(bool fail) { fail_ = fail; }
+
+private:
+    bool fail_{false};
+};
+
+void SetTrue(bool* flag) { *flag = true; }
+
+void Echo(Channel* channel, Controller* cntl) {
+    EchoService_Stub stub(channel);
+    EchoRequest request;
+    EchoResponse response;
+    request.set_message("hello");
+    bool done = false;
+    stub.Echo(cntl, &request, &response, NewCallback(&SetTrue, &done));
+    while (!done) {
+        IOContext context(LOOP_ONCE);
+    }
+}
+
+void RunFor(int64_t ms) {
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    while (std::chrono::steady_clock::now() < deadline) {
+        IOContext context(LOOP_ONCE);
+    }
+}
+
+std::map<int, uint64_t> MessagesOut() {
+    std::map<int, uint64_t> messages;
+    for (auto&& stats : StatsRegistry::singleton()->ListTransports()) {
+        if (!stats.server_side)
+            messages[stats.remote_side.port] += stats.messages_out;
+    }
+    return messages;
+}
+
+class CircuitBreakerTest : public testing::Test {
+protected:
+    void SetUp() override {
+        FLAGS_circuit_breaker_short_window_size = 10;
+        FLAGS_circuit_breaker_short_window_error_percent = 50;
+        FLAGS_circuit_breaker_min_isolation_duration_ms = 20;
+        FLAGS_circuit_breaker_max_isolation_duration_ms = 80;
+    }
+};
+
+}  // namespace
+
+TEST_F(CircuitBreakerTest, ErrorRate) {
+    CircuitBreaker breaker;
+    for (int i = 0; i < 10; ++i)
+        EXPECT_TRUE(breaker.OnCallEnd(true));
+
+    int errors = 0;
+    while (breaker.OnCallEnd(false))
+        errors++;
+    EXPECT_GT(errors, 2);
+    EXPECT_LT(errors, 10);
+
+    // The isolation doubles if isolated again soon.
+    EXPECT_EQ(breaker.MarkAsIsolated(), 20);
+    EXPECT_EQ(breaker.MarkAsIsolated(), 40);
+    EXPECT_EQ(breaker.MarkAsIsolated(), 80);
+    EXPECT_EQ(breaker.MarkAsIsolated(), 80);
+
+    breaker.Reset();
+    for (int i = 0; i < 20; ++i)
+        EXPECT_TRUE(breaker.OnCallEnd(i % 3 != 0));
+}
+
+TEST_F(CircuitBreakerTest, Channel) {
+    auto service = new EchoServiceImpl;
+    Server live, revived;
+    live.AddService(service, ServiceOwnership::SERVER_OWNS_SERVICE);
+    ASSERT_EQ(live.Start(EndPoint(IP_ANY, 8108)), 0);
+
+    // Nothing listens on 8107, it's isolated once failed to connect.
+    ChannelOptions options;
+    options.max_retry = 0;
+    Channel channel;
+    ASSERT_EQ(channel.Init("list://127.0.0.1:8107,127.0.0.1:8108", "rr",
+                           options),
+              0);
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    Echo(&channel, cntl.get());
+    EXPECT_EQ(cntl->ErrorCode(), ERR_CONNECT);
+    for (int i = 0; i < 4; ++i) {
+        cntl.reset(NewURPCController());
+        Echo(&channel, cntl.get());
+        EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+    }
+    EXPECT_EQ(MessagesOut()[8108], 4);
+
+    // Reconnected in the background once it's back.
+    ASSERT_EQ(revived.Start(EndPoint(IP_ANY, 8107)), 0);
+    RunFor(200);
+    for (int i = 0; i < 4; ++i) {
+        cntl.reset(NewURPCController());
+        Echo(&channel, cntl.get());
+        EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+    }
+    EXPECT_EQ(MessagesOut()[8107], 2);
+
+    // The server of too many errors is isolated, until the isolation
+    // duration elapses.
+    options.enable_circuit_breaker = true;
+    Channel single;
+    ASSERT_EQ(single.Init("127.0.0.1:8108", options), 0);
+    service->set_fail(true);
+    int failed = 0;
+    while (true) {
+        cntl.reset(NewURPCController());
+        Echo(&single, cntl.get());
+        if (cntl->ErrorCode() == ERR_NO_SERVER)
+            break;
+        EXPECT_EQ(cntl->ErrorCode(), 1);
+        ASSERT_LT(++failed, 100);
+    }
+    service->set_fail(false);
+    RunFor(50);
+    cntl.reset(NewURPCController());
+    Echo(&single, cntl.get());
+    EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+}
@@ -0,0 +1,157 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <echo.pb.h>
+#include <gtest/gtest.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <memory>
+#include <string>
+
+#include "urpc/base.h"
+#include "urpc/compress.h"
+#include "urpc/iobuf.h"
+#include "urpc/protocol/urpc/call.h"
+#include "urpc/protocol/urpc/protocol.h"
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+const CompressType kCompressTypes[] = {COMPRESS_SNAPPY, COMPRESS_ZSTD,
+                                       COMPRESS_LZ4};
+
+/// A compressible payload spread over many blocks.
+IOBuf MakePayload(size_t size) {
+    IOBuf buf;
+    std::string piece;
+    for (size_t i = 0; buf.size() < size; ++i) {
+        piece = "line " + std::to_string(i % 977) + " of the payload\n";
+        buf.append(piece.substr(0, size - buf.size()));
+    }
+    return buf;
+}
+
+class EchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        auto cntl = static_cast<Controller*>(controller);
+        response_compress_type = cntl->response_compress_type();
+        response->set_message(request->message());
+        done->Run();
+    }
+
+    CompressType response_compress_type{COMPRESS_NONE};
+};
+
+void SetTrue(bool* flag) { *flag = true; }
+
+}  // namespace
+
+TEST(CompressTest, RoundTrip) {
+    for (size_t size : {0, 1, 8191, 300 * 1024}) {
+        IOBuf payload = MakePayload(size);
+        for (CompressType type : kCompressTypes) {
+            IOBuf compressed;
+            ASSERT_EQ(Compress(type, payload, &compressed), ERR_OK);
+
+            IOBuf decompressed;
+            ASSERT_EQ(Decompress(type, compressed, &decompressed), ERR_OK)
+                << type << " " << size;
+            EXPECT_TRUE(decompressed.equals(payload)) << type << " " << size;
+        }
+    }
+}
+
+TEST(CompressTest, Corrupted) {
+    IOBuf payload = MakePayload(64 * 1024);
+    for (CompressType type : kCompressTypes) {
+        IOBuf compressed;
+        ASSERT_EQ(Compress(type, payload, &compressed), ERR_OK);
+
+        IOBuf truncated;
+        compressed.append_to(&truncated, compressed.size() / 2);
+        IOBuf decompressed;
+        EXPECT_EQ(Decompress(type, truncated, &decompressed), ERR_COMPRESS)
+            << type;
+    }
+
+    IOBuf garbage;
+    garbage.append("not compressed at all");
+    IOBuf decompressed;
+    EXPECT_EQ(Decompress(COMPRESS_ZSTD, garbage, &decompressed), ERR_COMPRESS);
+    EXPECT_EQ(Decompress(COMPRESS_LZ4, garbage, &decompressed), ERR_COMPRESS);
+}
+
+TEST(CompressTest, UnknownCompressType) {
+    EXPECT_TRUE(IsValidCompressType(COMPRESS_LZ4));
+    EXPECT_FALSE(IsValidCompressType(-1));
+    EXPECT_FALSE(IsValidCompressType(COMPRESS_LZ4 + 1));
+
+    // Rejected before the value is cast to CompressType.
+    for (int i = 0; i < 2; ++i) {
+        protocol::urpc::RPCMeta meta;
+        meta.set_correlation_id(1);
+        auto request = meta.mutable_request();
+        request->set_service_name("test.EchoService");
+        request->set_method_name("Echo");
+        if (i == 0)
+            request->set_compress_type(100);
+        else
+            request->set_response_compress_type(-1);
+        IOBuf buf;
+        protocol::urpc::AppendMessage(meta, IOBuf(), &buf);
+        protocol::urpc::URPCProtocol protocol;
+        ServerCall* call = nullptr;
+        EXPECT_EQ(protocol.ParseRequest(&buf, nullptr, &call),
+                  ERR_NOT_SUPPORTED);
+        EXPECT_EQ(call, nullptr);
+    }
+}
+
+TEST(CompressTest, CompressedRPC) {
+    auto service = new EchoServiceImpl;
+    Server server;
+    server.AddService(service, ServiceOwnership::SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8093)), 0);
+
+    Channel channel;
+    ASSERT_EQ(channel.Init("127.0.0.1:8093", ChannelOptions()), 0);
+    EchoService_Stub stub(&channel);
+    for (CompressType type : kCompressTypes) {
+        std::unique_ptr<Controller> cntl(NewURPCController());
+        cntl->set_request_compress_type(type);
+        cntl->set_response_compress_type(COMPRESS_ZSTD);
+        EchoRequest request;
+        EchoResponse response;
+        request.set_message(MakePayload(100 * 1024).to_string());
+        bool done = false;
+        stub.Echo(cntl.get(), &request, &response,
+                  NewCallback(&SetTrue, &done));
+        while (!done) {
+            IOContext context(LOOP_ONCE);
+        }
+        EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+        EXPECT_EQ(response.message(), request.message());
+        EXPECT_EQ(service->response_compress_type, COMPRESS_ZSTD);
+    }
+}
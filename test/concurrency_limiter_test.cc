@@ -0,0 +1,263 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <echo.pb.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "urpc/base.h"
+#include "urpc/concurrency_limiter.h"
+#include "urpc/method_status.h"
+#include "urpc/service_holder.h"
+
+DECLARE_int32(auto_cl_remeasure_interval_ms);
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+/// Feed a window of `count` requests of `latency_us` over `duration_us`.
+void FeedWindow(AutoConcurrencyLimiter* limiter, int count,
+                int64_t latency_us, int64_t duration_us, int64_t* now_us) {
+    for (int i = 0; i < count; ++i) {
+        *now_us += duration_us / count;
+        limiter->Sample(true, latency_us, *now_us);
+    }
+}
+
+/// Respond the requests once `Flush()` is invoked.
+class DelayedEchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        pending_.push_back(done);
+    }
+
+    void Flush() {
+        auto pending = std::move(pending_);
+        pending_.clear();
+        for (auto done : pending)
+            done->Run();
+    }
+
+    size_t pending() const { return pending_.size(); }
+
+private:
+    std::vector<Closure*> pending_;
+};
+
+void SetTrue(bool* flag) { *flag = true; }
+
+}  // namespace
+
+TEST(ConcurrencyLimiterTest, New) {
+    std::unique_ptr<ConcurrencyLimiter> limiter;
+    ASSERT_EQ(ConcurrencyLimiter::New("auto", &limiter), 0);
+    EXPECT_NE(dynamic_cast<AutoConcurrencyLimiter*>(limiter.get()), nullptr);
+    ASSERT_EQ(ConcurrencyLimiter::New("16", &limiter), 0);
+    EXPECT_EQ(limiter->max_concurrency(), 16);
+    ASSERT_EQ(ConcurrencyLimiter::New("unlimited", &limiter), 0);
+    EXPECT_EQ(limiter, nullptr);
+    ASSERT_EQ(ConcurrencyLimiter::New("0", &limiter), 0);
+    EXPECT_EQ(limiter, nullptr);
+    EXPECT_EQ(ConcurrencyLimiter::New("-1", &limiter), -1);
+    EXPECT_EQ(ConcurrencyLimiter::New("16x", &limiter), -1);
+    EXPECT_EQ(ConcurrencyLimiter::New("", &limiter), -1);
+}
+
+TEST(ConcurrencyLimiterTest, Constant) {
+    ConstantConcurrencyLimiter limiter(2);
+    EXPECT_TRUE(limiter.OnRequested());
+    EXPECT_TRUE(limiter.OnRequested());
+    EXPECT_FALSE(limiter.OnRequested());
+    EXPECT_EQ(limiter.concurrency(), 2);
+
+    limiter.OnResponded(true, 100);
+    EXPECT_TRUE(limiter.OnRequested());
+    limiter.OnCanceled();
+    limiter.OnResponded(false, 100);
+    EXPECT_EQ(limiter.concurrency(), 0);
+}
+
+TEST(ConcurrencyLimiterTest, Auto) {
+    FLAGS_auto_cl_remeasure_interval_ms = 50000;
+    AutoConcurrencyLimiter limiter;
+    int64_t now_us = 1;
+
+    // 1000 qps with 10ms latency needs 10 requests in processing.
+    for (int i = 0; i < 10; ++i)
+        FeedWindow(&limiter, 200, 10000, 200000, &now_us);
+    EXPECT_EQ(limiter.min_latency_us(), 10000);
+    EXPECT_NEAR(limiter.max_qps(), 1000, 10);
+    EXPECT_NEAR(limiter.max_concurrency(), 13, 1);
+
+    // Requests start queueing at the same qps, the headroom shrinks.
+    for (int i = 0; i < 20; ++i)
+        FeedWindow(&limiter, 200, 20000, 200000, &now_us);
+    EXPECT_EQ(limiter.min_latency_us(), 10000);
+    EXPECT_NEAR(limiter.max_concurrency(), 11, 1);
+
+    // The limit shrinks to drain the queue once the minimum latency is
+    // remeasured, and recovers with the new one.
+    now_us += 80 * 1000 * 1000;
+    limiter.Sample(true, 20000, now_us);  // drops the idle window
+    FeedWindow(&limiter, 200, 20000, 200000, &now_us);
+    EXPECT_EQ(limiter.max_concurrency(), 8);
+    FeedWindow(&limiter, 200, 12000, 200000, &now_us);
+    EXPECT_EQ(limiter.min_latency_us(), 12000);
+    EXPECT_GT(limiter.max_concurrency(), 12);
+
+    // The windows of low load are dropped.
+    const int64_t max_concurrency = limiter.max_concurrency();
+    for (int i = 0; i < 10; ++i)
+        FeedWindow(&limiter, 10, 1000, 2000000, &now_us);
+    EXPECT_EQ(limiter.max_concurrency(), max_concurrency);
+}
+
+TEST(ConcurrencyLimiterTest, Server) {
+    auto service = new DelayedEchoServiceImpl;
+    Server server;
+    server.AddService(service, ServiceOwnership::SERVER_OWNS_SERVICE);
+    EXPECT_EQ(server.SetMethodMaxConcurrency("test.EchoService.Echo", "x"),
+              -1);
+    EXPECT_EQ(server.SetMethodMaxConcurrency("test.EchoService.None", "1"),
+              -1);
+    ASSERT_EQ(server.SetMethodMaxConcurrency("test.EchoService.Echo", "2"), 0);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8097)), 0);
+
+    Channel channel;
+    ASSERT_EQ(channel.Init("127.0.0.1:8097", ChannelOptions()), 0);
+    EchoService_Stub stub(&channel);
+    EchoRequest request;
+    request.set_message("hello");
+
+    auto run = [&](size_t max_concurrency) {
+        const size_t num_calls = max_concurrency + 1;
+        std::vector<std::unique_ptr<Controller>> cntls;
+        std::vector<EchoResponse> responses(num_calls);
+        bool done[8] = {false};
+        for (size_t i = 0; i < num_calls; ++i) {
+            cntls.emplace_back(NewURPCController());
+            stub.Echo(cntls[i].get(), &request, &responses[i],
+                      NewCallback(&SetTrue, &done[i]));
+        }
+
+        // The excess one fails at once.
+        while (!done[num_calls - 1]) {
+            IOContext context(LOOP_ONCE);
+        }
+        EXPECT_EQ(cntls[num_calls - 1]->ErrorCode(), ERR_LIMITED);
+        EXPECT_EQ(service->pending(), max_concurrency);
+
+        service->Flush();
+        for (size_t i = 0; i + 1 < num_calls; ++i) {
+            while (!done[i]) {
+                IOContext context(LOOP_ONCE);
+            }
+            EXPECT_FALSE(cntls[i]->Failed()) << cntls[i]->ErrorText();
+            EXPECT_EQ(responses[i].message(), "hello");
+        }
+    };
+
+    run(2);
+
+    // The limit of the server applies to all methods.
+    ASSERT_EQ(server.SetMaxConcurrency("1"), 0);
+    run(1);
+    ASSERT_EQ(server.SetMaxConcurrency("unlimited"), 0);
+    ASSERT_EQ(server.SetMethodMaxConcurrency("test.EchoService.Echo", "0"), 0);
+}
+
+TEST(ConcurrencyLimiterTest, ReplacedWithRequestsInProcessing) {
+    ServiceHolder* holder = ServiceHolder::singleton();
+    holder->AddService(new DelayedEchoServiceImpl,
+                       ServiceOwnership::SERVER_OWNS_SERVICE);
+    MethodProperty* property =
+        holder->FindMethodProperty("test.EchoService", "Echo");
+    ASSERT_TRUE(property);
+
+    std::unique_ptr<ConcurrencyLimiter> limiter;
+    ASSERT_EQ(ConcurrencyLimiter::New("2", &limiter), 0);
+    ASSERT_EQ(holder->SetMethodLimiter("test.EchoService.Echo",
+                                       std::move(limiter)),
+              0);
+    ASSERT_TRUE(holder->OnRequested(property));
+    ASSERT_TRUE(holder->OnRequested(property));
+
+    // The new limiter takes over the requests admitted by the old one.
+    ASSERT_EQ(ConcurrencyLimiter::New("2", &limiter), 0);
+    ASSERT_EQ(holder->SetMethodLimiter("test.EchoService.Echo",
+                                       std::move(limiter)),
+              0);
+    EXPECT_EQ(property->limiter->concurrency(), 2);
+    EXPECT_FALSE(holder->OnRequested(property));
+    holder->OnResponded(property, true, 100);
+    holder->OnResponded(property, true, 100);
+    EXPECT_EQ(property->limiter->concurrency(), 0);
+    ASSERT_EQ(holder->SetMethodLimiter("test.EchoService.Echo", nullptr), 0);
+}
+
+TEST(ConcurrencyLimiterTest, PerThread) {
+    ServiceHolder::singleton()->AddService(
+        new DelayedEchoServiceImpl, ServiceOwnership::SERVER_OWNS_SERVICE);
+    std::unique_ptr<ConcurrencyLimiter> limiter;
+    ASSERT_EQ(ConcurrencyLimiter::New("3", &limiter), 0);
+    ASSERT_EQ(ServiceHolder::singleton()->SetMethodLimiter(
+                  "test.EchoService.Echo", std::move(limiter)),
+              0);
+    MethodStatus* status =
+        MethodStatusRegistry::singleton()->GetOrCreate("test.EchoService.Echo");
+    EXPECT_EQ(status->Sample().max_concurrency, 3);
+
+    // Each thread limits its own requests, the stats sum the limits up.
+    std::atomic<int> step{0};
+    std::thread thread([&step] {
+        ServiceHolder::singleton()->AddService(
+            new DelayedEchoServiceImpl, ServiceOwnership::SERVER_OWNS_SERVICE);
+        std::unique_ptr<ConcurrencyLimiter> limiter;
+        ConcurrencyLimiter::New("1", &limiter);
+        ServiceHolder::singleton()->SetMethodLimiter("test.EchoService.Echo",
+                                                     std::move(limiter));
+        step = 1;
+        while (step != 2) {
+        }
+    });
+    while (step != 1) {
+    }
+    EXPECT_EQ(status->Sample().max_concurrency, 4);
+    MethodProperty* property = ServiceHolder::singleton()->FindMethodProperty(
+        "test.EchoService", "Echo");
+    EXPECT_EQ(property->limiter->max_concurrency(), 3);
+    step = 2;
+    thread.join();
+    EXPECT_EQ(status->Sample().max_concurrency, 3);
+    ASSERT_EQ(ServiceHolder::singleton()->SetMethodLimiter(
+                  "test.EchoService.Echo", nullptr),
+              0);
+}
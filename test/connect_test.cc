@@ -0,0 +1,242 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <dlfcn.h>
+#include <echo.pb.h>
+#include <errno.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "urpc/base.h"
+#include "urpc/naming_service.h"
+#include "urpc/owned_fd.h"
+#include "urpc/resolver.h"
+#include "urpc/stats.h"
+
+DECLARE_int32(socket_recv_buffer_size);
+DECLARE_bool(tcp_fast_open);
+
+// Emulate a connection of TCP fast open falling back to a SYN without data
+// once armed: it connects at once, and the first write fails with
+// EINPROGRESS until the handshake completes.
+static std::atomic<bool> fast_open_fallback{false};
+static std::atomic<int> fast_open_fallback_fd{-1};
+static std::atomic<int> fast_open_fallback_writes{0};
+
+extern "C" int connect(int fd, const struct sockaddr* addr, socklen_t len) {
+    using ConnectFunc = int (*)(int, const struct sockaddr*, socklen_t);
+    static auto real_connect =
+        reinterpret_cast<ConnectFunc>(dlsym(RTLD_NEXT, "connect"));
+    int rc = real_connect(fd, addr, len);
+    if (rc < 0 && errno == EINPROGRESS && fast_open_fallback.exchange(false)) {
+        fast_open_fallback_fd = fd;
+        return 0;
+    }
+    return rc;
+}
+
+extern "C" ssize_t writev(int fd, const struct iovec* iov, int iovcnt) {
+    using WritevFunc = ssize_t (*)(int, const struct iovec*, int);
+    static auto real_writev =
+        reinterpret_cast<WritevFunc>(dlsym(RTLD_NEXT, "writev"));
+    int armed = fd;
+    if (fd >= 0 && fast_open_fallback_fd.compare_exchange_strong(armed, -1)) {
+        fast_open_fallback_writes++;
+        errno = EINPROGRESS;
+        return -1;
+    }
+    return real_writev(fd, iov, iovcnt);
+}
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+class EchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        done->Run();
+    }
+};
+
+void SetTrue(bool* flag) { *flag = true; }
+
+void Echo(Channel* channel, Controller* cntl) {
+    EchoService_Stub stub(channel);
+    EchoRequest request;
+    EchoResponse response;
+    request.set_message("hello");
+    bool done = false;
+    stub.Echo(cntl, &request, &response, NewCallback(&SetTrue, &done));
+    while (!done) {
+        IOContext context(LOOP_ONCE);
+    }
+}
+
+int GetIntOption(int fd, int level, int name) {
+    int value = 0;
+    socklen_t len = sizeof(value);
+    EXPECT_EQ(getsockopt(fd, level, name, &value, &len), 0);
+    return value;
+}
+
+}  // namespace
+
+TEST(ConnectTest, NamingServiceResolvesInBackground) {
+    auto naming_service = NamingService::New("list://localhost:8109 2");
+    ASSERT_NE(naming_service, nullptr);
+
+    // Skipped until resolved.
+    std::vector<ServerNode> servers;
+    ASSERT_EQ(naming_service->GetServers(&servers), 0);
+    EXPECT_TRUE(servers.empty());
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!naming_service->Changed())
+        ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+    ASSERT_EQ(naming_service->GetServers(&servers), 0);
+    ASSERT_EQ(servers.size(), 1);
+    EXPECT_STREQ(endpoint2str(servers[0].addr).c_str(), "127.0.0.1:8109");
+    EXPECT_EQ(servers[0].weight, 2);
+    EXPECT_FALSE(naming_service->Changed());
+
+    ServerNode node;
+    EXPECT_EQ(ParseServerNode("localhost", &node), -1);
+    EXPECT_EQ(ParseServerNode("localhost:port", &node), -1);
+}
+
+TEST(ConnectTest, Resolver) {
+    auto resolver = Resolver::singleton();
+    ip_t ip;
+    ASSERT_EQ(resolver->Resolve("localhost", &ip), 0);
+    EXPECT_STREQ(ip2str(ip).c_str(), "127.0.0.1");
+    ip = IP_NONE;
+    ASSERT_EQ(resolver->Lookup("localhost", &ip), 0);
+    EXPECT_STREQ(ip2str(ip).c_str(), "127.0.0.1");
+
+    // The failures are cached too.
+    const uint64_t version = resolver->version();
+    EXPECT_EQ(resolver->Resolve("nonexistent.invalid", &ip), -1);
+    EXPECT_EQ(resolver->Lookup("nonexistent.invalid", &ip), -1);
+    EXPECT_EQ(resolver->version(), version);
+}
+
+TEST(ConnectTest, SocketOptions) {
+    FLAGS_socket_recv_buffer_size = 64 * 1024;
+    Server server;
+    server.AddService(new EchoServiceImpl, SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8109)), 0);
+
+    Channel channel;
+    ASSERT_EQ(channel.Init("localhost:8109", ChannelOptions()), 0);
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    Echo(&channel, cntl.get());
+    ASSERT_FALSE(cntl->Failed()) << cntl->ErrorText();
+
+    int connections = 0;
+    for (auto&& stats : StatsRegistry::singleton()->ListTransports()) {
+        if (stats.fd < 0)
+            continue;
+        connections++;
+        EXPECT_EQ(GetIntOption(stats.fd, IPPROTO_TCP, TCP_NODELAY), 1);
+        // The kernel doubles the value for its bookkeeping.
+        EXPECT_GE(GetIntOption(stats.fd, SOL_SOCKET, SO_RCVBUF), 64 * 1024);
+    }
+    EXPECT_EQ(connections, 2);
+    FLAGS_socket_recv_buffer_size = 0;
+}
+
+TEST(ConnectTest, ConnectTimeout) {
+    // The SYNs are dropped once the accept queue of a listened socket not
+    // accepting is full, so the connections hang.
+    OwnedFD listen_fd(tcp_listen(EndPoint(IP_ANY, 8110)));
+    ASSERT_TRUE(listen_fd.valid());
+    ASSERT_EQ(listen(listen_fd, 0), 0);
+    std::vector<OwnedFD> fillers;
+    for (int i = 0; i < 4; ++i) {
+        OwnedFD fd(socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0));
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(8110);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+        fillers.push_back(std::move(fd));
+    }
+
+    ChannelOptions options;
+    options.connect_timeout_ms = 50;
+    options.timeout_ms = -1;
+    options.max_retry = 0;
+    Channel channel;
+    ASSERT_EQ(channel.Init("127.0.0.1:8110", options), 0);
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    auto start = std::chrono::steady_clock::now();
+    Echo(&channel, cntl.get());
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(cntl->ErrorCode(), ERR_CONNECT) << cntl->ErrorText();
+    EXPECT_GE(elapsed, std::chrono::milliseconds(50));
+    EXPECT_LT(elapsed, std::chrono::seconds(1));
+}
+
+TEST(ConnectTest, TCPFastOpen) {
+    FLAGS_tcp_fast_open = true;
+    Server server;
+    server.AddService(new EchoServiceImpl, SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8125)), 0);
+
+    // The first connection asks for a cookie, which the second one carries
+    // with its request in the SYN.
+    for (int i = 0; i < 2; ++i) {
+        Channel channel;
+        ASSERT_EQ(channel.Init("127.0.0.1:8125", ChannelOptions()), 0);
+        std::unique_ptr<Controller> cntl(NewURPCController());
+        Echo(&channel, cntl.get());
+        EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+    }
+    FLAGS_tcp_fast_open = false;
+}
+
+TEST(ConnectTest, TCPFastOpenFallback) {
+    Server server;
+    server.AddService(new EchoServiceImpl, SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8127)), 0);
+
+    // The request is written once connected instead of failing the call.
+    fast_open_fallback = true;
+    Channel channel;
+    ASSERT_EQ(channel.Init("127.0.0.1:8127", ChannelOptions()), 0);
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    Echo(&channel, cntl.get());
+    EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+    EXPECT_EQ(fast_open_fallback_writes.load(), 1);
+}
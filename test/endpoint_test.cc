@@ -0,0 +1,148 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <echo.pb.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <memory>
+#include <string>
+
+#include "urpc/naming_service.h"
+#include "urpc/owned_fd.h"
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+class EchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        done->Run();
+    }
+};
+
+void SetTrue(bool* flag) { *flag = true; }
+
+void Echo(Channel* channel, Controller* cntl) {
+    EchoService_Stub stub(channel);
+    EchoRequest request;
+    EchoResponse response;
+    request.set_message("hello");
+    bool done = false;
+    stub.Echo(cntl, &request, &response, NewCallback(&SetTrue, &done));
+    while (!done) {
+        IOContext context(LOOP_ONCE);
+    }
+    EXPECT_EQ(response.message(), cntl->Failed() ? "" : "hello");
+}
+
+std::string RoundTrip(const char* str) {
+    EndPoint point;
+    if (str2endpoint(str, &point) != 0)
+        return "invalid";
+    return endpoint2str(point).c_str();
+}
+
+}  // namespace
+
+TEST(EndPointTest, Parse) {
+    EXPECT_EQ(RoundTrip("127.0.0.1:8000"), "127.0.0.1:8000");
+    EXPECT_EQ(RoundTrip("[::1]:8000"), "[::1]:8000");
+    EXPECT_EQ(RoundTrip("[fe80::1:2]:80 "), "[fe80::1:2]:80");
+    EXPECT_EQ(RoundTrip("unix:/tmp/urpc.sock"), "unix:/tmp/urpc.sock");
+    EXPECT_EQ(RoundTrip("::1:8000"), "invalid");
+    EXPECT_EQ(RoundTrip("[::1]8000"), "invalid");
+    EXPECT_EQ(RoundTrip("[::1]:65536"), "invalid");
+    EXPECT_EQ(RoundTrip("unix:"), "invalid");
+    EXPECT_EQ(RoundTrip(("unix:/" + std::string(200, 'x')).c_str()),
+              "invalid");
+
+    EndPoint point;
+    ASSERT_EQ(str2endpoint("::1", 8000, &point), 0);
+    EXPECT_EQ(point.family, AF_INET6);
+    EXPECT_STREQ(endpoint2str(point).c_str(), "[::1]:8000");
+
+    EndPoint v4, v6, uds;
+    ASSERT_EQ(str2endpoint("127.0.0.1:8000", &v4), 0);
+    ASSERT_EQ(str2endpoint("[::1]:8000", &v6), 0);
+    ASSERT_EQ(str2endpoint("unix:/tmp/urpc.sock", &uds), 0);
+    EXPECT_NE(v4, v6);
+    EXPECT_NE(v6, uds);
+    EXPECT_LT(v4, v6);
+    EndPoint other;
+    ASSERT_EQ(str2endpoint("[::1]:8001", &other), 0);
+    EXPECT_LT(v6, other);
+    ASSERT_EQ(str2endpoint("unix:/tmp/urpc.sock", &other), 0);
+    EXPECT_EQ(uds, other);
+
+    ServerNode node;
+    ASSERT_EQ(ParseServerNode("[::1]:8000 3", &node), 0);
+    EXPECT_EQ(node.addr, v6);
+    EXPECT_EQ(node.weight, 3);
+    ASSERT_EQ(ParseServerNode("unix:/tmp/urpc.sock", &node), 0);
+    EXPECT_EQ(node.addr, uds);
+    EXPECT_EQ(ParseServerNode("[::1:8000", &node), -1);
+}
+
+TEST(EndPointTest, Echo) {
+    const std::string path = "/tmp/urpc_endpoint_test.sock";
+    // A stale socket file is replaced.
+    {
+        EndPoint stale;
+        ASSERT_EQ(str2endpoint(("unix:" + path).c_str(), &stale), 0);
+        OwnedFD fd(tcp_listen(stale));
+        ASSERT_TRUE(fd.valid());
+    }
+
+    Server v6_server, uds_server;
+    v6_server.AddService(new EchoServiceImpl, SERVER_OWNS_SERVICE);
+    EndPoint v6, uds;
+    ASSERT_EQ(str2endpoint("[::1]:8111", &v6), 0);
+    ASSERT_EQ(str2endpoint(("unix:" + path).c_str(), &uds), 0);
+    ASSERT_EQ(v6_server.Start(v6), 0);
+    ASSERT_EQ(uds_server.Start(uds), 0);
+
+    for (const std::string& url : {std::string("[::1]:8111"), "unix:" + path}) {
+        Channel channel;
+        ASSERT_EQ(channel.Init(url.c_str(), ChannelOptions()), 0);
+        for (int i = 0; i < 3; ++i) {
+            std::unique_ptr<Controller> cntl(NewURPCController());
+            Echo(&channel, cntl.get());
+            EXPECT_FALSE(cntl->Failed()) << url << ": " << cntl->ErrorText();
+        }
+    }
+
+    Channel channel;
+    ASSERT_EQ(channel.Init(("list://[::1]:8111,unix:" + path).c_str(), "rr",
+                           ChannelOptions()),
+              0);
+    for (int i = 0; i < 4; ++i) {
+        std::unique_ptr<Controller> cntl(NewURPCController());
+        Echo(&channel, cntl.get());
+        EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+    }
+    unlink(path.c_str());
+}
@@ -0,0 +1,312 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <arpa/inet.h>
+#include <echo.pb.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "urpc/base.h"
+#include "urpc/coding.h"
+#include "urpc/protocol/h2/frame.h"
+#include "urpc/protocol/h2/hpack.h"
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace urpc::protocol::h2;
+using namespace test;
+
+namespace {
+
+class EchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        done->Run();
+    }
+};
+
+int ConnectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void SendFrame(int fd, uint8_t type, uint8_t flags, uint32_t stream_id,
+               const IOBuf& payload) {
+    IOBuf frame;
+    AppendFrameHeader(payload.size(), type, flags, stream_id, &frame);
+    frame.append(payload);
+    const std::string data = frame.to_string();
+    ASSERT_EQ(write(fd, data.data(), data.size()),
+              static_cast<ssize_t>(data.size()));
+}
+
+void SendHeaders(int fd, uint32_t stream_id, const std::vector<Header>& headers,
+                 bool end_stream) {
+    IOBuf block;
+    HPackEncoder::Encode(headers, &block);
+    SendFrame(fd, FRAME_HEADERS,
+              FLAG_END_HEADERS | (end_stream ? FLAG_END_STREAM : 0), stream_id,
+              block);
+}
+
+void SendGRPCRequest(int fd, uint32_t stream_id, const std::string& path,
+                     const std::string& message) {
+    SendHeaders(fd, stream_id,
+                {{":method", "POST"},
+                 {":scheme", "http"},
+                 {":path", path},
+                 {":authority", "localhost"},
+                 {"content-type", "application/grpc"},
+                 {"te", "trailers"}},
+                false);
+    EchoRequest request;
+    request.set_message(message);
+    const std::string body = request.SerializeAsString();
+    uint8_t prefix[5] = {0};
+    EncodeBigEndian32(prefix + 1, body.size());
+    IOBuf data;
+    data.append(prefix, sizeof(prefix));
+    data.append(body);
+    while (data.size() > kDefaultMaxFrameSize) {
+        IOBuf frame;
+        data.cutn(&frame, kDefaultMaxFrameSize);
+        SendFrame(fd, FRAME_DATA, 0, stream_id, frame);
+    }
+    SendFrame(fd, FRAME_DATA, FLAG_END_STREAM, stream_id, data);
+}
+
+void SendWindowUpdate(int fd, uint32_t stream_id, uint32_t increment) {
+    uint8_t data[4];
+    EncodeBigEndian32(data, increment);
+    IOBuf payload;
+    payload.append(data, sizeof(data));
+    SendFrame(fd, FRAME_WINDOW_UPDATE, 0, stream_id, payload);
+}
+
+/// A response collected from the frames of a stream.
+struct Response {
+    std::vector<Header> headers;
+    std::string data;
+    bool closed{false};
+
+    const std::string* Find(const std::string& name) const {
+        for (auto&& header : headers) {
+            if (header.name == name)
+                return &header.value;
+        }
+        return nullptr;
+    }
+};
+
+/// The client side of a connection, frames are read by driving the server
+/// loop.
+class Client {
+public:
+    explicit Client(int fd) : fd_(fd) {}
+
+    /// Receive frames until `stream_ids` are closed, or nothing is received
+    /// in a while. The DATA received is acknowledged if `auto_window_update`.
+    void ReceiveUntilClosed(const std::vector<uint32_t>& stream_ids,
+                            bool auto_window_update = true) {
+        char data[4096];
+        for (int i = 0; i < 1000 && !AllClosed(stream_ids); ++i) {
+            IOContext context(LOOP_ONCE);
+            ssize_t n = recv(fd_, data, sizeof(data), MSG_DONTWAIT);
+            if (n == 0)
+                break;
+            if (n > 0)
+                buf_.append(data, n);
+
+            FrameHeader header;
+            while (PeekFrameHeader(buf_, &header) &&
+                   buf_.size() >= kFrameHeaderSize + header.length) {
+                buf_.pop_front(kFrameHeaderSize);
+                IOBuf payload;
+                buf_.cutn(&payload, header.length);
+                OnFrame(header, payload, auto_window_update);
+            }
+        }
+    }
+
+    std::map<uint32_t, Response> responses;
+    std::vector<FrameHeader> frames;
+
+private:
+    bool AllClosed(const std::vector<uint32_t>& stream_ids) {
+        for (uint32_t id : stream_ids) {
+            if (!responses[id].closed)
+                return false;
+        }
+        return true;
+    }
+
+    void OnFrame(const FrameHeader& header, const IOBuf& payload,
+                 bool auto_window_update) {
+        frames.push_back(header);
+        Response* response = &responses[header.stream_id];
+        if (header.type == FRAME_HEADERS) {
+            ASSERT_EQ(decoder_.Decode(payload, &response->headers), ERR_OK);
+        } else if (header.type == FRAME_DATA) {
+            response->data.append(payload.to_string());
+            if (auto_window_update && header.length > 0) {
+                SendWindowUpdate(fd_, 0, header.length);
+                SendWindowUpdate(fd_, header.stream_id, header.length);
+            }
+        } else if (header.type == FRAME_SETTINGS &&
+                   !(header.flags & FLAG_ACK)) {
+            SendFrame(fd_, FRAME_SETTINGS, FLAG_ACK, 0, IOBuf());
+        }
+        if (header.flags & FLAG_END_STREAM &&
+            (header.type == FRAME_HEADERS || header.type == FRAME_DATA))
+            response->closed = true;
+    }
+
+    const int fd_;
+    IOBuf buf_;
+    HPackDecoder decoder_;
+};
+
+std::string ParseEchoMessage(const std::string& data) {
+    EchoResponse response;
+    if (data.size() < 5 || data[0] != 0 ||
+        !response.ParseFromString(data.substr(5)))
+        return "<invalid>";
+    return response.message();
+}
+
+}  // namespace
+
+TEST(H2ProtocolTest, GRPCAndBuiltinPages) {
+    Server server;
+    server.AddService(new EchoServiceImpl,
+                      ServiceOwnership::SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8090)), 0);
+
+    int fd = ConnectTo(8090);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, kConnectionPreface, kConnectionPrefaceSize),
+              static_cast<ssize_t>(kConnectionPrefaceSize));
+    SendFrame(fd, FRAME_SETTINGS, 0, 0, IOBuf());
+    SendGRPCRequest(fd, 1, "/test.EchoService/Echo", "hello");
+    SendGRPCRequest(fd, 3, "/test.EchoService/Unknown", "hello");
+    SendHeaders(fd, 5,
+                {{":method", "GET"}, {":scheme", "http"}, {":path", "/health"}},
+                true);
+
+    Client client(fd);
+    client.ReceiveUntilClosed({1, 3, 5});
+    ASSERT_FALSE(client.frames.empty());
+    // The server preface comes first.
+    EXPECT_EQ(client.frames[0].type, FRAME_SETTINGS);
+
+    const Response& echo = client.responses[1];
+    ASSERT_TRUE(echo.closed);
+    ASSERT_TRUE(echo.Find(":status"));
+    EXPECT_EQ(*echo.Find(":status"), "200");
+    ASSERT_TRUE(echo.Find("grpc-status"));
+    EXPECT_EQ(*echo.Find("grpc-status"), "0");
+    EXPECT_EQ(ParseEchoMessage(echo.data), "hello");
+
+    const Response& unknown = client.responses[3];
+    ASSERT_TRUE(unknown.closed);
+    ASSERT_TRUE(unknown.Find("grpc-status"));
+    EXPECT_EQ(*unknown.Find("grpc-status"), "12");
+    EXPECT_TRUE(unknown.data.empty());
+
+    const Response& health = client.responses[5];
+    ASSERT_TRUE(health.closed);
+    ASSERT_TRUE(health.Find(":status"));
+    EXPECT_EQ(*health.Find(":status"), "200");
+    EXPECT_EQ(health.data, "OK\n");
+    close(fd);
+}
+
+TEST(H2ProtocolTest, FlowControl) {
+    Server server;
+    server.AddService(new EchoServiceImpl,
+                      ServiceOwnership::SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8091)), 0);
+
+    int fd = ConnectTo(8091);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, kConnectionPreface, kConnectionPrefaceSize),
+              static_cast<ssize_t>(kConnectionPrefaceSize));
+    SendFrame(fd, FRAME_SETTINGS, 0, 0, IOBuf());
+    // Larger than the initial windows, the server advertises a larger one.
+    const std::string message(100 * 1024, 'x');
+    SendGRPCRequest(fd, 1, "/test.EchoService/Echo", message);
+
+    // Without WINDOW_UPDATE, the response stops at the initial window.
+    Client client(fd);
+    client.ReceiveUntilClosed({1}, false);
+    EXPECT_FALSE(client.responses[1].closed);
+    EXPECT_EQ(client.responses[1].data.size(), kDefaultWindowSize);
+
+    SendWindowUpdate(fd, 0, kDefaultWindowSize);
+    SendWindowUpdate(fd, 1, kDefaultWindowSize);
+    client.ReceiveUntilClosed({1});
+    const Response& echo = client.responses[1];
+    ASSERT_TRUE(echo.closed);
+    ASSERT_TRUE(echo.Find("grpc-status"));
+    EXPECT_EQ(*echo.Find("grpc-status"), "0");
+    EXPECT_EQ(ParseEchoMessage(echo.data), message);
+    for (auto&& frame : client.frames)
+        EXPECT_LE(frame.length, kDefaultMaxFrameSize);
+    close(fd);
+}
+
+TEST(H2ProtocolTest, GoAwayOnStop) {
+    Server server;
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8121)), 0);
+
+    int fd = ConnectTo(8121);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, kConnectionPreface, kConnectionPrefaceSize),
+              static_cast<ssize_t>(kConnectionPrefaceSize));
+    SendFrame(fd, FRAME_SETTINGS, 0, 0, IOBuf());
+    SendHeaders(fd, 1,
+                {{":method", "GET"}, {":scheme", "http"}, {":path", "/health"}},
+                true);
+    Client client(fd);
+    client.ReceiveUntilClosed({1});
+    ASSERT_TRUE(client.responses[1].closed);
+
+    // GOAWAY is sent before the idle connection is closed.
+    ASSERT_EQ(server.Stop(), 0);
+    ASSERT_EQ(server.Join(1000), 0);
+    client.ReceiveUntilClosed({3});
+    EXPECT_FALSE(client.responses[3].closed);
+    EXPECT_EQ(client.frames.back().type, FRAME_GOAWAY);
+    close(fd);
+}
@@ -0,0 +1,185 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "urpc/base.h"
+#include "urpc/protocol/h2/hpack.h"
+
+using namespace urpc;
+using namespace urpc::protocol::h2;
+
+namespace {
+
+IOBuf FromHex(const std::string& hex) {
+    IOBuf buf;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2)
+        buf.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), 0, 16)));
+    return buf;
+}
+
+std::string ToHex(const std::string& data) {
+    static const char kHex[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned char c : data) {
+        hex.push_back(kHex[c >> 4]);
+        hex.push_back(kHex[c & 0xf]);
+    }
+    return hex;
+}
+
+void ExpectHeaders(const std::vector<Header>& headers,
+                   const std::vector<Header>& expected) {
+    ASSERT_EQ(headers.size(), expected.size());
+    for (size_t i = 0; i < headers.size(); ++i) {
+        EXPECT_EQ(headers[i].name, expected[i].name);
+        EXPECT_EQ(headers[i].value, expected[i].value);
+    }
+}
+
+}  // namespace
+
+TEST(HuffmanTest, RFCExamples) {
+    struct {
+        std::string plain;
+        std::string hex;
+    } cases[] = {
+        {"www.example.com", "f1e3c2e5f23a6ba0ab90f4ff"},
+        {"no-cache", "a8eb10649cbf"},
+        {"custom-key", "25a849e95ba97d7f"},
+        {"custom-value", "25a849e95bb8e8b4bf"},
+        {"Mon, 21 Oct 2013 20:13:21 GMT",
+         "d07abe941054d444a8200595040b8166e082a62d1bff"},
+    };
+    for (auto&& c : cases) {
+        std::string encoded;
+        HuffmanEncode(c.plain, &encoded);
+        EXPECT_EQ(ToHex(encoded), c.hex);
+        EXPECT_EQ(HuffmanEncodedSize(c.plain), encoded.size());
+
+        IOBuf buf = FromHex(c.hex);
+        IOBufBytesIterator it(buf);
+        std::string decoded;
+        ASSERT_EQ(HuffmanDecode(&it, buf.size(), &decoded), ERR_OK);
+        EXPECT_EQ(decoded, c.plain);
+    }
+}
+
+TEST(HuffmanTest, InvalidPadding) {
+    std::string decoded;
+    // "no-cache" followed by a whole byte of padding.
+    IOBuf buf = FromHex("a8eb10649cbfff");
+    IOBufBytesIterator it(buf);
+    EXPECT_EQ(HuffmanDecode(&it, buf.size(), &decoded), ERR_NOT_SUPPORTED);
+
+    // The padding must be the most significant bits of EOS.
+    buf = FromHex("a8eb10649cbe");
+    IOBufBytesIterator it2(buf);
+    EXPECT_EQ(HuffmanDecode(&it2, buf.size(), &decoded), ERR_NOT_SUPPORTED);
+}
+
+TEST(HPackDecoderTest, RequestsWithHuffman) {
+    // RFC 7541 C.4.
+    HPackDecoder decoder;
+    std::vector<Header> headers;
+    ASSERT_EQ(decoder.Decode(FromHex("828684418cf1e3c2e5f23a6ba0ab90f4ff"),
+                             &headers),
+              ERR_OK);
+    ExpectHeaders(headers, {{":method", "GET"},
+                            {":scheme", "http"},
+                            {":path", "/"},
+                            {":authority", "www.example.com"}});
+    EXPECT_EQ(decoder.table_size(), 57);
+
+    headers.clear();
+    ASSERT_EQ(decoder.Decode(FromHex("828684be5886a8eb10649cbf"), &headers),
+              ERR_OK);
+    ExpectHeaders(headers, {{":method", "GET"},
+                            {":scheme", "http"},
+                            {":path", "/"},
+                            {":authority", "www.example.com"},
+                            {"cache-control", "no-cache"}});
+    EXPECT_EQ(decoder.table_size(), 110);
+
+    headers.clear();
+    ASSERT_EQ(decoder.Decode(FromHex("828785bf408825a849e95ba97d7f89"
+                                     "25a849e95bb8e8b4bf"),
+                             &headers),
+              ERR_OK);
+    ExpectHeaders(headers, {{":method", "GET"},
+                            {":scheme", "https"},
+                            {":path", "/index.html"},
+                            {":authority", "www.example.com"},
+                            {"custom-key", "custom-value"}});
+    EXPECT_EQ(decoder.table_size(), 164);
+    EXPECT_EQ(decoder.table_entries(), 3);
+}
+
+TEST(HPackDecoderTest, Eviction) {
+    // RFC 7541 C.6, a 256 bytes dynamic table.
+    HPackDecoder decoder(256);
+    std::vector<Header> headers;
+    ASSERT_EQ(decoder.Decode(FromHex("488264025885aec3771a4b6196d07abe"
+                                     "941054d444a8200595040b8166e082a6"
+                                     "2d1bff6e919d29ad171863c78f0b97c8"
+                                     "e9ae82ae43d3"),
+                             &headers),
+              ERR_OK);
+    EXPECT_EQ(decoder.table_size(), 222);
+
+    headers.clear();
+    ASSERT_EQ(decoder.Decode(FromHex("4883640effc1c0bf"), &headers), ERR_OK);
+    ExpectHeaders(headers, {{":status", "307"},
+                            {"cache-control", "private"},
+                            {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+                            {"location", "https://www.example.com"}});
+    EXPECT_EQ(decoder.table_size(), 222);
+    EXPECT_EQ(decoder.table_entries(), 4);
+}
+
+TEST(HPackDecoderTest, Invalid) {
+    HPackDecoder decoder;
+    std::vector<Header> headers;
+    // Index 0.
+    EXPECT_EQ(decoder.Decode(FromHex("80"), &headers), ERR_NOT_SUPPORTED);
+    // Out of the tables.
+    EXPECT_EQ(decoder.Decode(FromHex("be"), &headers), ERR_NOT_SUPPORTED);
+    // Truncated string.
+    EXPECT_EQ(decoder.Decode(FromHex("0085f2b2"), &headers),
+              ERR_NOT_SUPPORTED);
+    // Table size update above the settings.
+    EXPECT_EQ(decoder.Decode(FromHex("3fe21f"), &headers), ERR_NOT_SUPPORTED);
+}
+
+TEST(HPackEncoderTest, RoundTrip) {
+    const std::vector<Header> expected = {
+        {":status", "200"},
+        {"content-type", "application/grpc"},
+        {"grpc-status", "0"},
+        {"x-binary", std::string("\0\x01\xff", 3)},
+        {"x-long", std::string(300, 'a')},
+    };
+    IOBuf block;
+    HPackEncoder::Encode(expected, &block);
+
+    HPackDecoder decoder;
+    std::vector<Header> headers;
+    ASSERT_EQ(decoder.Decode(block, &headers), ERR_OK);
+    ExpectHeaders(headers, expected);
+    // Nothing is inserted into the dynamic table of the peer.
+    EXPECT_EQ(decoder.table_entries(), 0);
+}
@@ -0,0 +1,229 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <arpa/inet.h>
+#include <echo.pb.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <string>
+#include <utility>
+
+#include "urpc/base.h"
+#include "urpc/protocol/http/parser.h"
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace urpc::protocol::http;
+using namespace test;
+
+namespace {
+
+class EchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        response->set_message_count(1);
+        done->Run();
+    }
+};
+
+int ConnectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/// Drive the server loop until `suffix` is received or the peer closed.
+std::string ReceiveUntil(int fd, const std::string& suffix) {
+    std::string received;
+    char buf[4096];
+    for (int i = 0; i < 1000; ++i) {
+        IOContext context(LOOP_ONCE);
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n == 0)
+            break;
+        if (n > 0)
+            received.append(buf, n);
+        if (!suffix.empty() && received.size() >= suffix.size() &&
+            received.compare(received.size() - suffix.size(), suffix.size(),
+                             suffix) == 0)
+            break;
+    }
+    return received;
+}
+
+}  // namespace
+
+TEST(HTTPRequestParserTest, ParseByteByByte) {
+    const std::string payload =
+        "POST /test.EchoService/Echo?x=1 HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "content-type: application/json\r\n"
+        "Content-Length:  17 \r\n"
+        "\r\n"
+        "{\"message\":\"hi\"}\n"
+        "GET /health HTTP/1.0\r\n\r\n";
+
+    HTTPRequestParser parser;
+    IOBuf buf;
+    HTTPRequest request;
+    size_t i = 0;
+    for (; i < payload.size(); ++i) {
+        buf.push_back(payload[i]);
+        int code = parser.Parse(&buf, &request);
+        if (code == ERR_OK)
+            break;
+        ASSERT_EQ(code, ERR_TOO_SMALL) << "at " << i;
+    }
+    ASSERT_LT(i, payload.size());
+    EXPECT_TRUE(buf.empty());
+    EXPECT_EQ(request.method, "POST");
+    EXPECT_EQ(request.uri, "/test.EchoService/Echo?x=1");
+    EXPECT_EQ(request.path(), "/test.EchoService/Echo");
+    EXPECT_EQ(request.minor_version, 1);
+    EXPECT_TRUE(request.keep_alive);
+    EXPECT_EQ(request.content_type, "application/json");
+    EXPECT_TRUE(request.body.equals("{\"message\":\"hi\"}\n"));
+
+    buf.append(payload.substr(i + 1));
+    ASSERT_EQ(parser.Parse(&buf, &request), ERR_OK);
+    EXPECT_EQ(request.method, "GET");
+    EXPECT_EQ(request.path(), "/health");
+    EXPECT_EQ(request.minor_version, 0);
+    EXPECT_FALSE(request.keep_alive);
+    EXPECT_TRUE(request.body.empty());
+}
+
+TEST(HTTPRequestParserTest, Invalid) {
+    HTTPRequest request;
+    {
+        HTTPRequestParser parser;
+        IOBuf buf;
+        buf.append("URPC\0\0\0\0");
+        EXPECT_EQ(parser.Parse(&buf, &request), ERR_MISMATCH);
+    }
+    {
+        HTTPRequestParser parser;
+        IOBuf buf;
+        buf.append("GET / HTTP/2.0\r\n\r\n");
+        EXPECT_EQ(parser.Parse(&buf, &request), ERR_NOT_SUPPORTED);
+    }
+    {
+        HTTPRequestParser parser;
+        IOBuf buf;
+        buf.append("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+        EXPECT_EQ(parser.Parse(&buf, &request), ERR_NOT_SUPPORTED);
+    }
+}
+
+TEST(HTTPRequestParserTest, InvalidContentLength) {
+    const std::pair<const char*, int> cases[] = {
+        {"-1", 400},
+        {"+1", 400},
+        {"1x", 400},
+        {"99999999999999999999999", 413},
+        {"1000000000000", 413},
+    };
+    for (auto&& [length, status] : cases) {
+        HTTPRequestParser parser;
+        IOBuf buf;
+        buf.append(std::string("POST / HTTP/1.1\r\nContent-Length: ") +
+                   length + "\r\n\r\nbody");
+        HTTPRequest request;
+        ASSERT_EQ(parser.Parse(&buf, &request), ERR_OK) << length;
+        EXPECT_EQ(request.reject_status, status) << length;
+        EXPECT_FALSE(request.keep_alive);
+        EXPECT_TRUE(request.body.empty());
+    }
+}
+
+TEST(HTTPProtocolTest, PipelinedRequests) {
+    Server server;
+    server.AddService(new EchoServiceImpl,
+                      ServiceOwnership::SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8089)), 0);
+
+    int fd = ConnectTo(8089);
+    ASSERT_GE(fd, 0);
+    std::string requests =
+        "POST /test.EchoService/Echo HTTP/1.1\r\n"
+        "Content-Length: 19\r\n\r\n"
+        "{\"message\":\"hello\"}"
+        "GET /health HTTP/1.1\r\n\r\n"
+        "POST /test.EchoService/Echo HTTP/1.1\r\n"
+        "Content-Length: 1\r\n\r\n"
+        "{"
+        "GET /test.EchoService/Echo HTTP/1.1\r\nConnection: close\r\n\r\n"
+        "GET /health HTTP/1.1\r\n\r\n";
+    ASSERT_EQ(write(fd, requests.data(), requests.size()),
+              static_cast<ssize_t>(requests.size()));
+
+    std::string received = ReceiveUntil(fd, "");
+    const std::string expected =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 36\r\n"
+        "Connection: keep-alive\r\n\r\n"
+        "{\"message\":\"hello\",\"messageCount\":1}"
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: 3\r\n"
+        "Connection: keep-alive\r\n\r\n"
+        "OK\n";
+    ASSERT_EQ(received.compare(0, expected.size(), expected), 0) << received;
+    received = received.substr(expected.size());
+    EXPECT_EQ(received.find("HTTP/1.1 400 Bad Request\r\n"), 0) << received;
+    // The last response before closing.
+    EXPECT_NE(received.find("Connection: close\r\n\r\n{\"messageCount\":1}"),
+              std::string::npos)
+        << received;
+    close(fd);
+}
+
+TEST(HTTPProtocolTest, BodyTooLarge) {
+    Server server;
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8123)), 0);
+
+    int fd = ConnectTo(8123);
+    ASSERT_GE(fd, 0);
+    const std::string request =
+        "POST /test.EchoService/Echo HTTP/1.1\r\n"
+        "Content-Length: 1000000000000\r\n\r\n"
+        "{\"message\":\"hello\"}";
+    ASSERT_EQ(write(fd, request.data(), request.size()),
+              static_cast<ssize_t>(request.size()));
+
+    // Answered without buffering the body, and closed.
+    std::string received = ReceiveUntil(fd, "");
+    EXPECT_EQ(received.find("HTTP/1.1 413 Payload Too Large\r\n"), 0)
+        << received;
+    EXPECT_NE(received.find("Connection: close\r\n"), std::string::npos)
+        << received;
+    close(fd);
+}
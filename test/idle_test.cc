@@ -0,0 +1,208 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <echo.pb.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include "urpc/owned_fd.h"
+#include "urpc/stats.h"
+
+DECLARE_int32(client_idle_timeout_s);
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+/// The response of the request "slow", run by the test.
+Closure* slow_done = nullptr;
+
+class EchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        if (request->message() == "slow") {
+            slow_done = done;
+            return;
+        }
+        done->Run();
+    }
+};
+
+void SetTrue(bool* flag) { *flag = true; }
+
+void Echo(Channel* channel, Controller* cntl) {
+    EchoService_Stub stub(channel);
+    EchoRequest request;
+    EchoResponse response;
+    request.set_message("hello");
+    bool done = false;
+    stub.Echo(cntl, &request, &response, NewCallback(&SetTrue, &done));
+    while (!done) {
+        IOContext context(LOOP_ONCE);
+    }
+}
+
+/// The stats of the acceptor listening to `port`.
+AcceptorStats FindAcceptor(int port) {
+    for (auto&& stats : StatsRegistry::singleton()->ListAcceptors()) {
+        EndPoint local;
+        if (get_local_side(stats.listen_fd, &local) == 0 && local.port == port)
+            return stats;
+    }
+    return AcceptorStats();
+}
+
+/// Run the loop until `pred` holds or `timeout_ms` elapses.
+bool LoopUntil(const std::function<bool()>& pred, int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeout_ms);
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        IOContext context(LOOP_ONCE);
+    }
+    return true;
+}
+
+/// Whether the peer closed `fd`, the bytes received are discarded.
+bool ClosedByPeer(int fd) {
+    char buf[1024];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+    }
+    return n == 0;
+}
+
+}  // namespace
+
+TEST(IdleTest, ServerClosesIdleConnections) {
+    const EndPoint endpoint(IP_ANY, 8116);
+    Server server;
+    ServerOptions options;
+    options.idle_timeout_s = 1;
+    ASSERT_EQ(server.Start(endpoint, options), 0);
+
+    OwnedFD idle(tcp_connect(endpoint, nullptr));
+    OwnedFD active(tcp_connect(endpoint, nullptr));
+    ASSERT_TRUE(idle.valid() && active.valid());
+    ASSERT_TRUE(LoopUntil(
+        [] { return FindAcceptor(8116).connections == 2; }, 1000));
+
+    // The requests keep the connection open.
+    const std::string request = "GET /health HTTP/1.1\r\n\r\n";
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start <
+           std::chrono::milliseconds(2500)) {
+        ASSERT_EQ(write(active, request.data(), request.size()),
+                  static_cast<ssize_t>(request.size()));
+        LoopUntil([] { return false; }, 300);
+        ASSERT_FALSE(ClosedByPeer(active));
+    }
+    EXPECT_TRUE(ClosedByPeer(idle));
+    EXPECT_EQ(FindAcceptor(8116).connections, 1);
+
+    active.reset();
+    EXPECT_TRUE(LoopUntil(
+        [] { return FindAcceptor(8116).connections == 0; }, 1000));
+}
+
+TEST(IdleTest, ClientReconnectsAfterIdle) {
+    FLAGS_client_idle_timeout_s = 1;
+    const EndPoint endpoint(IP_ANY, 8117);
+    Server server;
+    server.AddService(new EchoServiceImpl, SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(endpoint), 0);
+
+    ChannelOptions options;
+    Channel channel;
+    ASSERT_EQ(channel.Init("127.0.0.1:8117", options), 0);
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    Echo(&channel, cntl.get());
+    ASSERT_FALSE(cntl->Failed()) << cntl->ErrorText();
+    EXPECT_EQ(FindAcceptor(8117).connections, 1);
+
+    // Closed by the client, and the next call reconnects.
+    EXPECT_TRUE(LoopUntil(
+        [] { return FindAcceptor(8117).connections == 0; }, 3000));
+    cntl.reset(NewURPCController());
+    Echo(&channel, cntl.get());
+    EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+    EXPECT_EQ(FindAcceptor(8117).accepted, 2);
+    FLAGS_client_idle_timeout_s = -1;
+}
+
+TEST(IdleTest, ConnectionResetByPeer) {
+    const EndPoint endpoint(IP_ANY, 8118);
+    Server server;
+    ASSERT_EQ(server.Start(endpoint), 0);
+
+    OwnedFD fd(tcp_connect(endpoint, nullptr));
+    ASSERT_TRUE(fd.valid());
+    ASSERT_TRUE(LoopUntil(
+        [] { return FindAcceptor(8118).connections == 1; }, 1000));
+
+    // Closed with RST instead of FIN.
+    struct linger linger = {1, 0};
+    ASSERT_EQ(setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger)),
+              0);
+    fd.reset();
+    EXPECT_TRUE(LoopUntil(
+        [] { return FindAcceptor(8118).connections == 0; }, 1000));
+}
+
+TEST(IdleTest, ServerKeepsConnectionsInProcessing) {
+    const EndPoint endpoint(IP_ANY, 8128);
+    Server server;
+    server.AddService(new EchoServiceImpl, SERVER_OWNS_SERVICE);
+    ServerOptions options;
+    options.idle_timeout_s = 1;
+    ASSERT_EQ(server.Start(endpoint, options), 0);
+
+    ChannelOptions channel_options;
+    channel_options.timeout_ms = 10000;
+    Channel channel;
+    ASSERT_EQ(channel.Init("127.0.0.1:8128", channel_options), 0);
+    EchoService_Stub stub(&channel);
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    EchoRequest request;
+    EchoResponse response;
+    request.set_message("slow");
+    bool done = false;
+    stub.Echo(cntl.get(), &request, &response, NewCallback(&SetTrue, &done));
+
+    // The handler takes longer than the idle timeout.
+    LoopUntil([] { return false; }, 2500);
+    ASSERT_NE(slow_done, nullptr);
+    EXPECT_EQ(FindAcceptor(8128).connections, 1);
+    slow_done->Run();
+    slow_done = nullptr;
+    ASSERT_TRUE(LoopUntil([&] { return done; }, 1000));
+    EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+    EXPECT_EQ(response.message(), "slow");
+}
@@ -0,0 +1,168 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "urpc/base.h"
+#include "urpc/stats.h"
+
+using namespace urpc;
+
+namespace {
+
+class FakeHandle : public IOHandle {
+public:
+    explicit FakeHandle(std::atomic<int>* destroyed = nullptr)
+        : destroyed_(destroyed) {}
+    ~FakeHandle() override {
+        if (destroyed_)
+            destroyed_->fetch_add(1);
+    }
+
+    int fd() const override { return -1; }
+    int HandleReadEvent() override { return 0; }
+    int HandleWriteEvent() override { return 0; }
+    void Reset(int code, std::string reason) override {}
+
+private:
+    std::atomic<int>* destroyed_;
+};
+
+}  // namespace
+
+TEST(IOHandleTest, Address) {
+    auto handle = new FakeHandle;
+    const uint64_t id = handle->id();
+    EXPECT_NE(id, 0);
+    {
+        auto addressed = IOHandle::Address(id);
+        ASSERT_EQ(addressed.get(), handle);
+        EXPECT_EQ(handle->ref_count(), 2);
+    }
+    EXPECT_EQ(handle->ref_count(), 1);
+    handle->RelRef();
+    EXPECT_EQ(IOHandle::Address(id).get(), nullptr);
+
+    // The slot is reused with another version.
+    auto reused = new FakeHandle;
+    EXPECT_EQ(static_cast<uint32_t>(reused->id()), static_cast<uint32_t>(id));
+    EXPECT_NE(reused->id(), id);
+    EXPECT_EQ(IOHandle::Address(id).get(), nullptr);
+    EXPECT_EQ(IOHandle::Address(reused->id()).get(), reused);
+    reused->RelRef();
+    EXPECT_EQ(IOHandle::Address(0).get(), nullptr);
+}
+
+TEST(IOHandleTest, OwnerPtrRelease) {
+    auto handle = new FakeHandle;
+    utils::owner_ptr<IOHandle> ptr(handle);
+    EXPECT_TRUE(ptr);
+    EXPECT_EQ(ptr.release(), handle);
+    EXPECT_FALSE(ptr);
+    EXPECT_EQ(handle->ref_count(), 1);
+    handle->RelRef();
+}
+
+TEST(IOHandleTest, AddressedByOtherThreads) {
+    std::atomic<int> destroyed{0};
+    for (int round = 0; round < 100; ++round) {
+        auto handle = new FakeHandle(&destroyed);
+        const uint64_t id = handle->id();
+        std::atomic<bool> start{false};
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&] {
+                while (!start.load()) {
+                }
+                // Resolved until the owner releases the handle, never after.
+                for (int j = 0; j < 1000; ++j) {
+                    auto addressed = IOHandle::Address(id);
+                    if (!addressed.get())
+                        break;
+                    addressed->AddRef();
+                    addressed->RelRef();
+                }
+            });
+        }
+        start.store(true);
+        handle->RelRef();
+        for (auto&& thread : threads)
+            thread.join();
+        EXPECT_EQ(IOHandle::Address(id).get(), nullptr);
+        EXPECT_EQ(destroyed.load(), round + 1);
+    }
+}
+
+TEST(IOHandleTest, RegisteredByOtherThreads) {
+    std::atomic<int> destroyed{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] {
+            // The slots are reused across the threads.
+            for (int j = 0; j < 10000; ++j) {
+                auto handle = new FakeHandle(&destroyed);
+                const uint64_t id = handle->id();
+                EXPECT_EQ(IOHandle::Address(id).get(), handle);
+                handle->RelRef();
+                EXPECT_EQ(IOHandle::Address(id).get(), nullptr);
+            }
+        });
+    }
+    for (auto&& thread : threads)
+        thread.join();
+    EXPECT_EQ(destroyed.load(), 40000);
+}
+
+TEST(IOHandleTest, ClosedConnectionDestroyed) {
+    Server server;
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8126)), 0);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(8126);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(
+        ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)),
+        0);
+
+    uint64_t id = 0;
+    for (int i = 0; i < 100 && id == 0; ++i) {
+        IOContext context(LOOP_ONCE);
+        for (auto&& stats : StatsRegistry::singleton()->ListTransports()) {
+            if (stats.server_side)
+                id = stats.id;
+        }
+    }
+    ASSERT_NE(id, 0);
+    EXPECT_NE(IOHandle::Address(id).get(), nullptr);
+
+    // Released by the poller once the peer closes the connection.
+    ::close(fd);
+    for (int i = 0; i < 100 && IOHandle::Address(id).get(); ++i) {
+        IOContext context(LOOP_ONCE);
+    }
+    EXPECT_EQ(IOHandle::Address(id).get(), nullptr);
+}
@@ -0,0 +1,335 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <echo.pb.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "urpc/base.h"
+#include "urpc/load_balancer.h"
+#include "urpc/naming_service.h"
+#include "urpc/stats.h"
+
+DECLARE_int32(naming_file_check_interval_ms);
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+std::vector<ServerNode> MakeServers(const std::vector<int>& weights) {
+    std::vector<ServerNode> servers;
+    for (size_t i = 0; i < weights.size(); ++i) {
+        ServerNode node;
+        str2endpoint("127.0.0.1", 9000 + i, &node.addr);
+        node.weight = weights[i];
+        servers.push_back(node);
+    }
+    return servers;
+}
+
+/// The number of selections per port.
+std::map<int, int> Select(LoadBalancer* lb, int count) {
+    std::map<int, int> counts;
+    for (int i = 0; i < count; ++i) {
+        EndPoint server;
+        EXPECT_EQ(lb->SelectServer(LoadBalancer::SelectIn(), &server), 0);
+        counts[server.port]++;
+    }
+    return counts;
+}
+
+class EchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        done->Run();
+    }
+};
+
+void SetTrue(bool* flag) { *flag = true; }
+
+}  // namespace
+
+TEST(NamingServiceTest, List) {
+    auto ns = NamingService::New("list://127.0.0.1:8000, 127.0.0.1:8001 3");
+    ASSERT_NE(ns, nullptr);
+    std::vector<ServerNode> servers;
+    ASSERT_EQ(ns->GetServers(&servers), 0);
+    ASSERT_EQ(servers.size(), 2);
+    EXPECT_EQ(servers[0].addr.port, 8000);
+    EXPECT_EQ(servers[0].weight, 1);
+    EXPECT_EQ(servers[1].addr.port, 8001);
+    EXPECT_EQ(servers[1].weight, 3);
+    EXPECT_FALSE(ns->Changed());
+
+    for (const char* weight : {"0", "-1", "10001", "4294967297",
+                               "99999999999999999999"}) {
+        EXPECT_EQ(NamingService::New(std::string("list://127.0.0.1:8000 ") +
+                                     weight)
+                      ->GetServers(&servers),
+                  -1)
+            << weight;
+    }
+    EXPECT_EQ(NamingService::New("list://127.0.0.1:8000 10000")
+                  ->GetServers(&servers),
+              0);
+    EXPECT_EQ(NamingService::New("list://127.0.0.1")->GetServers(&servers),
+              -1);
+    EXPECT_EQ(NamingService::New("dns://localhost"), nullptr);
+    EXPECT_EQ(NamingService::New("127.0.0.1:8000"), nullptr);
+}
+
+TEST(NamingServiceTest, File) {
+    FLAGS_naming_file_check_interval_ms = 0;
+    char path[] = "/tmp/urpc_naming_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    std::ofstream(path) << "# servers\n127.0.0.1:8000\n\n127.0.0.1:8001 2\n";
+
+    auto ns = NamingService::New(std::string("file://") + path);
+    ASSERT_NE(ns, nullptr);
+    std::vector<ServerNode> servers;
+    ASSERT_EQ(ns->GetServers(&servers), 0);
+    ASSERT_EQ(servers.size(), 2);
+    EXPECT_EQ(servers[1].weight, 2);
+    EXPECT_FALSE(ns->Changed());
+
+    usleep(10000);
+    std::ofstream(path) << "127.0.0.1:8002\n";
+    EXPECT_TRUE(ns->Changed());
+    ASSERT_EQ(ns->GetServers(&servers), 0);
+    ASSERT_EQ(servers.size(), 1);
+    EXPECT_EQ(servers[0].addr.port, 8002);
+    EXPECT_FALSE(ns->Changed());
+    unlink(path);
+}
+
+TEST(LoadBalancerTest, RoundRobin) {
+    auto lb = LoadBalancer::New("rr");
+    EndPoint server;
+    EXPECT_EQ(lb->SelectServer(LoadBalancer::SelectIn(), &server), -1);
+
+    lb->ResetServers(MakeServers({1, 1, 1}));
+    auto counts = Select(lb.get(), 300);
+    EXPECT_EQ(counts, (std::map<int, int>{{9000, 100}, {9001, 100},
+                                          {9002, 100}}));
+
+    lb->ResetServers(MakeServers({1}));
+    EXPECT_EQ(Select(lb.get(), 10)[9000], 10);
+}
+
+TEST(LoadBalancerTest, WeightedRandom) {
+    auto lb = LoadBalancer::New("wr");
+    lb->ResetServers(MakeServers({1, 3}));
+    auto counts = Select(lb.get(), 40000);
+    EXPECT_NEAR(counts[9000], 10000, 1000);
+    EXPECT_NEAR(counts[9001], 30000, 1000);
+}
+
+TEST(LoadBalancerTest, LocalityAware) {
+    auto lb = LoadBalancer::New("la");
+    lb->ResetServers(MakeServers({1, 1}));
+
+    // The first server is 10 times faster.
+    std::map<int, int> counts;
+    for (int i = 0; i < 10000; ++i) {
+        EndPoint server;
+        ASSERT_EQ(lb->SelectServer(LoadBalancer::SelectIn(), &server), 0);
+        counts[server.port]++;
+        lb->Feedback(server, true, server.port == 9000 ? 1000 : 10000);
+    }
+    EXPECT_GT(counts[9000], 8 * counts[9001]);
+
+    // Failures make a server look slower.
+    counts.clear();
+    for (int i = 0; i < 1000; ++i) {
+        EndPoint server;
+        ASSERT_EQ(lb->SelectServer(LoadBalancer::SelectIn(), &server), 0);
+        counts[server.port]++;
+        lb->Feedback(server, server.port != 9000,
+                     server.port == 9000 ? 1000 : 10000);
+    }
+    EXPECT_GT(counts[9001], counts[9000]);
+
+    // The stats are kept across resets, and new servers are probed.
+    lb->ResetServers(MakeServers({1, 1, 1}));
+    counts.clear();
+    for (int i = 0; i < 1000; ++i) {
+        EndPoint server;
+        ASSERT_EQ(lb->SelectServer(LoadBalancer::SelectIn(), &server), 0);
+        counts[server.port]++;
+        lb->Feedback(server, true, server.port == 9002 ? 100 : 10000);
+    }
+    EXPECT_GT(counts[9002], counts[9000] + counts[9001]);
+}
+
+TEST(LoadBalancerTest, MD5) {
+    auto hex = [](const std::string& data) {
+        uint8_t digest[16];
+        MD5(data.data(), data.size(), digest);
+        std::string s;
+        char buf[3];
+        for (uint8_t b : digest) {
+            snprintf(buf, sizeof(buf), "%02x", b);
+            s += buf;
+        }
+        return s;
+    };
+    EXPECT_EQ(hex(""), "d41d8cd98f00b204e9800998ecf8427e");
+    EXPECT_EQ(hex("abc"), "900150983cd24fb0d6963f7d28e17f72");
+    EXPECT_EQ(hex(std::string(100, 'a')), "36a92cc94a9e0fa21f625f8bfb007adf");
+}
+
+TEST(LoadBalancerTest, ConsistentHash) {
+    for (const char* name : {"c_murmurhash", "c_ketama"}) {
+        SCOPED_TRACE(name);
+        auto lb = LoadBalancer::New(name);
+        ASSERT_NE(lb, nullptr);
+        lb->ResetServers(MakeServers({1, 1, 1, 1}));
+
+        EndPoint server;
+        EXPECT_EQ(lb->SelectServer(LoadBalancer::SelectIn(), &server), -1);
+
+        LoadBalancer::SelectIn in;
+        in.has_request_code = true;
+        std::vector<EndPoint> before;
+        std::map<int, int> counts;
+        for (uint64_t i = 0; i < 10000; ++i) {
+            in.request_code = MurmurHash64(&i, sizeof(i), 0);
+            ASSERT_EQ(lb->SelectServer(in, &server), 0);
+            before.push_back(server);
+            counts[server.port]++;
+        }
+        for (auto&& [port, count] : counts)
+            EXPECT_NEAR(count, 2500, 500) << port;
+
+        // Only the codes of the removed server move.
+        auto servers = MakeServers({1, 1, 1, 1});
+        servers.erase(servers.begin() + 1);
+        lb->ResetServers(servers);
+        for (uint64_t i = 0; i < 10000; ++i) {
+            in.request_code = MurmurHash64(&i, sizeof(i), 0);
+            ASSERT_EQ(lb->SelectServer(in, &server), 0);
+            if (before[i].port != 9001) {
+                EXPECT_EQ(server, before[i]);
+            } else {
+                EXPECT_NE(server.port, 9001);
+            }
+        }
+    }
+}
+
+TEST(LoadBalancerTest, BoundedConsistentHash) {
+    EXPECT_EQ(LoadBalancer::New("rr_bounded"), nullptr);
+
+    auto lb = LoadBalancer::New("c_murmurhash_bounded");
+    lb->ResetServers(MakeServers({1, 1, 1, 1}));
+
+    // A hot code spills over once its server exceeds 1.25 times the average.
+    LoadBalancer::SelectIn in;
+    in.has_request_code = true;
+    in.request_code = 12345;
+    std::vector<EndPoint> selected;
+    std::map<int, int> counts;
+    for (int i = 0; i < 100; ++i) {
+        EndPoint server;
+        ASSERT_EQ(lb->SelectServer(in, &server), 0);
+        selected.push_back(server);
+        counts[server.port]++;
+    }
+    ASSERT_EQ(counts.size(), 4u);
+    for (auto&& [port, count] : counts)
+        EXPECT_LE(count, 32) << port;
+
+    // The code returns to its server once the requests are done.
+    for (auto&& server : selected)
+        lb->Feedback(server, true, 100);
+    for (int i = 0; i < 10; ++i) {
+        EndPoint server;
+        ASSERT_EQ(lb->SelectServer(in, &server), 0);
+        EXPECT_EQ(server, selected[0]);
+        lb->Feedback(server, true, 100);
+    }
+}
+
+TEST(LoadBalancerTest, Channel) {
+    Server server1, server2;
+    server1.AddService(new EchoServiceImpl,
+                       ServiceOwnership::SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server1.Start(EndPoint(IP_ANY, 8098)), 0);
+    ASSERT_EQ(server2.Start(EndPoint(IP_ANY, 8099)), 0);
+
+    Channel channel;
+    EXPECT_EQ(channel.Init("list://127.0.0.1:8098", "unknown",
+                           ChannelOptions()),
+              -1);
+    ASSERT_EQ(channel.Init("list://127.0.0.1:8098,127.0.0.1:8099",
+                           ChannelOptions()),
+              0);
+    EchoService_Stub stub(&channel);
+    for (int i = 0; i < 10; ++i) {
+        std::unique_ptr<Controller> cntl(NewURPCController());
+        EchoRequest request;
+        EchoResponse response;
+        request.set_message("hello");
+        bool done = false;
+        stub.Echo(cntl.get(), &request, &response,
+                  NewCallback(&SetTrue, &done));
+        while (!done) {
+            IOContext context(LOOP_ONCE);
+        }
+        EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+        EXPECT_EQ(response.message(), "hello");
+    }
+
+    std::map<int, uint64_t> messages;
+    for (auto&& stats : StatsRegistry::singleton()->ListTransports()) {
+        if (!stats.server_side)
+            messages[stats.remote_side.port] += stats.messages_out;
+    }
+    EXPECT_EQ(messages[8098], 5);
+    EXPECT_EQ(messages[8099], 5);
+
+    // Calls fail at once without servers.
+    Channel empty;
+    ASSERT_EQ(empty.Init("list://", "rr", ChannelOptions()), 0);
+    EchoService_Stub empty_stub(&empty);
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    EchoRequest request;
+    EchoResponse response;
+    bool done = false;
+    empty_stub.Echo(cntl.get(), &request, &response,
+                    NewCallback(&SetTrue, &done));
+    EXPECT_TRUE(done);
+    EXPECT_EQ(cntl->ErrorCode(), ERR_NO_SERVER);
+}
@@ -0,0 +1,67 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "urpc/latency_recorder.h"
+#include "urpc/method_status.h"
+
+using namespace urpc;
+
+TEST(LatencyRecorderTest, MergeThreads) {
+    LatencyRecorder recorder;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&recorder]() {
+            for (uint64_t i = 1; i <= 1000; ++i)
+                recorder.Record(i);
+        });
+    }
+    for (auto&& thread : threads)
+        thread.join();
+
+    auto stats = recorder.Sample();
+    EXPECT_EQ(recorder.count(), 4000);
+    EXPECT_EQ(stats.total_count, 4000);
+    EXPECT_EQ(stats.total_sum_us, 4 * 500500);
+    EXPECT_EQ(stats.max_us, 1000);
+    EXPECT_NEAR(stats.avg_us, 500.5, 0.01);
+    EXPECT_NEAR(stats.p50_us, 500, 500 / 16);
+    EXPECT_NEAR(stats.p99_us, 990, 990 / 16);
+    EXPECT_GT(stats.qps, 0);
+}
+
+TEST(MethodStatusTest, Counters) {
+    MethodStatus* status =
+        MethodStatusRegistry::singleton()->GetOrCreate("test.Echo");
+    EXPECT_EQ(status,
+              MethodStatusRegistry::singleton()->GetOrCreate("test.Echo"));
+
+    status->OnRequested();
+    status->OnRequested();
+    status->OnRequested();
+    EXPECT_EQ(status->processing(), 3);
+
+    std::thread([status]() { status->OnResponded(true, 100); }).join();
+    status->OnResponded(false, 100);
+
+    auto stats = status->Sample();
+    EXPECT_EQ(stats.full_name, "test.Echo");
+    EXPECT_EQ(stats.processing, 1);
+    EXPECT_EQ(stats.errors, 1);
+    EXPECT_EQ(stats.latency.total_count, 1);
+}
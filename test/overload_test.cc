@@ -0,0 +1,274 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <gflags/gflags.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <echo.pb.h>
+#include <gtest/gtest.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <memory>
+#include <string>
+
+#include "urpc/base.h"
+#include "urpc/coding.h"
+#include "urpc/iobuf.h"
+#include "urpc/protocol/urpc/call.h"
+#include "urpc/stats.h"
+
+DECLARE_int64(write_high_watermark);
+DECLARE_int64(write_low_watermark);
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+constexpr int kNumRequests = 64;
+constexpr size_t kMessageSize = 256 * 1024;
+
+class EchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        done->Run();
+    }
+};
+
+int Connect(int port, bool non_blocking) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    if (non_blocking)
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+/// The sum of the counters of the connections of one side.
+TransportStats SumStats(bool server_side) {
+    TransportStats sum;
+    for (auto&& stats : StatsRegistry::singleton()->ListTransports()) {
+        if (stats.server_side != server_side)
+            continue;
+        sum.messages_in += stats.messages_in;
+        sum.messages_out += stats.messages_out;
+        sum.overloaded += stats.overloaded;
+        sum.rejected_writes += stats.rejected_writes;
+        sum.pending_bytes += stats.pending_bytes;
+    }
+    return sum;
+}
+
+void SetTrue(bool* flag) { *flag = true; }
+
+void Increase(size_t* count) { ++*count; }
+
+}  // namespace
+
+TEST(OverloadTest, ServerStopsReading) {
+    FLAGS_write_high_watermark = 1024 * 1024;
+    FLAGS_write_low_watermark = 256 * 1024;
+
+    Server server;
+    server.AddService(new EchoServiceImpl,
+                      ServiceOwnership::SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8095)), 0);
+
+    int fd = Connect(8095, true);
+    ASSERT_GE(fd, 0);
+
+    // Pipeline requests without reading any response.
+    std::string requests;
+    EchoRequest request;
+    request.set_message(std::string(kMessageSize, 'x'));
+    for (int i = 0; i < kNumRequests; ++i) {
+        protocol::urpc::RPCMeta meta;
+        meta.set_correlation_id(i + 1);
+        meta.mutable_request()->set_service_name("test.EchoService");
+        meta.mutable_request()->set_method_name("Echo");
+        IOBuf body, buf;
+        body.append(request.SerializeAsString());
+        protocol::urpc::AppendMessage(meta, std::move(body), &buf);
+        requests += buf.to_string();
+    }
+    size_t written = 0;
+    for (int i = 0; i < 1000 && SumStats(true).overloaded == 0; ++i) {
+        ssize_t n = ::write(fd, requests.data() + written,
+                            requests.size() - written);
+        if (n > 0)
+            written += n;
+        IOContext context(LOOP_ONCE);
+    }
+
+    // The server stops reading once the responses pile up.
+    auto stats = SumStats(true);
+    EXPECT_GT(stats.overloaded, 0);
+    EXPECT_LT(stats.messages_in, kNumRequests);
+
+    // All requests are served once the responses are read.
+    int responses = 0;
+    std::string input;
+    char data[64 * 1024];
+    for (int i = 0; i < 10000 && responses < kNumRequests; ++i) {
+        if (written < requests.size()) {
+            ssize_t n = ::write(fd, requests.data() + written,
+                                requests.size() - written);
+            if (n > 0)
+                written += n;
+        }
+        ssize_t n;
+        while ((n = ::read(fd, data, sizeof(data))) > 0) {
+            input.append(data, n);
+        }
+        while (input.size() >= 12) {
+            auto header = reinterpret_cast<const uint8_t*>(input.data());
+            size_t size =
+                12 + DecodeFixed32(header + 4) + DecodeFixed32(header + 8);
+            if (input.size() < size)
+                break;
+            input.erase(0, size);
+            responses++;
+        }
+        IOContext context(LOOP_ONCE);
+    }
+    EXPECT_EQ(responses, kNumRequests);
+    EXPECT_EQ(SumStats(true).messages_in, kNumRequests);
+    ::close(fd);
+}
+
+TEST(OverloadTest, ClientFailsFast) {
+    FLAGS_write_high_watermark = 1024 * 1024;
+    FLAGS_write_low_watermark = 256 * 1024;
+
+    // A server never reads.
+    int listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(8096);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int on = 1;
+    ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    ASSERT_EQ(::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr),
+                     sizeof(addr)),
+              0);
+    ASSERT_EQ(::listen(listen_fd, 16), 0);
+
+    Channel channel;
+    ASSERT_EQ(channel.Init("127.0.0.1:8096", ChannelOptions()), 0);
+    EchoService_Stub stub(&channel);
+    EchoRequest request;
+    request.set_message(std::string(kMessageSize, 'x'));
+
+    std::vector<std::unique_ptr<Controller>> cntls;
+    std::vector<std::unique_ptr<EchoResponse>> responses;
+    size_t completed = 0;
+    for (int i = 0; i < 1000 && completed == 0; ++i) {
+        cntls.emplace_back(NewURPCController());
+        responses.emplace_back(new EchoResponse);
+        stub.Echo(cntls.back().get(), &request, responses.back().get(),
+                  NewCallback(&Increase, &completed));
+        IOContext context(LOOP_ONCE);
+    }
+    ASSERT_EQ(completed, 1);
+    EXPECT_EQ(cntls.back()->ErrorCode(), ERR_OVERLOADED);
+    EXPECT_EQ(SumStats(false).rejected_writes, 1);
+    EXPECT_EQ(SumStats(false).overloaded, 1);
+
+    // The calls queued fail once the connection is reset.
+    ::close(listen_fd);
+    for (int i = 0; i < 1000 && completed < cntls.size(); ++i) {
+        IOContext context(LOOP_ONCE);
+    }
+    EXPECT_EQ(completed, cntls.size());
+}
+
+TEST(OverloadTest, PeerResetWhileWriting) {
+    Server server;
+    server.AddService(new EchoServiceImpl,
+                      ServiceOwnership::SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8124)), 0);
+
+    int fd = Connect(8124, true);
+    ASSERT_GE(fd, 0);
+    std::string requests;
+    EchoRequest request;
+    request.set_message(std::string(kMessageSize, 'x'));
+    for (int i = 0; i < kNumRequests; ++i) {
+        protocol::urpc::RPCMeta meta;
+        meta.set_correlation_id(i + 1);
+        meta.mutable_request()->set_service_name("test.EchoService");
+        meta.mutable_request()->set_method_name("Echo");
+        IOBuf body, buf;
+        body.append(request.SerializeAsString());
+        protocol::urpc::AppendMessage(meta, std::move(body), &buf);
+        requests += buf.to_string();
+    }
+
+    // The responses are queued since none is read.
+    const uint64_t pending_bytes = SumStats(true).pending_bytes;
+    size_t written = 0;
+    for (int i = 0; i < 1000 && SumStats(true).pending_bytes == pending_bytes;
+         ++i) {
+        ssize_t n = ::write(fd, requests.data() + written,
+                            requests.size() - written);
+        if (n > 0)
+            written += n;
+        IOContext context(LOOP_ONCE);
+    }
+    ASSERT_GT(SumStats(true).pending_bytes, pending_bytes);
+
+    // Reset with RST, the write and the read fail in the same event.
+    struct linger linger = {1, 0};
+    ASSERT_EQ(::setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger)),
+              0);
+    ::close(fd);
+    for (int i = 0; i < 100 && SumStats(true).pending_bytes > pending_bytes;
+         ++i) {
+        IOContext context(LOOP_ONCE);
+    }
+    EXPECT_EQ(SumStats(true).pending_bytes, pending_bytes);
+
+    // The server keeps serving.
+    Channel channel;
+    ASSERT_EQ(channel.Init("127.0.0.1:8124", ChannelOptions()), 0);
+    EchoService_Stub stub(&channel);
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    EchoResponse response;
+    bool done = false;
+    request.set_message("hello");
+    stub.Echo(cntl.get(), &request, &response, NewCallback(&SetTrue, &done));
+    while (!done) {
+        IOContext context(LOOP_ONCE);
+    }
+    EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+}
@@ -0,0 +1,134 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <string>
+
+#include "urpc/base.h"
+#include "urpc/protocol/manager.h"
+
+using namespace urpc;
+using namespace urpc::protocol;
+
+namespace {
+
+/// A protocol whose magic is shared by others, the byte after the magic
+/// decides.
+class FakeProtocol final : public BaseProtocol {
+public:
+    FakeProtocol(const char* header, char version)
+        : header_(header), version_(version) {}
+
+    const char* Header() const override { return header_; }
+
+    int Probe(const IOBuf& buf) const override {
+        char version;
+        if (buf.copy_to(&version, 1, strlen(header_)) < 1)
+            return ERR_TOO_SMALL;
+        return version == version_ ? ERR_OK : ERR_MISMATCH;
+    }
+
+    int ParseRequest(IOBuf* buf, ServerTransport* transport,
+                     ServerCall** server_call) override {
+        return ERR_NOT_SUPPORTED;
+    }
+
+    int ParseResponse(IOBuf* buf, ClientTransport* transport) override {
+        return ERR_NOT_SUPPORTED;
+    }
+
+private:
+    const char* header_;
+    const char version_;
+};
+
+int Probe(const std::string& payload, BaseProtocol** protocol) {
+    IOBuf buf;
+    buf.append(payload);
+    *protocol = nullptr;
+    return ProtocolManager::singleton()->ProbeProtocol(buf, protocol);
+}
+
+}  // namespace
+
+TEST(ProtocolManagerTest, BuiltinProtocols) {
+    auto manager = ProtocolManager::singleton();
+    BaseProtocol* urpc = manager->FindProtocol("URPC");
+    BaseProtocol* http = manager->FindProtocol("GET ");
+    ASSERT_NE(urpc, nullptr);
+    ASSERT_NE(http, nullptr);
+    EXPECT_EQ(manager->FindProtocol("POST "), http);
+    EXPECT_EQ(manager->FindProtocol("POST"), nullptr);
+
+    BaseProtocol* protocol = nullptr;
+    EXPECT_EQ(Probe("URPC\x01", &protocol), ERR_OK);
+    EXPECT_EQ(protocol, urpc);
+    EXPECT_EQ(Probe("POST /a HTTP/1.1\r\n", &protocol), ERR_OK);
+    EXPECT_EQ(protocol, http);
+
+    EXPECT_EQ(Probe("", &protocol), ERR_TOO_SMALL);
+    EXPECT_EQ(Probe("G", &protocol), ERR_TOO_SMALL);
+    EXPECT_EQ(Probe("POST", &protocol), ERR_TOO_SMALL);
+    EXPECT_EQ(Probe("GOT ", &protocol), ERR_MISMATCH);
+    EXPECT_EQ(Probe("\xff", &protocol), ERR_MISMATCH);
+    EXPECT_EQ(protocol, nullptr);
+}
+
+TEST(ProtocolManagerTest, VariableLengthMagic) {
+    static FakeProtocol v1("FAKE", '1');
+    static FakeProtocol v2("FAKE:", '2');
+    static FakeProtocol long_magic("FAKE-LONG-MAGIC/", '1');
+    auto manager = ProtocolManager::singleton();
+    EXPECT_TRUE(manager->Register(&v1));
+    EXPECT_TRUE(manager->Register(&v2));
+    EXPECT_TRUE(manager->Register(&long_magic));
+
+    BaseProtocol* protocol = nullptr;
+    EXPECT_EQ(Probe("FAKE1", &protocol), ERR_OK);
+    EXPECT_EQ(protocol, &v1);
+    EXPECT_EQ(Probe("FAKE:2", &protocol), ERR_OK);
+    EXPECT_EQ(protocol, &v2);
+    EXPECT_EQ(Probe("FAKE-LONG-MAGIC/1", &protocol), ERR_OK);
+    EXPECT_EQ(protocol, &long_magic);
+
+    // The longer magic is still possible, or the protocol asks for more.
+    EXPECT_EQ(Probe("FAKE-LONG", &protocol), ERR_TOO_SMALL);
+    EXPECT_EQ(Probe("FAKE", &protocol), ERR_TOO_SMALL);
+    EXPECT_EQ(Probe("FAKE:1", &protocol), ERR_MISMATCH);
+    EXPECT_EQ(Probe("FAKE3", &protocol), ERR_MISMATCH);
+}
+
+TEST(ProtocolManagerTest, LongerMagicSplit) {
+    static FakeProtocol short_magic("ZIP", '1');
+    static FakeProtocol long_magic("ZIP1-LONG/", '2');
+    auto manager = ProtocolManager::singleton();
+    EXPECT_TRUE(manager->Register(&short_magic));
+    EXPECT_TRUE(manager->Register(&long_magic));
+
+    // The longer magic arrives by two reads, the shorter one matches the
+    // first part.
+    IOBuf buf;
+    buf.append("ZIP1-LO");
+    BaseProtocol* protocol = nullptr;
+    EXPECT_EQ(manager->ProbeProtocol(buf, &protocol), ERR_TOO_SMALL);
+    EXPECT_EQ(protocol, nullptr);
+    buf.append("NG/2");
+    EXPECT_EQ(manager->ProbeProtocol(buf, &protocol), ERR_OK);
+    EXPECT_EQ(protocol, &long_magic);
+
+    EXPECT_EQ(Probe("ZIP1x", &protocol), ERR_OK);
+    EXPECT_EQ(protocol, &short_magic);
+}
@@ -0,0 +1,186 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/redis.h>
+#include <urpc/server.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "urpc/base.h"
+#include "urpc/iobuf.h"
+#include "urpc/protocol/redis/parser.h"
+
+using namespace urpc;
+using namespace urpc::protocol::redis;
+
+namespace {
+
+int ConnectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/// Drive the server loop until `size` bytes are received or the peer closed.
+std::string Receive(int fd, size_t size) {
+    std::string received;
+    char buf[4096];
+    for (int i = 0; i < 1000 && received.size() < size; ++i) {
+        IOContext context(LOOP_ONCE);
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n == 0)
+            break;
+        if (n > 0)
+            received.append(buf, n);
+    }
+    return received;
+}
+
+}  // namespace
+
+TEST(RedisCommandParserTest, ParseByteByByte) {
+    const std::string payload =
+        "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$5\r\nva\r\nl\r\n"
+        "*0\r\n"
+        "*2\r\n$3\r\nGET\r\n$0\r\n\r\n";
+
+    RedisCommandParser parser;
+    IOBuf buf;
+    std::vector<std::vector<std::string>> commands;
+    for (char c : payload) {
+        buf.push_back(c);
+        std::vector<std::string> args;
+        int code = parser.Parse(&buf, &args);
+        if (code == ERR_OK) {
+            commands.push_back(args);
+        } else {
+            ASSERT_EQ(code, ERR_TOO_SMALL);
+        }
+    }
+    EXPECT_TRUE(buf.empty());
+    ASSERT_EQ(commands.size(), 2);
+    EXPECT_EQ(commands[0],
+              (std::vector<std::string>{"SET", "key", "va\r\nl"}));
+    EXPECT_EQ(commands[1], (std::vector<std::string>{"GET", ""}));
+}
+
+TEST(RedisCommandParserTest, Invalid) {
+    std::vector<std::string> args;
+    {
+        RedisCommandParser parser;
+        IOBuf buf;
+        buf.append("GET / HTTP/1.1\r\n\r\n");
+        EXPECT_EQ(parser.Parse(&buf, &args), ERR_MISMATCH);
+    }
+    {
+        RedisCommandParser parser;
+        IOBuf buf;
+        buf.append("*1\r\n:1\r\n");
+        EXPECT_EQ(parser.Parse(&buf, &args), ERR_NOT_SUPPORTED);
+    }
+    {
+        RedisCommandParser parser;
+        IOBuf buf;
+        buf.append("*1\r\n$1\r\nab\r\n");
+        EXPECT_EQ(parser.Parse(&buf, &args), ERR_NOT_SUPPORTED);
+    }
+    {
+        RedisCommandParser parser;
+        IOBuf buf;
+        buf.append("*1\r\n$99999999999999999999999\r\n");
+        EXPECT_EQ(parser.Parse(&buf, &args), ERR_NOT_SUPPORTED);
+    }
+}
+
+TEST(RedisReplyTest, Encode) {
+    IOBuf buf;
+    RedisReply reply(&buf);
+    reply.AppendArray(5);
+    reply.AppendStatus("OK");
+    reply.AppendError("ERR bad\r\nline");
+    reply.AppendInteger(-42);
+    reply.AppendString("a\r\nb");
+    reply.AppendNull();
+    EXPECT_EQ(buf.to_string(),
+              "*5\r\n+OK\r\n-ERR bad  line\r\n:-42\r\n$4\r\na\r\nb\r\n$-1\r\n");
+}
+
+TEST(RedisProtocolTest, PipelinedCommands) {
+    std::unordered_map<std::string, std::string> cache;
+    auto service = new RedisService;
+    service->AddCommandHandler(
+        "set", [&cache](const std::vector<std::string>& args,
+                        RedisReply* reply) {
+            if (args.size() != 3) {
+                reply->AppendError("ERR wrong number of arguments");
+                return;
+            }
+            cache[args[1]] = args[2];
+            reply->AppendStatus("OK");
+        });
+    service->AddCommandHandler(
+        "GET", [&cache](const std::vector<std::string>& args,
+                        RedisReply* reply) {
+            auto it = cache.find(args.size() > 1 ? args[1] : "");
+            if (it == cache.end()) {
+                reply->AppendNull();
+            } else {
+                reply->AppendString(it->second);
+            }
+        });
+    EXPECT_FALSE(service->AddCommandHandler(
+        "Get", [](const std::vector<std::string>&, RedisReply*) {}));
+
+    Server server;
+    ASSERT_EQ(server.AddRedisService(service,
+                                     ServiceOwnership::SERVER_OWNS_SERVICE),
+              0);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8092)), 0);
+
+    int fd = ConnectTo(8092);
+    ASSERT_GE(fd, 0);
+    const std::string commands =
+        "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$5\r\nvalue\r\n"
+        "*2\r\n$3\r\nget\r\n$3\r\nkey\r\n"
+        "*2\r\n$3\r\nGET\r\n$7\r\nmissing\r\n"
+        "*1\r\n$4\r\nINCR\r\n";
+    ASSERT_EQ(write(fd, commands.data(), commands.size()),
+              static_cast<ssize_t>(commands.size()));
+    const std::string expected =
+        "+OK\r\n$5\r\nvalue\r\n$-1\r\n-ERR unknown command 'INCR'\r\n";
+    EXPECT_EQ(Receive(fd, expected.size()), expected);
+
+    // A command split across writes.
+    ASSERT_EQ(write(fd, "*2\r\n$3\r\nGET", 11), 11);
+    EXPECT_EQ(Receive(fd, 1), "");
+    ASSERT_EQ(write(fd, "\r\n$3\r\nkey\r\n", 11), 11);
+    EXPECT_EQ(Receive(fd, 11), "$5\r\nvalue\r\n");
+    close(fd);
+}
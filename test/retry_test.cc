@@ -0,0 +1,178 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <echo.pb.h>
+#include <gtest/gtest.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <memory>
+#include <vector>
+
+#include "urpc/base.h"
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+class EchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        done->Run();
+    }
+};
+
+/// Retry any failure, as if the methods are idempotent.
+class AlwaysRetryPolicy : public RetryPolicy {
+public:
+    bool DoRetry(const Controller* cntl, bool sent) const override {
+        return true;
+    }
+};
+
+/// Close the connections accepted once a request arrives, so the requests
+/// are sent but never answered.
+class ClosingServer {
+public:
+    explicit ClosingServer(int port) {
+        fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        int on = 1;
+        setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        EXPECT_EQ(bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)),
+                  0);
+        EXPECT_EQ(listen(fd_, 16), 0);
+    }
+
+    ~ClosingServer() {
+        for (int fd : conns_)
+            close(fd);
+        close(fd_);
+    }
+
+    void Poll() {
+        int fd = accept4(fd_, nullptr, nullptr, SOCK_NONBLOCK);
+        if (fd >= 0)
+            conns_.push_back(fd);
+        for (auto it = conns_.begin(); it != conns_.end();) {
+            char buf[1024];
+            if (read(*it, buf, sizeof(buf)) > 0) {
+                close(*it);
+                it = conns_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+private:
+    int fd_;
+    std::vector<int> conns_;
+};
+
+void SetTrue(bool* flag) { *flag = true; }
+
+/// Call Echo until done, polling `closing` if any.
+void Echo(Channel* channel, Controller* cntl,
+          ClosingServer* closing = nullptr) {
+    EchoService_Stub stub(channel);
+    EchoRequest request;
+    EchoResponse response;
+    request.set_message("hello");
+    bool done = false;
+    stub.Echo(cntl, &request, &response, NewCallback(&SetTrue, &done));
+    while (!done) {
+        IOContext context(LOOP_ONCE);
+        if (closing)
+            closing->Poll();
+    }
+}
+
+}  // namespace
+
+TEST(RetryTest, ConnectFailure) {
+    Server server;
+    server.AddService(new EchoServiceImpl,
+                      ServiceOwnership::SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8103)), 0);
+
+    // Nothing listens on 8104, the calls fail instead of hanging.
+    ChannelOptions options;
+    options.max_retry = 0;
+    Channel dead;
+    ASSERT_EQ(dead.Init("127.0.0.1:8104", options), 0);
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    Echo(&dead, cntl.get());
+    EXPECT_EQ(cntl->ErrorCode(), ERR_CONNECT);
+
+    // The requests never sent are retried with the next server.
+    options.max_retry = 1;
+    Channel channel;
+    ASSERT_EQ(channel.Init("list://127.0.0.1:8104,127.0.0.1:8103", "rr",
+                           options),
+              0);
+    cntl.reset(NewURPCController());
+    Echo(&channel, cntl.get());
+    EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+}
+
+TEST(RetryTest, RetryPolicy) {
+    Server server;
+    server.AddService(new EchoServiceImpl,
+                      ServiceOwnership::SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8106)), 0);
+    ClosingServer closing(8105);
+
+    // The requests might be sent aren't retried by default.
+    Channel channel;
+    ASSERT_EQ(channel.Init("list://127.0.0.1:8105,127.0.0.1:8106", "rr",
+                           ChannelOptions()),
+              0);
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    Echo(&channel, cntl.get(), &closing);
+    EXPECT_EQ(cntl->ErrorCode(), ERR_EOF);
+
+    AlwaysRetryPolicy policy;
+    ChannelOptions options;
+    options.retry_policy = &policy;
+    options.retry_budget_ratio = 0;
+    options.retry_budget_max_tokens = 1;
+    Channel idempotent;
+    ASSERT_EQ(idempotent.Init("list://127.0.0.1:8105,127.0.0.1:8106", "rr",
+                              options),
+              0);
+    cntl.reset(NewURPCController());
+    Echo(&idempotent, cntl.get(), &closing);
+    EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+
+    // Until the budget is exhausted.
+    cntl.reset(NewURPCController());
+    Echo(&idempotent, cntl.get(), &closing);
+    EXPECT_EQ(cntl->ErrorCode(), ERR_EOF);
+}
@@ -13,8 +13,12 @@
 // limitations under the License.
 
 #include <echo.pb.h>
+#include <errno.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <unistd.h>
 #include <urpc/channel.h>
 #include <urpc/controller.h>
 #include <urpc/endpoint.h>
@@ -25,10 +29,16 @@
 #include <memory>
 #include <ratio>
 #include <thread>
+#include <vector>
 
 #include "google/protobuf/stubs/callback.h"
 #include "urpc/endpoint.h"
 #include "urpc/io_context.h"
+#include "urpc/owned_fd.h"
+#include "urpc/poller.h"
+#include "urpc/stats.h"
+
+DECLARE_int32(accept_batch);
 
 using namespace google::protobuf;
 
@@ -133,3 +143,230 @@ TEST(EchoTest, Basic) {
     server_handle.join();
     client_handle.join();
 }
+
+TEST(ServerTest, ReusePort) {
+    constexpr int kThreads = 2;
+    const EndPoint endpoint(IP_ANY, 8112);
+    std::atomic<int> ready = 0;
+    std::atomic<bool> exit = false;
+    uint64_t poller_ids[kThreads];
+    std::vector<std::thread> workers;
+    for (int i = 0; i < kThreads; ++i) {
+        workers.emplace_back([&, i]() {
+            Server server;
+            RunEchoService(&server);
+            ServerOptions options;
+            options.reuse_port = true;
+            ASSERT_EQ(server.Start(endpoint, options), 0);
+            poller_ids[i] = Poller::singleton()->id();
+
+            ready.fetch_add(1, std::memory_order_release);
+            while (!exit.load(std::memory_order_acquire)) {
+                IOContext context(LOOP_ONCE);
+            }
+        });
+    }
+    while (ready.load(std::memory_order_acquire) < kThreads)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // The address is taken by the listeners sharing it.
+    Server server;
+    EXPECT_NE(server.Start(endpoint), 0);
+    ServerOptions options;
+    options.reuse_port = true;
+    EndPoint unix_endpoint;
+    ASSERT_EQ(str2endpoint("unix:/tmp/urpc_server_test.sock", &unix_endpoint),
+              0);
+    EXPECT_NE(server.Start(unix_endpoint, options), 0);
+    EXPECT_EQ(errno, EINVAL);
+
+    // Each worker accepts a share of the connections by its own acceptor.
+    std::vector<OwnedFD> fds;
+    for (int i = 0; i < 64; ++i) {
+        fds.emplace_back(tcp_connect(EndPoint(IP_ANY, 8112), nullptr));
+        ASSERT_TRUE(fds.back().valid());
+    }
+    uint64_t accepted[kThreads] = {};
+    for (int retry = 0; retry < 500; ++retry) {
+        uint64_t total = 0;
+        for (auto&& stats : StatsRegistry::singleton()->ListAcceptors()) {
+            for (int i = 0; i < kThreads; ++i) {
+                if (stats.poller_id == poller_ids[i]) {
+                    accepted[i] = stats.accepted;
+                    total += stats.accepted;
+                }
+            }
+        }
+        if (total == fds.size())
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(accepted[0] + accepted[1], fds.size());
+    EXPECT_GT(accepted[0], 0);
+    EXPECT_GT(accepted[1], 0);
+
+    fds.clear();
+    exit.store(true, std::memory_order_release);
+    for (auto&& worker : workers)
+        worker.join();
+}
+
+/// Run a server in its own thread, the loop starts once Run() is invoked.
+class ServerThread {
+public:
+    ServerThread(EndPoint endpoint, ServerOptions options) {
+        thread_ = std::thread([this, endpoint, options]() {
+            Server server;
+            RunEchoService(&server);
+            if (server.Start(endpoint, options) != 0) {
+                LOG(FATAL) << "Start server failed";
+                return;
+            }
+            poller_id_ = Poller::singleton()->id();
+            started_.store(true, std::memory_order_release);
+            while (!run_.load(std::memory_order_acquire))
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            while (!exit_.load(std::memory_order_acquire)) {
+                IOContext context(LOOP_ONCE);
+            }
+        });
+        while (!started_.load(std::memory_order_acquire))
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    ~ServerThread() {
+        Run();
+        exit_.store(true, std::memory_order_release);
+        thread_.join();
+    }
+
+    void Run() { run_.store(true, std::memory_order_release); }
+
+    /// Wait until `pred` holds for the stats of the acceptor of the server.
+    template <typename Pred>
+    AcceptorStats WaitFor(Pred pred) {
+        AcceptorStats result;
+        for (int retry = 0; retry < 500; ++retry) {
+            for (auto&& stats : StatsRegistry::singleton()->ListAcceptors()) {
+                if (stats.poller_id == poller_id_)
+                    result = stats;
+            }
+            if (pred(result))
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return result;
+    }
+
+private:
+    std::thread thread_;
+    uint64_t poller_id_{0};
+    std::atomic<bool> started_{false};
+    std::atomic<bool> run_{false};
+    std::atomic<bool> exit_{false};
+};
+
+/// Whether the peer of `fd` closes it.
+bool ClosedByPeer(int fd) {
+    char c;
+    for (int retry = 0; retry < 500; ++retry) {
+        ssize_t n = recv(fd, &c, 1, MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno == ECONNRESET))
+            return true;
+        if (n < 0 && errno != EAGAIN)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+TEST(ServerTest, MaxConnections) {
+    const EndPoint endpoint(IP_ANY, 8113);
+    ServerOptions options;
+    options.max_connections = 2;
+    ServerThread server(endpoint, options);
+    server.Run();
+
+    std::vector<OwnedFD> fds;
+    for (int i = 0; i < 2; ++i) {
+        fds.emplace_back(tcp_connect(endpoint, nullptr));
+        ASSERT_TRUE(fds.back().valid());
+    }
+    auto stats = server.WaitFor(
+        [](const AcceptorStats& s) { return s.connections == 2; });
+    EXPECT_EQ(stats.accepted, 2);
+
+    // The connections over the limit are closed at once.
+    OwnedFD rejected(tcp_connect(endpoint, nullptr));
+    ASSERT_TRUE(rejected.valid());
+    EXPECT_TRUE(ClosedByPeer(rejected));
+    stats = server.WaitFor(
+        [](const AcceptorStats& s) { return s.rejected == 1; });
+    EXPECT_EQ(stats.accepted, 3);
+    EXPECT_EQ(stats.connections, 2);
+
+    // And accepted again once some connection is closed.
+    fds.pop_back();
+    stats = server.WaitFor(
+        [](const AcceptorStats& s) { return s.connections == 1; });
+    EXPECT_EQ(stats.connections, 1);
+    fds.emplace_back(tcp_connect(endpoint, nullptr));
+    stats = server.WaitFor(
+        [](const AcceptorStats& s) { return s.connections == 2; });
+    EXPECT_EQ(stats.accepted, 4);
+    EXPECT_EQ(stats.rejected, 1);
+}
+
+TEST(ServerTest, AcceptBatch) {
+    FLAGS_accept_batch = 2;
+    const EndPoint endpoint(IP_ANY, 8114);
+    ServerThread server(endpoint, ServerOptions());
+
+    // The backlog is drained by several loops, without further events.
+    std::vector<OwnedFD> fds;
+    for (int i = 0; i < 9; ++i) {
+        fds.emplace_back(tcp_connect(endpoint, nullptr));
+        ASSERT_TRUE(fds.back().valid());
+    }
+    server.Run();
+    auto stats = server.WaitFor(
+        [](const AcceptorStats& s) { return s.connections == 9; });
+    EXPECT_EQ(stats.accepted, 9);
+    EXPECT_EQ(stats.rejected, 0);
+    FLAGS_accept_batch = 64;
+}
+
+TEST(ServerTest, ShedConnectionsWithoutDescriptors) {
+    const EndPoint endpoint(IP_ANY, 8115);
+    ServerThread server(endpoint, ServerOptions());
+
+    std::vector<OwnedFD> fds;
+    for (int i = 0; i < 4; ++i) {
+        fds.emplace_back(tcp_connect(endpoint, nullptr));
+        ASSERT_TRUE(fds.back().valid());
+    }
+
+    // Leave descriptors for 2 connections only.
+    struct rlimit limit;
+    ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &limit), 0);
+    const int lowest = dup(0);
+    ASSERT_GE(lowest, 0);
+    close(lowest);
+    struct rlimit lowered = limit;
+    lowered.rlim_cur = lowest + 2;
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &lowered), 0);
+    server.Run();
+    auto stats = server.WaitFor(
+        [](const AcceptorStats& s) { return s.accepted == 4; });
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &limit), 0);
+
+    EXPECT_EQ(stats.accepted, 4);
+    EXPECT_EQ(stats.connections, 2);
+    EXPECT_EQ(stats.rejected, 2);
+    // The backlog is accepted in order.
+    char c;
+    EXPECT_EQ(recv(fds[0], &c, 1, MSG_DONTWAIT), -1);
+    EXPECT_EQ(errno, EAGAIN);
+    EXPECT_TRUE(ClosedByPeer(fds[2]));
+    EXPECT_TRUE(ClosedByPeer(fds[3]));
+}
@@ -0,0 +1,203 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <echo.pb.h>
+#include <errno.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <memory>
+#include <string>
+
+#include "urpc/iobuf.h"
+#include "urpc/owned_fd.h"
+#include "urpc/shm_link.h"
+#include "urpc/stats.h"
+
+DECLARE_int32(shm_ring_size);
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+class EchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        done->Run();
+    }
+};
+
+void SetTrue(bool* flag) { *flag = true; }
+
+std::string Echo(Channel* channel, Controller* cntl,
+                 const std::string& message) {
+    EchoService_Stub stub(channel);
+    EchoRequest request;
+    EchoResponse response;
+    request.set_message(message);
+    bool done = false;
+    stub.Echo(cntl, &request, &response, NewCallback(&SetTrue, &done));
+    while (!done) {
+        IOContext context(LOOP_ONCE);
+    }
+    return response.message();
+}
+
+bool IsEventFd(int fd) {
+    char path[64];
+    char target[64] = {};
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    if (readlink(path, target, sizeof(target) - 1) < 0)
+        return false;
+    return std::string(target) == "anon_inode:[eventfd]";
+}
+
+class ShmTest : public testing::Test {
+protected:
+    void SetUp() override { FLAGS_shm_ring_size = 4096; }
+    void TearDown() override { FLAGS_shm_ring_size = 4 * 1024 * 1024; }
+};
+
+}  // namespace
+
+TEST_F(ShmTest, Link) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    OwnedFD client_fd(fds[0]), server_fd(fds[1]);
+
+    auto client = ShmLink::Connect(client_fd);
+    ASSERT_NE(client, nullptr);
+    IOPortal buf;
+    std::unique_ptr<ShmLink> server;
+    ASSERT_EQ(ShmLink::Accept(server_fd, &buf, &server), 16);
+    ASSERT_NE(server, nullptr);
+    EXPECT_TRUE(buf.empty());
+    OwnedFD client_bell = client->TakeBell();
+    OwnedFD server_bell = server->TakeBell();
+
+    // The reader waiting on an empty ring is woken by the writer.
+    ASSERT_EQ(server->Read(&buf, 1024), -1);
+    EXPECT_EQ(errno, EAGAIN);
+    IOBuf out;
+    out.append(std::string(3000, 'a'));
+    ASSERT_EQ(client->Write(&out), 3000);
+    uint64_t value = 0;
+    EXPECT_EQ(read(server_bell, &value, sizeof(value)), sizeof(value));
+
+    // The writer waiting on a full ring is woken by the reader, and the
+    // bytes wrap around the end of the ring.
+    out.append(std::string(3000, 'b'));
+    ASSERT_EQ(client->Write(&out), 4096 - 3000);
+    ASSERT_EQ(client->Write(&out), -1);
+    EXPECT_EQ(errno, EAGAIN);
+    ASSERT_EQ(server->Read(&buf, 4096), 4096);
+    EXPECT_EQ(read(client_bell, &value, sizeof(value)), sizeof(value));
+    ASSERT_EQ(client->Write(&out), 3000 - (4096 - 3000));
+    EXPECT_TRUE(out.empty());
+    ASSERT_EQ(server->Read(&buf, 4096), 3000 - (4096 - 3000));
+    EXPECT_EQ(buf.to_string(), std::string(3000, 'a') + std::string(3000, 'b'));
+
+    // The reader never read is taken as waiting, no bell rings after it
+    // reads until it waits again.
+    out.append("reply");
+    ASSERT_EQ(server->Write(&out), 5);
+    EXPECT_EQ(read(client_bell, &value, sizeof(value)), sizeof(value));
+    buf.clear();
+    ASSERT_EQ(client->Read(&buf, 1024), 5);
+    EXPECT_EQ(buf.to_string(), "reply");
+    out.append("again");
+    ASSERT_EQ(server->Write(&out), 5);
+    EXPECT_EQ(read(client_bell, &value, sizeof(value)), -1);
+    buf.clear();
+    ASSERT_EQ(client->Read(&buf, 1024), 5);
+
+    // Watch the socket for the close of the peer.
+    bool closed = false;
+    server->Watch(std::move(server_fd), [&closed] { closed = true; });
+    client.reset();
+    client_fd.reset();
+    while (!closed) {
+        IOContext context(LOOP_ONCE);
+    }
+}
+
+TEST_F(ShmTest, NotHandshake) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    OwnedFD client_fd(fds[0]), server_fd(fds[1]);
+    ASSERT_EQ(write(client_fd, "GET / HTTP/1.1\r\n", 16), 16);
+
+    IOPortal buf;
+    std::unique_ptr<ShmLink> server;
+    ASSERT_EQ(ShmLink::Accept(server_fd, &buf, &server), 16);
+    EXPECT_EQ(server, nullptr);
+    EXPECT_EQ(buf.to_string(), "GET / HTTP/1.1\r\n");
+}
+
+TEST_F(ShmTest, Echo) {
+    const std::string path = "/tmp/urpc_shm_test.sock";
+    EndPoint endpoint;
+    ASSERT_EQ(str2endpoint(("unix:" + path).c_str(), &endpoint), 0);
+    Server server;
+    server.AddService(new EchoServiceImpl, SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(endpoint), 0);
+
+    ChannelOptions options;
+    options.use_shared_memory = true;
+    Channel shm_channel;
+    ASSERT_EQ(shm_channel.Init(("unix:" + path).c_str(), options), 0);
+    // Larger than the rings.
+    const std::string large(100 * 1024, 'x');
+    for (auto&& message : {std::string("hello"), large}) {
+        std::unique_ptr<Controller> cntl(NewURPCController());
+        EXPECT_EQ(Echo(&shm_channel, cntl.get(), message), message);
+        EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+    }
+
+    // The clients without shared memory are served as well.
+    OwnedFD fd(tcp_connect(endpoint, nullptr));
+    ASSERT_TRUE(fd.valid());
+    const std::string request = "GET /health HTTP/1.1\r\n\r\n";
+    ASSERT_EQ(write(fd, request.data(), request.size()), request.size());
+    std::string response;
+    while (response.find("OK") == std::string::npos) {
+        IOContext context(LOOP_ONCE);
+        char buf[256];
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0)
+            response.append(buf, n);
+    }
+    EXPECT_EQ(response.find("HTTP/1.1 200"), 0);
+
+    // Both sides of the connection poll their bells.
+    int bells = 0;
+    for (auto&& stats : StatsRegistry::singleton()->ListTransports()) {
+        if (stats.fd >= 0 && IsEventFd(stats.fd))
+            bells++;
+    }
+    EXPECT_EQ(bells, 2);
+    unlink(path.c_str());
+}
@@ -0,0 +1,195 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <echo.pb.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "urpc/owned_fd.h"
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+/// Responds once the test runs the closures.
+class DelayedEchoService : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        pending.push_back(done);
+    }
+
+    void RunPending() {
+        auto dones = std::move(pending);
+        pending.clear();
+        for (auto done : dones)
+            done->Run();
+    }
+
+    std::vector<Closure*> pending;
+};
+
+/// The services are shared by the servers of a thread, so is the one added.
+DelayedEchoService* AddService(Server* server) {
+    static DelayedEchoService service;
+    server->AddService(&service, SERVER_DOESNT_OWN_SERVICE);
+    return &service;
+}
+
+void SetTrue(bool* flag) { *flag = true; }
+
+/// Run the loop until `pred` holds or `timeout_ms` elapses.
+bool LoopUntil(const std::function<bool()>& pred, int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeout_ms);
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        IOContext context(LOOP_ONCE);
+    }
+    return true;
+}
+
+/// The bytes received until the peer closes `fd`, or nothing is received in
+/// a while.
+std::string ReceiveUntilClosed(int fd) {
+    std::string received;
+    char buf[1024];
+    for (int i = 0; i < 100; ++i) {
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n == 0)
+            break;
+        if (n > 0)
+            received.append(buf, n);
+        else
+            IOContext context(LOOP_ONCE);
+    }
+    return received;
+}
+
+}  // namespace
+
+TEST(ShutdownTest, DrainsRequestsInProcessing) {
+    const EndPoint endpoint(IP_ANY, 8119);
+    Server server;
+    auto service = AddService(&server);
+    ASSERT_EQ(server.Start(endpoint), 0);
+
+    ChannelOptions options;
+    Channel channel;
+    ASSERT_EQ(channel.Init("127.0.0.1:8119", options), 0);
+    EchoService_Stub stub(&channel);
+    EchoRequest request;
+    EchoResponse response;
+    request.set_message("hello");
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    bool done = false;
+    stub.Echo(cntl.get(), &request, &response, NewCallback(&SetTrue, &done));
+    ASSERT_TRUE(LoopUntil([&] { return service->pending.size() == 1; }, 1000));
+
+    // New connections are refused, the request in processing is served.
+    ASSERT_EQ(server.Stop(), 0);
+    EXPECT_EQ(server.Stop(), -1);
+    EXPECT_LT(tcp_connect(endpoint, nullptr), 0);
+    service->RunPending();
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(server.Join(1000), 0);
+    EXPECT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::milliseconds(1000));
+    ASSERT_TRUE(done);
+    EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+    EXPECT_EQ(response.message(), "hello");
+
+    // The client reconnects to the restarted server.
+    Server restarted;
+    ASSERT_EQ(restarted.Start(endpoint), 0);
+    cntl.reset(NewURPCController());
+    done = false;
+    stub.Echo(cntl.get(), &request, &response, NewCallback(&SetTrue, &done));
+    ASSERT_TRUE(LoopUntil([&] { return service->pending.size() == 1; }, 1000));
+    service->RunPending();
+    ASSERT_TRUE(LoopUntil([&] { return done; }, 1000));
+    EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+}
+
+TEST(ShutdownTest, HTTPConnectionClose) {
+    const EndPoint endpoint(IP_ANY, 8120);
+    Server server;
+    auto service = AddService(&server);
+    ASSERT_EQ(server.Start(endpoint), 0);
+
+    OwnedFD fd(tcp_connect(endpoint, nullptr));
+    ASSERT_TRUE(fd.valid());
+    const std::string body = "{\"message\":\"hi\"}";
+    const std::string request =
+        "POST /test.EchoService/Echo HTTP/1.1\r\nContent-Length: " +
+        std::to_string(body.size()) + "\r\n\r\n" + body;
+    ASSERT_EQ(write(fd, request.data(), request.size()),
+              static_cast<ssize_t>(request.size()));
+    ASSERT_TRUE(LoopUntil([&] { return service->pending.size() == 1; }, 1000));
+
+    ASSERT_EQ(server.Stop(), 0);
+    service->RunPending();
+    ASSERT_EQ(server.Join(1000), 0);
+    const std::string response = ReceiveUntilClosed(fd);
+    EXPECT_NE(response.find("200 OK"), std::string::npos) << response;
+    EXPECT_NE(response.find("Connection: close"), std::string::npos)
+        << response;
+}
+
+TEST(ShutdownTest, JoinTimeout) {
+    const EndPoint endpoint(IP_ANY, 8122);
+    Server server;
+    auto service = AddService(&server);
+    ASSERT_EQ(server.Start(endpoint), 0);
+
+    ChannelOptions options;
+    options.max_retry = 0;
+    Channel channel;
+    ASSERT_EQ(channel.Init("127.0.0.1:8122", options), 0);
+    EchoService_Stub stub(&channel);
+    EchoRequest request;
+    EchoResponse response;
+    request.set_message("hello");
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    bool done = false;
+    stub.Echo(cntl.get(), &request, &response, NewCallback(&SetTrue, &done));
+    ASSERT_TRUE(LoopUntil([&] { return service->pending.size() == 1; }, 1000));
+
+    // The connection busy with the request is closed at the deadline.
+    ASSERT_EQ(server.Stop(), 0);
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(server.Join(200), 0);
+    EXPECT_GE(std::chrono::steady_clock::now() - start,
+              std::chrono::milliseconds(200));
+    EXPECT_TRUE(LoopUntil([&] { return done; }, 1000));
+    EXPECT_TRUE(cntl->Failed());
+    service->RunPending();
+}
@@ -0,0 +1,137 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <echo.pb.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "urpc/owned_fd.h"
+#include "urpc/stats.h"
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+class EchoServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        response->set_message(request->message());
+        done->Run();
+    }
+};
+
+void SetTrue(bool* flag) { *flag = true; }
+
+/// The connections accepted from unix domain sockets.
+int CountUnixConnections() {
+    int count = 0;
+    for (auto&& stats : StatsRegistry::singleton()->ListTransports()) {
+        if (stats.server_side && stats.remote_side.family == AF_UNIX)
+            count++;
+    }
+    return count;
+}
+
+}  // namespace
+
+TEST(StatsTest, TransportAndPoller) {
+    Server server;
+    server.AddService(new EchoServiceImpl,
+                      ServiceOwnership::SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8087)), 0);
+
+    Channel channel;
+    ASSERT_EQ(channel.Init("127.0.0.1:8087", ChannelOptions()), 0);
+    EchoService_Stub stub(&channel);
+    std::unique_ptr<Controller> cntl(NewURPCController());
+    EchoRequest request;
+    EchoResponse response;
+    request.set_message("hello world");
+    bool done = false;
+    stub.Echo(cntl.get(), &request, &response, NewCallback(&SetTrue, &done));
+    while (!done) {
+        IOContext context(LOOP_ONCE);
+    }
+
+    auto transports = StatsRegistry::singleton()->ListTransports();
+    ASSERT_EQ(transports.size(), 2);
+    for (auto&& stats : transports) {
+        EXPECT_EQ(stats.messages_in, 1);
+        EXPECT_EQ(stats.messages_out, 1);
+        EXPECT_GT(stats.bytes_in, 0);
+        EXPECT_GT(stats.bytes_out, 0);
+        EXPECT_EQ(stats.pending_writes, 0);
+        EXPECT_EQ(stats.pending_bytes, 0);
+    }
+
+    auto pollers = StatsRegistry::singleton()->ListPollers();
+    ASSERT_EQ(pollers.size(), 1);
+    EXPECT_GT(pollers[0].wakeups, 0);
+    EXPECT_GE(pollers[0].events, pollers[0].wakeups);
+    EXPECT_EQ(pollers[0].handles, 3);
+
+    auto acceptors = StatsRegistry::singleton()->ListAcceptors();
+    ASSERT_EQ(acceptors.size(), 1);
+    EXPECT_EQ(acceptors[0].accepted, 1);
+    EXPECT_EQ(acceptors[0].poller_id, pollers[0].id);
+}
+
+TEST(StatsTest, ListedByOtherThreads) {
+    const std::string path = "/tmp/urpc_stats_test.sock";
+    EndPoint endpoint;
+    ASSERT_EQ(str2endpoint(("unix:" + path).c_str(), &endpoint), 0);
+    Server server;
+    ASSERT_EQ(server.Start(endpoint), 0);
+
+    // The connections are listed while they are opened and closed.
+    std::atomic<bool> stop{false};
+    std::atomic<int> listed{0};
+    std::thread lister([&] {
+        while (!stop.load())
+            listed += CountUnixConnections();
+    });
+    for (int i = 0; i < 50; ++i) {
+        OwnedFD fd(tcp_connect(endpoint, nullptr));
+        ASSERT_TRUE(fd.valid());
+        while (CountUnixConnections() == 0) {
+            IOContext context(LOOP_ONCE);
+        }
+        const int seen = listed.load();
+        while (listed.load() == seen)
+            std::this_thread::yield();
+        fd.reset();
+        while (CountUnixConnections() != 0) {
+            IOContext context(LOOP_ONCE);
+        }
+    }
+    stop.store(true);
+    lister.join();
+    EXPECT_GE(listed.load(), 50);
+    unlink(path.c_str());
+}
@@ -0,0 +1,218 @@
+// Copyright 2022 The urpc Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <echo.pb.h>
+#include <gtest/gtest.h>
+#include <urpc/channel.h>
+#include <urpc/controller.h>
+#include <urpc/endpoint.h>
+#include <urpc/io_context.h>
+#include <urpc/server.h>
+#include <urpc/stream.h>
+
+#include <memory>
+#include <string>
+
+#include "urpc/base.h"
+#include "urpc/iobuf.h"
+
+using namespace google::protobuf;
+
+using namespace urpc;
+using namespace test;
+
+namespace {
+
+constexpr size_t kChunkSize = 64 * 1024;
+constexpr size_t kTotalSize = 64 * kChunkSize;
+constexpr int64_t kWindowSize = 4 * kChunkSize;
+
+/// Write `kTotalSize` bytes to a stream as fast as the window allows, and
+/// close it once all are written.
+class Pusher {
+public:
+    explicit Pusher(StreamWriter* stream) : stream_(stream) {}
+
+    void Push() {
+        while (written < kTotalSize) {
+            IOBuf chunk;
+            chunk.append(std::string(kChunkSize, 'a' + written % 26));
+            int code = stream_->Write(std::move(chunk));
+            if (code == ERR_STREAM_FULL) {
+                full_count++;
+                stream_->NotifyOnWritable(NewCallback(this, &Pusher::Push));
+                return;
+            }
+            if (code != ERR_OK) {
+                error_code = code;
+                break;
+            }
+            written += kChunkSize;
+        }
+        if (stream_) {
+            stream_->Close();
+            stream_ = nullptr;
+        }
+    }
+
+    size_t written{0};
+    size_t full_count{0};
+    int error_code{ERR_OK};
+
+private:
+    StreamWriter* stream_;
+};
+
+class Collector : public StreamReader {
+public:
+    void OnChunk(StreamWriter* stream, IOBuf chunk) override {
+        EXPECT_EQ(chunk.to_string(),
+                  std::string(chunk.size(), 'a' + received % 26));
+        received += chunk.size();
+    }
+
+    void OnClosed(StreamWriter* stream, int code) override {
+        closed = true;
+        error_code = code;
+        stream->Close();
+    }
+
+    size_t received{0};
+    bool closed{false};
+    int error_code{-1};
+};
+
+class StreamServiceImpl : public EchoService {
+public:
+    void Echo(RpcController* controller, const EchoRequest* request,
+              EchoResponse* response, Closure* done) override {
+        auto cntl = static_cast<Controller*>(controller);
+        StreamOptions options;
+        options.window_size = kWindowSize;
+        if (request->message() == "download") {
+            // Chunks are pushed before the response.
+            pusher.reset(new Pusher(StreamAccept(cntl, options)));
+            pusher->Push();
+        } else if (request->message() == "upload") {
+            options.reader = &collector;
+            EXPECT_NE(StreamAccept(cntl, options), nullptr);
+            EXPECT_EQ(StreamAccept(cntl, options), nullptr);
+        } else if (request->message() == "fail") {
+            // The accepted stream is closed once the method fails.
+            options.reader = &failed_collector;
+            EXPECT_NE(StreamAccept(cntl, options), nullptr);
+            cntl->SetFailed(ERR_NOT_SUPPORTED, "failed");
+        } else {
+            EXPECT_EQ(StreamAccept(cntl, options), nullptr);
+        }
+        response->set_message(request->message());
+        done->Run();
+    }
+
+    std::unique_ptr<Pusher> pusher;
+    Collector collector;
+    Collector failed_collector;
+};
+
+void SetTrue(bool* flag) { *flag = true; }
+
+void Call(Channel* channel, Controller* cntl, const std::string& message) {
+    EchoService_Stub stub(channel);
+    EchoRequest request;
+    EchoResponse response;
+    request.set_message(message);
+    bool done = false;
+    stub.Echo(cntl, &request, &response, NewCallback(&SetTrue, &done));
+    while (!done) {
+        IOContext context(LOOP_ONCE);
+    }
+}
+
+}  // namespace
+
+TEST(StreamTest, Streaming) {
+    auto service = new StreamServiceImpl;
+    Server server;
+    server.AddService(service, ServiceOwnership::SERVER_OWNS_SERVICE);
+    ASSERT_EQ(server.Start(EndPoint(IP_ANY, 8094)), 0);
+
+    Channel channel;
+    ASSERT_EQ(channel.Init("127.0.0.1:8094", ChannelOptions()), 0);
+
+    // Server-side streaming.
+    {
+        Collector collector;
+        StreamOptions options;
+        options.reader = &collector;
+        options.window_size = kWindowSize;
+        std::unique_ptr<Controller> cntl(NewURPCController());
+        ASSERT_NE(StreamCreate(cntl.get(), options), nullptr);
+        EXPECT_EQ(StreamCreate(cntl.get(), options), nullptr);
+        Call(&channel, cntl.get(), "download");
+        EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+        while (!collector.closed) {
+            IOContext context(LOOP_ONCE);
+        }
+        EXPECT_EQ(collector.error_code, ERR_OK);
+        EXPECT_EQ(collector.received, kTotalSize);
+        EXPECT_EQ(service->pusher->written, kTotalSize);
+        EXPECT_GT(service->pusher->full_count, 0);
+    }
+
+    // Client-side streaming.
+    {
+        StreamOptions options;
+        options.window_size = kWindowSize;
+        std::unique_ptr<Controller> cntl(NewURPCController());
+        auto stream = StreamCreate(cntl.get(), options);
+        ASSERT_NE(stream, nullptr);
+        IOBuf chunk;
+        chunk.append("too early");
+        EXPECT_EQ(stream->Write(std::move(chunk)), ERR_STREAM_FULL);
+
+        Pusher pusher(stream);
+        stream->NotifyOnWritable(NewCallback(&pusher, &Pusher::Push));
+        Call(&channel, cntl.get(), "upload");
+        EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+        while (!service->collector.closed) {
+            IOContext context(LOOP_ONCE);
+        }
+        EXPECT_EQ(pusher.written, kTotalSize);
+        EXPECT_EQ(pusher.error_code, ERR_OK);
+        EXPECT_EQ(service->collector.error_code, ERR_OK);
+        EXPECT_EQ(service->collector.received, kTotalSize);
+    }
+
+    // The stream is closed if the method fails.
+    {
+        Collector collector;
+        StreamOptions options;
+        options.reader = &collector;
+        std::unique_ptr<Controller> cntl(NewURPCController());
+        StreamCreate(cntl.get(), options);
+        Call(&channel, cntl.get(), "fail");
+        EXPECT_TRUE(cntl->Failed());
+        EXPECT_TRUE(collector.closed);
+        EXPECT_EQ(collector.error_code, ERR_STREAM_CLOSED);
+        EXPECT_TRUE(service->failed_collector.closed);
+        EXPECT_EQ(service->failed_collector.error_code, ERR_STREAM_CLOSED);
+    }
+
+    // The stream isn't accepted without StreamCreate().
+    {
+        std::unique_ptr<Controller> cntl(NewURPCController());
+        Call(&channel, cntl.get(), "plain");
+        EXPECT_FALSE(cntl->Failed()) << cntl->ErrorText();
+    }
+}